@@ -25,6 +25,7 @@ THE SOFTWARE.
 */
 
 #include "GsageFacade.h"
+#include "lua/LuaAllocator.h"
 
 #include <stdio.h>
 #include <thread>
@@ -68,7 +69,7 @@ extern "C" {
       Gsage::GsageFacade facade;
       std::string coreConfig = "gameConfig.json";
 
-      lua_State* L = lua_open();
+      lua_State* L = Gsage::LuaAllocator::newState();
       if(!L) {
         LOG(ERROR) << "Lua state is not initialized";
         return 1;
@@ -0,0 +1,282 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2016 Artem Chernyshev
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#define POCO_NO_UNWINDOWS
+#include "GsageFacade.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+#include "Logger.h"
+#include "Engine.h"
+#include "EngineSystem.h"
+#include "lua/LuaInterface.h"
+
+#ifndef RESOURCES_FOLDER
+#define RESOURCES_FOLDER "./resources"
+#endif
+
+#include "sol.hpp"
+
+namespace {
+
+  typedef std::chrono::high_resolution_clock Clock;
+
+  const std::string NULL_RENDER_SYSTEM = "NULL Rendering Subsystem";
+
+  double elapsed(const Clock::time_point& since)
+  {
+    return std::chrono::duration<double>(Clock::now() - since).count();
+  }
+
+  /**
+   * Copy list skipping the values matching the key
+   */
+  Gsage::DataProxy filterList(const Gsage::DataProxy& list, const std::string& key, const std::string& value)
+  {
+    Gsage::DataProxy res = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    for(auto pair : list) {
+      std::string v = key.empty() ? pair.second.getValueOptional<std::string>("") : pair.second.get(key, "");
+      if(v != value) {
+        res.push(pair.second);
+      }
+    }
+    return res;
+  }
+
+  /**
+   * Set up headless engine configuration: NULL render system and navigation system only
+   */
+  void configureHeadless(Gsage::DataProxy& config)
+  {
+    config.put("startupScript", "");
+    config.put("startLuaInterface", true);
+    config.put("packager.installOnStartup", false);
+
+    Gsage::DataProxy plugins = config.get("plugins", Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY));
+    plugins = filterList(plugins, "", "OgrePlugin");
+    plugins = filterList(plugins, "", "RecastNavigationPlugin");
+    plugins.push(std::string("OgrePlugin"));
+    plugins.push(std::string("RecastNavigationPlugin"));
+    config.put("plugins", plugins);
+
+    Gsage::DataProxy systems = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    systems.push(std::string("render"));
+    systems.push(std::string("navigation"));
+    config.put("systems", systems);
+    config.put("systemTypes.render", "ogre");
+    config.put("systemTypes.navigation", "recast");
+
+    // NULL render system goes first, others are kept as a fallback
+    Gsage::DataProxy renderSystems = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    Gsage::DataProxy nullRenderSystem = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+    nullRenderSystem.put("id", NULL_RENDER_SYSTEM);
+    renderSystems.push(nullRenderSystem);
+    for(auto pair : filterList(config.get("render.renderSystems", renderSystems), "id", NULL_RENDER_SYSTEM)) {
+      renderSystems.push(pair.second);
+    }
+    config.put("render.renderSystems", renderSystems);
+
+    Gsage::DataProxy renderPlugins = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    renderPlugins.push(std::string("RenderSystem_NULL"));
+    for(auto pair : filterList(config.get("render.plugins", renderPlugins), "", "RenderSystem_NULL")) {
+      renderPlugins.push(pair.second);
+    }
+    config.put("render.plugins", renderPlugins);
+    config.put("render.window.useWindowManager", false);
+
+    config.put("dataManager.scenesFolder", config.get("navbake.scenesFolder", "bundles/scenes"));
+  }
+
+  /**
+   * Create static entity from the mesh file
+   */
+  bool loadMesh(Gsage::GsageFacade& facade, const std::string& path)
+  {
+    Gsage::Filesystem* fs = facade.filesystem();
+    if(!fs->exists(path)) {
+      LOG(ERROR) << "Mesh file " << path << " does not exist";
+      return false;
+    }
+
+    Gsage::DataProxy location = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    location.push("FileSystem;" + fs->directory(path));
+
+    Gsage::DataProxy model = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+    model.put("type", "model");
+    model.put("mesh", fs->filename(path));
+    model.put("name", fs->basename(path));
+
+    Gsage::DataProxy children = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_ARRAY);
+    children.push(model);
+
+    Gsage::DataProxy entity = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+    entity.put("id", fs->basename(path));
+    entity.put("render.resources.navbake", location);
+    entity.put("render.root.children", children);
+    return facade.getEngine()->createEntity(entity) != nullptr;
+  }
+
+  /**
+   * Rebuild navmesh using navigation system bindings and save it
+   */
+  bool bake(Gsage::GsageFacade& facade, Gsage::DataProxy options, const std::string& output)
+  {
+    sol::state_view lua(facade.getLuaState());
+    sol::protected_function getNavigation = lua["Engine"]["navigation"];
+    if(!getNavigation.valid()) {
+      LOG(ERROR) << "RecastNavigation plugin is not installed";
+      return false;
+    }
+
+    sol::protected_function_result res = getNavigation(facade.getEngine());
+    if(!res.valid() || res.get_type() != sol::type::userdata) {
+      LOG(ERROR) << "Navigation system is not available";
+      return false;
+    }
+
+    sol::userdata navigation = res;
+    options.put("merge", false);
+    sol::protected_function rebuild = navigation["rebuildNavMesh"];
+    res = rebuild(navigation, options);
+    if(!res.valid() || !res.get<bool>()) {
+      return false;
+    }
+
+    sol::protected_function dump = navigation["dumpNavMesh"];
+    res = dump(navigation, output);
+    if(!res.valid() || !res.get<bool>()) {
+      LOG(ERROR) << "Failed to write navmesh " << output;
+      return false;
+    }
+    return true;
+  }
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int main(int argc, char *argv[])
+    {
+      Gsage::GsageFacade facade;
+      if(argc < 3) {
+        LOG(ERROR) << "Usage: executable config.json output [scene|file.mesh ...]";
+        return 1;
+      }
+
+      std::string coreConfig(argv[1]);
+      std::string outputFolder(argv[2]);
+      Gsage::DataProxy env;
+      env.put("workdir", RESOURCES_FOLDER);
+      env.put<int>("configEncoding", Gsage::FileLoader::Json);
+      Gsage::FileLoader::init(env);
+      Gsage::DataProxy config;
+      if(!Gsage::FileLoader::getSingletonPtr()->load(coreConfig, Gsage::DataProxy(), config))
+      {
+        LOG(ERROR) << "Failed to load file " << coreConfig;
+        return 1;
+      }
+
+      configureHeadless(config);
+
+      if(!facade.initialize(config, RESOURCES_FOLDER, 0))
+      {
+        LOG(ERROR) << "Failed to initialize game engine";
+        return 1;
+      }
+
+      Gsage::Filesystem* fs = facade.filesystem();
+      if(!fs->mkdir(outputFolder, true)) {
+        LOG(ERROR) << "Failed to create output folder " << outputFolder;
+        return 1;
+      }
+
+      // bake all scenes when there are no inputs
+      std::vector<std::string> inputs(argv + 3, argv + argc);
+      if(inputs.empty()) {
+        std::string scenesFolder = fs->join({RESOURCES_FOLDER, config.get("dataManager.scenesFolder", "")});
+        for(auto& file : fs->ls(scenesFolder)) {
+          if(fs->extension(file) == "json" && file != "placement.json") {
+            inputs.push_back(file);
+          }
+        }
+        std::sort(inputs.begin(), inputs.end());
+      }
+
+      Gsage::DataProxy report = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+      int failed = 0;
+      for(auto& input : inputs) {
+        std::string name = fs->basename(input);
+        std::string output = fs->join({outputFolder, name + ".navmesh"});
+        facade.getEngine()->unloadAll();
+
+        auto start = Clock::now();
+        bool loaded = false;
+        if(fs->extension(input) == "mesh") {
+          loaded = loadMesh(facade, input);
+        } else {
+          loaded = facade.loadScene(input);
+        }
+
+        // update scene graph, so that geometry is extracted in world space
+        loaded = loaded && facade.update();
+        double loadTime = elapsed(start);
+
+        start = Clock::now();
+        Gsage::DataProxy options = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+        Gsage::EngineSystem* navigation = facade.getEngine()->getSystem("navigation");
+        if(navigation) {
+          options = navigation->getConfig().get("build", options);
+        }
+
+        bool success = loaded && bake(facade, options, output);
+        double bakeTime = elapsed(start);
+
+        Gsage::DataProxy entry = Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT);
+        entry.put("success", success);
+        entry.put("loadTime", loadTime);
+        entry.put("bakeTime", bakeTime);
+        entry.put("output", output);
+        report.put(name, entry, false);
+
+        if(!success) {
+          LOG(ERROR) << "Failed to bake navmesh for " << input;
+          failed++;
+          continue;
+        }
+
+        LOG(INFO) << "Baked " << input << " -> " << output << ": load " << loadTime << "s, bake " << bakeTime << "s";
+      }
+
+      Gsage::FileLoader::getSingletonPtr()->dump(fs->join({outputFolder, "report.json"}), report);
+      LOG(INFO) << "Baked " << (inputs.size() - failed) << "/" << inputs.size() << " navmeshes";
+      return failed == 0 ? facade.getExitCode() : 1;
+    }
+#ifdef __cplusplus
+}
+#endif
@@ -26,6 +26,7 @@ THE SOFTWARE.
 
 #define POCO_NO_UNWINDOWS
 #include "GsageFacade.h"
+#include "lua/BytecodeBundle.h"
 
 #include <stdio.h>
 #include <thread>
@@ -46,7 +47,7 @@ extern "C" {
     {
       Gsage::GsageFacade facade;
       if(argc == 1) {
-        LOG(ERROR) << "Usage: executable config.json";
+        LOG(ERROR) << "Usage: executable config.json [--bytecode [output]]";
         return 1;
       }
 
@@ -71,6 +72,25 @@ extern "C" {
         return 1;
       }
 
+      // precompile scripts instead of installing packages
+      if(argc > 2 && std::string(argv[2]) == "--bytecode") {
+        Gsage::DataProxy bytecode = facade.getConfig().get("packager.bytecode", Gsage::DataProxy());
+        std::string root = std::string(RESOURCES_FOLDER) + GSAGE_PATH_SEPARATOR + bytecode.get("root", std::string("scripts"));
+        std::string output = argc > 3 ? argv[3] : std::string(RESOURCES_FOLDER) + GSAGE_PATH_SEPARATOR + bytecode.get("bundle", std::string("scripts.bundle"));
+
+        lua_State* L = luaL_newstate();
+        Gsage::BytecodeBundle bundle;
+        int count = bundle.addFolder(L, root);
+        lua_close(L);
+        if(count < 0 || !bundle.dump(output)) {
+          LOG(ERROR) << "Failed to compile lua scripts from " << root;
+          return 1;
+        }
+
+        LOG(INFO) << "Compiled " << count << " lua scripts into " << output;
+        return 0;
+      }
+
       Gsage::DataProxy deps = facade.getConfig().get("packager.deps", Gsage::DataProxy::create(Gsage::DataWrapper::JSON_OBJECT));
       if(!facade.installLuaPackages(deps)) {
         LOG(ERROR) << "Failed to install packages";
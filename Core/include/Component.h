@@ -65,7 +65,12 @@ namespace Gsage
         return node;
       };
     protected:
+      template<typename T>
+      friend class ComponentStorage;
+
       Entity* mOwner;
+      // time passed since the last update, when updates are skipped by UpdateLOD
+      double mSkippedTime;
   };
 }
 
@@ -29,6 +29,7 @@ THE SOFTWARE.
 
 #include "EngineSystem.h"
 #include "ObjectPool.h"
+#include "UpdateLOD.h"
 
 namespace Gsage
 {
@@ -62,7 +63,7 @@ namespace Gsage
         {
           T* c = allocateComponent();
           c->setOwner(owner);
-          if(!prepareComponent(c) || !c->read(data) || !fillComponentData(c, data))
+          if(!prepareComponent(c) || !readComponent(c, data) || !fillComponentData(c, data))
           {
             removeComponent(c);
             return NULL; // failed to read data from node
@@ -71,6 +72,20 @@ namespace Gsage
           return c;
         }
 
+        /**
+         * Read component properties, lua tables are read directly, without DataProxy casts
+         * @param component Component to read into
+         * @param data DataProxy to read
+         */
+        bool readComponent(T* component, const DataProxy& data)
+        {
+          EntityComponent* c = component;
+          if(data.getWrappedType() == DataWrapper::LUA_TABLE) {
+            return c->read(data.getWrapper<DataWrapper::LUA_TABLE>()->getTable());
+          }
+          return c->read(data);
+        }
+
         /**
          * Fill component data from data node
          * @param component Component to fill
@@ -124,9 +139,25 @@ namespace Gsage
           if(mConfigDirty)
             configUpdated();
 
+          UpdateLOD* lod = getUpdateLOD();
+          if(!lod || !lod->isEnabled())
+          {
+            for(size_t i = 0; i < len; ++i)
+            {
+              updateComponent(components[i], components[i]->getOwner(), time);
+            }
+            return;
+          }
+
+          // distant and invisible entities are updated less often, with the accumulated time
+          double delta;
           for(size_t i = 0; i < len; ++i)
           {
-            updateComponent(components[i], components[i]->getOwner(), time);
+            T* component = components[i];
+            if(lod->tick(component->getOwner(), time, component->mSkippedTime, delta))
+            {
+              updateComponent(component, component->getOwner(), delta);
+            }
           }
         }
         /**
@@ -33,6 +33,9 @@ THE SOFTWARE.
 #include "EventDispatcher.h"
 #include "GsageDefinitions.h"
 #include "Entity.h"
+#include "EntityQuery.h"
+#include "SpatialIndex.h"
+#include "UpdateLOD.h"
 #include "EngineSystem.h"
 #include "EngineEvent.h"
 
@@ -263,6 +266,24 @@ namespace Gsage
        * Get entity list
        */
       ObjectPool<Entity>::PointerVector getEntities() { return mEntities.getElements(); };
+      /**
+       * Get entities that have all specified components and flags.
+       * Query is cached and updated on entity changes, so it is cheap to call it each frame
+       *
+       * @param components Required components
+       * @param flags Required flags
+       */
+      EntityQuery* query(const std::vector<std::string>& components, const std::vector<std::string>& flags = {});
+      /**
+       * Get entity positions index, used for proximity queries.
+       * Render system keeps it in sync with render components
+       */
+      inline SpatialIndex& getSpatialIndex() { return mSpatialIndex; }
+      /**
+       * Get update LOD, it decides how often systems update entities.
+       * Render system provides the viewer position and frustum
+       */
+      inline UpdateLOD& getUpdateLOD() { return mUpdateLOD; }
       /**
        * Get entity by id
        * @param id Entity id
@@ -395,6 +416,9 @@ namespace Gsage
       unsigned long mEntityCounter;
       typedef std::map<const std::string, Entity*> EntityMap;
       EntityMap mEntityMap;
+      EntityQueryIndex mQueries;
+      SpatialIndex mSpatialIndex;
+      UpdateLOD mUpdateLOD;
 
       typedef std::vector<std::string> SystemNames;
       SystemNames mSetUpOrder;
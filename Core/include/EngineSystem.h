@@ -40,6 +40,7 @@ namespace Gsage
 {
   class Engine;
   class EntityComponent;
+  class UpdateLOD;
   class GsageFacade;
   class EngineSystem;
 
@@ -217,6 +218,15 @@ namespace Gsage
        * Check if multithreading is enabled
        */
       inline bool dedicatedThread() { return mDedicatedThread; };
+
+      /**
+       * Get update LOD, used to skip component updates of distant and invisible entities
+       *
+       * "updateLOD" can't be combined with "dedicatedThread": initialize fails in that case.
+       *
+       * @returns 0 if the system has no "updateLOD" flag in the config
+       */
+      UpdateLOD* getUpdateLOD();
       /**
        * This function tells Engine if the particular system allows running in separate thread
        *
@@ -262,6 +272,7 @@ namespace Gsage
       bool mEnabled;
       bool mConfigDirty;
       bool mDedicatedThread;
+      bool mUseUpdateLOD;
       bool mRestart;
 
       std::atomic_bool mReadyWasSet;
@@ -37,6 +37,8 @@ namespace Gsage
 {
   class Engine;
   class EntityComponent;
+  class EntityQueryIndex;
+  class UpdateLOD;
 
   class Entity
   {
@@ -151,6 +153,11 @@ namespace Gsage
        */
       std::vector<std::string> getComponentNames() const;
 
+      /**
+       * Get update rate level, assigned by UpdateLOD, 0 means update each frame
+       */
+      inline unsigned char getUpdateRate() const { return mUpdateRate; }
+
       typedef std::map<const std::string, EntityComponent*> Components;
       typedef Components::const_iterator ComponentsIterator;
 
@@ -158,11 +165,21 @@ namespace Gsage
       Components mComponents;
     private:
       friend class Engine;
+      friend class UpdateLOD;
+      /**
+       * Notify queries about components or flags change
+       */
+      void changed();
+
       std::string mId;
       typedef std::vector<std::string> Flags;
       Flags mFlags;
       std::string mClass;
       DataProxy mVars;
+      EntityQueryIndex* mIndex;
+      unsigned char mUpdateRate;
+      // UpdateLOD frame, which assigned the rate
+      unsigned long mUpdateRateFrame;
   };
 }
 
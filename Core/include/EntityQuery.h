@@ -0,0 +1,202 @@
+#ifndef _EntityQuery_H_
+#define _EntityQuery_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Gsage
+{
+  class Entity;
+
+  /**
+   * Set of entities, which have all the components and all the flags.
+   * Matches are maintained incrementally by EntityQueryIndex.
+   *
+   * Removed entities leave empty slots, which are compacted by EntityQueryIndex::compact
+   * at the start of the engine update, or when entities are accessed by index.
+   * So entities can be removed while iterating slots, none of the remaining ones are skipped.
+   */
+  class EntityQuery
+  {
+    public:
+      typedef std::vector<std::string> Names;
+      typedef std::vector<Entity*> Entities;
+
+      /**
+       * @param components Required components, sorted
+       * @param flags Required flags, sorted
+       */
+      EntityQuery(const Names& components, const Names& flags);
+      virtual ~EntityQuery();
+
+      /**
+       * Check if entity matches the query
+       *
+       * @param entity Entity to check
+       */
+      bool matches(Entity* entity) const;
+
+      /**
+       * Get all matching entities, compacts removed slots
+       */
+      inline const Entities& getEntities() { compact(); return mEntities; }
+
+      /**
+       * Get matching entity by index, compacts removed slots
+       *
+       * @param index Entity index
+       * @returns nullptr if index is out of bounds
+       */
+      inline Entity* get(size_t index) { compact(); return index < mEntities.size() ? mEntities[index] : nullptr; }
+
+      /**
+       * Get entity in the slot, slots are not compacted, so it is safe to remove entities while iterating them
+       *
+       * @param slot Slot index
+       * @returns nullptr if the slot is empty or out of bounds
+       */
+      inline Entity* at(size_t slot) const { return slot < mEntities.size() ? mEntities[slot] : nullptr; }
+
+      /**
+       * Get count of slots, including empty ones
+       */
+      inline size_t slots() const { return mEntities.size(); }
+
+      /**
+       * Get count of matching entities
+       */
+      inline size_t size() const { return mEntities.size() - mEmpty; }
+
+      /**
+       * Remove empty slots left by removed entities
+       */
+      void compact();
+
+      /**
+       * Get required components
+       */
+      inline const Names& getComponents() const { return mComponents; }
+
+      /**
+       * Get required flags
+       */
+      inline const Names& getFlags() const { return mFlags; }
+
+      /**
+       * Build query cache key
+       *
+       * @param components Required components, sorted
+       * @param flags Required flags, sorted
+       */
+      static std::string getKey(const Names& components, const Names& flags);
+    private:
+      friend class EntityQueryIndex;
+
+      /**
+       * Add or remove entity depending on the match
+       */
+      void update(Entity* entity);
+
+      /**
+       * Remove entity from the matches
+       */
+      void remove(Entity* entity);
+
+      /**
+       * Remove all matches
+       */
+      void clear();
+
+      Names mComponents;
+      Names mFlags;
+
+      Entities mEntities;
+      typedef std::unordered_map<Entity*, size_t> Positions;
+      Positions mPositions;
+      size_t mEmpty;
+  };
+
+  /**
+   * Keeps all queries that were ever requested and updates them on entity changes
+   */
+  class EntityQueryIndex
+  {
+    public:
+      typedef EntityQuery::Names Names;
+
+      EntityQueryIndex();
+      virtual ~EntityQueryIndex();
+
+      /**
+       * Get cached query or create a new one
+       *
+       * @param components Required components
+       * @param flags Required flags
+       * @param entities All existing entities, used to fill the new query
+       */
+      EntityQuery* get(Names components, Names flags, const EntityQuery::Entities& entities);
+
+      /**
+       * Update entity matches after components or flags change
+       *
+       * @param entity Changed entity
+       */
+      void update(Entity* entity);
+
+      /**
+       * Remove entity from all queries
+       *
+       * @param entity Removed entity
+       */
+      void remove(Entity* entity);
+
+      /**
+       * Remove all entities from all queries, queries themselves are kept
+       */
+      void clear();
+
+      /**
+       * Compact empty slots in all queries
+       */
+      void compact();
+
+      /**
+       * Get count of cached queries
+       */
+      inline size_t size() const { return mQueries.size(); }
+    private:
+      typedef std::map<std::string, std::unique_ptr<EntityQuery>> Queries;
+      Queries mQueries;
+  };
+}
+
+#endif
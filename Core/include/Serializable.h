@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include "GsageDefinitions.h"
 #include "DataProxy.h"
 #include <map>
+#include <type_traits>
 
 /**
  * Bind member field
@@ -149,8 +150,61 @@ namespace Gsage
        * @param props DataProxy
        */
       virtual bool setProps(const DataProxy& props) = 0;
+
+      /**
+       * Get all class props as lua table
+       *
+       * @param s lua state to create table in
+       */
+      virtual sol::table getPropsTable(sol::this_state s)
+      {
+        sol::table t = sol::state_view(s).create_table();
+        DataProxy dp = DataProxy::wrap(t);
+        getProps().dump(dp);
+        return t;
+      }
+
+      /**
+       * Set all class props from lua table
+       *
+       * @param props lua table
+       */
+      virtual bool setPropsTable(const sol::table& props)
+      {
+        return setProps(DataProxy::create(props));
+      }
+
+      /**
+       * Get single class prop
+       *
+       * @param s lua state
+       * @param name property name
+       */
+      virtual sol::object getProp(sol::this_state s, const std::string& name)
+      {
+        return getPropsTable(s).raw_get<sol::object>(name);
+      }
+
+      /**
+       * Set single class prop
+       *
+       * @param name property name
+       * @param value property value
+       */
+      virtual bool setProp(const std::string& name, const sol::object& value)
+      {
+        sol::table t = sol::state_view(value.lua_state()).create_table();
+        t.raw_set(name, value);
+        return setPropsTable(t);
+      }
   };
 
+  /**
+   * Types that can be passed between lua and C++ without DataProxy casts
+   */
+  template<typename T>
+  struct IsLuaNative : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_same<T, std::string>::value> {};
+
   template<typename Type>
   inline bool get(const DataProxy& dict, const std::string& id, Type& dest)
   {
@@ -195,6 +249,49 @@ namespace Gsage
     return true;
   }
 
+  template<typename Type>
+  inline typename std::enable_if<IsLuaNative<Type>::value, bool>::type get(const sol::table& props, const DataProxy& dict, const std::string& id, Type& dest)
+  {
+    sol::object value = props.raw_get<sol::object>(id);
+    if(value.get_type() == sol::type::lua_nil)
+      return false;
+
+    if(value.is<Type>()) {
+      dest = value.as<Type>();
+      return true;
+    }
+
+    // numbers stored as strings and such are handled by DataProxy casters
+    return get(dict, id, dest);
+  }
+
+  template<typename Type>
+  inline typename std::enable_if<!IsLuaNative<Type>::value, bool>::type get(const sol::table& props, const DataProxy& dict, const std::string& id, Type& dest)
+  {
+    return get(dict, id, dest);
+  }
+
+  template<typename Type>
+  inline typename std::enable_if<IsLuaNative<Type>::value, bool>::type put(sol::table& props, DataProxy& dict, const std::string& id, const Type& value)
+  {
+    props.raw_set(id, value);
+    return true;
+  }
+
+  template<typename Type>
+  inline typename std::enable_if<!IsLuaNative<Type>::value, bool>::type put(sol::table& props, DataProxy& dict, const std::string& id, const Type& value)
+  {
+    return put(dict, id, value);
+  }
+
+  inline bool put(sol::table& props, DataProxy& dict, const std::string& id, const std::string& value)
+  {
+    if(value.empty())
+      return true;
+    props.raw_set(id, value);
+    return true;
+  }
+
   /**
    * Class that has bindings for quick reading fields from DataProxy and writing it to it
    */
@@ -224,6 +321,24 @@ namespace Gsage
            * @param dict DataProxy
            */
           virtual bool dump(DataProxy& dict) = 0;
+          /**
+           * Read property from lua table
+           * @param props lua table
+           * @param dict DataProxy that wraps the same table, used for types that need casting
+           */
+          virtual bool read(const sol::table& props, const DataProxy& dict)
+          {
+            return read(dict);
+          }
+          /**
+           * Write property to lua table
+           * @param props lua table
+           * @param dict DataProxy that wraps the same table, used for types that need casting
+           */
+          virtual bool dump(sol::table& props, DataProxy& dict)
+          {
+            return dump(dict);
+          }
 
           std::string mName;
           bool isFlagSet(const PropertyFlag& flag)
@@ -274,6 +389,36 @@ namespace Gsage
 
             return put(dict, AbstractProperty::mName, *mPropertyPtr);
           }
+
+          /**
+           * Read property value from lua table, without DataProxy casts for lua native types
+           * @param props lua table
+           * @param dict DataProxy that wraps props
+           */
+          bool read(const sol::table& props, const DataProxy& dict)
+          {
+            if(AbstractProperty::isFlagSet(Readonly))
+              return true;
+
+            bool success = get(props, dict, AbstractProperty::mName, *mPropertyPtr);
+            return AbstractProperty::isFlagSet(Optional) ? true : success;
+          }
+
+          /**
+           * Write property to lua table
+           * @param props lua table
+           * @param dict DataProxy that wraps props
+           */
+          bool dump(sol::table& props, DataProxy& dict)
+          {
+            if(AbstractProperty::isFlagSet(Writeonly))
+              return true;
+
+            if(mPropertyPtr == NULL)
+              return false;
+
+            return put(props, dict, AbstractProperty::mName, *mPropertyPtr);
+          }
         private:
           std::string mName;
           T* mPropertyPtr;
@@ -321,6 +466,36 @@ namespace Gsage
 
             return put(dict, AbstractProperty::mName, (mInstance->*mGetter)());
           }
+
+          /**
+           * Read property value from lua table and call class setter
+           * @param props lua table
+           * @param dict DataProxy that wraps props
+           */
+          bool read(const sol::table& props, const DataProxy& dict)
+          {
+            T value;
+            if(mSetter == 0)
+              return true;
+            if(!get(props, dict, AbstractProperty::mName, value))
+              return AbstractProperty::isFlagSet(Optional);
+
+            (mInstance->*mSetter)(value);
+            return true;
+          }
+
+          /**
+           * Call class getter and write return value to lua table
+           * @param props lua table
+           * @param dict DataProxy that wraps props
+           */
+          bool dump(sol::table& props, DataProxy& dict)
+          {
+            if(mGetter == 0)
+              return true;
+
+            return put(props, dict, AbstractProperty::mName, (mInstance->*mGetter)());
+          }
         private:
           TInstance* mInstance;
           TGetter mGetter;
@@ -389,6 +564,45 @@ namespace Gsage
         return allSucceed;
       }
 
+      /**
+       * Iterates through all specified properties and reads each from lua table.
+       * Lua native types are read directly, others are converted by DataProxy
+       * @param props lua table
+       */
+      virtual bool read(const sol::table& props)
+      {
+        DataProxy dict = DataProxy::create(props);
+        bool allSucceed = true;
+        for(auto& pair : mProperties) {
+          for(AbstractProperty* prop : pair.second)
+          {
+            if(!prop->read(props, dict))
+            {
+              allSucceed = false;
+            }
+          }
+        }
+        return allSucceed;
+      }
+
+      /**
+       * Iterates through all specified properties and puts each to lua table
+       * @param props lua table
+       */
+      virtual bool dump(sol::table& props)
+      {
+        DataProxy dict = DataProxy::wrap(props);
+        bool allSucceed = true;
+        for(auto& pair : mProperties) {
+          for(AbstractProperty* prop : pair.second)
+          {
+            if(!prop->dump(props, dict))
+              allSucceed = false;
+          }
+        }
+        return allSucceed;
+      }
+
       /**
        * Get DataProxy with all properties
        *
@@ -411,6 +625,51 @@ namespace Gsage
         return read(props);
       }
 
+      /**
+       * @copydoc Reflection::getPropsTable
+       */
+      virtual sol::table getPropsTable(sol::this_state s)
+      {
+        sol::table t = sol::state_view(s).create_table();
+        dump(t);
+        return t;
+      }
+
+      /**
+       * @copydoc Reflection::setPropsTable
+       */
+      virtual bool setPropsTable(const sol::table& props)
+      {
+        return read(props);
+      }
+
+      /**
+       * @copydoc Reflection::getProp
+       */
+      virtual sol::object getProp(sol::this_state s, const std::string& name)
+      {
+        if(mPropMappings.count(name) == 0)
+          return Reflection::getProp(s, name);
+
+        sol::table t = sol::state_view(s).create_table();
+        DataProxy dict = DataProxy::wrap(t);
+        mPropMappings[name]->dump(t, dict);
+        return t.raw_get<sol::object>(name);
+      }
+
+      /**
+       * @copydoc Reflection::setProp
+       */
+      virtual bool setProp(const std::string& name, const sol::object& value)
+      {
+        if(mPropMappings.count(name) == 0)
+          return Reflection::setProp(name, value);
+
+        sol::table t = sol::state_view(value.lua_state()).create_table();
+        t.raw_set(name, value);
+        return mPropMappings[name]->read(t, DataProxy::create(t));
+      }
+
       /**
        * Register property as serializable
        * @param name Key to search in DataProxy
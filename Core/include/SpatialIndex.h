@@ -0,0 +1,222 @@
+#ifndef _SpatialIndex_H_
+#define _SpatialIndex_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "GeometryPrimitives.h"
+#include "GsageDefinitions.h"
+
+namespace Gsage
+{
+  class Entity;
+
+  /**
+   * Hashed uniform grid of entity positions, used for proximity queries.
+   *
+   * Does not depend on the render system: positions are pushed by the render system
+   * with update calls, entity is moved between cells only when it crosses the cell border.
+   * Each entity is indexed as a point, with the flags, that can be used to filter query results.
+   */
+  class GSAGE_API SpatialIndex
+  {
+    public:
+      typedef std::vector<Entity*> Entities;
+
+      /**
+       * Frustum plane, point is inside if dot(normal, point) + d >= 0
+       */
+      struct Plane
+      {
+        Vector3 normal;
+        double d;
+      };
+
+      typedef std::vector<Plane> Planes;
+
+      /**
+       * @param cellSize Grid cell size, should be close to the typical query radius
+       */
+      SpatialIndex(float cellSize = 16.0f);
+      virtual ~SpatialIndex();
+
+      /**
+       * Change grid cell size, reindexes all entities
+       *
+       * @param cellSize New cell size
+       */
+      void setCellSize(float cellSize);
+
+      /**
+       * Get grid cell size
+       */
+      inline float getCellSize() const { return mCellSize; }
+
+      /**
+       * Add entity to the index or update its position
+       *
+       * @param entity Entity to update
+       * @param position Entity position
+       * @param flags Entity query flags
+       */
+      void update(Entity* entity, const Vector3& position, unsigned int flags = 0xFFFFFFFF);
+
+      /**
+       * Remove entity from the index
+       *
+       * @param entity Entity to remove
+       * @returns true if entity was indexed
+       */
+      bool remove(Entity* entity);
+
+      /**
+       * Check if entity is indexed
+       *
+       * @param entity Entity to check
+       */
+      bool contains(Entity* entity) const;
+
+      /**
+       * Remove all entities
+       */
+      void clear();
+
+      /**
+       * Get count of indexed entities
+       */
+      inline size_t size() const { return mItems.size(); }
+
+      /**
+       * Get entities in the sphere
+       *
+       * @param center Sphere center
+       * @param radius Sphere radius
+       * @param dest Entities list to write to, it is cleared before writing
+       * @param flags Query flags, entity should have at least one of them
+       * @returns count of found entities
+       */
+      size_t queryRadius(const Vector3& center, float radius, Entities& dest, unsigned int flags = 0xFF) const;
+
+      /**
+       * Get entities in the sphere for each center, useful to run many agents queries at once
+       *
+       * @param centers Sphere centers
+       * @param radius Sphere radius
+       * @param dest Entities lists, one per center
+       * @param flags Query flags
+       * @returns total count of found entities
+       */
+      size_t queryRadius(const std::vector<Vector3>& centers, float radius, std::vector<Entities>& dest, unsigned int flags = 0xFF) const;
+
+      /**
+       * Get entities in the bounding box
+       *
+       * @param bounds Bounding box
+       * @param dest Entities list to write to, it is cleared before writing
+       * @param flags Query flags
+       * @returns count of found entities
+       */
+      size_t queryBox(const BoundingBox& bounds, Entities& dest, unsigned int flags = 0xFF) const;
+
+      /**
+       * Get closest entities, sorted by distance
+       *
+       * @param center Point to measure distance from
+       * @param count Max count of entities to get
+       * @param dest Entities list to write to, it is cleared before writing
+       * @param flags Query flags
+       * @param maxDistance Ignore entities that are further than that
+       * @returns count of found entities
+       */
+      size_t queryNearest(const Vector3& center, size_t count, Entities& dest, unsigned int flags = 0xFF, float maxDistance = std::numeric_limits<float>::max()) const;
+
+      /**
+       * Get entities inside of the convex volume, defined by planes
+       *
+       * @param planes Frustum planes, normals point inside
+       * @param dest Entities list to write to, it is cleared before writing
+       * @param flags Query flags
+       * @returns count of found entities
+       */
+      size_t queryFrustum(const Planes& planes, Entities& dest, unsigned int flags = 0xFF) const;
+
+      /**
+       * Visit all indexed entities
+       *
+       * @param f Function, which accepts Entity* and const Vector3& position
+       */
+      template<typename F>
+      void forEach(F f) const
+      {
+        for(auto& item : mItems) {
+          f(item.entity, Vector3(item.x, item.y, item.z));
+        }
+      }
+    private:
+      typedef uint64_t CellKey;
+      typedef std::vector<size_t> Cell;
+
+      struct Item
+      {
+        Entity* entity;
+        float x, y, z;
+        unsigned int flags;
+        CellKey cell;
+        // position in the cell
+        size_t slot;
+      };
+
+      int toCell(double value) const;
+
+      static CellKey getKey(int x, int y, int z);
+
+      void insert(size_t index);
+
+      void erase(size_t index);
+
+      /**
+       * Visit all items in the cells range, falls back to all items when the range has more cells
+       * than there are occupied cells
+       */
+      template<typename F>
+      void visit(double minX, double minY, double minZ, double maxX, double maxY, double maxZ, F f) const;
+
+      float mCellSize;
+      float mInverseCellSize;
+
+      std::vector<Item> mItems;
+      std::unordered_map<Entity*, size_t> mPositions;
+      std::unordered_map<CellKey, Cell> mCells;
+  };
+}
+
+#endif
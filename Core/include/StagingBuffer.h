@@ -0,0 +1,220 @@
+#ifndef _StagingBuffer_H_
+#define _StagingBuffer_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "GeometryPrimitives.h"
+#include "GsageDefinitions.h"
+
+namespace Gsage {
+  /**
+   * Set of rectangles, covering changed areas of an image.
+   *
+   * Overlapping and adjacent rectangles are merged as long as the merged rectangle
+   * does not cover more pixels than the source ones. Rectangles count is limited,
+   * the pair which wastes the least space is merged when the limit is exceeded.
+   */
+  class GSAGE_API DirtyRegions
+  {
+    public:
+      typedef std::vector<Rect<int>> Rects;
+
+      /**
+       * @param maxRects max rectangles count
+       */
+      DirtyRegions(size_t maxRects = 16);
+      virtual ~DirtyRegions();
+
+      /**
+       * Add changed area
+       *
+       * @param area changed rect
+       * @param width image width, area is clipped by it
+       * @param height image height, area is clipped by it
+       */
+      void add(const Rect<int>& area, int width, int height);
+
+      /**
+       * Add all rects from other regions
+       */
+      void add(const DirtyRegions& other, int width, int height);
+
+      /**
+       * Remove all rects
+       */
+      inline void clear() { mRects.clear(); }
+
+      /**
+       * Check if there are no changes
+       */
+      inline bool empty() const { return mRects.empty(); }
+
+      /**
+       * Get merged rects
+       */
+      inline const Rects& get() const { return mRects; }
+
+      /**
+       * Get count of pixels covered by rects
+       */
+      size_t getArea() const;
+    private:
+      void insert(Rect<int> area);
+
+      Rects mRects;
+      size_t mMaxRects;
+  };
+
+  /**
+   * Double buffered image storage, which is used to pass partially updated images
+   * to the render thread.
+   *
+   * Writer copies changed areas into the back buffer. Reader swaps the buffers and
+   * then reads the front buffer without any lock, so writes never wait for the blit.
+   * Reader does not wait for writes either: acquire just reports no changes if the
+   * writer holds the back buffer.
+   */
+  class GSAGE_API StagingBuffer
+  {
+    public:
+      /**
+       * @param maxRects max dirty rectangles count per frame
+       */
+      StagingBuffer(size_t maxRects = 16);
+      virtual ~StagingBuffer();
+
+      /**
+       * Copy changed areas of the image into the back buffer
+       *
+       * @param buffer image data
+       * @param size image data size
+       * @param width image width
+       * @param height image height
+       * @param areas changed rects
+       * @param count rects count
+       */
+      void write(const void* buffer, size_t size, int width, int height, const Rect<int>* areas, size_t count);
+
+      /**
+       * Make the latest written image the front buffer. Should be called from a single reader thread
+       *
+       * @returns true if the front buffer was changed
+       */
+      bool acquire();
+
+      /**
+       * Check if there are written changes, which were not acquired yet
+       */
+      inline bool hasChanges() const { return mChanged.load(std::memory_order_acquire); }
+
+      /**
+       * Front buffer data
+       */
+      inline const char* getData() const { return mFront.data.data(); }
+
+      /**
+       * Front buffer size
+       */
+      inline size_t getSize() const { return mFront.data.size(); }
+
+      /**
+       * Front buffer width
+       */
+      inline int getWidth() const { return mFront.width; }
+
+      /**
+       * Front buffer height
+       */
+      inline int getHeight() const { return mFront.height; }
+
+      /**
+       * Front buffer pixel size in bytes
+       */
+      inline int getPixelSize() const { return mFront.pixelSize; }
+
+      /**
+       * Areas of the front buffer, changed since the previous acquire
+       */
+      inline const DirtyRegions::Rects& getRegions() const { return mFront.regions.get(); }
+
+      /**
+       * Free both buffers
+       */
+      void reset();
+
+      /**
+       * Copy rows from one buffer to another, large copies are split between threads
+       *
+       * @param dest destination buffer
+       * @param destPitch destination row size in bytes
+       * @param src source buffer
+       * @param srcPitch source row size in bytes
+       * @param rowSize bytes to copy in each row
+       * @param rows rows count
+       */
+      static void copyRows(char* dest, size_t destPitch, const char* src, size_t srcPitch, size_t rowSize, size_t rows);
+
+      /**
+       * Copy rect from one image to another of the same size
+       *
+       * @param dest destination image
+       * @param src source image
+       * @param width image width
+       * @param height image height
+       * @param pixelSize pixel size in bytes
+       * @param area rect to copy, it is clipped by the image size
+       */
+      static void copyRect(char* dest, const char* src, int width, int height, int pixelSize, const Rect<int>& area);
+    private:
+      struct Buffer
+      {
+        Buffer(size_t maxRects);
+
+        std::vector<char> data;
+        int width;
+        int height;
+        int pixelSize;
+        DirtyRegions regions;
+      };
+
+      void sync(const Rect<int>* areas, size_t count);
+
+      std::mutex mLock;
+      std::atomic<bool> mChanged;
+
+      Buffer mFront;
+      Buffer mBack;
+      // areas which were changed in the front buffer, but not in the back buffer yet
+      DirtyRegions mStale;
+  };
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _TimerWheel_H_
+#define _TimerWheel_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Gsage {
+
+  /**
+   * Hierarchical timer wheel.
+   *
+   * Timers are stored in 4 levels of 64 slots each, every level covers 64 times more ticks than the previous one.
+   * Timers that are further than 64^4 ticks from now are kept in the overflow list.
+   * Advancing the wheel skips empty slots using per level occupancy masks,
+   * so the cost of advance depends on the number of expired timers, not on the number of scheduled timers.
+   */
+  class TimerWheel
+  {
+    public:
+      typedef uint64_t Tick;
+      typedef uint64_t Payload;
+      typedef std::vector<Payload> Payloads;
+
+      TimerWheel();
+      virtual ~TimerWheel();
+
+      /**
+       * Schedule payload
+       *
+       * @param expire Tick when the timer should fire. Timers that are already due fire on the next advance call
+       * @param payload Arbitrary value to return on expiration
+       */
+      void schedule(Tick expire, Payload payload);
+
+      /**
+       * Advance the wheel
+       *
+       * @param tick Tick to advance the wheel to
+       * @param expired Appends payloads of all timers that expired to this list
+       * @returns count of expired timers
+       */
+      size_t advance(Tick tick, Payloads& expired);
+
+      /**
+       * Get current wheel tick
+       */
+      inline Tick getCurrentTick() const { return mCurrent; }
+
+      /**
+       * Get count of scheduled timers
+       */
+      inline size_t size() const { return mSize; }
+
+      /**
+       * Remove all timers and reset current tick
+       */
+      void clear();
+    private:
+      static const int LEVELS = 4;
+      static const int SLOT_BITS = 6;
+      static const int SLOTS = 1 << SLOT_BITS;
+      static const Tick SLOT_MASK = SLOTS - 1;
+
+      struct Timer
+      {
+        Tick expire;
+        Payload payload;
+      };
+
+      typedef std::vector<Timer> Timers;
+
+      void insert(const Timer& timer);
+
+      void cascade(int level);
+
+      void take(Timers& slot, Payloads& expired);
+
+      Timers mSlots[LEVELS][SLOTS];
+      uint64_t mOccupied[LEVELS];
+
+      Timers mOverflow;
+      Timers mDue;
+
+      Tick mCurrent;
+      size_t mSize;
+  };
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef _TripleBuffer_H_
+#define _TripleBuffer_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <atomic>
+
+namespace Gsage {
+  /**
+   * Lock free single producer single consumer triple buffer.
+   *
+   * Writer fills the back buffer and publishes it, reader acquires the latest
+   * published buffer. Neither side ever waits for the other one, reader can skip
+   * intermediate buffers if writer is faster.
+   */
+  template<class T>
+  class TripleBuffer
+  {
+    public:
+      TripleBuffer()
+        : mBack(0)
+        , mFront(1)
+        , mState(2)
+      {
+      }
+
+      virtual ~TripleBuffer()
+      {
+      }
+
+      /**
+       * Get buffer owned by the writer
+       */
+      T& back()
+      {
+        return mBuffers[mBack];
+      }
+
+      /**
+       * Make back buffer available to the reader, writer gets a free buffer in exchange
+       */
+      void publish()
+      {
+        int state = mState.exchange(mBack | NEW_DATA, std::memory_order_acq_rel);
+        mBack = state & INDEX_MASK;
+      }
+
+      /**
+       * Swap front buffer with the latest published buffer
+       *
+       * @returns false if nothing was published since the last call
+       */
+      bool acquire()
+      {
+        if((mState.load(std::memory_order_relaxed) & NEW_DATA) == 0) {
+          return false;
+        }
+
+        int state = mState.exchange(mFront, std::memory_order_acq_rel);
+        mFront = state & INDEX_MASK;
+        return true;
+      }
+
+      /**
+       * Get buffer owned by the reader
+       */
+      T& front()
+      {
+        return mBuffers[mFront];
+      }
+    private:
+      static const int INDEX_MASK = 0x3;
+      static const int NEW_DATA = 0x4;
+
+      T mBuffers[3];
+      int mBack;
+      int mFront;
+      // index of the ready buffer and new data flag
+      std::atomic<int> mState;
+  };
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef _UpdateLOD_H_
+#define _UpdateLOD_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <mutex>
+
+#include "SpatialIndex.h"
+#include "GsageDefinitions.h"
+
+namespace Gsage
+{
+  class Entity;
+
+  /**
+   * Decides how often entities should be updated by the systems.
+   *
+   * Rate of each indexed entity is calculated once per frame from the distance to the viewer
+   * and from the viewer frustum visibility. Systems, which have updateLOD enabled, skip
+   * entity updates on the frames it should not be ticked and pass accumulated time, when it is.
+   * Rates are updated from the main thread, so systems with dedicatedThread can't use it.
+   */
+  class GSAGE_API UpdateLOD
+  {
+    public:
+      /**
+       * Entity is ticked each 2^rate frame
+       */
+      enum Rate {
+        RATE_FULL = 0,
+        RATE_HALF = 1,
+        RATE_QUARTER = 2,
+        RATE_OFF = 3
+      };
+
+      UpdateLOD();
+      virtual ~UpdateLOD();
+
+      /**
+       * Enable or disable LOD, all entities are updated each frame when disabled
+       */
+      inline void setEnabled(bool value) { mEnabled = value; }
+
+      /**
+       * Check if LOD is enabled
+       */
+      inline bool isEnabled() const { return mEnabled; }
+
+      /**
+       * Set distances, 0 disables the level
+       *
+       * @param half Distance to switch to the half rate
+       * @param quarter Distance to switch to the quarter rate
+       * @param off Distance to stop updating entities
+       */
+      void setDistances(float half, float quarter, float off);
+
+      /**
+       * Set rate for entities outside of the viewer frustum
+       *
+       * @param rate Minimal rate of the entities, that are not visible
+       */
+      inline void setInvisibleRate(Rate rate) { mInvisibleRate = rate; }
+
+      /**
+       * Set viewer state, can be called from the render thread
+       *
+       * @param position Viewer position
+       * @param planes Viewer frustum planes, empty planes mean that everything is visible
+       */
+      void setViewer(const Vector3& position, const SpatialIndex::Planes& planes);
+
+      /**
+       * Calculate rates of all indexed entities, engine calls it at the beginning of each frame
+       *
+       * @param index Spatial index to get entity positions from
+       */
+      void update(const SpatialIndex& index);
+
+      /**
+       * Get rate of the entity, entities which were not rated in the current frame are updated at the full rate
+       *
+       * @param entity Entity
+       */
+      Rate getRate(Entity* entity) const;
+
+      /**
+       * Check if entity should be updated in this frame
+       *
+       * @param entity Entity to check
+       * @param time Frame time
+       * @param accumulated Time accumulated by skipped frames, reset on tick
+       * @param delta Time to pass to the update
+       * @returns true if entity should be updated
+       */
+      bool tick(Entity* entity, double time, double& accumulated, double& delta) const;
+
+      /**
+       * Get frame counter
+       */
+      inline unsigned long getFrame() const { return mFrame; }
+    private:
+      Rate getRate(const Vector3& position) const;
+
+      bool mEnabled;
+      unsigned long mFrame;
+
+      float mHalfDistance;
+      float mQuarterDistance;
+      float mOffDistance;
+      Rate mInvisibleRate;
+
+      Vector3 mViewer;
+      SpatialIndex::Planes mPlanes;
+
+      // viewer state written by the render system
+      Vector3 mPendingViewer;
+      SpatialIndex::Planes mPendingPlanes;
+      bool mViewerDirty;
+      std::mutex mViewerMutex;
+  };
+}
+
+#endif
@@ -112,6 +112,18 @@ namespace Gsage {
        */
       bool dump(DataProxy& dict);
 
+      /**
+       * Stats are free form, so lua table is read the same way as DataProxy
+       * @param props lua table with all stats
+       */
+      bool read(const sol::table& props);
+
+      /**
+       * Stats are free form, so they are written to lua table the same way as to DataProxy
+       * @param props lua table to write to
+       */
+      bool dump(sol::table& props);
+
       /**
        * Increase numeric types, shortcut function
        * If stat is not set it will be set to 0 and then increased
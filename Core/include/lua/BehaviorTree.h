@@ -0,0 +1,162 @@
+#ifndef _BehaviorTree_H_
+#define _BehaviorTree_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <string>
+#include <vector>
+
+#include "sol.hpp"
+
+struct lua_State;
+
+namespace Gsage {
+
+  class BehaviorTreeExecutor;
+
+  /**
+   * Native behavior tree.
+   *
+   * Tree is compiled from the lua description, created by the functions registered with btree.register.
+   * Composite nodes are evaluated in C++, only leaf callbacks and delay closures are called in lua.
+   * Each leaf runs in a separate coroutine, so it can wait for time or signals: such leaf stays running
+   * until the coroutine finishes.
+   */
+  class BehaviorTree
+  {
+    public:
+      enum Status {
+        Success = 0,
+        Failure,
+        Running
+      };
+
+      enum NodeType {
+        Sequence = 0,
+        Selector,
+        Parallel,
+        Invertor,
+        Successor,
+        Repeat,
+        RepeatUntil,
+        Delay,
+        Leaf
+      };
+
+      /**
+       * @param executor Executor that owns the tree
+       * @param context Lua run context
+       */
+      BehaviorTree(BehaviorTreeExecutor* executor, const sol::table& context);
+      virtual ~BehaviorTree();
+
+      /**
+       * Compile lua tree description
+       *
+       * @param root Root node of the lua tree
+       * @returns false if the tree has unknown nodes
+       */
+      bool build(const sol::table& root);
+
+      /**
+       * Tick the tree
+       *
+       * @returns root node status
+       */
+      Status tick();
+
+      /**
+       * Reset nodes state, running leaves are abandoned
+       */
+      void reset();
+
+      /**
+       * Get lua run context
+       */
+      inline sol::table& getContext() { return mContext; }
+
+      /**
+       * Get compiled node count
+       */
+      inline size_t getNodeCount() const { return mNodes.size(); }
+
+      /**
+       * Convert node type from string
+       *
+       * @param value String representation of the node type
+       * @param dest Destination
+       * @returns false if the type is unknown
+       */
+      static bool readNodeType(const std::string& value, NodeType& dest);
+    private:
+      struct Node
+      {
+        Node(NodeType type);
+
+        NodeType type;
+        // children are stored in mChildren starting from this offset
+        int firstChild;
+        int childCount;
+        // running child index for composites
+        int current;
+        // children done mask for parallel node
+        std::vector<char> done;
+        bool failed;
+        // delay node cooldown
+        double readyAt;
+        bool childRunning;
+        // leaf callback or delay closure
+        sol::reference function;
+        // coroutine of the running leaf
+        lua_State* thread;
+        int threadRef;
+      };
+
+      int build(const sol::table& node, int depth);
+
+      Status tick(int index);
+
+      Status startLeaf(Node& node);
+
+      Status pollLeaf(Node& node);
+
+      Status finishLeaf(Node& node, int status);
+
+      void reset(int index);
+
+      int child(const Node& node, int index) const;
+
+      BehaviorTreeExecutor* mExecutor;
+      sol::table mContext;
+
+      std::vector<Node> mNodes;
+      std::vector<int> mChildren;
+      int mRoot;
+  };
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef _BehaviorTreeExecutor_H_
+#define _BehaviorTreeExecutor_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lua/BehaviorTree.h"
+#include "GeometryPrimitives.h"
+#include "DataProxy.h"
+#include "sol.hpp"
+
+struct lua_State;
+
+namespace Gsage {
+
+  class Engine;
+  class ScriptComponent;
+  class CoroutineScheduler;
+
+  /**
+   * Ticks native behavior trees of script components.
+   *
+   * Executor supports:
+   * - per frame budgets: tick count and time limits, trees that did not fit into the budget
+   *   are ticked on the next frame, starting from the tree where the previous frame has stopped.
+   * - tick rate LOD: trees are ticked less often the further the entity is from the focus point.
+   *   Trees that get into the same LOD level are spread over the interval to avoid spikes.
+   *
+   * Config example:
+   *
+   * @code{.json}
+   * {
+   *   "tickBudget": 500,
+   *   "timeBudget": 2,
+   *   "focusEntity": "player",
+   *   "lod": [
+   *     {"distance": 30, "interval": 0},
+   *     {"distance": 100, "interval": 0.25},
+   *     {"interval": 1}
+   *   ]
+   * }
+   * @endcode
+   *
+   * timeBudget is in milliseconds, 0 means no limit.
+   */
+  class BehaviorTreeExecutor
+  {
+    public:
+      BehaviorTreeExecutor();
+      virtual ~BehaviorTreeExecutor();
+
+      /**
+       * Set lua state to use
+       *
+       * @param L lua state
+       */
+      void setLuaState(lua_State* L);
+
+      /**
+       * Set engine instance, it's used to get entity positions
+       *
+       * @param engine Engine
+       */
+      void setEngine(Engine* engine);
+
+      /**
+       * Set coroutine scheduler, it's used to check if running leaves are waiting
+       *
+       * @param scheduler CoroutineScheduler
+       */
+      void setScheduler(CoroutineScheduler* scheduler);
+
+      /**
+       * Read executor settings
+       *
+       * @param config DataProxy with settings
+       */
+      void configure(const DataProxy& config);
+
+      /**
+       * Create behavior tree for the script component
+       * If the tree can't be created, component is still registered to avoid retrying each frame
+       *
+       * @param component ScriptComponent with the behavior set
+       * @returns true if tree was created
+       */
+      bool add(ScriptComponent* component);
+
+      /**
+       * Remove behavior tree of the component
+       *
+       * @param component ScriptComponent
+       * @returns false if the component has no tree
+       */
+      bool remove(ScriptComponent* component);
+
+      /**
+       * Check if the component is registered in the executor
+       *
+       * @param component ScriptComponent
+       */
+      bool has(ScriptComponent* component) const;
+
+      /**
+       * Tick behavior trees
+       *
+       * @param time Elapsed time
+       */
+      void update(double time);
+
+      /**
+       * Remove all trees
+       */
+      void clear();
+
+      /**
+       * Set LOD focus point
+       *
+       * @param position Focus position
+       */
+      void setFocus(const Vector3& position);
+
+      /**
+       * Use entity position as the LOD focus point
+       *
+       * @param id Entity id, empty string disables it
+       */
+      void setFocusEntity(const std::string& id);
+
+      /**
+       * Set max tree count to tick per frame
+       *
+       * @param value 0 means no limit
+       */
+      inline void setTickBudget(int value) { mTickBudget = value; }
+
+      /**
+       * Get max tree count to tick per frame
+       */
+      inline int getTickBudget() const { return mTickBudget; }
+
+      /**
+       * Set max time to spend ticking trees per frame
+       *
+       * @param value Time in milliseconds, 0 means no limit
+       */
+      inline void setTimeBudget(double value) { mTimeBudget = value; }
+
+      /**
+       * Get max time to spend ticking trees per frame
+       */
+      inline double getTimeBudget() const { return mTimeBudget; }
+
+      /**
+       * Get count of trees ticked on the last update
+       */
+      inline int getTickCount() const { return mTickCount; }
+
+      /**
+       * Get registered trees count
+       */
+      inline size_t size() const { return mIndex.size(); }
+
+      /**
+       * Get executor time
+       */
+      inline double getTime() const { return mTime; }
+
+      /**
+       * Get lua state
+       */
+      inline lua_State* getLuaState() { return mState; }
+
+      /**
+       * Get coroutine for the leaf from the pool
+       *
+       * @param thread Coroutine state
+       * @param ref Coroutine registry reference
+       */
+      void acquireThread(lua_State*& thread, int& ref);
+
+      /**
+       * Return coroutine to the pool
+       *
+       * @param thread Coroutine state
+       * @param ref Coroutine registry reference
+       */
+      void releaseThread(lua_State* thread, int ref);
+
+      /**
+       * Release the reference to the coroutine which can't be reused
+       *
+       * @param ref Coroutine registry reference
+       */
+      void abandonThread(int ref);
+
+      /**
+       * Check if coroutine waits in the scheduler
+       *
+       * @param thread Coroutine state
+       */
+      bool isWaiting(lua_State* thread) const;
+
+      /**
+       * Push btree.runLeaf function to the stack
+       *
+       * @param L Lua state to push to
+       * @returns false if the function is not defined
+       */
+      bool pushLeafRunner(lua_State* L);
+    private:
+      struct Instance
+      {
+        ScriptComponent* component;
+        std::unique_ptr<BehaviorTree> tree;
+        double lastTick;
+        double nextTick;
+        int lod;
+        double phase;
+        bool finished;
+      };
+
+      struct LodLevel
+      {
+        double distance;
+        double interval;
+      };
+
+      struct LeafThread
+      {
+        lua_State* state;
+        int ref;
+      };
+
+      bool resolveFunctions();
+
+      bool getFocus(Vector3& dest);
+
+      void tick(Instance& instance, bool hasFocus, const Vector3& focus);
+
+      int getLod(Instance& instance, bool hasFocus, const Vector3& focus);
+
+      void compact();
+
+      lua_State* mState;
+      Engine* mEngine;
+      CoroutineScheduler* mScheduler;
+
+      sol::protected_function mCreateContext;
+      sol::protected_function mGetBehavior;
+      sol::reference mRunLeaf;
+
+      typedef std::vector<Instance> Instances;
+      Instances mInstances;
+
+      typedef std::unordered_map<ScriptComponent*, size_t> Index;
+      Index mIndex;
+
+      std::vector<LodLevel> mLods;
+      std::vector<LeafThread> mThreads;
+
+      Vector3 mFocus;
+      bool mHasFocus;
+      std::string mFocusEntity;
+
+      size_t mCursor;
+      size_t mRemoved;
+      unsigned int mNextPhase;
+      bool mUpdating;
+
+      int mTickBudget;
+      double mTimeBudget;
+      int mTickCount;
+      double mTime;
+  };
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef _BytecodeBundle_H_
+#define _BytecodeBundle_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+
+namespace Gsage {
+
+  /**
+   * Archive of precompiled lua modules.
+   *
+   * Packager compiles scripts into a single file, engine reads it in one go and installs
+   * a package searcher, which loads modules from the bytecode instead of parsing the sources.
+   * Each module keeps the source modification time and hash, so edited sources are still
+   * loaded from the disk.
+   */
+  class BytecodeBundle
+  {
+    public:
+      struct Entry
+      {
+        // source path, relative to the scripts root
+        std::string path;
+        signed long long mtime;
+        uint64_t hash;
+        size_t offset;
+        size_t size;
+      };
+
+      typedef std::unordered_map<std::string, Entry> Entries;
+
+      BytecodeBundle();
+      virtual ~BytecodeBundle();
+
+      /**
+       * Compile lua source and add it to the bundle
+       *
+       * @param L Lua state to use for compilation
+       * @param root Scripts root folder
+       * @param path Source path, relative to the root
+       * @returns false if the source failed to compile
+       */
+      bool add(lua_State* L, const std::string& root, const std::string& path);
+
+      /**
+       * Compile all lua files in the folder
+       *
+       * @param L Lua state to use for compilation
+       * @param root Scripts root folder
+       * @returns count of compiled modules, -1 if any of them failed
+       */
+      int addFolder(lua_State* L, const std::string& root);
+
+      /**
+       * Write bundle to the file
+       *
+       * @param filepath Bundle path
+       */
+      bool dump(const std::string& filepath) const;
+
+      /**
+       * Read bundle from the file
+       *
+       * @param filepath Bundle path
+       * @param root Scripts root folder, used to check if sources were changed
+       */
+      bool load(const std::string& filepath, const std::string& root);
+
+      /**
+       * Add package searcher to the lua state, which loads modules from the bundle.
+       * Bundle must outlive the lua state.
+       *
+       * @param L Lua state
+       */
+      bool install(lua_State* L);
+
+      /**
+       * Load module chunk on top of the stack
+       *
+       * @param L Lua state
+       * @param module Module name
+       * @returns false if the module is not in the bundle or its source was changed
+       */
+      bool loadModule(lua_State* L, const std::string& module);
+
+      /**
+       * Get entries count
+       */
+      size_t size() const { return mEntries.size(); }
+
+      /**
+       * Get module name for the source path
+       *
+       * @param path Source path, relative to the scripts root
+       */
+      static std::string getModuleName(const std::string& path);
+
+      /**
+       * FNV-1a hash of the data
+       */
+      static uint64_t hash(const char* data, size_t size);
+    private:
+      /**
+       * Check that the source file was not changed since it was compiled
+       */
+      bool isUpToDate(Entry& entry);
+
+      /**
+       * Read file into the string
+       */
+      static bool readFile(const std::string& path, std::string& dest);
+
+      /**
+       * Get file modification time, -1 if the file does not exist
+       */
+      static signed long long getModificationTime(const std::string& path);
+
+      static int searcher(lua_State* L);
+
+      Entries mEntries;
+      std::string mData;
+      std::string mRoot;
+  };
+}
+
+#endif
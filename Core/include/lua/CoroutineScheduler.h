@@ -0,0 +1,167 @@
+#ifndef _CoroutineScheduler_H_
+#define _CoroutineScheduler_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TimerWheel.h"
+#include "sol_forward.hpp"
+
+struct lua_State;
+
+namespace Gsage {
+
+  /**
+   * Native scheduler for suspended lua coroutines.
+   *
+   * Coroutines that wait for time are kept in the TimerWheel, coroutines waiting for signals
+   * are kept in lists indexed by the signal name.
+   * Scheduler keeps registry references to all suspended coroutines and resumes them in batch,
+   * so the update cost only depends on the number of coroutines that wake up.
+   */
+  class CoroutineScheduler
+  {
+    public:
+      /**
+       * @param resolution Timer resolution in seconds
+       */
+      CoroutineScheduler(double resolution = 0.001);
+      virtual ~CoroutineScheduler();
+
+      /**
+       * Set main lua state
+       *
+       * @param L lua state
+       */
+      void setLuaState(lua_State* L);
+
+      /**
+       * Suspend calling coroutine for the time
+       * Coroutine should yield right after this call
+       *
+       * @param s Calling coroutine
+       * @param seconds Time to wait
+       * @returns false if called from the main thread
+       */
+      bool waitSeconds(sol::this_state s, double seconds);
+
+      /**
+       * Suspend calling coroutine until the signal is fired
+       * Coroutine should yield right after this call
+       *
+       * @param s Calling coroutine
+       * @param name Signal name
+       * @returns false if called from the main thread
+       */
+      bool waitSignal(sol::this_state s, const std::string& name);
+
+      /**
+       * Resume all coroutines waiting for the signal
+       *
+       * @param s Calling lua state
+       * @param name Signal name
+       * @returns count of resumed coroutines
+       */
+      int signal(sol::this_state s, const std::string& name);
+
+      /**
+       * Check if coroutine is waiting in the scheduler
+       *
+       * @param co Coroutine object
+       */
+      bool isSuspended(const sol::object& co) const;
+
+      /**
+       * Check if coroutine is waiting in the scheduler
+       *
+       * @param co Coroutine state
+       */
+      bool isSuspended(lua_State* co) const;
+
+      /**
+       * Advance scheduler time and resume all coroutines that should wake up
+       *
+       * @param time Elapsed time
+       * @returns count of resumed coroutines
+       */
+      int update(double time);
+
+      /**
+       * Get scheduler time
+       */
+      inline double getTime() const { return mTime; }
+
+      /**
+       * Get count of suspended coroutines
+       */
+      inline size_t size() const { return mWaiters.size(); }
+
+      /**
+       * Release all suspended coroutines without resuming them
+       */
+      void clear();
+    private:
+      typedef TimerWheel::Payload WaitID;
+
+      struct Waiter
+      {
+        // coroutine reference in the registry
+        int ref;
+        WaitID id;
+      };
+
+      lua_State* getThread(lua_State* L) const;
+
+      void suspend(lua_State* co, WaitID id);
+
+      bool resume(WaitID id, lua_State* from);
+
+      lua_State* mState;
+
+      typedef std::unordered_map<lua_State*, Waiter> Waiters;
+      Waiters mWaiters;
+
+      typedef std::unordered_map<WaitID, lua_State*> Waits;
+      Waits mWaits;
+
+      typedef std::vector<WaitID> WaitList;
+      typedef std::unordered_map<std::string, WaitList> Signals;
+      Signals mSignals;
+
+      TimerWheel mWheel;
+      TimerWheel::Payloads mExpired;
+
+      WaitID mNextID;
+      double mResolution;
+      double mTime;
+  };
+}
+
+#endif
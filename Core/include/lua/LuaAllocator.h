@@ -0,0 +1,115 @@
+#ifndef _LuaAllocator_H_
+#define _LuaAllocator_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <cstddef>
+#include <vector>
+
+struct lua_State;
+
+namespace Gsage {
+
+  /**
+   * Pooled allocator for the lua state.
+   *
+   * Small blocks are served from size class free lists, which are carved from big chunks,
+   * so lua objects churn does not hit malloc. Lua always passes the old block size,
+   * so blocks do not need any headers.
+   * Allocator is not thread safe, same as the lua state itself.
+   */
+  class LuaAllocator
+  {
+    public:
+      // size class granularity
+      static const size_t GRANULARITY = 16;
+      // blocks bigger than that are allocated by malloc
+      static const size_t MAX_POOLED_SIZE = 512;
+      // size of the chunk, which is split into blocks of the same size class
+      static const size_t CHUNK_SIZE = 64 * 1024;
+
+      LuaAllocator();
+      virtual ~LuaAllocator();
+
+      /**
+       * lua_Alloc compatible function
+       *
+       * @param ud LuaAllocator instance
+       * @param ptr Block to reallocate, NULL if it is new allocation
+       * @param osize Old block size
+       * @param nsize New block size, 0 to free the block
+       */
+      static void* allocate(void* ud, void* ptr, size_t osize, size_t nsize);
+
+      /**
+       * Reallocate block
+       *
+       * @param ptr Block to reallocate, NULL if it is new allocation
+       * @param osize Old block size
+       * @param nsize New block size, 0 to free the block
+       * @returns new block, NULL if freed or allocation failed
+       */
+      void* reallocate(void* ptr, size_t osize, size_t nsize);
+
+      /**
+       * Create lua state, that uses the process wide pooled allocator.
+       * Falls back to the default allocator if the lua implementation does not support custom allocators
+       * (LuaJIT 2.0 on 64 bit platforms).
+       */
+      static lua_State* newState();
+
+      /**
+       * Get the count of bytes allocated by lua
+       */
+      size_t getAllocated() const { return mAllocated; }
+
+      /**
+       * Get the count of bytes reserved for pooled blocks
+       */
+      size_t getReserved() const { return mReserved; }
+    private:
+      struct FreeBlock
+      {
+        FreeBlock* next;
+      };
+
+      static const size_t CLASS_COUNT = MAX_POOLED_SIZE / GRANULARITY;
+
+      inline size_t sizeClass(size_t size) const { return (size - 1) / GRANULARITY; }
+
+      void* allocateBlock(size_t size);
+      void freeBlock(void* ptr, size_t size);
+      bool grow(size_t sizeClass);
+
+      FreeBlock* mFreeLists[CLASS_COUNT];
+      std::vector<void*> mChunks;
+      size_t mAllocated;
+      size_t mReserved;
+  };
+}
+
+#endif
@@ -30,99 +30,58 @@ THE SOFTWARE.
 #include "EventSubscriber.h"
 
 #include "sol.hpp"
+#include <unordered_map>
 
 namespace Gsage {
   /**
-   * Class that allows to bind lua function to any event
+   * Class that allows to bind lua function to any event.
+   *
+   * Lua callbacks of each (dispatcher, event type) pair are kept in a plain lua array,
+   * referenced from the registry. Dispatching an event pushes the event once and calls
+   * a lua side trampoline, which walks the array, so the cost of a C++ -> lua transition
+   * is paid once per event and not once per listener.
    */
   class LuaEventProxy : public EventSubscriber<LuaEventProxy>
   {
     public:
       /**
-       * sol::function wrapper
+       * Function that pushes event to the lua stack, casted to the concrete event type
        */
-      class GenericCallback
-      {
-        public:
-          GenericCallback(sol::function func)
-            : mFunc(func)
-            , mState(func.lua_state()) {};
-
-          virtual ~GenericCallback() {};
-          /**
-           * Checks if wrapped function is valid
-           * @returns sol::function valid result
-           */
-          bool valid() const{
-            return mState != NULL && mFunc.lua_state() == mState && mFunc.valid();
-          }
-
-          /**
-           * Calls underlying lua callback
-           *
-           * @param event Event to process
-           * @returnds sol::function_result
-           */
-          virtual sol::function_result operator()(const Event& event)
-          {
-            return mFunc(std::ref(event));
-          }
-
-          operator const sol::function() const {
-            return mFunc;
-          }
-
-          friend bool operator==(GenericCallback* cb, const sol::function& func) {
-            return cb->mFunc == func;
-          }
-
-          sol::protected_function& func()
-          {
-            return mFunc;
-          }
-
-        protected:
-          sol::protected_function mFunc;
-          lua_State* mState;
-      };
+      typedef void (*EventPusher)(lua_State*, const Event&);
+      typedef std::vector<EventPusher> EventPushers;
 
       /**
-       * Templated version of callback. Casts event to any specific type before calling the function.
+       * Lua callbacks, bound to the single dispatcher event type
        */
-      template<class T>
-      class Callback : public GenericCallback
+      struct Binding
       {
-        public:
-          Callback(sol::protected_function func) : GenericCallback(func) {}
-          virtual ~Callback() {}
-          /**
-           * Calls underlying lua callback
-           *
-           * @param event Event to process (will be cast to the particular templated event).
-           * @returns sol::function_result
-           */
-          virtual sol::function_result operator()(const Event& event)
-          {
-            return mFunc(std::ref(static_cast<const T&>(event)));
-          }
-      };
-
-      typedef std::pair<EventDispatcher*, const Event::ConstType> CallbackBinding;
-      struct CmpCallbackBinding {
-        bool operator()(const CallbackBinding& a, const CallbackBinding& b) const
+        Binding(Event::ConstType t, int l)
+          : type(t)
+          , list(l)
+          , length(0)
+          , size(0)
+          , depth(0)
+          , generation(0)
         {
-          if(a.first == b.first) {
-            return std::strcmp(a.second, b.second) > 0;
-          }
-
-          return a.first < b.first;
         }
+        // event type
+        Event::ConstType type;
+        // registry reference of the callbacks array
+        int list;
+        // array length, including removed entries
+        int length;
+        // active callbacks count
+        int size;
+        // dispatch nesting level
+        int depth;
+        // changes on each new binding, to detect replacement during the dispatch
+        unsigned long generation;
+        // event pushers, referenced by the callbacks
+        EventPushers pushers;
       };
 
-      typedef std::shared_ptr<GenericCallback> GenericCallbackPtr;
-
-      typedef std::vector<GenericCallbackPtr> Callbacks;
-      typedef std::map<CallbackBinding, Callbacks, CmpCallbackBinding> CallbackBindings;
+      typedef std::vector<Binding> Bindings;
+      typedef std::unordered_map<EventDispatcher*, Bindings> CallbackBindings;
 
       LuaEventProxy();
       virtual ~LuaEventProxy();
@@ -142,14 +101,7 @@ namespace Gsage {
       template<class T>
       bool addEventListener(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback)
       {
-        if(callback.get_type() != sol::type::function)
-          return false;
-
-        Callbacks* cb = getCallbacks(dispatcher, eventType);
-        Callbacks& callbacks = cb != 0 ? *cb : subscribe(dispatcher, eventType);
-        GenericCallback* c = new Callback<T>(callback.as<sol::protected_function>());
-        callbacks.push_back(GenericCallbackPtr(c));
-        return true;
+        return addCallback(dispatcher, eventType, callback, &LuaEventProxy::pushEvent<T>);
       }
 
       /**
@@ -163,11 +115,21 @@ namespace Gsage {
       bool removeEventListener(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback);
 
       /**
-       * Get callbacks for binding
+       * Drop all lua callbacks and the dispatch trampoline.
+       * Must be called before the lua state is closed or replaced, as the next binding
+       * creates the trampoline in the state of the new callback.
+       *
+       * @param release Release registry references, set to false if the state is already closed
+       */
+      void reset(bool release = true);
+
+      /**
+       * Get callbacks binding
        * @param dispatcher Object that dispatches the event
        * @param eventType Event id
+       * @returns 0 if there are no callbacks bound
        */
-      Callbacks* getCallbacks(EventDispatcher* dispatcher, Event::ConstType eventType);
+      Binding* getBinding(EventDispatcher* dispatcher, Event::ConstType eventType);
 
       /**
        * Overriding standard callback which is called on dispatcher deletion
@@ -176,6 +138,22 @@ namespace Gsage {
        */
       bool onForceUnsubscribe(EventDispatcher* sender, const Event& event);
     private:
+      template<class T>
+      static void pushEvent(lua_State* L, const Event& event)
+      {
+        sol::stack::push(L, std::ref(static_cast<const T&>(event)));
+      }
+
+      /**
+       * Add lua callback to the binding
+       *
+       * @param dispatcher Object that dispatches the event
+       * @param eventType Event id
+       * @param callback Lua function
+       * @param pusher Function that pushes the event to the lua stack
+       */
+      bool addCallback(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback, EventPusher pusher);
+
       /**
        * Listens to all events and proxies to lua objects
        *
@@ -187,11 +165,42 @@ namespace Gsage {
        *
        * @param dispatcher Event dispatcher
        * @param eventType Event id
-       * @returns list of callbacks
+       * @returns created binding
+       */
+      Binding& subscribe(EventDispatcher* dispatcher, Event::ConstType eventType);
+
+      /**
+       * Remove c++ event listener and release lua callbacks array
+       *
+       * @param dispatcher Event dispatcher
+       * @param eventType Event id
+       */
+      void unsubscribe(EventDispatcher* dispatcher, Event::ConstType eventType);
+
+      /**
+       * Remove holes left by the callbacks, unbound during the dispatch
+       *
+       * @param binding Binding to compact
+       */
+      void compact(Binding& binding);
+
+      /**
+       * Lazily create the dispatch trampoline
+       *
+       * @param L Lua state
+       */
+      bool initialize(lua_State* L);
+
+      /**
+       * Logs lua callback error, called from the trampoline
        */
-      Callbacks& subscribe(EventDispatcher* dispatcher, Event::ConstType eventType);
+      static int warn(lua_State* L);
 
       CallbackBindings mCallbackBindings;
+      lua_State* mState;
+      int mTrampoline;
+      int mThread;
+      unsigned long mGeneration;
   };
 }
 
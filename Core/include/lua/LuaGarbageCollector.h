@@ -0,0 +1,157 @@
+#ifndef _LuaGarbageCollector_H_
+#define _LuaGarbageCollector_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "DataProxy.h"
+
+struct lua_State;
+
+namespace Gsage {
+
+  /**
+   * Paces lua garbage collection with the engine frames.
+   *
+   * Incremental GC steps are run at the end of each frame until the frame budget is spent,
+   * bigger chunks of work are done in the time left before the next frame.
+   * Automatic collection is kept as a backstop with the higher pause, so scripts that allocate a lot
+   * in a single frame are still collected.
+   */
+  class LuaGarbageCollector
+  {
+    public:
+      LuaGarbageCollector();
+      virtual ~LuaGarbageCollector();
+
+      /**
+       * Set lua state to control
+       *
+       * @param L lua state, 0 to detach
+       */
+      void setLuaState(lua_State* L);
+
+      /**
+       * Configure collector
+       *
+       * @param config
+       *  * enabled: pace collection with frames, otherwise lua collects on its own (default true)
+       *  * stepBudget: microseconds that can be spent each frame (default 1000)
+       *  * idleBudget: part of the idle frame time that can be spent (default 0.5)
+       *  * pause: automatic collection pause, used as the backstop (default 400)
+       *  * growth: heap growth since the last complete cycle, which starts the next one (default 1.2)
+       */
+      void configure(const DataProxy& config);
+
+      /**
+       * Run collection steps within the frame budget
+       */
+      void step();
+
+      /**
+       * Run collection steps in the idle time
+       *
+       * @param seconds Idle time left till the next frame
+       * @returns time spent in seconds
+       */
+      double idle(double seconds);
+
+      /**
+       * Get lua heap size in KB
+       */
+      double getHeapSize() const;
+
+      /**
+       * Get time spent in GC steps during the last frame, microseconds
+       */
+      double getStepTime() const { return mStepTime; }
+
+      /**
+       * Get the longest frame GC time since the last reset, microseconds
+       */
+      double getMaxPause() const { return mMaxPause; }
+
+      /**
+       * Get count of completed collection cycles
+       */
+      unsigned long getCycles() const { return mCycles; }
+
+      /**
+       * Get frame budget, microseconds
+       */
+      double getBudget() const { return mBudget; }
+
+      /**
+       * Set frame budget
+       *
+       * @param value Budget in microseconds
+       */
+      void setBudget(double value) { mBudget = value; }
+
+      /**
+       * Check if collector controls lua GC
+       */
+      bool getEnabled() const { return mEnabled; }
+
+      /**
+       * Enable or disable frame paced collection
+       *
+       * @param value Enable
+       */
+      void setEnabled(bool value);
+
+      /**
+       * Reset collected stats
+       */
+      void resetStats();
+    private:
+      /**
+       * Run GC steps
+       *
+       * @param budget Budget in seconds
+       * @returns spent time in seconds
+       */
+      double run(double budget);
+
+      void applyParameters();
+
+      lua_State* mState;
+      bool mEnabled;
+      double mBudget;
+      double mIdleBudget;
+      int mPause;
+      double mGrowth;
+
+      double mHeapAfterCycle;
+      bool mCycleDone;
+
+      double mStepTime;
+      double mMaxPause;
+      unsigned long mCycles;
+  };
+}
+
+#endif
@@ -36,6 +36,8 @@ THE SOFTWARE.
 
 #include "lua/LuaEventProxy.h"
 #include "lua/LuaEventConnection.h"
+#include "lua/LuaGarbageCollector.h"
+#include "lua/BytecodeBundle.h"
 
 #include <stdexcept>
 
@@ -240,6 +242,20 @@ namespace Gsage
        */
       sol::state_view* getSolState();
 
+      /**
+       * Get lua garbage collector controller
+       */
+      LuaGarbageCollector& getGarbageCollector();
+
+      /**
+       * Load precompiled scripts and make require use them
+       *
+       * @param path Bytecode bundle path
+       * @param root Scripts root folder, which was used to build the bundle
+       * @returns true if succeed
+       */
+      bool loadBytecodeBundle(const std::string& path, const std::string& root);
+
       /**
        * Set resource path, which is helps lua to find all the scripts
        *
@@ -301,6 +317,8 @@ namespace Gsage
       std::string mResourcePath;
 
       LuaEventProxy* mEventProxy;
+      LuaGarbageCollector mGarbageCollector;
+      BytecodeBundle mBytecode;
 
       lua_State* mState;
       sol::state_view* mStateView;
@@ -0,0 +1,170 @@
+#ifndef _LuaWorkerPool_H_
+#define _LuaWorkerPool_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataProxy.h"
+
+struct lua_State;
+
+namespace Gsage {
+
+  class CoroutineScheduler;
+
+  /**
+   * Pool of isolated lua states, which run jobs on worker threads.
+   *
+   * Job is a module that returns a function. The function is called with a copy of arguments
+   * and its return value is copied back, so the states never share tables.
+   * Worker states only have the lua standard library without io and most of os.
+   */
+  class LuaWorkerPool
+  {
+    public:
+      typedef unsigned long JobID;
+
+      LuaWorkerPool();
+      virtual ~LuaWorkerPool();
+
+      /**
+       * Configure pool
+       *
+       * @param config
+       *  * threads: worker threads count (default: cores count - 1)
+       */
+      void configure(const DataProxy& config);
+
+      /**
+       * Set package.path for worker states, it is copied to each worker when the threads are started,
+       * so changing it later has no effect until the pool is restarted
+       *
+       * @param path lua package.path
+       */
+      void setPackagePath(const std::string& path);
+
+      /**
+       * Submit the job, worker threads are started on the first call
+       *
+       * @param module Lua module, which returns the job function
+       * @param args Job arguments, copied
+       * @returns job id, 0 if the pool failed to start
+       */
+      JobID submit(const std::string& module, const DataProxy& args);
+
+      /**
+       * Take the job result
+       *
+       * @param id Job id
+       * @param result Job function return value, stored as "value" field
+       * @param error Error message if the job failed
+       * @returns false if the job is not finished yet
+       */
+      bool take(JobID id, DataProxy& result, std::string& error);
+
+      /**
+       * Check if the job is finished
+       *
+       * @param id Job id
+       */
+      bool isDone(JobID id);
+
+      /**
+       * Collect finished jobs and wake up coroutines that wait for them
+       *
+       * @param scheduler Coroutine scheduler
+       * @param L Main lua state
+       * @returns count of finished jobs
+       */
+      int update(CoroutineScheduler& scheduler, lua_State* L);
+
+      /**
+       * Stop worker threads, pending jobs are dropped
+       */
+      void stop();
+
+      /**
+       * Get count of jobs that are not finished yet
+       */
+      size_t getPending() const { return mPending; }
+
+      /**
+       * Get worker threads count
+       */
+      size_t getThreads() const { return mThreads.size(); }
+
+      /**
+       * Get signal name that is sent when the job finishes
+       *
+       * @param id Job id
+       */
+      static std::string getSignal(JobID id);
+    private:
+      struct Job
+      {
+        JobID id;
+        std::string module;
+        DataProxy args;
+        DataProxy result;
+        std::string error;
+        bool success;
+      };
+
+      typedef std::shared_ptr<Job> JobPtr;
+      typedef std::deque<JobPtr> Jobs;
+
+      bool start();
+      void run(std::string packagePath);
+      bool execute(lua_State* L, Job& job);
+      lua_State* createState(const std::string& packagePath);
+
+      std::vector<std::thread> mThreads;
+      int mThreadCount;
+      std::string mPackagePath;
+
+      std::mutex mMutex;
+      std::condition_variable mCondition;
+      Jobs mQueue;
+      Jobs mFinished;
+      bool mStopped;
+
+      std::map<JobID, JobPtr> mResults;
+      JobID mNextID;
+      size_t mPending;
+  };
+}
+
+#endif
@@ -31,6 +31,9 @@ THE SOFTWARE.
 #include "components/ScriptComponent.h"
 #include "systems/SystemFactory.h"
 #include "lua/LuaInterface.h"
+#include "lua/CoroutineScheduler.h"
+#include "lua/BehaviorTreeExecutor.h"
+#include "lua/LuaWorkerPool.h"
 #include "Engine.h"
 #include "sol_forward.hpp"
 
@@ -138,28 +141,133 @@ namespace Gsage
        */
       bool removeUpdateListener(const sol::object& function);
 
+      /**
+       * Get count of active update listeners
+       */
+      size_t getUpdateListenersCount() const;
+
+      /**
+       * Enable per listener time measurement
+       *
+       * @param value Enable
+       */
+      void setProfileListeners(bool value);
+
+      /**
+       * Check if per listener time measurement is enabled
+       */
+      inline bool getProfileListeners() const { return mProfileListeners; }
+
+      /**
+       * Get time each update listener took during the last update
+       *
+       * @param s lua state
+       * @returns table: listener function -> time in seconds
+       */
+      sol::table getListenerTimes(sol::this_state s);
+
       /**
        * Unload components.
        */
       void unloadComponents();
+
+      /**
+       * Get scheduler that resumes suspended coroutines
+       */
+      inline CoroutineScheduler* getScheduler() { return &mScheduler; }
+
+      /**
+       * Get executor that ticks behavior trees of script components
+       */
+      inline BehaviorTreeExecutor* getBehaviors() { return &mBehaviors; }
+
+      /**
+       * Get pool that runs lua jobs on worker threads
+       */
+      inline LuaWorkerPool* getWorkers() { return &mWorkers; }
     private:
       struct Listener
       {
         Listener(sol::function function, bool global)
           : function(function)
           , global(global)
+          , removed(false)
         {}
 
         sol::function function;
         bool global;
+        bool removed;
       };
 
       std::string getScriptData(const std::string& data);
 
+      /**
+       * Compile script once per unique source and reuse the chunk.
+       * File scripts are compiled again when the file modification time changes
+       *
+       * @param script Script string or file to compile
+       * @returns invalid function if compilation failed
+       */
+      sol::protected_function compile(const std::string& script);
+
+      struct CompiledScript
+      {
+        sol::protected_function function;
+        // resolved path of the file script, empty for inline scripts
+        std::string path;
+        signed long long modified;
+      };
+
+      /**
+       * Get file modification time, -1 if the file does not exist
+       */
+      static signed long long getModificationTime(const std::string& path);
+
+      typedef std::unordered_map<std::string, CompiledScript> CompiledScripts;
+      CompiledScripts mCompiledScripts;
+
       sol::state_view* mState;
 
+      /**
+       * Create lua side listeners list and the dispatcher
+       */
+      bool createDispatcher();
+
+      /**
+       * Mark listener removed, slots are compacted when dispatch is over
+       *
+       * @param index Listener index
+       */
+      void markListenerRemoved(size_t index);
+
+      /**
+       * Drop removed listeners from both lists
+       */
+      void compactUpdateListeners();
+
+      /**
+       * Log failed listener error
+       */
+      static int warn(lua_State* L);
+
+      /**
+       * High resolution clock for listener profiling
+       */
+      static int clock(lua_State* L);
+
+      // listeners are mirrored by the lua array, which is walked by the dispatcher
+      // in a single call, indices match while the dispatch is in progress
       typedef std::vector<Listener> UpdateListeners;
       UpdateListeners mUpdateListeners;
+      sol::table mListenersList;
+      sol::protected_function mDispatcher;
+      bool mDispatching;
+      bool mListenersDirty;
+      bool mProfileListeners;
+
+      CoroutineScheduler mScheduler;
+      BehaviorTreeExecutor mBehaviors;
+      LuaWorkerPool mWorkers;
 
       std::string mWorkdir;
   };
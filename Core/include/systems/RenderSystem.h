@@ -34,6 +34,7 @@ THE SOFTWARE.
 #include "GeometryPrimitives.h"
 #include "DataProxy.h"
 #include "EventDispatcher.h"
+#include "StagingBuffer.h"
 
 namespace Gsage {
   class RenderSystem;
@@ -135,6 +136,17 @@ namespace Gsage {
        */
       virtual void update(const void* buffer, size_t size, int width, int height, const Rect<int>& area) = 0;
 
+      /**
+       * Update texture data using several changed rectangles at once
+       *
+       * @param buffer buffer to use
+       * @param size provided buffer size
+       * @param width buffer width
+       * @param height buffer height
+       * @param areas changed rects
+       */
+      virtual void update(const void* buffer, size_t size, int width, int height, const std::vector<Rect<int>>& areas) = 0;
+
       /**
        * Set texture size
        *
@@ -186,8 +198,6 @@ namespace Gsage {
 
     protected:
 
-      char* allocateBuffer(size_t size);
-
       Gsage::Vector2 mUVTL;
       Gsage::Vector2 mUVBL;
       Gsage::Vector2 mUVTR;
@@ -200,17 +210,12 @@ namespace Gsage {
       int mBufferWidth;
       int mBufferHeight;
 
-      char* mBuffer;
-      size_t mSize;
+      StagingBuffer mStaging;
       DataProxy mParams;
 
       std::string mHandle;
 
       std::mutex mLock;
-      
-    private:
-
-      void deleteBuffer();
   };
 
   typedef std::shared_ptr<Texture> TexturePtr;
@@ -29,6 +29,7 @@ THE SOFTWARE.
 using namespace Gsage;
 
 EntityComponent::EntityComponent()
+  : mSkippedTime(0)
 {
 }
 
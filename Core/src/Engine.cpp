@@ -51,6 +51,14 @@ namespace Gsage
   {
     mConfiguration = configuration;
     mEnvironment = environment;
+    mSpatialIndex.setCellSize(configuration.get("spatialIndex.cellSize", mSpatialIndex.getCellSize()));
+    mUpdateLOD.setEnabled(configuration.get("updateLOD.enabled", false));
+    mUpdateLOD.setDistances(
+        configuration.get("updateLOD.halfDistance", 0.0f),
+        configuration.get("updateLOD.quarterDistance", 0.0f),
+        configuration.get("updateLOD.offDistance", 0.0f)
+    );
+    mUpdateLOD.setInvisibleRate((UpdateLOD::Rate)configuration.get("updateLOD.invisibleRate", (int)UpdateLOD::RATE_QUARTER));
 
     bool succeed = true;
     for(auto& systemName : mSetUpOrder)
@@ -92,6 +100,8 @@ namespace Gsage
   void Engine::update(const double& time)
   {
     fireEvent(EngineEvent(EngineEvent::UPDATE));
+    mQueries.compact();
+    mUpdateLOD.update(mSpatialIndex);
     for(auto& pair : mEngineSystems)
     {
       if(!pair.second->isEnabled() || !pair.second->isReady())
@@ -258,6 +268,7 @@ namespace Gsage
     {
       entity = mEntities.create();
       entity->mId = id;
+      entity->mIndex = &mQueries;
       created = true;
     }
     entity->setClass(data.get<std::string>("class", "default"));
@@ -268,6 +279,8 @@ namespace Gsage
     mEntityMap[id] = entity;
     readEntityData(entity, data);
     if(created) {
+      // entities without components and flags are not added to the queries by readEntityData
+      mQueries.update(entity);
       fireEvent(EntityEvent(EntityEvent::CREATE, entity->getId()));
     }
     return entity;
@@ -283,6 +296,9 @@ namespace Gsage
     if(entity == 0 || mEntityMap.count(entity->getId()) == 0)
       return false;
     fireEvent(EntityEvent(EntityEvent::REMOVE, entity->getId()));
+    mQueries.remove(entity);
+    mSpatialIndex.remove(entity);
+    entity->mIndex = 0;
     for(auto& pair : entity->mComponents)
     {
       if(!hasSystem(pair.first))
@@ -308,6 +324,8 @@ namespace Gsage
       LOG(INFO) << "Unload components from system " << pair.first;
       pair.second->unloadComponents();
     }
+    mQueries.clear();
+    mSpatialIndex.clear();
     mEntities.clear();
     mEntityMap.clear();
   }
@@ -321,6 +339,9 @@ namespace Gsage
         fireEvent(EntityEvent(EntityEvent::REMOVE, pair.second->getId()));
 
         removed.push_back(pair.second);
+        mQueries.remove(pair.second);
+        mSpatialIndex.remove(pair.second);
+        pair.second->mIndex = 0;
         for(auto& p : pair.second->mComponents)
         {
           if(!hasSystem(p.first))
@@ -340,6 +361,11 @@ namespace Gsage
     }
   }
 
+  EntityQuery* Engine::query(const std::vector<std::string>& components, const std::vector<std::string>& flags)
+  {
+    return mQueries.get(components, flags, mEntities.getElements());
+  }
+
   Entity* Engine::getEntity(const std::string& id)
   {
     if(mEntityMap.count(id) == 0)
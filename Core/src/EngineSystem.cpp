@@ -60,6 +60,7 @@ namespace Gsage
     , mEnabled(true)
     , mThreadsNumber(1)
     , mDedicatedThread(false)
+    , mUseUpdateLOD(false)
     , mReadyWasSet(false)
     , mShutdown(false)
     , mRestart(false)
@@ -70,6 +71,15 @@ namespace Gsage
   {
   }
 
+  UpdateLOD* EngineSystem::getUpdateLOD()
+  {
+    if(!mUseUpdateLOD || !mEngine) {
+      return 0;
+    }
+
+    return &mEngine->getUpdateLOD();
+  }
+
   bool EngineSystem::configure(const DataProxy& config)
   {
     mergeInto(mConfig, config);
@@ -89,10 +99,17 @@ namespace Gsage
     mConfig = settings;
     mThreadsNumber = mConfig.get("threadsNumber", 1);
     mDedicatedThread = mConfig.get("dedicatedThread", false);
+    mUseUpdateLOD = mConfig.get("updateLOD", false);
     if(mDedicatedThread && !allowMultithreading()) {
       LOG(ERROR) << "System " << mName << " does not support multithreaded mode";
       return false;
     }
+
+    // update rates are recalculated on the main thread while the system reads them
+    if(mDedicatedThread && mUseUpdateLOD) {
+      LOG(ERROR) << "System " << mName << " can't use updateLOD when running in a dedicated thread";
+      return false;
+    }
     setReady(true);
 
     size_t backgroundWorkersCount = mConfig.get("backgroundWorkersCount", 0);
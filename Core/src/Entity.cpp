@@ -26,11 +26,15 @@ THE SOFTWARE.
 
 #include "Entity.h"
 #include "Component.h"
+#include "EntityQuery.h"
 
 namespace Gsage
 {
 
   Entity::Entity()
+    : mIndex(0)
+    , mUpdateRate(0)
+    , mUpdateRateFrame(0)
   {
   }
 
@@ -41,6 +45,7 @@ namespace Gsage
   void Entity::addComponent(const std::string& name, EntityComponent* c)
   {
     mComponents[name] = c;
+    changed();
   }
 
   bool Entity::removeComponent(const std::string& name)
@@ -48,7 +53,9 @@ namespace Gsage
     if(mComponents.count(name) == 0)
       return false;
 
-    return mComponents.erase(name);
+    bool res = mComponents.erase(name);
+    changed();
+    return res;
   }
 
   EntityComponent* Entity::getComponent(const std::string& name)
@@ -62,6 +69,7 @@ namespace Gsage
       return;
 
     mFlags.push_back(flag);
+    changed();
   }
 
   bool Entity::hasFlag(const std::string& flag)
@@ -69,6 +77,13 @@ namespace Gsage
     return std::find(mFlags.begin(), mFlags.end(), flag) != mFlags.end();
   }
 
+  void Entity::changed()
+  {
+    if(mIndex) {
+      mIndex->update(this);
+    }
+  }
+
   const std::string& Entity::getClass() const
   {
     return mClass;
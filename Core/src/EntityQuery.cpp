@@ -0,0 +1,189 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "EntityQuery.h"
+#include "Entity.h"
+
+#include <algorithm>
+
+namespace Gsage
+{
+
+  EntityQuery::EntityQuery(const Names& components, const Names& flags)
+    : mComponents(components)
+    , mFlags(flags)
+    , mEmpty(0)
+  {
+  }
+
+  EntityQuery::~EntityQuery()
+  {
+  }
+
+  bool EntityQuery::matches(Entity* entity) const
+  {
+    for(auto& component : mComponents) {
+      auto iter = entity->mComponents.find(component);
+      // Entity::getComponent leaves empty handles in the map
+      if(iter == entity->mComponents.end() || iter->second == 0) {
+        return false;
+      }
+    }
+
+    for(auto& flag : mFlags) {
+      if(!entity->hasFlag(flag)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::string EntityQuery::getKey(const Names& components, const Names& flags)
+  {
+    std::string key;
+    for(auto& component : components) {
+      key += component + ",";
+    }
+    key += "|";
+    for(auto& flag : flags) {
+      key += flag + ",";
+    }
+    return key;
+  }
+
+  void EntityQuery::update(Entity* entity)
+  {
+    bool matched = mPositions.count(entity) != 0;
+    if(matches(entity)) {
+      if(!matched) {
+        mPositions[entity] = mEntities.size();
+        mEntities.push_back(entity);
+      }
+    } else if(matched) {
+      remove(entity);
+    }
+  }
+
+  void EntityQuery::remove(Entity* entity)
+  {
+    Positions::iterator iter = mPositions.find(entity);
+    if(iter == mPositions.end()) {
+      return;
+    }
+
+    // the slot is kept, so indices of the other entities do not change until compact
+    mEntities[iter->second] = nullptr;
+    mPositions.erase(iter);
+    mEmpty++;
+  }
+
+  void EntityQuery::compact()
+  {
+    if(mEmpty == 0) {
+      return;
+    }
+
+    size_t count = 0;
+    for(size_t i = 0; i < mEntities.size(); ++i) {
+      Entity* entity = mEntities[i];
+      if(entity == nullptr) {
+        continue;
+      }
+
+      if(count != i) {
+        mEntities[count] = entity;
+        mPositions[entity] = count;
+      }
+      count++;
+    }
+    mEntities.resize(count);
+    mEmpty = 0;
+  }
+
+  void EntityQuery::clear()
+  {
+    mEntities.clear();
+    mPositions.clear();
+    mEmpty = 0;
+  }
+
+  EntityQueryIndex::EntityQueryIndex()
+  {
+  }
+
+  EntityQueryIndex::~EntityQueryIndex()
+  {
+  }
+
+  EntityQuery* EntityQueryIndex::get(Names components, Names flags, const EntityQuery::Entities& entities)
+  {
+    std::sort(components.begin(), components.end());
+    components.erase(std::unique(components.begin(), components.end()), components.end());
+    std::sort(flags.begin(), flags.end());
+    flags.erase(std::unique(flags.begin(), flags.end()), flags.end());
+
+    std::string key = EntityQuery::getKey(components, flags);
+    Queries::iterator iter = mQueries.find(key);
+    if(iter != mQueries.end()) {
+      return iter->second.get();
+    }
+
+    EntityQuery* query = new EntityQuery(components, flags);
+    mQueries[key] = std::unique_ptr<EntityQuery>(query);
+    for(auto entity : entities) {
+      query->update(entity);
+    }
+    return query;
+  }
+
+  void EntityQueryIndex::update(Entity* entity)
+  {
+    for(auto& pair : mQueries) {
+      pair.second->update(entity);
+    }
+  }
+
+  void EntityQueryIndex::remove(Entity* entity)
+  {
+    for(auto& pair : mQueries) {
+      pair.second->remove(entity);
+    }
+  }
+
+  void EntityQueryIndex::clear()
+  {
+    for(auto& pair : mQueries) {
+      pair.second->clear();
+    }
+  }
+
+  void EntityQueryIndex::compact()
+  {
+    for(auto& pair : mQueries) {
+      pair.second->compact();
+    }
+  }
+}
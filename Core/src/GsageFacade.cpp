@@ -204,6 +204,19 @@ namespace Gsage {
     mConfig = config;
     if(config.get<bool>("startLuaInterface", true)) {
       mLuaInterface->initialize(mLuaState);
+      auto gc = config.get<DataProxy>("luaGC");
+      if(gc.second) {
+        mLuaInterface->getGarbageCollector().configure(gc.first);
+      }
+
+      // precompiled scripts, built by the packager
+      auto bytecode = config.get<DataProxy>("packager.bytecode");
+      if(bytecode.second) {
+        std::string bundle = mResourcePath + GSAGE_PATH_SEPARATOR + bytecode.first.get("bundle", std::string("scripts.bundle"));
+        if(mFilesystem.exists(bundle)) {
+          mLuaInterface->loadBytecodeBundle(bundle, mResourcePath + GSAGE_PATH_SEPARATOR + bytecode.first.get("root", std::string("scripts")));
+        }
+      }
       // execute lua package manager, if it's enabled
       auto pair = config.get<DataProxy>("packager");
 
@@ -467,10 +480,17 @@ namespace Gsage {
     mEngine.update(frameTime.count());
     mInputManager.update(frameTime.count());
     mFilesystem.update(frameTime.count());
+    // lua garbage collection is paced by frames
+    LuaGarbageCollector& gc = mLuaInterface->getGarbageCollector();
+    gc.step();
     mPreviousUpdateTime = now;
     std::chrono::duration<double> maxTime(1.0/60.0);
     if(maxTime > frameTime) {
-      std::this_thread::sleep_for(maxTime - frameTime);
+      std::chrono::duration<double> idleTime = maxTime - frameTime;
+      idleTime -= std::chrono::duration<double>(gc.idle(idleTime.count()));
+      if(idleTime.count() > 0) {
+        std::this_thread::sleep_for(idleTime);
+      }
     }
 
     return !mStopped;
@@ -0,0 +1,346 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Gsage
+{
+
+  // 21 bit per axis, coordinates outside of that range wrap, which only adds candidates
+  static const int KEY_BITS = 21;
+  static const uint64_t KEY_MASK = (1 << KEY_BITS) - 1;
+
+  SpatialIndex::SpatialIndex(float cellSize)
+    : mCellSize(cellSize)
+    , mInverseCellSize(1.0f / cellSize)
+  {
+  }
+
+  SpatialIndex::~SpatialIndex()
+  {
+  }
+
+  void SpatialIndex::setCellSize(float cellSize)
+  {
+    if(cellSize <= 0.0f || cellSize == mCellSize) {
+      return;
+    }
+
+    mCellSize = cellSize;
+    mInverseCellSize = 1.0f / cellSize;
+    mCells.clear();
+    for(size_t i = 0; i < mItems.size(); ++i) {
+      insert(i);
+    }
+  }
+
+  int SpatialIndex::toCell(double value) const
+  {
+    return (int)std::floor(value * mInverseCellSize);
+  }
+
+  SpatialIndex::CellKey SpatialIndex::getKey(int x, int y, int z)
+  {
+    return ((CellKey)(x & KEY_MASK) << (KEY_BITS * 2)) | ((CellKey)(y & KEY_MASK) << KEY_BITS) | (CellKey)(z & KEY_MASK);
+  }
+
+  void SpatialIndex::insert(size_t index)
+  {
+    Item& item = mItems[index];
+    item.cell = getKey(toCell(item.x), toCell(item.y), toCell(item.z));
+    Cell& cell = mCells[item.cell];
+    item.slot = cell.size();
+    cell.push_back(index);
+  }
+
+  void SpatialIndex::erase(size_t index)
+  {
+    Item& item = mItems[index];
+    auto iter = mCells.find(item.cell);
+    Cell& cell = iter->second;
+    size_t last = cell.back();
+    cell[item.slot] = last;
+    mItems[last].slot = item.slot;
+    cell.pop_back();
+    if(cell.empty()) {
+      mCells.erase(iter);
+    }
+  }
+
+  void SpatialIndex::update(Entity* entity, const Vector3& position, unsigned int flags)
+  {
+    auto iter = mPositions.find(entity);
+    if(iter == mPositions.end()) {
+      Item item;
+      item.entity = entity;
+      item.x = position.X;
+      item.y = position.Y;
+      item.z = position.Z;
+      item.flags = flags;
+      mItems.push_back(item);
+      mPositions[entity] = mItems.size() - 1;
+      insert(mItems.size() - 1);
+      return;
+    }
+
+    size_t index = iter->second;
+    Item& item = mItems[index];
+    item.x = position.X;
+    item.y = position.Y;
+    item.z = position.Z;
+    item.flags = flags;
+
+    CellKey key = getKey(toCell(item.x), toCell(item.y), toCell(item.z));
+    if(key != item.cell) {
+      erase(index);
+      insert(index);
+    }
+  }
+
+  bool SpatialIndex::remove(Entity* entity)
+  {
+    auto iter = mPositions.find(entity);
+    if(iter == mPositions.end()) {
+      return false;
+    }
+
+    size_t index = iter->second;
+    mPositions.erase(iter);
+    erase(index);
+
+    size_t last = mItems.size() - 1;
+    if(index != last) {
+      // move the last item into the freed position
+      mItems[index] = mItems[last];
+      Item& moved = mItems[index];
+      mCells[moved.cell][moved.slot] = index;
+      mPositions[moved.entity] = index;
+    }
+    mItems.pop_back();
+    return true;
+  }
+
+  bool SpatialIndex::contains(Entity* entity) const
+  {
+    return mPositions.count(entity) != 0;
+  }
+
+  void SpatialIndex::clear()
+  {
+    mItems.clear();
+    mPositions.clear();
+    mCells.clear();
+  }
+
+  template<typename F>
+  void SpatialIndex::visit(double minX, double minY, double minZ, double maxX, double maxY, double maxZ, F f) const
+  {
+    int x0 = toCell(minX), y0 = toCell(minY), z0 = toCell(minZ);
+    int x1 = toCell(maxX), y1 = toCell(maxY), z1 = toCell(maxZ);
+
+    double cells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1) * ((double)z1 - z0 + 1);
+    if(cells > (double)mCells.size()) {
+      for(auto& item : mItems) {
+        f(item);
+      }
+      return;
+    }
+
+    for(int x = x0; x <= x1; ++x) {
+      for(int y = y0; y <= y1; ++y) {
+        for(int z = z0; z <= z1; ++z) {
+          auto iter = mCells.find(getKey(x, y, z));
+          if(iter == mCells.end()) {
+            continue;
+          }
+
+          for(size_t index : iter->second) {
+            f(mItems[index]);
+          }
+        }
+      }
+    }
+  }
+
+  size_t SpatialIndex::queryRadius(const Vector3& center, float radius, Entities& dest, unsigned int flags) const
+  {
+    dest.clear();
+    float cx = center.X, cy = center.Y, cz = center.Z;
+    float squaredRadius = radius * radius;
+    visit(cx - radius, cy - radius, cz - radius, cx + radius, cy + radius, cz + radius, [&] (const Item& item) {
+      float dx = item.x - cx, dy = item.y - cy, dz = item.z - cz;
+      if((item.flags & flags) != 0 && dx * dx + dy * dy + dz * dz <= squaredRadius) {
+        dest.push_back(item.entity);
+      }
+    });
+    return dest.size();
+  }
+
+  size_t SpatialIndex::queryRadius(const std::vector<Vector3>& centers, float radius, std::vector<Entities>& dest, unsigned int flags) const
+  {
+    size_t count = 0;
+    dest.resize(centers.size());
+    for(size_t i = 0; i < centers.size(); ++i) {
+      count += queryRadius(centers[i], radius, dest[i], flags);
+    }
+    return count;
+  }
+
+  size_t SpatialIndex::queryBox(const BoundingBox& bounds, Entities& dest, unsigned int flags) const
+  {
+    dest.clear();
+    if(bounds.extent == BoundingBox::EXTENT_NULL) {
+      return 0;
+    }
+
+    if(bounds.extent == BoundingBox::EXTENT_INFINITE) {
+      for(auto& item : mItems) {
+        if((item.flags & flags) != 0) {
+          dest.push_back(item.entity);
+        }
+      }
+      return dest.size();
+    }
+
+    const Vector3& min = bounds.min;
+    const Vector3& max = bounds.max;
+    visit(min.X, min.Y, min.Z, max.X, max.Y, max.Z, [&] (const Item& item) {
+      if((item.flags & flags) != 0 &&
+          item.x >= min.X && item.y >= min.Y && item.z >= min.Z &&
+          item.x <= max.X && item.y <= max.Y && item.z <= max.Z) {
+        dest.push_back(item.entity);
+      }
+    });
+    return dest.size();
+  }
+
+  size_t SpatialIndex::queryNearest(const Vector3& center, size_t count, Entities& dest, unsigned int flags, float maxDistance) const
+  {
+    dest.clear();
+    if(count == 0 || mItems.empty()) {
+      return 0;
+    }
+
+    typedef std::pair<float, Entity*> Candidate;
+    std::vector<Candidate> candidates;
+    float cx = center.X, cy = center.Y, cz = center.Z;
+
+    float squaredRadius = 0.0f;
+    auto collect = [&] (const Item& item) {
+      float dx = item.x - cx, dy = item.y - cy, dz = item.z - cz;
+      float distance = dx * dx + dy * dy + dz * dz;
+      if((item.flags & flags) != 0 && distance <= squaredRadius) {
+        candidates.emplace_back(distance, item.entity);
+      }
+    };
+
+    // grow the search radius until there are enough entities inside of it
+    float radius = std::min(mCellSize, maxDistance);
+    while(true) {
+      candidates.clear();
+      double cells = std::pow(2.0 * radius * mInverseCellSize + 1.0, 3.0);
+      if(cells > (double)mCells.size()) {
+        // growing further is not cheaper than a full scan, so scan everything up to the max distance
+        squaredRadius = maxDistance * maxDistance;
+        for(auto& item : mItems) {
+          collect(item);
+        }
+        break;
+      }
+
+      squaredRadius = radius * radius;
+      visit(cx - radius, cy - radius, cz - radius, cx + radius, cy + radius, cz + radius, collect);
+      if(candidates.size() >= count || radius >= maxDistance) {
+        break;
+      }
+      radius = std::min(radius * 2.0f, maxDistance);
+    }
+
+    size_t found = std::min(count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end());
+    for(size_t i = 0; i < found; ++i) {
+      dest.push_back(candidates[i].second);
+    }
+    return found;
+  }
+
+  size_t SpatialIndex::queryFrustum(const Planes& planes, Entities& dest, unsigned int flags) const
+  {
+    dest.clear();
+    float half = mCellSize * 0.5f;
+    for(auto& pair : mCells) {
+      // cells are tested by the first item in them, expanded by the cell diagonal
+      const Item& first = mItems[pair.second[0]];
+      float centerX = (toCell(first.x) + 0.5f) * mCellSize;
+      float centerY = (toCell(first.y) + 0.5f) * mCellSize;
+      float centerZ = (toCell(first.z) + 0.5f) * mCellSize;
+
+      bool outside = false;
+      bool inside = true;
+      for(auto& plane : planes) {
+        const Vector3& n = plane.normal;
+        double distance = n.X * centerX + n.Y * centerY + n.Z * centerZ + plane.d;
+        double extent = half * (std::fabs(n.X) + std::fabs(n.Y) + std::fabs(n.Z));
+        if(distance < -extent) {
+          outside = true;
+          break;
+        }
+        inside = inside && distance >= extent;
+      }
+
+      if(outside) {
+        continue;
+      }
+
+      for(size_t index : pair.second) {
+        const Item& item = mItems[index];
+        if((item.flags & flags) == 0) {
+          continue;
+        }
+
+        bool contained = inside;
+        if(!contained) {
+          contained = true;
+          for(auto& plane : planes) {
+            const Vector3& n = plane.normal;
+            if(n.X * item.x + n.Y * item.y + n.Z * item.z + plane.d < 0) {
+              contained = false;
+              break;
+            }
+          }
+        }
+
+        if(contained) {
+          dest.push_back(item.entity);
+        }
+      }
+    }
+    return dest.size();
+  }
+}
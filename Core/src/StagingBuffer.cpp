@@ -0,0 +1,290 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "StagingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+// copies smaller than that are not worth spawning threads
+#define PARALLEL_COPY_THRESHOLD (1 << 21)
+
+namespace Gsage {
+
+  static size_t getRectArea(const Rect<int>& rect)
+  {
+    return (size_t)rect.width * (size_t)rect.height;
+  }
+
+  static Rect<int> unite(const Rect<int>& a, const Rect<int>& b)
+  {
+    int x = std::min(a.x, b.x);
+    int y = std::min(a.y, b.y);
+    return Rect<int>(x, y, std::max(a.x + a.width, b.x + b.width) - x, std::max(a.y + a.height, b.y + b.height) - y);
+  }
+
+  static bool contains(const Rect<int>& outer, const Rect<int>& inner)
+  {
+    return inner.x >= outer.x && inner.y >= outer.y &&
+      inner.x + inner.width <= outer.x + outer.width &&
+      inner.y + inner.height <= outer.y + outer.height;
+  }
+
+  static bool clip(const Rect<int>& area, int width, int height, Rect<int>& res)
+  {
+    int x = std::max(area.x, 0);
+    int y = std::max(area.y, 0);
+    res = Rect<int>(x, y, std::min(area.x + area.width, width) - x, std::min(area.y + area.height, height) - y);
+    return res.width > 0 && res.height > 0;
+  }
+
+  static void copyRange(char* dest, size_t destPitch, const char* src, size_t srcPitch, size_t rowSize, size_t start, size_t end)
+  {
+    dest += destPitch * start;
+    src += srcPitch * start;
+    if(destPitch == rowSize && srcPitch == rowSize) {
+      memcpy(dest, src, rowSize * (end - start));
+      return;
+    }
+
+    for(size_t row = start; row < end; ++row) {
+      memcpy(dest, src, rowSize);
+      dest += destPitch;
+      src += srcPitch;
+    }
+  }
+
+  DirtyRegions::DirtyRegions(size_t maxRects)
+    : mMaxRects(std::max((size_t)1, maxRects))
+  {
+  }
+
+  DirtyRegions::~DirtyRegions()
+  {
+  }
+
+  void DirtyRegions::add(const Rect<int>& area, int width, int height)
+  {
+    Rect<int> clipped(0, 0, 0, 0);
+    if(!clip(area, width, height, clipped)) {
+      return;
+    }
+
+    insert(clipped);
+
+    while(mRects.size() > mMaxRects) {
+      size_t first = 0;
+      size_t second = 1;
+      size_t minWaste = std::numeric_limits<size_t>::max();
+      for(size_t i = 0; i < mRects.size(); ++i) {
+        for(size_t j = i + 1; j < mRects.size(); ++j) {
+          size_t united = getRectArea(unite(mRects[i], mRects[j]));
+          size_t sum = getRectArea(mRects[i]) + getRectArea(mRects[j]);
+          size_t waste = united > sum ? united - sum : 0;
+          if(waste < minWaste) {
+            minWaste = waste;
+            first = i;
+            second = j;
+          }
+        }
+      }
+
+      Rect<int> united = unite(mRects[first], mRects[second]);
+      mRects.erase(mRects.begin() + second);
+      mRects.erase(mRects.begin() + first);
+      insert(united);
+    }
+  }
+
+  void DirtyRegions::insert(Rect<int> area)
+  {
+    // merged rect can overlap other rects, so the scan starts over after each merge
+    for(size_t i = 0; i < mRects.size();) {
+      Rect<int> united = unite(mRects[i], area);
+      if(getRectArea(united) <= getRectArea(mRects[i]) + getRectArea(area)) {
+        area = united;
+        mRects[i] = mRects.back();
+        mRects.pop_back();
+        i = 0;
+        continue;
+      }
+      ++i;
+    }
+
+    mRects.push_back(area);
+  }
+
+  size_t DirtyRegions::getArea() const
+  {
+    size_t res = 0;
+    for(auto& rect : mRects) {
+      res += getRectArea(rect);
+    }
+    return res;
+  }
+
+  StagingBuffer::Buffer::Buffer(size_t maxRects)
+    : width(0)
+    , height(0)
+    , pixelSize(0)
+    , regions(maxRects)
+  {
+  }
+
+  StagingBuffer::StagingBuffer(size_t maxRects)
+    : mChanged(false)
+    , mFront(maxRects)
+    , mBack(maxRects)
+    , mStale(maxRects)
+  {
+  }
+
+  StagingBuffer::~StagingBuffer()
+  {
+  }
+
+  void StagingBuffer::write(const void* buffer, size_t size, int width, int height, const Rect<int>* areas, size_t count)
+  {
+    if(width <= 0 || height <= 0 || size == 0) {
+      return;
+    }
+
+    int pixelSize = size / ((size_t)width * height);
+    std::lock_guard<std::mutex> lock(mLock);
+    if(mBack.width != width || mBack.height != height || mBack.pixelSize != pixelSize) {
+      mBack.data.resize((size_t)width * height * pixelSize);
+      mBack.width = width;
+      mBack.height = height;
+      mBack.pixelSize = pixelSize;
+      mBack.regions.clear();
+      if(mFront.width == width && mFront.height == height && mFront.pixelSize == pixelSize) {
+        // front buffer has the same size, so the back buffer just needs its contents
+        size_t pitch = (size_t)width * pixelSize;
+        copyRows(mBack.data.data(), pitch, mFront.data.data(), pitch, pitch, height);
+      } else {
+        // image was resized, so everything should be redrawn
+        mBack.regions.add(Rect<int>(0, 0, width, height), width, height);
+      }
+      mStale.clear();
+    } else {
+      sync(areas, count);
+    }
+
+    for(size_t i = 0; i < count; ++i) {
+      copyRect(mBack.data.data(), static_cast<const char*>(buffer), width, height, pixelSize, areas[i]);
+      mBack.regions.add(areas[i], width, height);
+    }
+
+    mChanged.store(true, std::memory_order_release);
+  }
+
+  void StagingBuffer::sync(const Rect<int>* areas, size_t count)
+  {
+    for(auto& stale : mStale.get()) {
+      bool overwritten = false;
+      for(size_t i = 0; i < count; ++i) {
+        if(contains(areas[i], stale)) {
+          overwritten = true;
+          break;
+        }
+      }
+
+      if(!overwritten) {
+        copyRect(mBack.data.data(), mFront.data.data(), mBack.width, mBack.height, mBack.pixelSize, stale);
+      }
+    }
+    mStale.clear();
+  }
+
+  bool StagingBuffer::acquire()
+  {
+    std::unique_lock<std::mutex> lock(mLock, std::try_to_lock);
+    if(!lock.owns_lock() || mBack.regions.empty()) {
+      return false;
+    }
+
+    std::swap(mFront, mBack);
+    // back buffer misses the changes which were just acquired, they are copied on the next write
+    mStale = mFront.regions;
+    mBack.regions.clear();
+    mChanged.store(false, std::memory_order_release);
+    return true;
+  }
+
+  void StagingBuffer::reset()
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    for(Buffer* buffer : {&mFront, &mBack}) {
+      std::vector<char>().swap(buffer->data);
+      buffer->width = 0;
+      buffer->height = 0;
+      buffer->pixelSize = 0;
+      buffer->regions.clear();
+    }
+    mStale.clear();
+    mChanged.store(false, std::memory_order_release);
+  }
+
+  void StagingBuffer::copyRows(char* dest, size_t destPitch, const char* src, size_t srcPitch, size_t rowSize, size_t rows)
+  {
+    if(rows == 0 || rowSize == 0) {
+      return;
+    }
+
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max((size_t)1, rowSize * rows / PARALLEL_COPY_THRESHOLD));
+    if(threads <= 1 || rows < threads) {
+      copyRange(dest, destPitch, src, srcPitch, rowSize, 0, rows);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    size_t perThread = (rows + threads - 1) / threads;
+    for(size_t start = perThread; start < rows; start += perThread) {
+      workers.emplace_back(copyRange, dest, destPitch, src, srcPitch, rowSize, start, std::min(start + perThread, rows));
+    }
+
+    copyRange(dest, destPitch, src, srcPitch, rowSize, 0, std::min(perThread, rows));
+
+    for(auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  void StagingBuffer::copyRect(char* dest, const char* src, int width, int height, int pixelSize, const Rect<int>& area)
+  {
+    Rect<int> clipped(0, 0, 0, 0);
+    if(!clip(area, width, height, clipped)) {
+      return;
+    }
+
+    size_t pitch = (size_t)width * pixelSize;
+    size_t offset = (size_t)clipped.y * pitch + (size_t)clipped.x * pixelSize;
+    copyRows(dest + offset, pitch, src + offset, pitch, (size_t)clipped.width * pixelSize, clipped.height);
+  }
+}
@@ -0,0 +1,175 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "TimerWheel.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Gsage {
+
+  static inline int lowestBit(uint64_t value)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctzll(value);
+#endif
+  }
+
+  TimerWheel::TimerWheel()
+    : mCurrent(0)
+    , mSize(0)
+  {
+    for(int i = 0; i < LEVELS; ++i) {
+      mOccupied[i] = 0;
+    }
+  }
+
+  TimerWheel::~TimerWheel()
+  {
+  }
+
+  void TimerWheel::schedule(Tick expire, Payload payload)
+  {
+    mSize++;
+    Timer timer = {expire, payload};
+    if(expire <= mCurrent) {
+      mDue.push_back(timer);
+      return;
+    }
+
+    insert(timer);
+  }
+
+  size_t TimerWheel::advance(Tick tick, Payloads& expired)
+  {
+    size_t count = expired.size();
+    if(!mDue.empty()) {
+      take(mDue, expired);
+    }
+
+    while(mCurrent < tick) {
+      Tick base = mCurrent & ~SLOT_MASK;
+      Tick index = mCurrent & SLOT_MASK;
+      // find the next occupied slot in the current revolution of the first level
+      uint64_t mask = index == SLOT_MASK ? 0 : mOccupied[0] & (~uint64_t(0) << (index + 1));
+      Tick next = mask ? base + lowestBit(mask) : base + SLOTS;
+      if(next > tick) {
+        mCurrent = tick;
+        break;
+      }
+
+      mCurrent = next;
+      if((mCurrent & SLOT_MASK) == 0) {
+        // new revolution: move timers from upper levels down, starting from the highest level
+        // which crossed the boundary
+        int top = 1;
+        while(top + 1 < LEVELS && (mCurrent & ((Tick(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+          top++;
+        }
+
+        if(top == LEVELS - 1 && !mOverflow.empty()) {
+          Timers overflow;
+          overflow.swap(mOverflow);
+          for(auto& timer : overflow) {
+            insert(timer);
+          }
+        }
+
+        for(int level = top; level > 0; --level) {
+          cascade(level);
+        }
+      }
+
+      index = mCurrent & SLOT_MASK;
+      if(mOccupied[0] & (uint64_t(1) << index)) {
+        take(mSlots[0][index], expired);
+        mOccupied[0] &= ~(uint64_t(1) << index);
+      }
+    }
+
+    return expired.size() - count;
+  }
+
+  void TimerWheel::clear()
+  {
+    for(int level = 0; level < LEVELS; ++level) {
+      for(int i = 0; i < SLOTS; ++i) {
+        mSlots[level][i].clear();
+      }
+      mOccupied[level] = 0;
+    }
+
+    mOverflow.clear();
+    mDue.clear();
+    mCurrent = 0;
+    mSize = 0;
+  }
+
+  void TimerWheel::insert(const Timer& timer)
+  {
+    Tick delta = timer.expire > mCurrent ? timer.expire - mCurrent : 0;
+    for(int level = 0; level < LEVELS; ++level) {
+      if(delta < (Tick(1) << (SLOT_BITS * (level + 1)))) {
+        Tick index = (timer.expire >> (SLOT_BITS * level)) & SLOT_MASK;
+        mSlots[level][index].push_back(timer);
+        mOccupied[level] |= uint64_t(1) << index;
+        return;
+      }
+    }
+
+    mOverflow.push_back(timer);
+  }
+
+  void TimerWheel::cascade(int level)
+  {
+    Tick index = (mCurrent >> (SLOT_BITS * level)) & SLOT_MASK;
+    if((mOccupied[level] & (uint64_t(1) << index)) == 0) {
+      return;
+    }
+
+    Timers timers;
+    timers.swap(mSlots[level][index]);
+    mOccupied[level] &= ~(uint64_t(1) << index);
+    for(auto& timer : timers) {
+      insert(timer);
+    }
+  }
+
+  void TimerWheel::take(Timers& slot, Payloads& expired)
+  {
+    for(auto& timer : slot) {
+      expired.push_back(timer.payload);
+    }
+    mSize -= slot.size();
+    slot.clear();
+  }
+}
@@ -0,0 +1,154 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "UpdateLOD.h"
+#include "Entity.h"
+
+#include <algorithm>
+
+namespace Gsage
+{
+
+  // entities are indexed as points, so the frustum is extended a bit to keep big objects on the edge visible
+  static const double VISIBILITY_MARGIN = 2.0;
+
+  UpdateLOD::UpdateLOD()
+    : mEnabled(false)
+    , mFrame(0)
+    , mHalfDistance(0)
+    , mQuarterDistance(0)
+    , mOffDistance(0)
+    , mInvisibleRate(RATE_QUARTER)
+    , mViewerDirty(false)
+  {
+  }
+
+  UpdateLOD::~UpdateLOD()
+  {
+  }
+
+  void UpdateLOD::setDistances(float half, float quarter, float off)
+  {
+    mHalfDistance = half;
+    mQuarterDistance = quarter;
+    mOffDistance = off;
+  }
+
+  void UpdateLOD::setViewer(const Vector3& position, const SpatialIndex::Planes& planes)
+  {
+    std::lock_guard<std::mutex> lock(mViewerMutex);
+    mPendingViewer = position;
+    mPendingPlanes = planes;
+    mViewerDirty = true;
+  }
+
+  void UpdateLOD::update(const SpatialIndex& index)
+  {
+    mFrame++;
+    if(!mEnabled) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mViewerMutex);
+      if(mViewerDirty) {
+        mViewer = mPendingViewer;
+        mPlanes.swap(mPendingPlanes);
+        mViewerDirty = false;
+      }
+    }
+
+    index.forEach([this] (Entity* entity, const Vector3& position) {
+      entity->mUpdateRate = (unsigned char)getRate(position);
+      entity->mUpdateRateFrame = mFrame;
+    });
+  }
+
+  UpdateLOD::Rate UpdateLOD::getRate(Entity* entity) const
+  {
+    // rates are tagged with the frame, so entities that left the index are not stuck with the old rate
+    if(!mEnabled || entity->mUpdateRateFrame != mFrame) {
+      return RATE_FULL;
+    }
+    return (Rate)entity->getUpdateRate();
+  }
+
+  UpdateLOD::Rate UpdateLOD::getRate(const Vector3& position) const
+  {
+    double x = position.X - mViewer.X;
+    double y = position.Y - mViewer.Y;
+    double z = position.Z - mViewer.Z;
+    double distance = x * x + y * y + z * z;
+
+    Rate rate = RATE_FULL;
+    if(mOffDistance > 0 && distance > mOffDistance * mOffDistance) {
+      rate = RATE_OFF;
+    } else if(mQuarterDistance > 0 && distance > mQuarterDistance * mQuarterDistance) {
+      rate = RATE_QUARTER;
+    } else if(mHalfDistance > 0 && distance > mHalfDistance * mHalfDistance) {
+      rate = RATE_HALF;
+    }
+
+    if(rate >= mInvisibleRate) {
+      return rate;
+    }
+
+    for(auto& plane : mPlanes) {
+      if(Vector3::Dot(plane.normal, position) + plane.d < -VISIBILITY_MARGIN) {
+        return mInvisibleRate;
+      }
+    }
+    return rate;
+  }
+
+  bool UpdateLOD::tick(Entity* entity, double time, double& accumulated, double& delta) const
+  {
+    Rate rate = getRate(entity);
+    if(rate == RATE_FULL) {
+      delta = accumulated + time;
+      accumulated = 0;
+      return true;
+    }
+
+    // time is not accumulated for stopped entities, so they do not jump when start updating again
+    if(rate == RATE_OFF) {
+      accumulated = 0;
+      return false;
+    }
+
+    accumulated += time;
+    // entities are spread between frames, so the same rate entities do not tick all at once
+    size_t phase = reinterpret_cast<size_t>(entity) / sizeof(Entity);
+    size_t mask = (1 << rate) - 1;
+    if(((mFrame + phase) & mask) != 0) {
+      return false;
+    }
+
+    delta = accumulated;
+    accumulated = 0;
+    return true;
+  }
+}
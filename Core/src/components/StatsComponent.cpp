@@ -75,6 +75,17 @@ namespace Gsage {
     return true;
   }
 
+  bool StatsComponent::read(const sol::table& props)
+  {
+    return read(DataProxy::create(props));
+  }
+
+  bool StatsComponent::dump(sol::table& props)
+  {
+    DataProxy dict = DataProxy::wrap(props);
+    return dump(dict);
+  }
+
   const float StatsComponent::increase(const std::string& key, double n)
   {
     float newVal = getStat(key, 0.0f) + n;
@@ -0,0 +1,405 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "lua/BehaviorTree.h"
+#include "lua/BehaviorTreeExecutor.h"
+#include "Logger.h"
+
+#include <map>
+
+#include "lua.hpp"
+#include "sol.hpp"
+
+namespace Gsage {
+
+  // protects from reference loops in the lua tree description
+  static const int MAX_TREE_DEPTH = 128;
+
+  BehaviorTree::Node::Node(NodeType type)
+    : type(type)
+    , firstChild(0)
+    , childCount(0)
+    , current(0)
+    , failed(false)
+    , readyAt(0)
+    , childRunning(false)
+    , thread(0)
+    , threadRef(LUA_NOREF)
+  {
+  }
+
+  BehaviorTree::BehaviorTree(BehaviorTreeExecutor* executor, const sol::table& context)
+    : mExecutor(executor)
+    , mContext(context)
+    , mRoot(-1)
+  {
+  }
+
+  BehaviorTree::~BehaviorTree()
+  {
+    reset();
+  }
+
+  bool BehaviorTree::readNodeType(const std::string& value, NodeType& dest)
+  {
+    static std::map<std::string, NodeType> mapping = {
+      {"sequence", Sequence},
+      {"selector", Selector},
+      {"parallel", Parallel},
+      {"invertor", Invertor},
+      {"successor", Successor},
+      {"repeat", Repeat},
+      {"repeatUntil", RepeatUntil},
+      {"delay", Delay},
+      {"leaf", Leaf}
+    };
+
+    auto iter = mapping.find(value);
+    if(iter == mapping.end()) {
+      return false;
+    }
+
+    dest = iter->second;
+    return true;
+  }
+
+  bool BehaviorTree::build(const sol::table& root)
+  {
+    reset();
+    mNodes.clear();
+    mChildren.clear();
+    mRoot = build(root, 0);
+    return mRoot != -1;
+  }
+
+  int BehaviorTree::build(const sol::table& node, int depth)
+  {
+    if(depth > MAX_TREE_DEPTH) {
+      LOG(ERROR) << "Behavior tree is too deep";
+      return -1;
+    }
+
+    sol::optional<std::string> typeName = node.get<sol::optional<std::string>>("nodeType");
+    NodeType type;
+    if(!typeName || !readNodeType(typeName.value(), type)) {
+      LOG(ERROR) << "Unknown behavior tree node type " << (typeName ? typeName.value() : "nil");
+      return -1;
+    }
+
+    std::vector<int> children;
+    sol::object function;
+    switch(type) {
+      case Leaf:
+        function = node.get<sol::object>("callback");
+        if(function.get_type() != sol::type::function) {
+          LOG(ERROR) << "Leaf node has no callback";
+          return -1;
+        }
+        break;
+      case Delay:
+        function = node.get<sol::object>("delayClosure");
+        // fallthrough: delay has a single child as decorators do
+      case Invertor:
+      case Successor:
+        {
+          sol::optional<sol::table> child = node.get<sol::optional<sol::table>>("child");
+          if(child) {
+            int index = build(child.value(), depth + 1);
+            if(index == -1) {
+              return -1;
+            }
+            children.push_back(index);
+          } else if(type != Successor) {
+            LOG(ERROR) << "Node " << typeName.value() << " has no child";
+            return -1;
+          }
+        }
+        break;
+      default:
+        {
+          sol::optional<sol::table> list = node.get<sol::optional<sol::table>>("children");
+          if(!list) {
+            break;
+          }
+
+          sol::table& t = list.value();
+          for(size_t i = 1; i <= t.size(); ++i) {
+            sol::optional<sol::table> child = t.get<sol::optional<sol::table>>(i);
+            if(!child) {
+              continue;
+            }
+
+            int index = build(child.value(), depth + 1);
+            if(index == -1) {
+              return -1;
+            }
+            children.push_back(index);
+          }
+        }
+    }
+
+    mNodes.emplace_back(type);
+    Node& n = mNodes.back();
+    n.firstChild = (int)mChildren.size();
+    n.childCount = (int)children.size();
+    if(function.valid() && function.get_type() == sol::type::function) {
+      n.function = function;
+    }
+    mChildren.insert(mChildren.end(), children.begin(), children.end());
+    return (int)mNodes.size() - 1;
+  }
+
+  BehaviorTree::Status BehaviorTree::tick()
+  {
+    if(mRoot == -1) {
+      return Failure;
+    }
+
+    return tick(mRoot);
+  }
+
+  void BehaviorTree::reset()
+  {
+    for(size_t i = 0; i < mNodes.size(); ++i) {
+      reset((int)i);
+    }
+  }
+
+  int BehaviorTree::child(const Node& node, int index) const
+  {
+    return mChildren[node.firstChild + index];
+  }
+
+  BehaviorTree::Status BehaviorTree::tick(int index)
+  {
+    Node& node = mNodes[index];
+    Status status;
+    switch(node.type) {
+      case Sequence:
+        for(; node.current < node.childCount; ++node.current) {
+          status = tick(child(node, node.current));
+          if(status == Running) {
+            return Running;
+          }
+
+          if(status == Failure) {
+            node.current = 0;
+            return Failure;
+          }
+        }
+        node.current = 0;
+        return Success;
+      case Selector:
+        for(; node.current < node.childCount; ++node.current) {
+          status = tick(child(node, node.current));
+          if(status == Running) {
+            return Running;
+          }
+
+          if(status == Success) {
+            node.current = 0;
+            return Success;
+          }
+        }
+        node.current = 0;
+        return Failure;
+      case Parallel:
+        {
+          if((int)node.done.size() != node.childCount) {
+            node.done.assign(node.childCount, 0);
+          }
+
+          bool running = false;
+          for(int i = 0; i < node.childCount; ++i) {
+            if(node.done[i]) {
+              continue;
+            }
+
+            status = tick(child(node, i));
+            if(status == Running) {
+              running = true;
+              continue;
+            }
+
+            node.done[i] = 1;
+            node.failed = node.failed || status == Failure;
+          }
+
+          if(running) {
+            return Running;
+          }
+
+          status = node.failed ? Failure : Success;
+          node.done.assign(node.childCount, 0);
+          node.failed = false;
+          return status;
+        }
+      case Invertor:
+        status = tick(child(node, 0));
+        if(status == Running) {
+          return Running;
+        }
+        return status == Success ? Failure : Success;
+      case Successor:
+        if(node.childCount == 0) {
+          return Success;
+        }
+
+        return tick(child(node, 0)) == Running ? Running : Success;
+      case Repeat:
+      case RepeatUntil:
+        if(node.childCount == 0) {
+          return Running;
+        }
+
+        status = tick(child(node, node.current));
+        if(status == Running) {
+          return Running;
+        }
+
+        if(status == Failure && node.type == RepeatUntil) {
+          node.current = 0;
+          return Failure;
+        }
+
+        // continue with the next child on the next tick
+        node.current = (node.current + 1) % node.childCount;
+        return Running;
+      case Delay:
+        {
+          if(!node.childRunning && mExecutor->getTime() < node.readyAt) {
+            return Failure;
+          }
+
+          status = tick(child(node, 0));
+          if(status == Running) {
+            node.childRunning = true;
+            return Running;
+          }
+          node.childRunning = false;
+
+          double delay = 0;
+          if(node.function.valid()) {
+            lua_State* L = mExecutor->getLuaState();
+            node.function.push(L);
+            if(lua_pcall(L, 0, 1, 0) != 0) {
+              LOG(ERROR) << "Failed to get delay value: " << lua_tostring(L, -1);
+            } else {
+              delay = lua_tonumber(L, -1);
+            }
+            lua_pop(L, 1);
+          }
+          node.readyAt = mExecutor->getTime() + delay;
+          return Failure;
+        }
+      case Leaf:
+        return node.thread ? pollLeaf(node) : startLeaf(node);
+    }
+
+    return Failure;
+  }
+
+  BehaviorTree::Status BehaviorTree::startLeaf(Node& node)
+  {
+    mExecutor->acquireThread(node.thread, node.threadRef);
+    if(!node.thread) {
+      return Failure;
+    }
+
+    lua_settop(node.thread, 0);
+    if(!mExecutor->pushLeafRunner(node.thread)) {
+      mExecutor->releaseThread(node.thread, node.threadRef);
+      node.thread = 0;
+      node.threadRef = LUA_NOREF;
+      return Failure;
+    }
+
+    node.function.push(node.thread);
+    mContext.push(node.thread);
+    return finishLeaf(node, lua_resume(node.thread, mExecutor->getLuaState(), 2));
+  }
+
+  BehaviorTree::Status BehaviorTree::pollLeaf(Node& node)
+  {
+    int status = lua_status(node.thread);
+    if(status == LUA_YIELD) {
+      if(mExecutor->isWaiting(node.thread)) {
+        return Running;
+      }
+
+      // leaf yielded outside of the scheduler, so resume it here
+      status = lua_resume(node.thread, mExecutor->getLuaState(), 0);
+    }
+
+    // status 0 means that the scheduler has already finished the leaf coroutine,
+    // the result is left on the coroutine stack
+    return finishLeaf(node, status);
+  }
+
+  BehaviorTree::Status BehaviorTree::finishLeaf(Node& node, int status)
+  {
+    if(status == LUA_YIELD) {
+      // drop yielded values
+      lua_settop(node.thread, 0);
+      return Running;
+    }
+
+    Status result = Failure;
+    if(status == 0) {
+      if(lua_gettop(node.thread) > 0 && lua_toboolean(node.thread, -1)) {
+        result = Success;
+      }
+      lua_settop(node.thread, 0);
+      mExecutor->releaseThread(node.thread, node.threadRef);
+    } else {
+      const char* err = lua_tostring(node.thread, -1);
+      LOG(ERROR) << "Failed to run behavior tree leaf: " << (err ? err : "unknown error");
+      // coroutine is dead after error
+      mExecutor->abandonThread(node.threadRef);
+    }
+
+    node.thread = 0;
+    node.threadRef = LUA_NOREF;
+    return result;
+  }
+
+  void BehaviorTree::reset(int index)
+  {
+    Node& node = mNodes[index];
+    node.current = 0;
+    node.done.clear();
+    node.failed = false;
+    node.childRunning = false;
+    node.readyAt = 0;
+    if(node.thread) {
+      // coroutine can still be suspended in the scheduler, so it can't be reused
+      mExecutor->abandonThread(node.threadRef);
+      node.thread = 0;
+      node.threadRef = LUA_NOREF;
+    }
+  }
+}
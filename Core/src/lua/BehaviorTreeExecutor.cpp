@@ -0,0 +1,436 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "lua/BehaviorTreeExecutor.h"
+#include "lua/CoroutineScheduler.h"
+#include "components/ScriptComponent.h"
+#include "components/RenderComponent.h"
+#include "Engine.h"
+#include "Entity.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "lua.hpp"
+
+namespace Gsage {
+
+  // idle leaf coroutines kept for reuse
+  static const size_t MAX_POOLED_THREADS = 256;
+
+  BehaviorTreeExecutor::BehaviorTreeExecutor()
+    : mState(0)
+    , mEngine(0)
+    , mScheduler(0)
+    , mHasFocus(false)
+    , mCursor(0)
+    , mRemoved(0)
+    , mNextPhase(0)
+    , mUpdating(false)
+    , mTickBudget(0)
+    , mTimeBudget(0)
+    , mTickCount(0)
+    , mTime(0)
+  {
+  }
+
+  BehaviorTreeExecutor::~BehaviorTreeExecutor()
+  {
+  }
+
+  void BehaviorTreeExecutor::setLuaState(lua_State* L)
+  {
+    if(mState && mState != L) {
+      clear();
+    }
+    mState = L;
+  }
+
+  void BehaviorTreeExecutor::setEngine(Engine* engine)
+  {
+    mEngine = engine;
+  }
+
+  void BehaviorTreeExecutor::setScheduler(CoroutineScheduler* scheduler)
+  {
+    mScheduler = scheduler;
+  }
+
+  void BehaviorTreeExecutor::configure(const DataProxy& config)
+  {
+    mTickBudget = config.get("tickBudget", 0);
+    mTimeBudget = config.get("timeBudget", 0.0);
+    setFocusEntity(config.get("focusEntity", std::string("")));
+
+    mLods.clear();
+    auto lods = config.get<DataProxy>("lod");
+    if(lods.second) {
+      for(auto pair : lods.first) {
+        LodLevel level;
+        level.distance = pair.second.get("distance", 0.0);
+        if(level.distance <= 0) {
+          level.distance = std::numeric_limits<double>::max();
+        }
+        level.interval = pair.second.get("interval", 0.0);
+        mLods.push_back(level);
+      }
+
+      std::sort(mLods.begin(), mLods.end(), [] (const LodLevel& a, const LodLevel& b) { return a.distance < b.distance; });
+    }
+
+    // reassign LOD levels on the next tick
+    for(auto& instance : mInstances) {
+      instance.lod = -1;
+    }
+  }
+
+  bool BehaviorTreeExecutor::add(ScriptComponent* component)
+  {
+    if(!mState || has(component)) {
+      return false;
+    }
+
+    Instance instance;
+    instance.component = component;
+    instance.lastTick = mTime;
+    instance.nextTick = mTime;
+    instance.lod = -1;
+    // golden ratio sequence gives an even spread of phases for any count of trees
+    instance.phase = std::fmod(mNextPhase++ * 0.618033988749895, 1.0);
+    instance.finished = true;
+
+    const std::string& id = component->getOwner()->getId();
+    if(resolveFunctions()) {
+      auto res = mGetBehavior(component->getBehavior());
+      sol::optional<sol::table> root;
+      if(res.valid()) {
+        root = res.get<sol::optional<sol::table>>();
+      } else {
+        sol::error err = res;
+        LOG(ERROR) << "Failed to get behavior " << component->getBehavior() << ": " << err.what();
+      }
+
+      if(root) {
+        auto ctx = mCreateContext(id);
+        if(ctx.valid()) {
+          sol::table context = ctx;
+          instance.tree = std::unique_ptr<BehaviorTree>(new BehaviorTree(this, context));
+          if(instance.tree->build(root.value())) {
+            component->setBtree(root.value());
+            component->setData(context);
+            instance.finished = false;
+            LOG(INFO) << "Successfuly registered script component for entity " << id;
+          } else {
+            LOG(ERROR) << "Failed to build behavior tree " << component->getBehavior() << " for entity " << id;
+          }
+        } else {
+          sol::error err = ctx;
+          LOG(ERROR) << "Failed to create behavior context for entity " << id << ": " << err.what();
+        }
+      }
+    }
+
+    mIndex[component] = mInstances.size();
+    mInstances.push_back(std::move(instance));
+    return !mInstances.back().finished;
+  }
+
+  bool BehaviorTreeExecutor::remove(ScriptComponent* component)
+  {
+    Index::iterator iter = mIndex.find(component);
+    if(iter == mIndex.end()) {
+      return false;
+    }
+
+    Instance& instance = mInstances[iter->second];
+    bool hadTree = instance.tree && instance.tree->getNodeCount() > 0;
+    // tree can be still running, so it's destroyed on compact
+    instance.component = 0;
+    instance.finished = true;
+    mIndex.erase(iter);
+    mRemoved++;
+
+    if(!mUpdating) {
+      compact();
+    }
+
+    if(hadTree) {
+      LOG(INFO) << "Stopped btree for object " << component->getOwner()->getId();
+    }
+    return true;
+  }
+
+  bool BehaviorTreeExecutor::has(ScriptComponent* component) const
+  {
+    return mIndex.count(component) != 0;
+  }
+
+  void BehaviorTreeExecutor::update(double time)
+  {
+    mTime += time;
+    mTickCount = 0;
+    if(mInstances.empty()) {
+      return;
+    }
+
+    Vector3 focus;
+    bool hasFocus = getFocus(focus);
+
+    mUpdating = true;
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t count = mInstances.size();
+    size_t i = 0;
+    for(; i < count; ++i) {
+      Instance& instance = mInstances[(mCursor + i) % count];
+      if(!instance.component || instance.finished || mTime < instance.nextTick) {
+        continue;
+      }
+
+      if(mTickBudget > 0 && mTickCount >= mTickBudget) {
+        break;
+      }
+
+      if(mTimeBudget > 0 && mTickCount > 0) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        if(elapsed.count() >= mTimeBudget) {
+          break;
+        }
+      }
+
+      tick(instance, hasFocus, focus);
+      mTickCount++;
+    }
+    // continue from the first tree that did not fit into the budget
+    mCursor = (mCursor + i) % count;
+    mUpdating = false;
+
+    if(mRemoved > 0) {
+      compact();
+    }
+  }
+
+  void BehaviorTreeExecutor::clear()
+  {
+    mInstances.clear();
+    mIndex.clear();
+    mCursor = 0;
+    mRemoved = 0;
+
+    if(mState) {
+      for(auto& thread : mThreads) {
+        luaL_unref(mState, LUA_REGISTRYINDEX, thread.ref);
+      }
+    }
+    mThreads.clear();
+
+    mCreateContext = sol::protected_function();
+    mGetBehavior = sol::protected_function();
+    mRunLeaf = sol::reference();
+  }
+
+  void BehaviorTreeExecutor::setFocus(const Vector3& position)
+  {
+    mFocus = position;
+    mHasFocus = true;
+  }
+
+  void BehaviorTreeExecutor::setFocusEntity(const std::string& id)
+  {
+    mFocusEntity = id;
+  }
+
+  void BehaviorTreeExecutor::acquireThread(lua_State*& thread, int& ref)
+  {
+    if(!mThreads.empty()) {
+      thread = mThreads.back().state;
+      ref = mThreads.back().ref;
+      mThreads.pop_back();
+      return;
+    }
+
+    thread = lua_newthread(mState);
+    ref = luaL_ref(mState, LUA_REGISTRYINDEX);
+  }
+
+  void BehaviorTreeExecutor::releaseThread(lua_State* thread, int ref)
+  {
+    if(mThreads.size() >= MAX_POOLED_THREADS) {
+      abandonThread(ref);
+      return;
+    }
+
+    LeafThread t = {thread, ref};
+    mThreads.push_back(t);
+  }
+
+  void BehaviorTreeExecutor::abandonThread(int ref)
+  {
+    if(mState && ref != LUA_NOREF) {
+      luaL_unref(mState, LUA_REGISTRYINDEX, ref);
+    }
+  }
+
+  bool BehaviorTreeExecutor::isWaiting(lua_State* thread) const
+  {
+    return mScheduler && mScheduler->isSuspended(thread);
+  }
+
+  bool BehaviorTreeExecutor::pushLeafRunner(lua_State* L)
+  {
+    if(!mRunLeaf.valid()) {
+      return false;
+    }
+
+    mRunLeaf.push(L);
+    return true;
+  }
+
+  bool BehaviorTreeExecutor::resolveFunctions()
+  {
+    if(mCreateContext.valid() && mGetBehavior.valid() && mRunLeaf.valid()) {
+      return true;
+    }
+
+    sol::state_view lua(mState);
+    sol::optional<sol::table> btree = lua["btree"];
+    if(!btree) {
+      LOG(ERROR) << "Failed to create behavior tree: btree module is not loaded";
+      return false;
+    }
+
+    sol::object createContext = btree.value()["createContext"];
+    sol::object getBehavior = btree.value()["getBehavior"];
+    sol::object runLeaf = btree.value()["runLeaf"];
+    if(createContext.get_type() != sol::type::function ||
+       getBehavior.get_type() != sol::type::function ||
+       runLeaf.get_type() != sol::type::function) {
+      LOG(ERROR) << "Failed to create behavior tree: btree module is missing createContext, getBehavior or runLeaf";
+      return false;
+    }
+
+    mCreateContext = createContext.as<sol::protected_function>();
+    mGetBehavior = getBehavior.as<sol::protected_function>();
+    mRunLeaf = runLeaf;
+    return true;
+  }
+
+  bool BehaviorTreeExecutor::getFocus(Vector3& dest)
+  {
+    if(!mFocusEntity.empty() && mEngine) {
+      Entity* entity = mEngine->getEntity(mFocusEntity);
+      if(entity && entity->hasComponent(RenderComponent::SYSTEM)) {
+        dest = entity->getComponent<RenderComponent>()->getPosition();
+        return true;
+      }
+    }
+
+    if(mHasFocus) {
+      dest = mFocus;
+    }
+    return mHasFocus;
+  }
+
+  void BehaviorTreeExecutor::tick(Instance& instance, bool hasFocus, const Vector3& focus)
+  {
+    instance.tree->getContext()["delta"] = mTime - instance.lastTick;
+    instance.lastTick = mTime;
+
+    BehaviorTree::Status status = instance.tree->tick();
+    if(!instance.component) {
+      // removed while ticking
+      return;
+    }
+
+    if(status != BehaviorTree::Running) {
+      instance.finished = true;
+      LOG(INFO) << "Behavior tree finished for entity " << instance.component->getOwner()->getId();
+      return;
+    }
+
+    int lod = getLod(instance, hasFocus, focus);
+    double interval = lod == -1 ? 0 : mLods[lod].interval;
+    if(lod != instance.lod) {
+      // spread trees that switched to the same LOD level over the interval
+      instance.nextTick = mTime + interval * instance.phase;
+      instance.lod = lod;
+    } else {
+      instance.nextTick = mTime + interval;
+    }
+  }
+
+  int BehaviorTreeExecutor::getLod(Instance& instance, bool hasFocus, const Vector3& focus)
+  {
+    if(!hasFocus || mLods.empty()) {
+      return -1;
+    }
+
+    Entity* entity = instance.component->getOwner();
+    if(!entity->hasComponent(RenderComponent::SYSTEM)) {
+      return -1;
+    }
+
+    Vector3 position = entity->getComponent<RenderComponent>()->getPosition();
+    double dx = position.X - focus.X;
+    double dy = position.Y - focus.Y;
+    double dz = position.Z - focus.Z;
+    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    for(size_t i = 0; i < mLods.size(); ++i) {
+      if(distance <= mLods[i].distance) {
+        return (int)i;
+      }
+    }
+
+    return (int)mLods.size() - 1;
+  }
+
+  void BehaviorTreeExecutor::compact()
+  {
+    size_t cursor = mCursor;
+    size_t write = 0;
+    for(size_t read = 0; read < mInstances.size(); ++read) {
+      if(!mInstances[read].component) {
+        if(read < mCursor) {
+          cursor--;
+        }
+        continue;
+      }
+
+      if(write != read) {
+        mInstances[write] = std::move(mInstances[read]);
+      }
+      mIndex[mInstances[write].component] = write;
+      write++;
+    }
+
+    mInstances.erase(mInstances.begin() + write, mInstances.end());
+    mCursor = write == 0 ? 0 : cursor % write;
+    mRemoved = 0;
+  }
+}
@@ -0,0 +1,388 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "lua/BytecodeBundle.h"
+#include "Logger.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+
+#include "lua.hpp"
+#include "sol.hpp"
+
+namespace Gsage {
+
+  static const int BYTECODE_MAGIC = 'G'<<24 | 'S'<<16 | 'B'<<8 | 'C';
+  static const int BYTECODE_VERSION = 1;
+
+#ifdef LUAJIT_VERSION
+  static const char* BYTECODE_LUA_VERSION = LUAJIT_VERSION;
+#else
+  static const char* BYTECODE_LUA_VERSION = LUA_RELEASE;
+#endif
+
+  struct BytecodeBundleHeader
+  {
+    int magic;
+    int version;
+    int numEntries;
+    int pointerSize;
+    // bytecode is not compatible between lua versions
+    char luaVersion[32];
+  };
+
+  struct BytecodeEntryHeader
+  {
+    uint32_t moduleLength;
+    uint32_t pathLength;
+    int64_t mtime;
+    uint64_t hash;
+    uint64_t size;
+  };
+
+  static int writeChunk(lua_State* L, const void* p, size_t size, void* ud)
+  {
+    static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+    return 0;
+  }
+
+  BytecodeBundle::BytecodeBundle()
+  {
+  }
+
+  BytecodeBundle::~BytecodeBundle()
+  {
+  }
+
+  bool BytecodeBundle::add(lua_State* L, const std::string& root, const std::string& path)
+  {
+    std::string source;
+    std::string fullPath = Poco::Path(root).append(path).toString();
+    if(!readFile(fullPath, source)) {
+      LOG(ERROR) << "Failed to read lua script " << fullPath;
+      return false;
+    }
+
+    std::string chunkName = "@" + fullPath;
+    if(luaL_loadbuffer(L, source.c_str(), source.size(), chunkName.c_str()) != 0) {
+      LOG(ERROR) << "Failed to compile lua script " << fullPath << ": " << lua_tostring(L, -1);
+      lua_pop(L, 1);
+      return false;
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.mtime = getModificationTime(fullPath);
+    entry.hash = hash(source.c_str(), source.size());
+    entry.offset = mData.size();
+    lua_dump(L, &writeChunk, &mData);
+    lua_pop(L, 1);
+    entry.size = mData.size() - entry.offset;
+
+    mEntries[getModuleName(path)] = entry;
+    return true;
+  }
+
+  int BytecodeBundle::addFolder(lua_State* L, const std::string& root)
+  {
+    int count = 0;
+    std::vector<std::string> folders = {""};
+    while(!folders.empty()) {
+      std::string folder = folders.back();
+      folders.pop_back();
+
+      std::vector<std::string> files;
+      Poco::File(Poco::Path(root).append(folder)).list(files);
+      for(auto& file : files) {
+        std::string path = folder.empty() ? file : folder + "/" + file;
+        Poco::File f(Poco::Path(root).append(path));
+        if(f.isDirectory()) {
+          folders.push_back(path);
+          continue;
+        }
+
+        if(Poco::Path(path).getExtension() != "lua") {
+          continue;
+        }
+
+        if(!add(L, root, path)) {
+          return -1;
+        }
+        count++;
+      }
+    }
+
+    return count;
+  }
+
+  bool BytecodeBundle::dump(const std::string& filepath) const
+  {
+    std::ofstream stream(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!stream) {
+      LOG(ERROR) << "Failed to open bytecode bundle for writing " << filepath;
+      return false;
+    }
+
+    BytecodeBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BYTECODE_MAGIC;
+    header.version = BYTECODE_VERSION;
+    header.numEntries = (int)mEntries.size();
+    header.pointerSize = (int)sizeof(void*);
+    strncpy(header.luaVersion, BYTECODE_LUA_VERSION, sizeof(header.luaVersion) - 1);
+    stream.write((const char*)&header, sizeof(header));
+
+    for(auto& pair : mEntries) {
+      const Entry& entry = pair.second;
+      BytecodeEntryHeader entryHeader;
+      entryHeader.moduleLength = (uint32_t)pair.first.size();
+      entryHeader.pathLength = (uint32_t)entry.path.size();
+      entryHeader.mtime = entry.mtime;
+      entryHeader.hash = entry.hash;
+      entryHeader.size = entry.size;
+      stream.write((const char*)&entryHeader, sizeof(entryHeader));
+      stream.write(pair.first.c_str(), pair.first.size());
+      stream.write(entry.path.c_str(), entry.path.size());
+      stream.write(mData.c_str() + entry.offset, entry.size);
+    }
+
+    return stream.good();
+  }
+
+  bool BytecodeBundle::load(const std::string& filepath, const std::string& root)
+  {
+    std::string data;
+    if(!readFile(filepath, data)) {
+      LOG(ERROR) << "Failed to open bytecode bundle " << filepath;
+      return false;
+    }
+
+    BytecodeBundleHeader header;
+    if(data.size() < sizeof(header)) {
+      LOG(ERROR) << "Failed to read bytecode bundle header " << filepath;
+      return false;
+    }
+    memcpy(&header, data.c_str(), sizeof(header));
+
+    if(header.magic != BYTECODE_MAGIC) {
+      LOG(ERROR) << "Failed to load bytecode bundle " << filepath << ": unknown file format";
+      return false;
+    }
+
+    if(header.version != BYTECODE_VERSION) {
+      LOG(ERROR) << "Failed to load bytecode bundle " << filepath << ": unsupported version " << header.version;
+      return false;
+    }
+
+    header.luaVersion[sizeof(header.luaVersion) - 1] = '\0';
+    if(header.pointerSize != (int)sizeof(void*) || strcmp(header.luaVersion, BYTECODE_LUA_VERSION) != 0) {
+      LOG(WARNING) << "Bytecode bundle " << filepath << " was compiled by " << header.luaVersion << ", ignoring it";
+      return false;
+    }
+
+    if(header.numEntries < 0) {
+      LOG(ERROR) << "Failed to load bytecode bundle " << filepath << ": bad entries count " << header.numEntries;
+      return false;
+    }
+
+    Entries entries;
+    size_t offset = sizeof(header);
+    for(int i = 0; i < header.numEntries; ++i) {
+      BytecodeEntryHeader entryHeader;
+      if(data.size() - offset < sizeof(entryHeader)) {
+        LOG(ERROR) << "Failed to load bytecode bundle " << filepath << ": unexpected end of file";
+        return false;
+      }
+      memcpy(&entryHeader, data.c_str() + offset, sizeof(entryHeader));
+      offset += sizeof(entryHeader);
+
+      // sizes are checked one by one, so corrupted values can't overflow the sum
+      size_t remaining = data.size() - offset;
+      if(entryHeader.size > remaining || (uint64_t)entryHeader.moduleLength + entryHeader.pathLength > remaining - entryHeader.size) {
+        LOG(ERROR) << "Failed to load bytecode bundle " << filepath << ": unexpected end of file";
+        return false;
+      }
+
+      std::string module(data.c_str() + offset, entryHeader.moduleLength);
+      offset += entryHeader.moduleLength;
+
+      Entry& entry = entries[module];
+      entry.path.assign(data.c_str() + offset, entryHeader.pathLength);
+      offset += entryHeader.pathLength;
+      entry.mtime = entryHeader.mtime;
+      entry.hash = entryHeader.hash;
+      entry.offset = offset;
+      entry.size = (size_t)entryHeader.size;
+      offset += entry.size;
+    }
+
+    // bytecode is referenced by offsets in the file data
+    mData.swap(data);
+    mEntries.swap(entries);
+    mRoot = root;
+    LOG(INFO) << "Loaded bytecode bundle " << filepath << ", modules: " << mEntries.size();
+    return true;
+  }
+
+  bool BytecodeBundle::install(lua_State* L)
+  {
+    lua_getglobal(L, "package");
+    if(!lua_istable(L, -1)) {
+      lua_pop(L, 1);
+      return false;
+    }
+
+    // lua 5.1 and LuaJIT call them loaders
+    lua_getfield(L, -1, "loaders");
+    if(!lua_istable(L, -1)) {
+      lua_pop(L, 1);
+      lua_getfield(L, -1, "searchers");
+    }
+
+    if(!lua_istable(L, -1)) {
+      lua_pop(L, 2);
+      return false;
+    }
+
+    // goes right after the preload searcher, so bytecode has priority over the sources
+    int count = (int)lua_rawlen(L, -1);
+    for(int i = count; i >= 2; --i) {
+      lua_rawgeti(L, -1, i);
+      lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, &BytecodeBundle::searcher, 1);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 2);
+    return true;
+  }
+
+  bool BytecodeBundle::loadModule(lua_State* L, const std::string& module)
+  {
+    Entries::iterator iter = mEntries.find(module);
+    if(iter == mEntries.end() || !isUpToDate(iter->second)) {
+      return false;
+    }
+
+    Entry& entry = iter->second;
+    std::string chunkName = "@" + Poco::Path(mRoot).append(entry.path).toString();
+    if(luaL_loadbuffer(L, mData.c_str() + entry.offset, entry.size, chunkName.c_str()) != 0) {
+      LOG(ERROR) << "Failed to load module " << module << " bytecode: " << lua_tostring(L, -1);
+      lua_pop(L, 1);
+      return false;
+    }
+    return true;
+  }
+
+  bool BytecodeBundle::isUpToDate(Entry& entry)
+  {
+    std::string fullPath = Poco::Path(mRoot).append(entry.path).toString();
+    signed long long mtime = getModificationTime(fullPath);
+    // scripts can be shipped without sources
+    if(mtime == -1 || mtime == entry.mtime) {
+      return true;
+    }
+
+    std::string source;
+    if(!readFile(fullPath, source) || hash(source.c_str(), source.size()) != entry.hash) {
+      return false;
+    }
+
+    // touched, but not changed
+    entry.mtime = mtime;
+    return true;
+  }
+
+  int BytecodeBundle::searcher(lua_State* L)
+  {
+    BytecodeBundle* bundle = static_cast<BytecodeBundle*>(lua_touserdata(L, lua_upvalueindex(1)));
+    const char* module = luaL_checkstring(L, 1);
+    if(bundle->loadModule(L, module)) {
+      return 1;
+    }
+
+    lua_pushfstring(L, "\n\tno module '%s' in bytecode bundle", module);
+    return 1;
+  }
+
+  std::string BytecodeBundle::getModuleName(const std::string& path)
+  {
+    std::string res = path;
+    if(res.size() > 4 && res.compare(res.size() - 4, 4, ".lua") == 0) {
+      res.resize(res.size() - 4);
+    }
+
+    for(auto& c : res) {
+      if(c == '/' || c == '\\') {
+        c = '.';
+      }
+    }
+
+    // package/init.lua is required as package
+    static const std::string init = ".init";
+    if(res.size() > init.size() && res.compare(res.size() - init.size(), init.size(), init) == 0) {
+      res.resize(res.size() - init.size());
+    }
+    return res;
+  }
+
+  uint64_t BytecodeBundle::hash(const char* data, size_t size)
+  {
+    uint64_t res = 14695981039346656037ULL;
+    for(size_t i = 0; i < size; ++i) {
+      res ^= (unsigned char)data[i];
+      res *= 1099511628211ULL;
+    }
+    return res;
+  }
+
+  bool BytecodeBundle::readFile(const std::string& path, std::string& dest)
+  {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if(!stream) {
+      return false;
+    }
+
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    dest = buffer.str();
+    return true;
+  }
+
+  signed long long BytecodeBundle::getModificationTime(const std::string& path)
+  {
+    Poco::File f(path);
+    if(!f.exists()) {
+      return -1;
+    }
+
+    return (signed long long)f.getLastModified().epochMicroseconds();
+  }
+}
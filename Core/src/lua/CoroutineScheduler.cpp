@@ -0,0 +1,225 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "lua/CoroutineScheduler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "lua.hpp"
+#include "sol.hpp"
+
+namespace Gsage {
+
+  CoroutineScheduler::CoroutineScheduler(double resolution)
+    : mState(0)
+    , mNextID(0)
+    , mResolution(resolution)
+    , mTime(0)
+  {
+  }
+
+  CoroutineScheduler::~CoroutineScheduler()
+  {
+  }
+
+  void CoroutineScheduler::setLuaState(lua_State* L)
+  {
+    if(mState && mState != L) {
+      clear();
+    }
+    mState = L;
+  }
+
+  bool CoroutineScheduler::waitSeconds(sol::this_state s, double seconds)
+  {
+    lua_State* co = getThread(s);
+    if(!co) {
+      return false;
+    }
+
+    WaitID id = mNextID++;
+    suspend(co, id);
+
+    double expire = std::ceil((mTime + std::max(seconds, 0.0)) / mResolution - 1e-6);
+    mWheel.schedule((TimerWheel::Tick)expire, id);
+    return true;
+  }
+
+  bool CoroutineScheduler::waitSignal(sol::this_state s, const std::string& name)
+  {
+    lua_State* co = getThread(s);
+    if(!co) {
+      return false;
+    }
+
+    WaitID id = mNextID++;
+    suspend(co, id);
+    mSignals[name].push_back(id);
+    return true;
+  }
+
+  int CoroutineScheduler::signal(sol::this_state s, const std::string& name)
+  {
+    Signals::iterator iter = mSignals.find(name);
+    if(iter == mSignals.end()) {
+      return 0;
+    }
+
+    WaitList waiting;
+    waiting.swap(iter->second);
+    mSignals.erase(iter);
+
+    int count = 0;
+    for(auto id : waiting) {
+      if(resume(id, s)) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  bool CoroutineScheduler::isSuspended(const sol::object& co) const
+  {
+    if(co.get_type() != sol::type::thread) {
+      return false;
+    }
+
+    return isSuspended(co.as<sol::thread>().thread_state());
+  }
+
+  bool CoroutineScheduler::isSuspended(lua_State* co) const
+  {
+    return mWaiters.count(co) != 0;
+  }
+
+  int CoroutineScheduler::update(double time)
+  {
+    mTime += time;
+    if(mWaits.empty()) {
+      return 0;
+    }
+
+    // resumed coroutines may update the scheduler, so work on the local list
+    TimerWheel::Payloads expired;
+    expired.swap(mExpired);
+    mWheel.advance((TimerWheel::Tick)std::floor(mTime / mResolution + 1e-6), expired);
+
+    int count = 0;
+    for(auto id : expired) {
+      if(resume(id, mState)) {
+        count++;
+      }
+    }
+
+    expired.clear();
+    mExpired.swap(expired);
+    return count;
+  }
+
+  void CoroutineScheduler::clear()
+  {
+    if(mState) {
+      for(auto& pair : mWaiters) {
+        luaL_unref(mState, LUA_REGISTRYINDEX, pair.second.ref);
+      }
+    }
+
+    mWaiters.clear();
+    mWaits.clear();
+    mSignals.clear();
+    mWheel.clear();
+    mTime = 0;
+  }
+
+  lua_State* CoroutineScheduler::getThread(lua_State* L) const
+  {
+    // lua_pushthread returns 1 for the main thread, which can't yield
+    bool main = lua_pushthread(L) == 1;
+    lua_pop(L, 1);
+    if(main) {
+      LOG(ERROR) << "The main thread cannot wait";
+      return 0;
+    }
+    return L;
+  }
+
+  void CoroutineScheduler::suspend(lua_State* co, WaitID id)
+  {
+    Waiters::iterator iter = mWaiters.find(co);
+    if(iter != mWaiters.end()) {
+      // coroutine was resumed outside of the scheduler, forget the previous wait
+      mWaits.erase(iter->second.id);
+      iter->second.id = id;
+    } else {
+      lua_pushthread(co);
+      Waiter waiter = {luaL_ref(co, LUA_REGISTRYINDEX), id};
+      mWaiters[co] = waiter;
+    }
+    mWaits[id] = co;
+  }
+
+  bool CoroutineScheduler::resume(WaitID id, lua_State* from)
+  {
+    Waits::iterator wait = mWaits.find(id);
+    if(wait == mWaits.end()) {
+      return false;
+    }
+
+    lua_State* co = wait->second;
+    mWaits.erase(wait);
+
+    Waiters::iterator iter = mWaiters.find(co);
+    int ref = iter->second.ref;
+    mWaiters.erase(iter);
+
+    // keep coroutine on the main stack, so it is not collected while running
+    lua_rawgeti(mState, LUA_REGISTRYINDEX, ref);
+    luaL_unref(mState, LUA_REGISTRYINDEX, ref);
+
+    bool resumed = false;
+    if(lua_status(co) == LUA_YIELD) {
+      int status = lua_resume(co, from, 0);
+      if(status == LUA_YIELD) {
+        // drop yielded values
+        lua_settop(co, 0);
+        resumed = true;
+      } else if(status == 0) {
+        resumed = true;
+      } else {
+        const char* err = lua_tostring(co, -1);
+        luaL_traceback(mState, co, err ? err : "unknown error", 0);
+        LOG(ERROR) << "Failed to resume coroutine: " << lua_tostring(mState, -1);
+        lua_pop(mState, 1);
+      }
+    }
+
+    lua_pop(mState, 1);
+    return resumed;
+  }
+}
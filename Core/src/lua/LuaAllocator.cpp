@@ -0,0 +1,172 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "lua/LuaAllocator.h"
+#include "Logger.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "lua.hpp"
+
+namespace Gsage {
+
+  const size_t LuaAllocator::GRANULARITY;
+  const size_t LuaAllocator::MAX_POOLED_SIZE;
+  const size_t LuaAllocator::CHUNK_SIZE;
+
+  LuaAllocator::LuaAllocator()
+    : mAllocated(0)
+    , mReserved(0)
+  {
+    std::memset(mFreeLists, 0, sizeof(mFreeLists));
+  }
+
+  LuaAllocator::~LuaAllocator()
+  {
+    for(auto chunk : mChunks) {
+      std::free(chunk);
+    }
+    mChunks.clear();
+  }
+
+  void* LuaAllocator::allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+  {
+    return static_cast<LuaAllocator*>(ud)->reallocate(ptr, osize, nsize);
+  }
+
+  void* LuaAllocator::reallocate(void* ptr, size_t osize, size_t nsize)
+  {
+    // lua 5.2+ passes object type as osize for new blocks
+    if(ptr == 0) {
+      osize = 0;
+    }
+
+    if(nsize == 0) {
+      if(ptr) {
+        freeBlock(ptr, osize);
+      }
+      return 0;
+    }
+
+    if(ptr == 0) {
+      return allocateBlock(nsize);
+    }
+
+    bool pooled = osize <= MAX_POOLED_SIZE;
+    if(pooled && nsize <= MAX_POOLED_SIZE && sizeClass(osize) == sizeClass(nsize)) {
+      mAllocated += nsize - osize;
+      return ptr;
+    }
+
+    if(!pooled && nsize > MAX_POOLED_SIZE) {
+      void* res = std::realloc(ptr, nsize);
+      if(res) {
+        mAllocated += nsize - osize;
+      }
+      return res;
+    }
+
+    void* res = allocateBlock(nsize);
+    if(!res) {
+      return 0;
+    }
+
+    std::memcpy(res, ptr, osize < nsize ? osize : nsize);
+    freeBlock(ptr, osize);
+    return res;
+  }
+
+  void* LuaAllocator::allocateBlock(size_t size)
+  {
+    void* res = 0;
+    if(size > MAX_POOLED_SIZE) {
+      res = std::malloc(size);
+    } else {
+      size_t c = sizeClass(size);
+      if(mFreeLists[c] == 0 && !grow(c)) {
+        return 0;
+      }
+
+      FreeBlock* block = mFreeLists[c];
+      mFreeLists[c] = block->next;
+      res = block;
+    }
+
+    if(res) {
+      mAllocated += size;
+    }
+    return res;
+  }
+
+  void LuaAllocator::freeBlock(void* ptr, size_t size)
+  {
+    mAllocated -= size;
+    if(size > MAX_POOLED_SIZE) {
+      std::free(ptr);
+      return;
+    }
+
+    size_t c = sizeClass(size);
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = mFreeLists[c];
+    mFreeLists[c] = block;
+  }
+
+  bool LuaAllocator::grow(size_t c)
+  {
+    char* chunk = static_cast<char*>(std::malloc(CHUNK_SIZE));
+    if(!chunk) {
+      return false;
+    }
+
+    mChunks.push_back(chunk);
+    mReserved += CHUNK_SIZE;
+
+    size_t blockSize = (c + 1) * GRANULARITY;
+    size_t count = CHUNK_SIZE / blockSize;
+    // link blocks in the address order
+    for(size_t i = count; i > 0; --i) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize);
+      block->next = mFreeLists[c];
+      mFreeLists[c] = block;
+    }
+    return true;
+  }
+
+  lua_State* LuaAllocator::newState()
+  {
+    // allocator must outlive all states, which use it
+    static LuaAllocator* allocator = new LuaAllocator();
+
+    lua_State* L = lua_newstate(&LuaAllocator::allocate, allocator);
+    if(!L) {
+      LOG(INFO) << "Custom lua allocators are not supported, falling back to the default one";
+      L = luaL_newstate();
+    }
+    return L;
+  }
+}
@@ -29,137 +29,370 @@ THE SOFTWARE.
 
 namespace Gsage  {
 
+  // Walks the callbacks array of the binding. Removed callbacks are left as false
+  // until the dispatch is over, callback count is captured once, so listeners added
+  // during the dispatch are called starting from the next event.
+  static const char* TRAMPOLINE = R"(
+    local warn = ...
+    local pcall = pcall
+    local select = select
+    return function(list, eventType, event, ...)
+      local kinds = list.kinds
+      for i = 1, list.n do
+        local callback = list[i]
+        if callback then
+          local ok, res
+          if kinds then
+            ok, res = pcall(callback, (select(kinds[i], event, ...)))
+          else
+            ok, res = pcall(callback, event)
+          end
+
+          if not ok then
+            warn(eventType, res)
+          elseif res == false then
+            return false
+          end
+        end
+      end
+      return true
+    end
+  )";
+
   LuaEventProxy::LuaEventProxy()
+    : mState(0)
+    , mTrampoline(LUA_NOREF)
+    , mThread(LUA_NOREF)
+    , mGeneration(0)
   {
 
   }
 
   LuaEventProxy::~LuaEventProxy()
   {
+    // the state is closed by the owner, so the references are released in reset
+    reset(false);
+  }
+
+  void LuaEventProxy::reset(bool release)
+  {
+    for(auto& pair : mCallbackBindings) {
+      for(auto& binding : pair.second) {
+        EventSubscriber<LuaEventProxy>::removeEventListener(pair.first, binding.type, &LuaEventProxy::handleEvent);
+        if(release && mState) {
+          luaL_unref(mState, LUA_REGISTRYINDEX, binding.list);
+        }
+      }
+    }
     mCallbackBindings.clear();
+
+    if(release && mState) {
+      luaL_unref(mState, LUA_REGISTRYINDEX, mTrampoline);
+      luaL_unref(mState, LUA_REGISTRYINDEX, mThread);
+    }
+
+    mState = 0;
+    mTrampoline = LUA_NOREF;
+    mThread = LUA_NOREF;
+  }
+
+  bool LuaEventProxy::initialize(lua_State* L)
+  {
+    if(mState) {
+      return true;
+    }
+
+    // dedicated thread: callbacks can be bound from the coroutine, which may be suspended on dispatch
+    lua_State* thread = lua_newthread(L);
+    int threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    if(luaL_loadstring(thread, TRAMPOLINE) != 0) {
+      LOG(ERROR) << "Failed to load lua event trampoline: " << lua_tostring(thread, -1);
+      lua_pop(thread, 1);
+      luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+      return false;
+    }
+
+    lua_pushcfunction(thread, &LuaEventProxy::warn);
+    if(lua_pcall(thread, 1, 1, 0) != 0) {
+      LOG(ERROR) << "Failed to create lua event trampoline: " << lua_tostring(thread, -1);
+      lua_pop(thread, 1);
+      luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+      return false;
+    }
+
+    mTrampoline = luaL_ref(thread, LUA_REGISTRYINDEX);
+    mThread = threadRef;
+    mState = thread;
+    return true;
+  }
+
+  int LuaEventProxy::warn(lua_State* L)
+  {
+    const char* eventType = lua_tostring(L, 1);
+    const char* error = lua_tostring(L, 2);
+    LOG(WARNING) << "Failed to call " << (eventType ? eventType : "unknown") << " lua listener: " << (error ? error : "unknown error");
+    return 0;
   }
 
   bool LuaEventProxy::addEventListener(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback)
+  {
+    return addCallback(dispatcher, eventType, callback, &LuaEventProxy::pushEvent<Event>);
+  }
+
+  bool LuaEventProxy::addCallback(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback, EventPusher pusher)
   {
     if(callback.get_type() != sol::type::function) {
       LOG(ERROR) << "Failed to bind event " << eventType << " handler for dispatcher " << dispatcher << ", bad object passed " << (int)callback.get_type();
       return false;
     }
 
-    Callbacks* cb = getCallbacks(dispatcher, eventType);
-    Callbacks& callbacks = cb != 0 ? *cb : subscribe(dispatcher, eventType);
-    callbacks.push_back(GenericCallbackPtr(new GenericCallback(callback.as<sol::function>())));
+    if(!initialize(callback.lua_state())) {
+      return false;
+    }
+
+    lua_State* L = mState;
+    Binding* b = getBinding(dispatcher, eventType);
+    Binding& binding = b != 0 ? *b : subscribe(dispatcher, eventType);
+
+    int kind = 1;
+    for(; kind <= (int)binding.pushers.size(); ++kind) {
+      if(binding.pushers[kind - 1] == pusher) {
+        break;
+      }
+    }
+
+    if(kind > (int)binding.pushers.size()) {
+      binding.pushers.push_back(pusher);
+    }
+
+    int index = ++binding.length;
+    binding.size++;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, binding.list);
+    callback.push(L);
+    lua_rawseti(L, -2, index);
+    lua_pushinteger(L, index);
+    lua_setfield(L, -2, "n");
+
+    if(binding.pushers.size() > 1) {
+      lua_getfield(L, -1, "kinds");
+      if(lua_isnil(L, -1)) {
+        // first callback with the different event type: all previous callbacks use the first pusher
+        lua_pop(L, 1);
+        lua_createtable(L, index, 0);
+        for(int i = 1; i < index; ++i) {
+          lua_pushinteger(L, 1);
+          lua_rawseti(L, -2, i);
+        }
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, "kinds");
+      }
+      lua_pushinteger(L, kind);
+      lua_rawseti(L, -2, index);
+      lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1);
     return true;
   }
 
   bool LuaEventProxy::removeEventListener(EventDispatcher* dispatcher, Event::ConstType eventType, const sol::object& callback)
   {
-    if(callback.get_type() != sol::type::function)
+    if(callback.get_type() != sol::type::function || !mState)
       return false;
 
-    auto callbacks = getCallbacks(dispatcher, eventType);
-    if(!callbacks)
+    Binding* binding = getBinding(dispatcher, eventType);
+    if(!binding)
       return false;
 
-    sol::function listener = callback.as<sol::function>();
-    Callbacks::iterator iter = std::find_if(callbacks->begin(), callbacks->end(), [listener](GenericCallbackPtr e){
-      return e->func() == listener;
-    });
-    if(iter == callbacks->end())
+    lua_State* L = mState;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, binding->list);
+    callback.push(L);
+
+    int index = 0;
+    for(int i = 1; i <= binding->length; ++i) {
+      lua_rawgeti(L, -2, i);
+      bool found = lua_rawequal(L, -1, -2) != 0;
+      lua_pop(L, 1);
+      if(found) {
+        index = i;
+        break;
+      }
+    }
+    lua_pop(L, 1);
+
+    if(index == 0) {
+      lua_pop(L, 1);
       return false;
+    }
+
+    // dispatch in progress, keep indices stable and compact when it's done
+    lua_pushboolean(L, 0);
+    lua_rawseti(L, -2, index);
+    lua_pop(L, 1);
+    binding->size--;
 
-    int previousSize = callbacks->size();
-    callbacks->erase(iter);
-    if(callbacks->size() == 0)
+    if(binding->size == 0)
     {
-      EventSubscriber<LuaEventProxy>::removeEventListener(dispatcher, eventType, &LuaEventProxy::handleEvent);
-      mCallbackBindings.erase(CallbackBinding(dispatcher, eventType));
+      unsubscribe(dispatcher, eventType);
       LOG(TRACE) << "Removed event listener for event " << eventType << " as there is no more lua callbacks";
     } else {
+      if(binding->depth == 0) {
+        compact(*binding);
+      }
       LOG(TRACE) << "Removed event callback " << eventType;
-      assert(getCallbacks(dispatcher, eventType)->size() != previousSize);
     }
 
     return true;
   }
 
-  bool LuaEventProxy::handleEvent(EventDispatcher* sender, const Event& event)
+  void LuaEventProxy::compact(Binding& binding)
   {
-    Callbacks* callbacks = getCallbacks(sender, event.getType());
-    if(callbacks != 0)
-    {
-      for(auto callback : (*callbacks))
-      {
-        if(!callback->valid())
-        {
-          removeEventListener(sender, event.getType(), callback->func());
-          LOG(ERROR) << "Failed to call " << event.getType() << " listener invalid, removed from subscribers";
-          continue;
-        }
-        std::string error;
-        sol::function_result res;
-        try {
-          res = (*callback)(event);
-        } catch (...) {
-          LOG(WARNING) << "Failed to call " << event.getType() << " lua listener: unknown error";
-          continue;
-        }
+    lua_State* L = mState;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, binding.list);
+    lua_getfield(L, -1, "kinds");
+    bool hasKinds = !lua_isnil(L, -1);
 
-        if(!res.valid()) {
-          sol::error err = res;
-          error = err.what();
-        }
+    int length = 0;
+    for(int i = 1; i <= binding.length; ++i) {
+      lua_rawgeti(L, -2, i);
+      if(!lua_toboolean(L, -1)) {
+        lua_pop(L, 1);
+        continue;
+      }
 
-        if(res.get_type() == sol::type::boolean) {
-          bool cont = res;
-          if(!cont) {
-            return false;
-          }
+      length++;
+      if(length != i) {
+        lua_rawseti(L, -3, length);
+        if(hasKinds) {
+          lua_rawgeti(L, -1, i);
+          lua_rawseti(L, -2, length);
         }
+      } else {
+        lua_pop(L, 1);
+      }
+    }
 
-        if(!error.empty())
-        {
-          LOG(WARNING) << "Failed to call " << event.getType() << " lua listener: " << error;
-        }
+    for(int i = length + 1; i <= binding.length; ++i) {
+      lua_pushnil(L);
+      lua_rawseti(L, -3, i);
+      if(hasKinds) {
+        lua_pushnil(L);
+        lua_rawseti(L, -2, i);
       }
     }
 
-    return true;
+    lua_pop(L, 1);
+    binding.length = length;
+    lua_pushinteger(L, length);
+    lua_setfield(L, -2, "n");
+    lua_pop(L, 1);
+  }
+
+  bool LuaEventProxy::handleEvent(EventDispatcher* sender, const Event& event)
+  {
+    Binding* binding = getBinding(sender, event.getType());
+    if(binding == 0 || !mState)
+      return true;
+
+    lua_State* L = mState;
+    Event::ConstType eventType = binding->type;
+    unsigned long generation = binding->generation;
+    int top = lua_gettop(L);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, mTrampoline);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, binding->list);
+    lua_pushstring(L, eventType);
+    for(auto pusher : binding->pushers) {
+      pusher(L, event);
+    }
+
+    int nargs = 2 + (int)binding->pushers.size();
+    binding->depth++;
+    // binding pointer can be invalidated by the callbacks, which add or remove listeners
+    int status = lua_pcall(L, nargs, 1, 0);
+
+    bool res = true;
+    if(status != 0) {
+      LOG(ERROR) << "Failed to dispatch " << eventType << " to lua listeners: " << lua_tostring(L, -1);
+    } else {
+      res = lua_toboolean(L, -1) != 0;
+    }
+    lua_settop(L, top);
+
+    binding = getBinding(sender, eventType);
+    if(binding && binding->generation == generation && --binding->depth == 0 && binding->length != binding->size) {
+      compact(*binding);
+    }
+
+    return res;
   }
 
   bool LuaEventProxy::onForceUnsubscribe(EventDispatcher* sender, const Event& event)
   {
     EventSubscriber<LuaEventProxy>::onForceUnsubscribe(sender, event);
-    CallbackBindings::iterator iter = mCallbackBindings.begin();
-    while(iter != mCallbackBindings.end())
+    CallbackBindings::iterator iter = mCallbackBindings.find(sender);
+    if(iter == mCallbackBindings.end())
+      return true;
+
+    for(auto& binding : iter->second)
     {
-      if((*iter).first.first == sender)
-      {
-        LOG(TRACE) << "Unbinding lua callbacks, event type: " << (*iter).first.second;
-        CallbackBindings::iterator tmp = iter++;
-        mCallbackBindings.erase(tmp);
-      }
-      else
-      {
-        iter++;
-      }
+      LOG(TRACE) << "Unbinding lua callbacks, event type: " << binding.type;
+      luaL_unref(mState, LUA_REGISTRYINDEX, binding.list);
     }
+    mCallbackBindings.erase(iter);
     return true;
   }
 
-  LuaEventProxy::Callbacks* LuaEventProxy::getCallbacks(EventDispatcher* dispatcher, Event::ConstType eventType)
+  LuaEventProxy::Binding* LuaEventProxy::getBinding(EventDispatcher* dispatcher, Event::ConstType eventType)
   {
-    CallbackBinding binding(dispatcher, eventType);
-    if(!contains(mCallbackBindings, binding))
+    CallbackBindings::iterator iter = mCallbackBindings.find(dispatcher);
+    if(iter == mCallbackBindings.end())
       return 0;
 
-    return &mCallbackBindings[binding];
+    for(auto& binding : iter->second) {
+      if(binding.type == eventType || std::strcmp(binding.type, eventType) == 0) {
+        return &binding;
+      }
+    }
+
+    return 0;
   }
 
-  LuaEventProxy::Callbacks& LuaEventProxy::subscribe(EventDispatcher* dispatcher, Event::ConstType eventType)
+  LuaEventProxy::Binding& LuaEventProxy::subscribe(EventDispatcher* dispatcher, Event::ConstType eventType)
   {
-    Callbacks& res = mCallbackBindings[CallbackBinding(dispatcher, eventType)];
+    lua_State* L = mState;
+    lua_createtable(L, 0, 1);
+    lua_pushinteger(L, 0);
+    lua_setfield(L, -2, "n");
+
+    Bindings& bindings = mCallbackBindings[dispatcher];
+    bindings.emplace_back(eventType, luaL_ref(L, LUA_REGISTRYINDEX));
+    Binding& res = bindings.back();
+    res.generation = ++mGeneration;
     EventSubscriber<LuaEventProxy>::addEventListener(dispatcher, eventType, &LuaEventProxy::handleEvent);
     return res;
   }
+
+  void LuaEventProxy::unsubscribe(EventDispatcher* dispatcher, Event::ConstType eventType)
+  {
+    CallbackBindings::iterator iter = mCallbackBindings.find(dispatcher);
+    if(iter == mCallbackBindings.end())
+      return;
+
+    Bindings& bindings = iter->second;
+    for(Bindings::iterator b = bindings.begin(); b != bindings.end(); ++b) {
+      if(b->type == eventType || std::strcmp(b->type, eventType) == 0) {
+        EventSubscriber<LuaEventProxy>::removeEventListener(dispatcher, b->type, &LuaEventProxy::handleEvent);
+        luaL_unref(mState, LUA_REGISTRYINDEX, b->list);
+        bindings.erase(b);
+        break;
+      }
+    }
+
+    if(bindings.empty()) {
+      mCallbackBindings.erase(iter);
+    }
+  }
 }
@@ -0,0 +1,154 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "lua/LuaGarbageCollector.h"
+
+#include <chrono>
+
+#include "lua.hpp"
+
+namespace Gsage {
+
+  // lua default pause, restored when collector is disabled
+  static const int DEFAULT_PAUSE = 200;
+
+  LuaGarbageCollector::LuaGarbageCollector()
+    : mState(0)
+    , mEnabled(true)
+    , mBudget(1000.0)
+    , mIdleBudget(0.5)
+    , mPause(400)
+    , mGrowth(1.2)
+    , mHeapAfterCycle(0)
+    , mCycleDone(false)
+    , mStepTime(0)
+    , mMaxPause(0)
+    , mCycles(0)
+  {
+  }
+
+  LuaGarbageCollector::~LuaGarbageCollector()
+  {
+  }
+
+  void LuaGarbageCollector::setLuaState(lua_State* L)
+  {
+    mState = L;
+    mHeapAfterCycle = 0;
+    mCycleDone = false;
+    resetStats();
+    applyParameters();
+  }
+
+  void LuaGarbageCollector::configure(const DataProxy& config)
+  {
+    mEnabled = config.get("enabled", mEnabled);
+    mBudget = config.get("stepBudget", mBudget);
+    mIdleBudget = config.get("idleBudget", mIdleBudget);
+    mPause = config.get("pause", mPause);
+    mGrowth = config.get("growth", mGrowth);
+    applyParameters();
+  }
+
+  void LuaGarbageCollector::setEnabled(bool value)
+  {
+    mEnabled = value;
+    applyParameters();
+  }
+
+  void LuaGarbageCollector::applyParameters()
+  {
+    if(!mState) {
+      return;
+    }
+
+    lua_gc(mState, LUA_GCSETPAUSE, mEnabled ? mPause : DEFAULT_PAUSE);
+  }
+
+  void LuaGarbageCollector::step()
+  {
+    if(!mState || !mEnabled) {
+      mStepTime = 0;
+      return;
+    }
+
+    // nothing to do until the heap grows enough since the last complete cycle
+    if(mCycleDone && getHeapSize() < mHeapAfterCycle * mGrowth) {
+      mStepTime = 0;
+      return;
+    }
+
+    mStepTime = run(mBudget / 1000000.0) * 1000000.0;
+    if(mStepTime > mMaxPause) {
+      mMaxPause = mStepTime;
+    }
+  }
+
+  double LuaGarbageCollector::idle(double seconds)
+  {
+    if(!mState || !mEnabled || seconds <= 0 || (mCycleDone && getHeapSize() < mHeapAfterCycle * mGrowth)) {
+      return 0;
+    }
+
+    return run(seconds * mIdleBudget);
+  }
+
+  double LuaGarbageCollector::run(double budget)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    mCycleDone = false;
+    while(elapsed.count() < budget) {
+      // smallest possible incremental step
+      if(lua_gc(mState, LUA_GCSTEP, 0) == 1) {
+        mCycles++;
+        mCycleDone = true;
+        mHeapAfterCycle = getHeapSize();
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+        break;
+      }
+      elapsed = std::chrono::high_resolution_clock::now() - start;
+    }
+
+    return elapsed.count();
+  }
+
+  double LuaGarbageCollector::getHeapSize() const
+  {
+    if(!mState) {
+      return 0;
+    }
+
+    return lua_gc(mState, LUA_GCCOUNT, 0) + lua_gc(mState, LUA_GCCOUNTB, 0) / 1024.0;
+  }
+
+  void LuaGarbageCollector::resetStats()
+  {
+    mStepTime = 0;
+    mMaxPause = 0;
+    mCycles = 0;
+  }
+}
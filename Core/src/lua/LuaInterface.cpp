@@ -48,6 +48,7 @@ THE SOFTWARE.
 
 #include "lua/LuaEventProxy.h"
 #include "lua/LuaEventConnection.h"
+#include "lua/LuaAllocator.h"
 
 #if GSAGE_PLATFORM == GSAGE_LINUX || GSAGE_PLATFORM == GSAGE_APPLE
 #include <limits.h>
@@ -158,6 +159,7 @@ namespace Gsage {
 
   void LuaInterface::closeLuaState()
   {
+    mGarbageCollector.setLuaState(0);
     if(mStateCreated) {
       lua_close(mState);
     }
@@ -172,12 +174,16 @@ namespace Gsage {
     if(mStateView)
       delete mStateView;
 
+    // lua callbacks and the trampoline belong to the previous state.
+    // external state could be closed already, so its references are not released
+    mEventProxy->reset(mStateCreated);
+
     if(mState) {
       closeLuaState();
     }
 
     if(L == 0) {
-      mState = lua_open();
+      mState = LuaAllocator::newState();
       mStateCreated = true;
     } else {
       mState = L;
@@ -185,6 +191,7 @@ namespace Gsage {
     }
 
     luaL_openlibs(mState);
+    mGarbageCollector.setLuaState(mState);
     mStateView = new sol::state_view(mState);
     sol::state_view lua = *mStateView;
 
@@ -207,6 +214,17 @@ namespace Gsage {
         "stats", sol::property(&ResourceMonitor::getStats)
     );
 
+    lua.new_usertype<LuaGarbageCollector>("LuaGarbageCollector",
+        "new", sol::no_constructor,
+        "heapSize", sol::property(&LuaGarbageCollector::getHeapSize),
+        "stepTime", sol::property(&LuaGarbageCollector::getStepTime),
+        "maxPause", sol::property(&LuaGarbageCollector::getMaxPause),
+        "cycles", sol::property(&LuaGarbageCollector::getCycles),
+        "budget", sol::property(&LuaGarbageCollector::getBudget, &LuaGarbageCollector::setBudget),
+        "enabled", sol::property(&LuaGarbageCollector::getEnabled, &LuaGarbageCollector::setEnabled),
+        "resetStats", &LuaGarbageCollector::resetStats
+    );
+
     lua.new_usertype<ResourceMonitor::Stats>("ResourceMonitorStats",
         "physicalMem", &ResourceMonitor::Stats::physicalMem,
         "virtualMem", &ResourceMonitor::Stats::virtualMem,
@@ -236,6 +254,7 @@ namespace Gsage {
         "createSystem", &GsageFacade::createSystem,
         "getWindowManager", &GsageFacade::getWindowManager,
         "addUpdateListener", &GsageFacade::addUpdateListener,
+        "gc", sol::property([this](GsageFacade*) { return &mGarbageCollector; }),
         "BEFORE_RESET", sol::var(GsageFacade::BEFORE_RESET),
         "RESET", sol::var(GsageFacade::RESET),
         "LOAD", sol::var(GsageFacade::LOAD)
@@ -310,9 +329,16 @@ namespace Gsage {
     );
 
     lua.new_usertype<Reflection>("Reflection",
-        "props", sol::property(&Reflection::getProps, &Reflection::setProps)
+        "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
+        "getProp", &Reflection::getProp,
+        "setProp", &Reflection::setProp
     );
 
+    // lib.gmath defines FFI structs with the same layout
+    static_assert(sizeof(Vector3) == sizeof(double) * 3, "Vector3 layout is not compatible with GsageVector3");
+    static_assert(sizeof(Quaternion) == sizeof(double) * 4, "Quaternion layout is not compatible with GsageQuaternion");
+    static_assert(sizeof(Radian) == sizeof(double), "Radian layout is not compatible with GsageRadian");
+
     auto vector3 = sol::usertype<Vector3>(
         sol::constructors<sol::types<double, double, double>>(),
         "x", &Vector3::X,
@@ -477,9 +503,69 @@ namespace Gsage {
         "restart", &EngineSystem::restart
     );
 
+    lua.new_usertype<CoroutineScheduler>("CoroutineScheduler",
+        "new", sol::no_constructor,
+        "waitSeconds", &CoroutineScheduler::waitSeconds,
+        "waitSignal", &CoroutineScheduler::waitSignal,
+        "signal", &CoroutineScheduler::signal,
+        "isSuspended", static_cast<bool(CoroutineScheduler::*)(const sol::object&) const>(&CoroutineScheduler::isSuspended),
+        "update", &CoroutineScheduler::update,
+        "time", sol::property(&CoroutineScheduler::getTime),
+        "size", sol::property(&CoroutineScheduler::size)
+    );
+
+    lua.new_usertype<BehaviorTreeExecutor>("BehaviorTreeExecutor",
+        "new", sol::no_constructor,
+        "setFocus", &BehaviorTreeExecutor::setFocus,
+        "setFocusEntity", &BehaviorTreeExecutor::setFocusEntity,
+        "tickBudget", sol::property(&BehaviorTreeExecutor::getTickBudget, &BehaviorTreeExecutor::setTickBudget),
+        "timeBudget", sol::property(&BehaviorTreeExecutor::getTimeBudget, &BehaviorTreeExecutor::setTimeBudget),
+        "tickCount", sol::property(&BehaviorTreeExecutor::getTickCount),
+        "size", sol::property(&BehaviorTreeExecutor::size)
+    );
+
+    lua.new_usertype<LuaWorkerPool>("LuaWorkerPool",
+        "new", sol::no_constructor,
+        "submit", [](LuaWorkerPool* self, sol::this_state s, const std::string& module, sol::object args) {
+          sol::state_view lua(s);
+          if(self->getThreads() == 0) {
+            self->setPackagePath(lua["package"]["path"].get_or(std::string()));
+          }
+          DataProxy dp = args.get_type() == sol::type::table ? DataProxy::create(args.as<sol::table>()) : DataProxy::create(DataWrapper::JSON_OBJECT);
+          return self->submit(module, dp);
+        },
+        "isDone", &LuaWorkerPool::isDone,
+        "result", [](LuaWorkerPool* self, sol::this_state s, LuaWorkerPool::JobID id) {
+          sol::state_view lua(s);
+          DataProxy result;
+          std::string error;
+          if(!self->take(id, result, error)) {
+            return std::make_tuple(false, sol::make_object(lua, sol::lua_nil), sol::make_object(lua, sol::lua_nil));
+          }
+
+          if(!error.empty()) {
+            return std::make_tuple(true, sol::make_object(lua, sol::lua_nil), sol::make_object(lua, error));
+          }
+
+          sol::table t = lua.create_table();
+          DataProxy dp = DataProxy::wrap(t);
+          result.dump(dp);
+          return std::make_tuple(true, t.get<sol::object>("value"), sol::make_object(lua, sol::lua_nil));
+        },
+        "stop", &LuaWorkerPool::stop,
+        "pending", sol::property(&LuaWorkerPool::getPending),
+        "threads", sol::property(&LuaWorkerPool::getThreads)
+    );
+
     lua.new_usertype<LuaScriptSystem>("ScriptSystem",
         "addUpdateListener", &LuaScriptSystem::addUpdateListener,
-        "removeUpdateListener", &LuaScriptSystem::removeUpdateListener
+        "removeUpdateListener", &LuaScriptSystem::removeUpdateListener,
+        "updateListeners", sol::property(&LuaScriptSystem::getUpdateListenersCount),
+        "profileListeners", sol::property(&LuaScriptSystem::getProfileListeners, &LuaScriptSystem::setProfileListeners),
+        "getListenerTimes", &LuaScriptSystem::getListenerTimes,
+        "scheduler", sol::property(&LuaScriptSystem::getScheduler),
+        "behaviors", sol::property(&LuaScriptSystem::getBehaviors),
+        "workers", sol::property(&LuaScriptSystem::getWorkers)
     );
 
 
@@ -533,6 +619,17 @@ namespace Gsage {
           Gsage::Vector3 position = self->getPosition();
           return std::make_tuple(position.X, position.Y, position.Z);
         },
+        "setOrientation", [](RenderComponent* self, double w, double x, double y, double z) {
+          self->setOrientation(Gsage::Quaternion(x, y, z, w));
+        },
+        "getOrientation", [](RenderComponent* self) {
+          Gsage::Quaternion orientation = self->getOrientation();
+          return std::make_tuple(orientation.W, orientation.X, orientation.Y, orientation.Z);
+        },
+        "getDirection", [](RenderComponent* self) {
+          Gsage::Vector3 direction = self->getDirection();
+          return std::make_tuple(direction.X, direction.Y, direction.Z);
+        },
 
         "position", sol::property((void(RenderComponent::*)(const Gsage::Vector3&))&RenderComponent::setPosition, &RenderComponent::getPosition),
         "direction", sol::property(&RenderComponent::getDirection),
@@ -556,7 +653,7 @@ namespace Gsage {
 
     lua.new_usertype<MovementComponent>("MovementComponent",
         sol::base_classes, sol::bases<Reflection>(),
-        "props", sol::property(&MovementComponent::getProps, &MovementComponent::setProps),
+        "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
         "go", sol::overload(
           (void(MovementComponent::*)(const Gsage::Vector3&))&MovementComponent::go,
           (void(MovementComponent::*)(float, float, float))&MovementComponent::go
@@ -619,6 +716,90 @@ namespace Gsage {
     };
     lua["Engine"]["getEntities"] = &Engine::getEntities;
 
+    // query spec is {"component1", "component2", flags={"flag1"}}
+    auto getQuery = [](Engine* e, const sol::table& spec) -> EntityQuery* {
+      EntityQuery::Names components;
+      EntityQuery::Names flags;
+      for(size_t i = 1; i <= spec.size(); ++i) {
+        components.push_back(spec.raw_get<std::string>(i));
+      }
+
+      sol::optional<sol::table> f = spec["flags"];
+      if(f) {
+        for(size_t i = 1; i <= f.value().size(); ++i) {
+          flags.push_back(f.value().raw_get<std::string>(i));
+        }
+      }
+      return e->query(components, flags);
+    };
+
+    lua.new_usertype<EntityQuery>("EntityQuery",
+        "new", sol::no_constructor,
+        "size", sol::property(&EntityQuery::size),
+        "get", [](EntityQuery* self, size_t index) { return self->get(index - 1); },
+        "iter", [](sol::this_state s, EntityQuery* self) {
+          return std::make_tuple(sol::state_view(s)["EntityQuery"]["next"].get<sol::object>(), self, 0);
+        }
+    );
+
+    // stateless iterator, so the generic for does not create closures
+    // it walks the slots, so removing entities inside the loop does not skip the remaining ones
+    lua["EntityQuery"]["next"] = [](sol::this_state s, EntityQuery* self, size_t slot) {
+      for(; slot < self->slots(); ++slot) {
+        Entity* entity = self->at(slot);
+        if(entity) {
+          return std::make_tuple(sol::make_object(s, slot + 1), sol::make_object(s, entity));
+        }
+      }
+      return std::make_tuple(sol::make_object(s, sol::lua_nil), sol::make_object(s, sol::lua_nil));
+    };
+
+    lua["Engine"]["getQuery"] = getQuery;
+    lua["Engine"]["query"] = [getQuery](sol::this_state s, Engine* e, const sol::table& spec) {
+      return std::make_tuple(sol::state_view(s)["EntityQuery"]["next"].get<sol::object>(), getQuery(e, spec), 0);
+    };
+
+    lua.new_usertype<SpatialIndex>("SpatialIndex",
+        "new", sol::no_constructor,
+        "size", sol::property(&SpatialIndex::size),
+        "cellSize", sol::property(&SpatialIndex::getCellSize, &SpatialIndex::setCellSize),
+        "inRadius", [](SpatialIndex* self, const Vector3& center, float radius, sol::optional<unsigned int> flags) {
+          SpatialIndex::Entities res;
+          self->queryRadius(center, radius, res, flags.value_or(0xFF));
+          return res;
+        },
+        "inBox", [](SpatialIndex* self, const BoundingBox& bounds, sol::optional<unsigned int> flags) {
+          SpatialIndex::Entities res;
+          self->queryBox(bounds, res, flags.value_or(0xFF));
+          return res;
+        },
+        "nearest", [](SpatialIndex* self, const Vector3& center, size_t count, sol::optional<unsigned int> flags, sol::optional<float> maxDistance) {
+          SpatialIndex::Entities res;
+          self->queryNearest(center, count, res, flags.value_or(0xFF), maxDistance.value_or(std::numeric_limits<float>::max()));
+          return res;
+        },
+        // runs radius query for each center, returns list of lists
+        "inRadiusBatch", [](sol::this_state s, SpatialIndex* self, const sol::table& centers, float radius, sol::optional<unsigned int> flags) {
+          std::vector<Vector3> points;
+          points.reserve(centers.size());
+          for(size_t i = 1; i <= centers.size(); ++i) {
+            points.push_back(centers.raw_get<Vector3>(i));
+          }
+
+          std::vector<SpatialIndex::Entities> found;
+          self->queryRadius(points, radius, found, flags.value_or(0xFF));
+
+          sol::state_view lua(s);
+          sol::table res = lua.create_table(found.size(), 0);
+          for(size_t i = 0; i < found.size(); ++i) {
+            res[i + 1] = sol::as_table(std::move(found[i]));
+          }
+          return res;
+        }
+    );
+
+    lua["Engine"]["spatial"] = sol::property(&Engine::getSpatialIndex);
+
     // register system getters
     lua["Engine"]["script"] = &Engine::getSystem<LuaScriptSystem>;
     lua["Engine"]["movement"] = &Engine::getSystem<MovementSystem>;
@@ -1012,6 +1193,24 @@ namespace Gsage {
     return mStateView;
   }
 
+  LuaGarbageCollector& LuaInterface::getGarbageCollector()
+  {
+    return mGarbageCollector;
+  }
+
+  bool LuaInterface::loadBytecodeBundle(const std::string& path, const std::string& root)
+  {
+    if(!mState) {
+      return false;
+    }
+
+    if(!mBytecode.load(path, root)) {
+      return false;
+    }
+
+    return mBytecode.install(mState);
+  }
+
   lua_State* LuaInterface::getState()
   {
     return mState;
@@ -0,0 +1,330 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "lua/LuaWorkerPool.h"
+#include "lua/LuaInterface.h"
+#include "lua/CoroutineScheduler.h"
+#include "Logger.h"
+#include "lua.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace Gsage {
+
+  static int traceback(lua_State* L)
+  {
+    const char* message = lua_tostring(L, 1);
+    luaL_traceback(L, L, message ? message : "unknown error", 1);
+    return 1;
+  }
+
+  static int logInfo(lua_State* L)
+  {
+    LOG(INFO) << "[worker] " << luaL_checkstring(L, 1);
+    return 0;
+  }
+
+  static int logWarning(lua_State* L)
+  {
+    LOG(WARNING) << "[worker] " << luaL_checkstring(L, 1);
+    return 0;
+  }
+
+  static int logError(lua_State* L)
+  {
+    LOG(ERROR) << "[worker] " << luaL_checkstring(L, 1);
+    return 0;
+  }
+
+  // worker states can not touch the engine, only pure computations are allowed
+  static const char* RESTRICT = R"(
+    io = nil
+    debug = nil
+    dofile = nil
+    loadfile = nil
+    local os = os
+    _G.os = {
+      clock = os.clock,
+      time = os.time,
+      date = os.date,
+      difftime = os.difftime
+    }
+    package.loaded.io = nil
+    package.loaded.debug = nil
+    package.loaded.os = _G.os
+  )";
+
+  LuaWorkerPool::LuaWorkerPool()
+    : mThreadCount(std::max(1, (int)std::thread::hardware_concurrency() - 1))
+    , mStopped(false)
+    , mNextID(1)
+    , mPending(0)
+  {
+  }
+
+  LuaWorkerPool::~LuaWorkerPool()
+  {
+    stop();
+  }
+
+  void LuaWorkerPool::configure(const DataProxy& config)
+  {
+    int threads = config.get("threads", mThreadCount);
+    if(threads < 1) {
+      LOG(WARNING) << "Lua worker pool should have at least one thread, got " << threads;
+      threads = 1;
+    }
+
+    if(!mThreads.empty() && threads != mThreadCount) {
+      LOG(WARNING) << "Lua worker pool is already running, threads count will be changed after restart";
+    }
+    mThreadCount = threads;
+  }
+
+  void LuaWorkerPool::setPackagePath(const std::string& path)
+  {
+    mPackagePath = path;
+  }
+
+  LuaWorkerPool::JobID LuaWorkerPool::submit(const std::string& module, const DataProxy& args)
+  {
+    if(mThreads.empty() && !start()) {
+      return 0;
+    }
+
+    JobPtr job = std::make_shared<Job>();
+    job->id = mNextID++;
+    job->module = module;
+    job->success = false;
+    // copy arguments to json, so the worker never touches the main lua state
+    job->args = DataProxy::create(DataWrapper::JSON_OBJECT);
+    args.dump(job->args, DataProxy::ForceCopy);
+
+    mResults[job->id] = nullptr;
+    mPending++;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQueue.push_back(job);
+    }
+    mCondition.notify_one();
+    return job->id;
+  }
+
+  bool LuaWorkerPool::take(JobID id, DataProxy& result, std::string& error)
+  {
+    auto iter = mResults.find(id);
+    if(iter == mResults.end() || !iter->second) {
+      return false;
+    }
+
+    JobPtr job = iter->second;
+    mResults.erase(iter);
+    if(job->success) {
+      result = job->result;
+    } else {
+      error = job->error;
+    }
+    return true;
+  }
+
+  bool LuaWorkerPool::isDone(JobID id)
+  {
+    auto iter = mResults.find(id);
+    return iter != mResults.end() && iter->second;
+  }
+
+  int LuaWorkerPool::update(CoroutineScheduler& scheduler, lua_State* L)
+  {
+    if(mPending == 0) {
+      return 0;
+    }
+
+    Jobs finished;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      finished.swap(mFinished);
+    }
+
+    for(auto job : finished) {
+      mPending--;
+      mResults[job->id] = job;
+      if(!job->success) {
+        LOG(ERROR) << "Lua job " << job->module << " failed: " << job->error;
+      }
+    }
+
+    // resumed coroutines may submit new jobs, so it is done after all results are stored
+    for(auto job : finished) {
+      scheduler.signal(sol::this_state{L}, getSignal(job->id));
+    }
+    return (int)finished.size();
+  }
+
+  void LuaWorkerPool::stop()
+  {
+    if(mThreads.empty()) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStopped = true;
+      mQueue.clear();
+    }
+    mCondition.notify_all();
+
+    for(auto& thread : mThreads) {
+      thread.join();
+    }
+    mThreads.clear();
+
+    mFinished.clear();
+    mResults.clear();
+    mPending = 0;
+    mStopped = false;
+  }
+
+  std::string LuaWorkerPool::getSignal(JobID id)
+  {
+    std::stringstream ss;
+    ss << "job:" << id;
+    return ss.str();
+  }
+
+  bool LuaWorkerPool::start()
+  {
+    LOG(INFO) << "Starting lua worker pool, threads: " << mThreadCount;
+    for(int i = 0; i < mThreadCount; ++i) {
+      // each worker gets its own copy of the path, so it is never read while being changed
+      mThreads.push_back(std::thread(&LuaWorkerPool::run, this, mPackagePath));
+    }
+    return !mThreads.empty();
+  }
+
+  lua_State* LuaWorkerPool::createState(const std::string& packagePath)
+  {
+    // pooled allocator is not thread safe, so each worker uses the default one
+    lua_State* L = luaL_newstate();
+    if(!L) {
+      return 0;
+    }
+
+    luaL_openlibs(L);
+    if(luaL_dostring(L, RESTRICT) != 0) {
+      LOG(ERROR) << "Failed to set up lua worker state: " << lua_tostring(L, -1);
+      lua_close(L);
+      return 0;
+    }
+
+    lua_createtable(L, 0, 3);
+    lua_pushcfunction(L, logInfo);
+    lua_setfield(L, -2, "info");
+    lua_pushcfunction(L, logWarning);
+    lua_setfield(L, -2, "warn");
+    lua_pushcfunction(L, logError);
+    lua_setfield(L, -2, "error");
+    lua_setglobal(L, "log");
+
+    if(!packagePath.empty()) {
+      lua_getglobal(L, "package");
+      lua_pushstring(L, packagePath.c_str());
+      lua_setfield(L, -2, "path");
+      lua_pop(L, 1);
+    }
+    return L;
+  }
+
+  void LuaWorkerPool::run(std::string packagePath)
+  {
+    lua_State* L = createState(packagePath);
+    if(!L) {
+      LOG(ERROR) << "Failed to create lua worker state";
+    }
+
+    while(true) {
+      JobPtr job;
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return mStopped || !mQueue.empty(); });
+        if(mStopped) {
+          break;
+        }
+        job = mQueue.front();
+        mQueue.pop_front();
+      }
+
+      if(L) {
+        job->success = execute(L, *job);
+      } else {
+        job->error = "worker state is not initialized";
+      }
+
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFinished.push_back(job);
+    }
+
+    if(L) {
+      lua_close(L);
+    }
+  }
+
+  bool LuaWorkerPool::execute(lua_State* L, Job& job)
+  {
+    int top = lua_gettop(L);
+    lua_pushcfunction(L, traceback);
+    int handler = lua_gettop(L);
+
+    bool success = false;
+    lua_getglobal(L, "require");
+    lua_pushstring(L, job.module.c_str());
+    if(lua_pcall(L, 1, 1, handler) != 0) {
+      job.error = lua_tostring(L, -1);
+    } else if(!lua_isfunction(L, -1)) {
+      job.error = "module " + job.module + " should return a function";
+    } else {
+      sol::stack::push(L, job.args);
+      if(lua_pcall(L, 1, 1, handler) != 0) {
+        job.error = lua_tostring(L, -1);
+      } else {
+        // wrap the value, so scalars and nil are handled the same way as tables
+        lua_createtable(L, 0, 1);
+        lua_insert(L, -2);
+        lua_setfield(L, -2, "value");
+
+        sol::table t(L, -1);
+        job.result = DataProxy::create(DataWrapper::JSON_OBJECT);
+        DataProxy::create(t).dump(job.result, DataProxy::ForceCopy);
+        success = true;
+      }
+    }
+
+    lua_settop(L, top);
+    // worker states live for the whole pool lifetime, so keep them small
+    lua_gc(L, LUA_GCSTEP, 0);
+    return success;
+  }
+}
@@ -33,15 +33,54 @@ THE SOFTWARE.
 #include "lua.hpp"
 #include "FileLoader.h"
 
+#include <chrono>
+
+#include <Poco/File.h>
+
 namespace Gsage {
 
   const std::string LuaScriptSystem::ID = "lua";
 
+  // Calls all update listeners in one go. Removed listeners are left as false until
+  // the dispatch is over; failed listeners are set to false here and dropped by the system.
+  static const char* DISPATCHER = R"(
+    local clock, warn = ...
+    local pcall = pcall
+    return function(list, time)
+      local times = list.times
+      local failed = 0
+      for i = 1, list.n do
+        local listener = list[i]
+        if listener then
+          local ok, err
+          if times then
+            local start = clock()
+            ok, err = pcall(listener, time)
+            times[i] = clock() - start
+          else
+            ok, err = pcall(listener, time)
+          end
+
+          if not ok then
+            list[i] = false
+            failed = failed + 1
+            warn(err)
+          end
+        end
+      end
+      return failed
+    end
+  )";
+
   LuaScriptSystem::LuaScriptSystem()
     : mState(0)
+    , mDispatching(false)
+    , mListenersDirty(false)
+    , mProfileListeners(false)
     , mWorkdir(".")
   {
     mSystemInfo.put("type", LuaScriptSystem::ID);
+    mBehaviors.setScheduler(&mScheduler);
   }
 
   LuaScriptSystem::~LuaScriptSystem()
@@ -50,12 +89,25 @@ namespace Gsage {
 
   bool LuaScriptSystem::initialize(const DataProxy& settings) {
     mWorkdir = mEngine->env().get("workdir", ".");
+    mBehaviors.setEngine(mEngine);
     EngineSystem::initialize(settings);
     return true;
   }
 
   void LuaScriptSystem::configUpdated() {
     EngineSystem::configUpdated();
+    std::pair<DataProxy, bool> behaviors = mConfig.get<DataProxy>("behaviors");
+    if(behaviors.second) {
+      mBehaviors.configure(behaviors.first);
+    }
+
+    setProfileListeners(mConfig.get("profileListeners", mProfileListeners));
+
+    std::pair<DataProxy, bool> workers = mConfig.get<DataProxy>("workers");
+    if(workers.second) {
+      mWorkers.configure(workers.first);
+    }
+
     std::pair<DataProxy, bool> hooks = mConfig.get<DataProxy>("hooks");
     if(hooks.second) {
       for(auto& pair : hooks.first) {
@@ -95,25 +147,84 @@ namespace Gsage {
       return true;
 
     mState = new sol::state_view(L);
+    mScheduler.setLuaState(L);
+    mBehaviors.setLuaState(L);
+    return createDispatcher();
+  }
+
+  bool LuaScriptSystem::createDispatcher()
+  {
+    lua_State* L = mState->lua_state();
+    if(luaL_loadstring(L, DISPATCHER) != 0) {
+      LOG(ERROR) << "Failed to load update listeners dispatcher: " << lua_tostring(L, -1);
+      lua_pop(L, 1);
+      return false;
+    }
+
+    lua_pushcfunction(L, &LuaScriptSystem::clock);
+    lua_pushcfunction(L, &LuaScriptSystem::warn);
+    if(lua_pcall(L, 2, 1, 0) != 0) {
+      LOG(ERROR) << "Failed to create update listeners dispatcher: " << lua_tostring(L, -1);
+      lua_pop(L, 1);
+      return false;
+    }
+
+    mDispatcher = sol::protected_function(L, -1);
+    lua_pop(L, 1);
+
+    mListenersList = mState->create_table();
+    mListenersList["n"] = 0;
+    if(mProfileListeners) {
+      mListenersList["times"] = mState->create_table();
+    }
     return true;
   }
 
+  int LuaScriptSystem::warn(lua_State* L)
+  {
+    const char* error = lua_tostring(L, 1);
+    LOG(ERROR) << "Failed to call update listener: " << (error ? error : "unknown error") << ", force unsubscribe";
+    return 0;
+  }
+
+  int LuaScriptSystem::clock(lua_State* L)
+  {
+    auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+    lua_pushnumber(L, std::chrono::duration<double>(now).count());
+    return 1;
+  }
+
   void LuaScriptSystem::update(const double& time)
   {
     if(!mState)
       return;
 
-    for(Listener& listener : mUpdateListeners)
-    {
-      auto res = listener.function(time);
+    mScheduler.update(time);
+    mWorkers.update(mScheduler, mState->lua_state());
+
+    if(!mUpdateListeners.empty() && mDispatcher.valid()) {
+      mDispatching = true;
+      auto res = mDispatcher(mListenersList, time);
+      mDispatching = false;
       if(!res.valid()) {
         sol::error err = res;
-        removeUpdateListener(listener.function);
-        LOG(ERROR) << "Failed to call update listener: " << err.what() << "\n\t" << lua_tostring(mState->lua_state(), -1) << ", force unsubscribe";
+        LOG(ERROR) << "Failed to dispatch update listeners: " << err.what();
+      } else if(res.get<int>() > 0) {
+        // dispatcher has already cleared failed slots
+        for(size_t i = 0; i < mUpdateListeners.size(); ++i) {
+          if(!mUpdateListeners[i].removed && mListenersList.raw_get<sol::object>(i + 1).get_type() != sol::type::function) {
+            markListenerRemoved(i);
+          }
+        }
+      }
+
+      if(mListenersDirty) {
+        compactUpdateListeners();
       }
     }
 
     ComponentStorage<ScriptComponent>::update(time);
+    mBehaviors.update(time);
   }
 
   void LuaScriptSystem::updateComponent(ScriptComponent* component, Entity* entity, const double& time)
@@ -126,38 +237,17 @@ namespace Gsage {
       component->setSetupExecuted(true);
     }
 
-    if(!component->getBehavior().empty() && component->getBtree() == sol::lua_nil) {
-      sol::function initializeBtree = (*mState)["btree"]["initialize"].get<sol::function>();
-      sol::table btree = initializeBtree(component->getOwner()->getId(), component->getBehavior());
-      component->setBtree(btree);
-      sol::table context = btree["context"];
-
-      component->setData(context);
-
-      LOG(INFO) << "Successfuly registered script component for entity " << component->getOwner()->getId();
-    }
-
-    if(component->hasBehavior())
-    {
-      sol::table& btree = component->getBtree();
-      btree["update"](btree, time);
+    // trees are ticked by the executor in LuaScriptSystem::update
+    if(!component->getBehavior().empty() && !mBehaviors.has(component)) {
+      mBehaviors.add(component);
     }
   }
 
   bool LuaScriptSystem::removeComponent(ScriptComponent* component)
   {
-    const std::string id = component->getOwner()->getId();
     bool stopped = true;
-    if(mState && component->hasBehavior())
+    if(mState && mBehaviors.remove(component) && component->hasBehavior())
     {
-      sol::function stopBtree = (*mState)["btree"]["deinitialize"].get<sol::function>();
-      auto res = stopBtree(id);
-      if(!res.valid()) {
-        sol::error err = res;
-        LOG(ERROR) << "Failed to stop btree " << err.what();
-      }
-
-
       if(!runScript(component, component->getTearDownScript()))
       {
         LOG(ERROR) << "Failed to tear down script component (tear down script)";
@@ -188,7 +278,12 @@ namespace Gsage {
   bool LuaScriptSystem::runScript(ScriptComponent* component, const std::string& script)
   {
     try {
-      auto res = mState->script(getScriptData(script).c_str());
+      sol::protected_function chunk = compile(script);
+      if(!chunk.valid()) {
+        return false;
+      }
+
+      auto res = chunk();
       if(!res.valid())
       {
         sol::error err = res;
@@ -237,6 +332,61 @@ namespace Gsage {
     return scriptData;
   }
 
+  sol::protected_function LuaScriptSystem::compile(const std::string& script)
+  {
+    CompiledScripts::iterator iter = mCompiledScripts.find(script);
+    if(iter != mCompiledScripts.end()) {
+      const CompiledScript& compiled = iter->second;
+      if(compiled.path.empty() || getModificationTime(compiled.path) == compiled.modified) {
+        return compiled.function;
+      }
+      LOG(INFO) << "Script file " << compiled.path << " was changed, compiling it again";
+    }
+
+    static const std::string filePrefix = "@File:";
+    bool isFile = script.compare(0, filePrefix.size(), filePrefix) == 0;
+    std::string chunkName = isFile ? "@" + script.substr(filePrefix.size()) : script;
+
+    CompiledScript compiled;
+    compiled.modified = -1;
+    if(isFile) {
+      compiled.path = FileLoader::getSingletonPtr()->searchFile(script.substr(filePrefix.size()));
+      // modification time is taken before reading, so the change made during the read is not missed
+      compiled.modified = getModificationTime(compiled.path);
+    }
+
+    std::string data = getScriptData(script);
+    lua_State* L = mState->lua_state();
+    if(luaL_loadbuffer(L, data.c_str(), data.size(), chunkName.c_str()) != 0) {
+      LOG(ERROR) << "Failed to compile lua script " << lua_tostring(L, -1);
+      lua_pop(L, 1);
+      return sol::protected_function();
+    }
+
+    sol::protected_function res(L, -1);
+    lua_pop(L, 1);
+    // missing files are read again next time
+    if(!data.empty()) {
+      compiled.function = res;
+      mCompiledScripts[script] = compiled;
+    }
+    return res;
+  }
+
+  signed long long LuaScriptSystem::getModificationTime(const std::string& path)
+  {
+    if(path.empty()) {
+      return -1;
+    }
+
+    Poco::File f(path);
+    if(!f.exists()) {
+      return -1;
+    }
+
+    return (signed long long)f.getLastModified().epochMicroseconds();
+  }
+
   bool LuaScriptSystem::runScript(const std::string& script)
   {
     if(script == "") {
@@ -244,7 +394,12 @@ namespace Gsage {
     }
 
     try {
-      auto res = mState->script(getScriptData(script).c_str());
+      sol::protected_function chunk = compile(script);
+      if(!chunk.valid()) {
+        return false;
+      }
+
+      auto res = chunk();
       if(!res.valid()) {
         return false;
       }
@@ -258,43 +413,129 @@ namespace Gsage {
 
   bool LuaScriptSystem::addUpdateListener(const sol::object& function, bool global)
   {
-    if(std::find_if(mUpdateListeners.begin(), mUpdateListeners.end(), [function] (Listener l) { return l.function == function; } ) != mUpdateListeners.end())
+    if(std::find_if(mUpdateListeners.begin(), mUpdateListeners.end(), [&function] (const Listener& l) { return !l.removed && l.function == function; } ) != mUpdateListeners.end())
       return true;
 
-    if(function.get_type() == sol::type::function) {
-      mUpdateListeners.emplace_back(function.as<sol::function>(), global);
-    } else {
+    if(function.get_type() != sol::type::function) {
       LOG(WARNING) << "Tried to add update listener object of unsupported type";
       return false;
     }
 
+    if(!mListenersList.valid()) {
+      LOG(WARNING) << "Tried to add update listener before lua state was set";
+      return false;
+    }
+
+    // listeners added during the dispatch are called starting from the next update
+    mUpdateListeners.emplace_back(function.as<sol::function>(), global);
+    size_t n = mUpdateListeners.size();
+    mListenersList.raw_set(n, function);
+    mListenersList["n"] = n;
     return true;
   }
 
   bool LuaScriptSystem::removeUpdateListener(const sol::object& object)
   {
-    sol::function function = object.as<sol::function>();
-
-    UpdateListeners::iterator element = std::find_if(mUpdateListeners.begin(), mUpdateListeners.end(), [function] (Listener l) { return l.function == function; } );
+    UpdateListeners::iterator element = std::find_if(mUpdateListeners.begin(), mUpdateListeners.end(), [&object] (const Listener& l) { return !l.removed && l.function == object; } );
     if(element == mUpdateListeners.end())
       return false;
 
-    mUpdateListeners.erase(element);
+    markListenerRemoved(element - mUpdateListeners.begin());
+    if(!mDispatching) {
+      compactUpdateListeners();
+    }
     return true;
   }
 
+  void LuaScriptSystem::markListenerRemoved(size_t index)
+  {
+    Listener& listener = mUpdateListeners[index];
+    listener.removed = true;
+    listener.function = sol::function();
+    mListenersList.raw_set(index + 1, false);
+    mListenersDirty = true;
+  }
+
+  void LuaScriptSystem::compactUpdateListeners()
+  {
+    if(!mListenersList.valid()) {
+      return;
+    }
+
+    size_t n = mUpdateListeners.size();
+    mUpdateListeners.erase(
+        std::remove_if(mUpdateListeners.begin(), mUpdateListeners.end(), [] (const Listener& l) { return l.removed; }),
+        mUpdateListeners.end()
+    );
+
+    for(size_t i = 0; i < n; ++i) {
+      if(i < mUpdateListeners.size()) {
+        mListenersList.raw_set(i + 1, mUpdateListeners[i].function);
+      } else {
+        mListenersList.raw_set(i + 1, sol::lua_nil);
+      }
+    }
+    mListenersList["n"] = mUpdateListeners.size();
+    if(mProfileListeners) {
+      mListenersList["times"] = mState->create_table();
+    }
+    mListenersDirty = false;
+  }
+
+  size_t LuaScriptSystem::getUpdateListenersCount() const
+  {
+    return std::count_if(mUpdateListeners.begin(), mUpdateListeners.end(), [] (const Listener& l) { return !l.removed; });
+  }
+
+  void LuaScriptSystem::setProfileListeners(bool value)
+  {
+    mProfileListeners = value;
+    if(!mListenersList.valid()) {
+      return;
+    }
+
+    if(value) {
+      mListenersList["times"] = mState->create_table();
+    } else {
+      mListenersList["times"] = sol::lua_nil;
+    }
+  }
+
+  sol::table LuaScriptSystem::getListenerTimes(sol::this_state s)
+  {
+    sol::state_view lua(s);
+    sol::table res = lua.create_table();
+    if(!mProfileListeners || !mListenersList.valid()) {
+      return res;
+    }
+
+    sol::table times = mListenersList["times"];
+    for(size_t i = 0; i < mUpdateListeners.size(); ++i) {
+      if(mUpdateListeners[i].removed) {
+        continue;
+      }
+
+      sol::optional<double> time = times.raw_get<sol::optional<double>>(i + 1);
+      res[mUpdateListeners[i].function] = time ? time.value() : 0.0;
+    }
+    return res;
+  }
+
   void LuaScriptSystem::unloadComponents()
   {
     setEnabled(false);
-    for (auto i = mUpdateListeners.begin(); i != mUpdateListeners.end();) {
-      if(i->global) {
-        ++i;
-        continue;
+    for(size_t i = 0; i < mUpdateListeners.size(); ++i) {
+      if(!mUpdateListeners[i].global && !mUpdateListeners[i].removed) {
+        markListenerRemoved(i);
       }
+    }
 
-      i = mUpdateListeners.erase(i);
+    if(!mDispatching) {
+      compactUpdateListeners();
     }
     ComponentStorage<ScriptComponent>::unloadComponents();
+    // script files may change between scenes
+    mCompiledScripts.clear();
     setEnabled(true);
   }
 }
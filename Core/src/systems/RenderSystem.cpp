@@ -99,8 +99,6 @@ namespace Gsage {
     : mValid(false)
     , mWidth(0)
     , mHeight(0)
-    , mBuffer(nullptr)
-    , mSize(0)
     , mBufferWidth(0)
     , mBufferHeight(0)
     , mHandle(name)
@@ -121,24 +119,6 @@ namespace Gsage {
 
   Texture::~Texture()
   {
-    deleteBuffer();
-  }
-
-  void Texture::deleteBuffer()
-  {
-    if(mBuffer) {
-      delete[] mBuffer;
-      mBuffer = nullptr;
-      mSize = 0;
-    }
-  }
-
-  char* Texture::allocateBuffer(size_t size)
-  {
-    deleteBuffer();
-    mBuffer = new char[size]();
-    mSize = size;
-    return mBuffer;
   }
 
   Texture::UVs Texture::getUVs() const
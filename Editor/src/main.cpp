@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include "GsageFacade.h"
 #include "Editor.h"
 #include "lua/LuaInterface.h"
+#include "lua/LuaAllocator.h"
 
 #include <stdio.h>
 #include <thread>
@@ -78,7 +79,7 @@ extern "C" {
       Gsage::GsageFacade facade;
       Gsage::Editor editor(&facade);
       std::string coreConfig = "editorConfig.json";
-      lua_State* L = lua_open();
+      lua_State* L = Gsage::LuaAllocator::newState();
       if(!L) {
         LOG(ERROR) << "Lua state is not initialized";
         return 1;
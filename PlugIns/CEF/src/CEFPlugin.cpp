@@ -185,16 +185,18 @@ namespace Gsage {
 
   void RenderHandler::OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList &dirtyRects, const void *buffer, int width, int height)
   {
+    std::vector<Rect<int>> areas;
+    areas.reserve(dirtyRects.size());
     for(auto rect : dirtyRects) {
-      mTexture->update(buffer, width * height * 4, width, height,
-        Rect<int>(
-          rect.x,
-          rect.y,
-          rect.width,
-          rect.height
-        )
+      areas.emplace_back(
+        rect.x,
+        rect.y,
+        rect.width,
+        rect.height
       );
     }
+    // all rects are submitted at once, so the texture merges them and takes the lock once per paint
+    mTexture->update(buffer, width * height * 4, width, height, areas);
   }
 
   void RenderHandler::setTexture(TexturePtr texture)
@@ -0,0 +1,183 @@
+#ifndef _AnimationPool_H_
+#define _AnimationPool_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <vector>
+#include <cstddef>
+
+#include "Definitions.h"
+
+#define DEFAULT_FADE_SPEED 5.0f
+
+namespace Gsage {
+
+  /**
+   * Storage for animation states of all render components.
+   *
+   * Time, speed, weight and fade values are kept in flat arrays, so all animations are advanced
+   * in one pass, which is split between threads when there are many of them.
+   * Ogre animation states are written afterwards, only for entities that are not culled.
+   */
+  class GSAGE_OGRE_PLUGIN_API AnimationPool
+  {
+    public:
+      typedef size_t Handle;
+      static const Handle INVALID_HANDLE;
+
+      enum Flags {
+        Enabled = 1 << 0,
+        Loop    = 1 << 1,
+        FadeIn  = 1 << 2,
+        FadeOut = 1 << 3,
+        // entity is not visible, Ogre state is not updated
+        Culled  = 1 << 4,
+        // values were changed since the last apply call
+        Dirty   = 1 << 5
+      };
+
+      AnimationPool();
+      virtual ~AnimationPool();
+
+      /**
+       * Allocate animation slot
+       *
+       * @param state Ogre animation state to write values to, can be null
+       * @param length Animation length in seconds
+       */
+      Handle create(OgreV1::AnimationState* state, float length);
+
+      /**
+       * Free animation slot
+       *
+       * @param handle Animation handle
+       */
+      void destroy(Handle handle);
+
+      /**
+       * Get animation time position
+       */
+      inline float getTime(Handle handle) const { return mTime[handle]; }
+
+      /**
+       * Set animation time position, it is wrapped or clamped the same way as Ogre does it
+       *
+       * @param handle Animation handle
+       * @param value Time in seconds
+       */
+      void setTime(Handle handle, float value);
+
+      /**
+       * Get animation length
+       */
+      inline float getLength(Handle handle) const { return mLength[handle]; }
+
+      /**
+       * Get animation weight
+       */
+      inline float getWeight(Handle handle) const { return mWeight[handle]; }
+
+      /**
+       * Get animation speed
+       */
+      inline float getSpeed(Handle handle) const { return mSpeed[handle]; }
+
+      /**
+       * Set animation speed
+       */
+      inline void setSpeed(Handle handle, float value) { mSpeed[handle] = value; }
+
+      /**
+       * Check if all flags are set
+       *
+       * @param handle Animation handle
+       * @param flags Flags mask
+       */
+      inline bool hasFlags(Handle handle, unsigned char flags) const { return (mFlags[handle] & flags) == flags; }
+
+      /**
+       * Set or clear flags
+       *
+       * @param handle Animation handle
+       * @param flags Flags mask
+       * @param value Set or clear
+       */
+      void setFlags(Handle handle, unsigned char flags, bool value);
+
+      /**
+       * Start fading animation in or out
+       *
+       * @param handle Animation handle
+       * @param in Fade in if true, fade out otherwise
+       * @param rate Weight change per second
+       */
+      void fade(Handle handle, bool in, float rate);
+
+      /**
+       * Advance all enabled animations
+       *
+       * @param time Time delta in seconds
+       * @param threads Number of threads to use, 0 means pick automatically
+       */
+      void update(float time, int threads = 0);
+
+      /**
+       * Advance single animation
+       *
+       * @param handle Animation handle
+       * @param time Time delta in seconds
+       */
+      void update(Handle handle, float time);
+
+      /**
+       * Write changed values to Ogre animation states of entities, that are not culled
+       */
+      void apply();
+
+      /**
+       * Get count of allocated slots
+       */
+      inline size_t size() const { return mFlags.size() - mFree.size(); }
+    private:
+      /**
+       * Advance animations in range
+       */
+      void advance(size_t start, size_t end, float time);
+
+      std::vector<OgreV1::AnimationState*> mStates;
+      std::vector<float> mTime;
+      std::vector<float> mLength;
+      std::vector<float> mSpeed;
+      std::vector<float> mWeight;
+      std::vector<float> mFadeRate;
+      std::vector<unsigned char> mFlags;
+
+      std::vector<Handle> mFree;
+  };
+}
+
+#endif
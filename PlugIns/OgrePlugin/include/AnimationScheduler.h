@@ -32,8 +32,8 @@ THE SOFTWARE.
 #include "Definitions.h"
 #include "OgreConverters.h"
 #include "Serializable.h"
+#include "AnimationPool.h"
 
-#define DEFAULT_FADE_SPEED 5.0f
 #define LOOP -1
 
 namespace Ogre
@@ -51,7 +51,8 @@ namespace Gsage {
   class OgreRenderComponent;
 
   /**
-   * Class that wraps ogre animation state, adds speed definition
+   * Class that wraps ogre animation state, adds speed definition.
+   * Animation values are stored in the AnimationPool, which writes them to the Ogre animation state
    */
   class Animation
   {
@@ -59,11 +60,18 @@ namespace Gsage {
       Animation();
       virtual ~Animation();
       /**
+       * Allocate animation in the pool
        *
+       * @param pool AnimationPool to store values in
+       * @param state Ogre animation state
        */
-      void initialize(OgreV1::AnimationState* state);
+      void initialize(AnimationPool* pool, OgreV1::AnimationState* state);
       /**
-       * Calls Ogre::AnimationState addTime with adjusted speed
+       * Free animation slot in the pool
+       */
+      void release();
+      /**
+       * Advance this animation only, all animations are advanced by AnimationPool::update
        *
        * @param time Time in seconds
        */
@@ -143,13 +151,16 @@ namespace Gsage {
        * @param offset If speed >= 0: 0 + offset, else: length - offset
        */
       void rewind(double offset = 0);
+      /**
+       * Mark animation as culled, so Ogre animation state is not updated
+       *
+       * @param value Culled
+       */
+      void setCulled(bool value);
     private:
       friend class AnimationScheduler;
-      OgreV1::AnimationState* mAnimationState;
-      bool mFadeIn;
-      bool mFadeOut;
-      float mFadeTime;
-      float mSpeed;
+      AnimationPool* mPool;
+      AnimationPool::Handle mHandle;
   };
 
   /**
@@ -158,13 +169,17 @@ namespace Gsage {
   class AnimationGroup
   {
     public:
-      AnimationGroup() : mRenderComponent(0) {};
-      AnimationGroup(OgreRenderComponent* c);
+      AnimationGroup() : mRenderComponent(0), mPool(0) {};
+      AnimationGroup(OgreRenderComponent* c, AnimationPool* pool);
       virtual ~AnimationGroup();
       /**
        * Initialize animation groups
        */
       bool initialize(const DataProxy& dict, Ogre::SceneManager* sceneManager);
+      /**
+       * Free all animations slots in the pool
+       */
+      void release();
       /**
        * Gets animations speed
        */
@@ -186,6 +201,7 @@ namespace Gsage {
       Animations mAnimations;
 
       OgreRenderComponent* mRenderComponent;
+      AnimationPool* mPool;
 
       float mSpeed;
   };
@@ -238,8 +254,14 @@ namespace Gsage {
        * @param dict DataProxy to get settings from
        * @param sceneManager Ogre::SceneManager to get entities from
        * @param renderComponent target render component
+       * @param pool AnimationPool to allocate animations in
+       */
+      bool initialize(const DataProxy& dict, Ogre::SceneManager* sceneManager, OgreRenderComponent* renderComponent, AnimationPool* pool);
+
+      /**
+       * Free all animations, should be called before Ogre entities are destroyed
        */
-      bool initialize(const DataProxy& dict, Ogre::SceneManager* sceneManager, OgreRenderComponent* renderComponent);
+      void release();
 
       /**
        * Adjust animation speed
@@ -266,12 +288,25 @@ namespace Gsage {
        */
       void resetState();
       /**
-       * Update animations
+       * Switch finished animations to the next queued ones.
+       * Animations time is advanced by AnimationPool::update
        *
        * @param time Time delta in seconds
        */
       void update(double time);
 
+      /**
+       * Skip updating Ogre animation states, when the entity is not visible
+       *
+       * @param value Culled
+       */
+      void setCulled(bool value);
+
+      /**
+       * Check if there are any animations
+       */
+      inline bool hasAnimations() const { return !mTracks.empty(); }
+
     private:
       /**
        * Plays default animation, if present
@@ -318,6 +353,21 @@ namespace Gsage {
       AnimationGroups mAnimationGroups;
       Animations mAnimations;
 
+      /**
+       * Animation with the queue, resolved once, so update does not do map lookups
+       */
+      struct Track
+      {
+        Animation* animation;
+        AnimationQueue* queue;
+      };
+
+      typedef std::vector<Track> Tracks;
+      Tracks mTracks;
+
+      AnimationPool* mPool;
+      bool mCulled;
+
       float mDefaultAnimationSpeed;
       std::string mDefaultAnimation;
       std::string mCurrentAnimation;
@@ -30,6 +30,7 @@
 #include <Ogre.h>
 
 #include "Definitions.h"
+#include "StaticBatcher.h"
 // uncomment if you want to use ETM as terrainmanager
 //#define ETM_TERRAIN
 
@@ -39,6 +40,18 @@
 
 namespace MOC {
 
+  /**
+   * Result of a single ray in the batch raycast
+   */
+  struct RaycastHit {
+    bool hit;
+    Ogre::Vector3 point;
+    Ogre::MovableObject* target;
+    float distance;
+  };
+
+  typedef std::vector<RaycastHit> RaycastHits;
+
   class CollisionTools {
     public:
       Ogre::RaySceneQuery *mRaySceneQuery;
@@ -71,13 +84,24 @@ namespace MOC {
       bool raycast(const Ogre::Ray &ray, Ogre::Vector3 &result, Ogre::MovableObject* &target,float &closest_distance, const Ogre::uint32 queryMask = 0xFFFFFFFF);
       // convenience wrapper with Ogre::Entity to it:
       bool raycast(const Ogre::Ray &ray, Ogre::Vector3 &result, OgreV1::Entity* &target,float &closest_distance, const Ogre::uint32 queryMask = 0xFFFFFFFF);
+      // raycast several rays at once, results are written in the same order as rays
+      // returns count of rays, that hit anything
+      size_t raycast(const std::vector<Ogre::Ray> &rays, RaycastHits &results, const Ogre::uint32 queryMask = 0xFFFFFFFF);
 
       void setHeightAdjust(const float heightadjust);
       float getHeightAdjust(void);
 
+      // batched objects, detached from the scene graph, are picked through the batcher
+      void setStaticBatcher(Gsage::StaticBatcher* batcher);
+
     private:
 
+      // get object world transform, objects detached by the static batcher use recorded transform
+      bool getWorldTransform(Ogre::MovableObject* object, Ogre::Matrix4& dest);
+
       float _heightAdjust;
+
+      Gsage::StaticBatcher* mStaticBatcher;
   };
 };
 
@@ -118,6 +118,17 @@ namespace Gsage {
        */
       virtual void update(const void* buffer, size_t size, int width, int height, const Rect<int>& area);
 
+      /**
+       * Update texture data using several changed rectangles at once
+       *
+       * @param buffer buffer to use
+       * @param size provided buffer size
+       * @param width buffer width
+       * @param height buffer height
+       * @param areas changed rects
+       */
+      virtual void update(const void* buffer, size_t size, int width, int height, const std::vector<Rect<int>>& areas);
+
       /**
        * Check if the texture has actual data
        */
@@ -147,7 +158,7 @@ namespace Gsage {
       /**
        * Texture buffer was changed
        */
-      inline bool isDirty() const { return mDirty; }
+      inline bool isDirty() const { return mDirty || mStaging.hasChanges(); }
 
       /**
        * Update texture using supplied buffer
@@ -168,6 +179,8 @@ namespace Gsage {
 
       std::unique_ptr<OgreTexture::ScalingPolicy> createScalingPolicy(const DataProxy& params);
 
+      void write(const void* buffer, size_t size, int width, int height, const Rect<int>* areas, size_t count);
+
       bool blitDirty();
       bool blitAll();
 
@@ -179,8 +192,6 @@ namespace Gsage {
       bool mDirty;
       bool mCreate;
       int mFlags;
-
-      std::vector<Rect<int>> mDirtyRegions;
   };
 
 
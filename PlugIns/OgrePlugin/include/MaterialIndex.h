@@ -0,0 +1,153 @@
+#ifndef _MaterialIndex_H_
+#define _MaterialIndex_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Definitions.h"
+#include "MaterialScanner.h"
+
+namespace Gsage {
+  class Filesystem;
+
+  /**
+   * Index of materials defined in material files.
+   *
+   * Index is updated incrementally: files are read again only when their modification time changes,
+   * and scanned again only when the contents hash changes. Files are read and scanned in parallel
+   */
+  class GSAGE_OGRE_PLUGIN_API MaterialIndex
+  {
+    public:
+      struct FileInfo {
+        std::string path;
+        signed long modified;
+        std::string folder;
+      };
+
+      /**
+       * Counts of files by the scan result
+       */
+      struct ScanStats {
+        size_t unchanged;
+        size_t touched;
+        size_t parsed;
+        size_t failed;
+        size_t removed;
+
+        /**
+         * Check if the index was changed by the scan
+         */
+        inline bool changed() const { return touched + parsed + removed > 0; }
+      };
+
+      MaterialIndex(Filesystem* filesystem);
+      virtual ~MaterialIndex();
+
+      /**
+       * Scan material files in the folder and subfolders, files that were removed from the folder are dropped
+       *
+       * @param folder Folder to scan
+       */
+      ScanStats scan(const std::string& folder);
+
+      /**
+       * Find file, which defines the material
+       *
+       * @param material Material name
+       * @returns nullptr if the material is not indexed
+       */
+      const FileInfo* find(const std::string& material) const;
+
+      /**
+       * Read index file, indexed files are not scanned again until they are changed
+       *
+       * @param path Index file path
+       * @returns false if there is no index file or it is malformed
+       */
+      bool read(const std::string& path);
+
+      /**
+       * Write index file
+       *
+       * @param path Index file path
+       */
+      bool write(const std::string& path) const;
+
+      /**
+       * Drop all indexed files and materials
+       */
+      void clear();
+
+      /**
+       * Get count of indexed materials
+       */
+      inline size_t size() const { return mMaterials.size(); }
+    private:
+      struct IndexEntry {
+        signed long modified;
+        unsigned int hash;
+        std::string folder;
+        MaterialScanner::Names materials;
+      };
+
+      struct ScanJob {
+        enum State {
+          Unchanged,
+          Touched,
+          Parsed,
+          Failed
+        };
+
+        std::string path;
+        const IndexEntry* cached;
+        State state;
+        signed long modified;
+        unsigned int hash;
+        MaterialScanner::Names materials;
+      };
+
+      void scanFolder(const std::string& folder, std::vector<std::string>& files, const std::string extension);
+
+      void scanFiles(std::vector<ScanJob>& jobs, size_t start, size_t end);
+
+      void unindex(const std::string& file, const MaterialScanner::Names& materials);
+
+      Filesystem* mFilesystem;
+
+      typedef std::map<std::string, IndexEntry> Files;
+      Files mFiles;
+
+      typedef std::map<std::string, FileInfo> Materials;
+      Materials mMaterials;
+  };
+}
+
+#endif
@@ -27,64 +27,64 @@ THE SOFTWARE.
 -----------------------------------------------------------------------------
 */
 
+#include <memory>
+#include <mutex>
+#include <set>
+#include <OgreScriptCompiler.h>
+
 #include "EventSubscriber.h"
 #include "EventDispatcher.h"
 #include "GsageDefinitions.h"
 #include "DataProxy.h"
+#include "MaterialIndex.h"
 
 namespace Gsage {
   class OgreRenderSystem;
   class GsageFacade;
 
-  /**
-   TODO: INDEXER
-
-   {
-     "filename": {
-        "checksum": "...",
-        "changed": "...",
-        "materials": []
-     }
-   }
-
-   for(auto& file : filesystem->ls(folder)) {
-     if(filesystem->extension(file) != "material") {
-       continue;
-     }
-   }
-
-   */
-
   /**
    * Custom OGRE material loader
+   *
+   * Keeps an index of materials defined in material files of all resource folders.
+   * Index is stored in the workdir, see MaterialIndex.
    */
   class MaterialLoader : public EventDispatcher, public EventSubscriber<MaterialLoader>
   {
     public:
       MaterialLoader(OgreRenderSystem* render, GsageFacade* facade);
+      virtual ~MaterialLoader();
 
       /**
        * Loads material from any of resource folders
        *
        * @param material Material name
        * @param group Material group
-       * @param background Loads material in background
+       * @param background Read and parse material script in a background worker, material is
+       * created later in the render thread. Use false if the material should be ready when the call returns
        */
       bool load(const std::string& material, const std::string& group, bool background = true);
 
       /**
-       * Indexer scans materials files to detect materials sets defined there
+       * Indexer scans materials files to detect materials sets defined there.
+       * Files are read and scanned in parallel
        *
        * @param folder Folder to scan
        */
       void scan(const std::string& folder);
 
     private:
-      void scanFolder(const std::string& folder, std::vector<std::string>& files, const std::string extension);
+      /**
+       * Background loads state, shared with the queued tasks, so they can outlive the loader
+       */
+      struct PendingLoads {
+        std::mutex mutex;
+        MaterialLoader* loader;
+        std::set<std::string> paths;
+      };
 
-      void readIndexFile();
+      bool compile(const Ogre::ConcreteNodeListPtr& nodes, const std::string& group);
 
-      void writeIndexFile();
+      std::string getIndexPath() const;
 
       bool onEnvUpdated(EventDispatcher* sender, const Event& event);
 
@@ -92,18 +92,13 @@ namespace Gsage {
 
       OgreRenderSystem* mRender;
       GsageFacade* mFacade;
-      DataProxy mIndex;
       std::string mWorkdir;
 
-      struct FileInfo {
-        std::string path;
-        signed long modified;
-        std::string folder;
-      };
+      MaterialIndex mIndex;
 
-      typedef std::map<std::string, FileInfo> MaterialIndex;
+      std::unique_ptr<Ogre::ScriptCompiler> mCompiler;
 
-      MaterialIndex mMaterialIndex;
+      std::shared_ptr<PendingLoads> mPending;
   };
 }
 
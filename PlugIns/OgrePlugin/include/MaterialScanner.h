@@ -0,0 +1,69 @@
+#ifndef _MaterialScanner_H_
+#define _MaterialScanner_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "Definitions.h"
+
+namespace Gsage {
+
+  /**
+   * Finds material definitions in OGRE material scripts without parsing them.
+   *
+   * Text is read in a single pass: comments, quoted strings and nested blocks are
+   * handled, so keywords inside passes, like shadow_caster_material, are not mistaken
+   * for material definitions.
+   */
+  class GSAGE_OGRE_PLUGIN_API MaterialScanner
+  {
+    public:
+      typedef std::vector<std::string> Names;
+
+      /**
+       * Collect names of materials and hlms datablocks defined in the script
+       *
+       * @param data script text
+       * @param size text size
+       * @param names names are appended there
+       */
+      static void scan(const char* data, size_t size, Names& names);
+
+      /**
+       * Get FNV-1a hash of the script, used to detect changed files
+       *
+       * @param data script text
+       * @param size text size
+       */
+      static unsigned int hash(const char* data, size_t size);
+  };
+}
+
+#endif
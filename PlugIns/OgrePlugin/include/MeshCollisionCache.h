@@ -0,0 +1,111 @@
+#ifndef _MeshCollisionCache_H_
+#define _MeshCollisionCache_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <OgreResource.h>
+#include <OgreSingleton.h>
+#include <OgreMovableObject.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "TriangleBVH.h"
+#include "MeshTools.h"
+
+namespace Gsage {
+
+  typedef std::shared_ptr<TriangleBVH> TriangleBVHPtr;
+  typedef std::shared_ptr<const Ogre::MeshInformation> MeshInformationPtr;
+
+  /**
+   * Keeps mesh data, extracted for raycasts and geometry requests.
+   *
+   * Vertices, normals and indices are read once per mesh in the mesh local space,
+   * from the LOD 0 geometry, so all instances of the mesh share them.
+   * Triangle BVH is built lazily on top of that data on the first raycast.
+   * Cache entry is dropped when the mesh is unloaded, so reloaded mesh gets rebuilt.
+   */
+  class MeshCollisionCache : public Ogre::Singleton<MeshCollisionCache>, public Ogre::Resource::Listener
+  {
+    public:
+      MeshCollisionCache();
+      virtual ~MeshCollisionCache();
+
+      static MeshCollisionCache& getSingleton(void);
+      static MeshCollisionCache* getSingletonPtr(void);
+
+      /**
+       * Get BVH for the movable object mesh, builds it on the first access
+       *
+       * @param object Entity or Item
+       * @returns nullptr if the object has no mesh
+       */
+      TriangleBVHPtr get(Ogre::MovableObject* object);
+
+      /**
+       * Get local space vertices, normals and indices of the movable object mesh
+       *
+       * @param object Entity or Item
+       * @returns nullptr if the object has no mesh
+       */
+      MeshInformationPtr getMeshInformation(Ogre::MovableObject* object);
+
+      /**
+       * Drop all cached data
+       */
+      void clear();
+
+      /**
+       * Get count of cached meshes
+       */
+      size_t size() const;
+
+      /**
+       * Ogre::Resource::Listener implementation
+       */
+      void unloadingComplete(Ogre::Resource* resource);
+    private:
+      struct Entry
+      {
+        MeshInformationPtr info;
+        TriangleBVHPtr bvh;
+      };
+
+      /**
+       * Get entry for the object mesh, extracts mesh data if it is not cached yet
+       */
+      Entry* getEntry(Ogre::MovableObject* object);
+
+      typedef std::unordered_map<Ogre::Resource*, Entry> Entries;
+      Entries mEntries;
+
+      mutable std::mutex mMutex;
+  };
+}
+
+#endif
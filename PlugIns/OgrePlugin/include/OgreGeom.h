@@ -36,11 +36,19 @@ namespace Ogre {
 }
 
 namespace Gsage {
+  class StaticBatcher;
+
   class OgreGeom : public Geom
   {
     public:
       typedef std::vector<Ogre::MovableObject*> OgreEntities;
-      OgreGeom(OgreEntities src, Ogre::SceneNode* referenceNode);
+      /**
+       * @param src Entities to get geometry from
+       * @param referenceNode Node, which defines the geometry coordinate space
+       * @param threads Threads to use for big scenes, 0 means hardware concurrency
+       * @param batcher StaticBatcher to get transforms of the entities, detached from the scene graph
+       */
+      OgreGeom(OgreEntities src, Ogre::SceneNode* referenceNode, int threads = 0, StaticBatcher* batcher = 0);
       virtual ~OgreGeom();
     private:
       OgreEntities mSrcEntities;
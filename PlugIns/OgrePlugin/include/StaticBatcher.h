@@ -0,0 +1,224 @@
+#ifndef _StaticBatcher_H_
+#define _StaticBatcher_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <OgreNode.h>
+#include <OgreStaticGeometry.h>
+#include <OgreRay.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "Definitions.h"
+#include "DataProxy.h"
+
+namespace Ogre
+{
+  class SceneManager;
+  class MovableObject;
+}
+
+namespace Gsage {
+  class EntityWrapper;
+#if OGRE_VERSION_MAJOR != 1
+  class ItemWrapper;
+#endif
+
+  /**
+   * Groups static objects, which share mesh and materials, into batches.
+   *
+   * Ogre 1.x: group is baked into static geometry and batched entities are detached from the scene graph,
+   * their nodes are detached too, if nothing else is attached to them. Picking and geometry extraction
+   * use world transforms and bounds, recorded at the build time, see getTransform and queryRay.
+   *
+   * Ogre 2.x: nodes of batched objects are made static, so they are skipped by the scene graph update,
+   * and Hlms instances the objects, which share mesh and datablock, in a single draw call.
+   *
+   * Batches are rebuilt when members change or when any member node or its ancestor is moved
+   * through SceneNodeWrapper. Node visibility changes are not tracked, objects that are hidden
+   * at runtime should not be static.
+   */
+  class StaticBatcher
+  {
+    public:
+      /**
+       * Batched object hit by a ray
+       */
+      typedef std::pair<Ogre::Real, Ogre::MovableObject*> RayHit;
+      typedef std::vector<RayHit> RayHits;
+
+      StaticBatcher();
+      virtual ~StaticBatcher();
+
+      /**
+       * @param sceneManager Ogre::SceneManager to create batches in
+       */
+      void initialize(Ogre::SceneManager* sceneManager);
+
+      /**
+       * Configure batching
+       * \verbatim embed:rst:leading-asterisk
+       *
+       *  * :code:`enabled` batch static objects, applies to the objects created after that (default true).
+       *  * :code:`minInstances` min count of objects sharing mesh and materials to create a batch (default 4).
+       *  * :code:`regionSize` size of static geometry region, Ogre 1.x only (default 100).
+       *
+       * \endverbatim
+       * @param config DataProxy with settings
+       */
+      void configure(const DataProxy& config);
+
+      /**
+       * Register static entity or update its group
+       * @param entity EntityWrapper
+       */
+      void add(EntityWrapper* entity);
+
+#if OGRE_VERSION_MAJOR != 1
+      /**
+       * Register static item or update its group
+       * @param item ItemWrapper
+       */
+      void add(ItemWrapper* item);
+#endif
+
+      /**
+       * Unregister object and return it to the scene graph
+       * @param object Ogre::MovableObject
+       */
+      void remove(Ogre::MovableObject* object);
+
+      /**
+       * Rebuild batches of the objects attached to the node or to its descendants on the next update
+       * @param node Moved node
+       * @param restore Return batched objects to the scene graph immediately, should be used when the node is detached
+       */
+      void invalidate(const Ogre::Node* node, bool restore = false);
+
+      /**
+       * Rebuild changed batches, should be called before the scene is rendered
+       */
+      void update();
+
+      /**
+       * Destroy all batches and unregister all objects
+       */
+      void clear();
+
+      /**
+       * Get count of built batches
+       */
+      size_t getBatchCount();
+
+      /**
+       * Get count of objects, that are rendered through batches
+       */
+      size_t getBatchedCount();
+
+      /**
+       * Check if the object is rendered through a batch
+       * @param object Ogre::MovableObject
+       */
+      bool isBatched(const Ogre::MovableObject* object);
+
+      /**
+       * Get world transform of the batched object, detached from the scene graph
+       * @param object Ogre::MovableObject
+       * @param dest Matrix4 to write transform to
+       * @returns false if the object is not detached by the batcher
+       */
+      bool getTransform(const Ogre::MovableObject* object, Ogre::Matrix4& dest);
+
+      /**
+       * Find batched objects, detached from the scene graph, which bounds are hit by the ray
+       * @param ray Ray to test
+       * @param queryMask Object query flags mask
+       * @param dest RayHits to append hits to
+       */
+      void queryRay(const Ogre::Ray& ray, Ogre::uint32 queryMask, RayHits& dest);
+    private:
+      struct Entry {
+        Entry() : node(0), parent(0), batched(false) {}
+
+        std::string key;
+        // node the object is attached to
+        Ogre::SceneNode* node;
+        // node with all ancestors, moving any of them moves the object
+        std::vector<const Ogre::Node*> path;
+        // parent of the node, detached from the scene graph
+        Ogre::Node* parent;
+        bool batched;
+#if OGRE_VERSION_MAJOR == 1
+        Ogre::Matrix4 transform;
+        Ogre::AxisAlignedBox bounds;
+#endif
+      };
+
+      struct Group {
+        Group() : geometry(0), dirty(false) {}
+
+        std::vector<Ogre::MovableObject*> objects;
+        std::vector<Ogre::MovableObject*> batched;
+        OgreV1::StaticGeometry* geometry;
+        bool dirty;
+      };
+
+      void add(Ogre::MovableObject* object, const std::string& key);
+
+      void unregister(Ogre::MovableObject* object);
+
+      bool isInScene(Ogre::MovableObject* object) const;
+
+      void build(Group& group);
+
+      void release(Group& group);
+
+      void detach(Ogre::MovableObject* object, Entry& entry);
+
+      void restore(Ogre::MovableObject* object, Entry& entry);
+
+      typedef std::map<std::string, Group> Groups;
+      Groups mGroups;
+
+      typedef std::map<const Ogre::MovableObject*, Entry> Entries;
+      Entries mEntries;
+
+      typedef std::map<const Ogre::Node*, std::vector<Ogre::MovableObject*>> Nodes;
+      Nodes mNodes;
+
+      std::mutex mMutex;
+
+      Ogre::SceneManager* mSceneManager;
+      bool mEnabled;
+      size_t mMinInstances;
+      float mRegionSize;
+      long mCounter;
+  };
+}
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef _TransformSnapshot_H_
+#define _TransformSnapshot_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "TripleBuffer.h"
+
+namespace Gsage {
+
+  class SceneNodeWrapper;
+  class Entity;
+
+  /**
+   * Transforms of scene nodes in the structure of arrays layout.
+   *
+   * Snapshot is written by the simulation thread and applied to the scene graph by the render thread.
+   * Rare operations, like animation state changes or nodes destruction, are stored as commands.
+   */
+  class TransformSnapshot
+  {
+    public:
+      typedef std::function<void()> Command;
+
+      enum Field {
+        Position    = 1 << 0,
+        Orientation = 1 << 1,
+        Visibility  = 1 << 2
+      };
+
+      TransformSnapshot();
+      virtual ~TransformSnapshot();
+
+      /**
+       * Remove all nodes and commands from the snapshot
+       */
+      void clear();
+
+      /**
+       * Add node state
+       *
+       * @param node scene node wrapper
+       * @param fields Field mask, only these fields will be applied
+       * @param position node position
+       * @param orientation node orientation
+       * @param visible node visibility
+       */
+      void add(SceneNodeWrapper* node, unsigned char fields, const Ogre::Vector3& position, const Ogre::Quaternion& orientation, bool visible);
+
+      /**
+       * Add command
+       *
+       * @param frame frame when the command was queued
+       * @param command command to run
+       */
+      void addCommand(unsigned long frame, const Command& command);
+
+      /**
+       * Apply node states and run commands, which were not run by the previous snapshots
+       *
+       * @param lastFrame frame of the last applied snapshot
+       */
+      void apply(unsigned long lastFrame);
+
+      /**
+       * Get number of nodes in the snapshot
+       */
+      inline size_t size() const { return mNodes.size(); }
+
+      /**
+       * Get snapshot frame
+       */
+      inline unsigned long getFrame() const { return mFrame; }
+
+      /**
+       * Set snapshot frame
+       */
+      inline void setFrame(unsigned long frame) { mFrame = frame; }
+    private:
+      std::vector<SceneNodeWrapper*> mNodes;
+      std::vector<unsigned char> mFields;
+      std::vector<Ogre::Vector3> mPositions;
+      std::vector<Ogre::Quaternion> mOrientations;
+      std::vector<unsigned char> mVisible;
+
+      typedef std::vector<std::pair<unsigned long, Command>> Commands;
+      Commands mCommands;
+
+      unsigned long mFrame;
+  };
+
+  /**
+   * Passes transform snapshots from the simulation thread to the render thread.
+   *
+   * Simulation thread writes node states during the frame and publishes them once per frame.
+   * Render thread applies the latest published snapshot and skips older ones, so each
+   * published snapshot contains all states and commands, which were not applied yet.
+   */
+  class TransformSnapshotBuffer
+  {
+    public:
+      /**
+       * Latest node state written by the simulation thread
+       */
+      struct State
+      {
+        State();
+
+        unsigned char fields;
+        Ogre::Vector3 position;
+        Ogre::Quaternion orientation;
+        bool visible;
+        // entity, which owns the node, and query flags of the node tree
+        Entity* owner;
+        unsigned int queryFlags;
+        // frame when the state was written last time
+        unsigned long frame;
+      };
+
+      typedef std::unordered_map<SceneNodeWrapper*, State> States;
+
+      TransformSnapshotBuffer();
+      virtual ~TransformSnapshotBuffer();
+
+      /**
+       * Get node state for writing, should be called from the simulation thread
+       *
+       * @param node scene node wrapper
+       */
+      State& write(SceneNodeWrapper* node);
+
+      /**
+       * Get node state, which is not applied yet
+       *
+       * @param node scene node wrapper
+       * @returns nullptr if there is nothing pending for the node
+       */
+      const State* read(SceneNodeWrapper* node) const;
+
+      /**
+       * Queue command, should be called from the simulation thread
+       *
+       * @param command command to run in the render thread
+       */
+      void queue(const TransformSnapshot::Command& command);
+
+      /**
+       * Forget node states, should be called before the node destruction is queued
+       *
+       * @param node scene node wrapper
+       */
+      void remove(SceneNodeWrapper* node);
+
+      /**
+       * Get all states, which were not applied by the render thread yet
+       */
+      inline const States& getPending() const { return mPending; }
+
+      /**
+       * Get current simulation frame
+       */
+      inline unsigned long getFrame() const { return mFrame; }
+
+      /**
+       * Publish all pending states and commands, should be called from the simulation thread
+       */
+      void publish();
+
+      /**
+       * Apply the latest published snapshot, should be called from the render thread
+       *
+       * @returns false if there was no new snapshot
+       */
+      bool apply();
+
+      /**
+       * Run commands, which were not applied by the render thread yet.
+       * Should be called when the render thread is stopped
+       */
+      void flush();
+
+      /**
+       * Drop all pending states and commands
+       */
+      void reset();
+    private:
+      TripleBuffer<TransformSnapshot> mBuffer;
+
+      States mPending;
+
+      typedef std::vector<std::pair<unsigned long, TransformSnapshot::Command>> Commands;
+      Commands mCommands;
+
+      unsigned long mFrame;
+      unsigned long mAppliedFrame;
+      std::atomic<unsigned long> mConsumedFrame;
+  };
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _TriangleBVH_H_
+#define _TriangleBVH_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <OgreVector3.h>
+#include <vector>
+#include <limits>
+
+namespace Gsage {
+
+  /**
+   * Bounding volume hierarchy over mesh triangles.
+   *
+   * Triangles are stored in packets of 4 in SoA layout, so each leaf is tested
+   * with a single 4-wide ray-triangle test, which the compiler can vectorize.
+   */
+  class TriangleBVH
+  {
+    public:
+      /**
+       * Which triangle sides can be hit by the ray
+       */
+      enum CullMode {
+        // only front faces can be hit, same as Ogre::Math::intersects(ray, a, b, c, true, false)
+        CULL_BACK,
+        // only back faces can be hit, used when the mesh transform mirrors triangles
+        CULL_FRONT,
+        CULL_NONE
+      };
+
+      /**
+       * Triangles per leaf
+       */
+      static const int PACKET_SIZE = 4;
+
+      TriangleBVH();
+      virtual ~TriangleBVH();
+
+      /**
+       * Build hierarchy from the indexed triangle list
+       *
+       * @param vertices Vertex positions
+       * @param vertexCount Count of vertices
+       * @param indices Triangle indices
+       * @param indexCount Count of indices, should be divisible by 3
+       */
+      void build(const Ogre::Vector3* vertices, size_t vertexCount, const Ogre::uint32* indices, size_t indexCount);
+
+      /**
+       * Find the closest hit
+       *
+       * @param origin Ray origin
+       * @param direction Ray direction, distance is measured in its length units
+       * @param distance Distance to the closest hit, if any
+       * @param cull Cull mode
+       * @param maxDistance Ignore hits that are further than this value
+       * @returns true if the ray hits any triangle
+       */
+      bool intersect(const Ogre::Vector3& origin, const Ogre::Vector3& direction, Ogre::Real& distance, CullMode cull = CULL_BACK, Ogre::Real maxDistance = std::numeric_limits<Ogre::Real>::max()) const;
+
+      /**
+       * Get count of indexed triangles
+       */
+      inline size_t getTriangleCount() const { return mTriangleCount; }
+
+      /**
+       * Get count of hierarchy nodes
+       */
+      inline size_t getNodeCount() const { return mNodes.size(); }
+
+      /**
+       * Check if the hierarchy has no triangles
+       */
+      inline bool empty() const { return mTriangleCount == 0; }
+    private:
+      struct Node
+      {
+        float min[3];
+        float max[3];
+        // leaf: first packet, inner node: second child (first child follows the node)
+        Ogre::uint32 offset;
+        // packets count, 0 for inner nodes
+        Ogre::uint32 count;
+      };
+
+      struct Packet
+      {
+        float v0[3][PACKET_SIZE];
+        float e1[3][PACKET_SIZE];
+        float e2[3][PACKET_SIZE];
+      };
+
+      struct Triangle
+      {
+        Ogre::Vector3 a;
+        Ogre::Vector3 b;
+        Ogre::Vector3 c;
+        Ogre::Vector3 centroid;
+      };
+
+      typedef std::vector<Triangle> Triangles;
+
+      Ogre::uint32 buildNode(Triangles& triangles, size_t start, size_t end);
+
+      void testPacket(const Packet& packet, const float origin[3], const float direction[3], CullMode cull, float& closest) const;
+
+      std::vector<Node> mNodes;
+      std::vector<Packet> mPackets;
+      size_t mTriangleCount;
+  };
+}
+
+#endif
@@ -47,6 +47,8 @@ namespace Gsage {
   class OgreRenderSystem;
   class ResourceManager;
   class OgreObjectManager;
+  class TransformSnapshotBuffer;
+  class AnimationPool;
 
   /**
    * Ogre render system component
@@ -71,11 +73,15 @@ namespace Gsage {
        * @param sceneManager Ogre::SceneManager instance to allow creating objects on scene
        * @param resourceManager ResourceManager* instance to allow component loading additional resource
        * @param objectManager OgreObjectManager instance to allow creating root tree
+       * @param snapshots TransformSnapshotBuffer to write transforms to, when render system runs in the dedicated thread
+       * @param animationPool AnimationPool to keep animation states in
        */
-      inline void prepare(Ogre::SceneManager* sceneManager, ResourceManager* resourceManager, OgreObjectManager* objectManager) {
+      inline void prepare(Ogre::SceneManager* sceneManager, ResourceManager* resourceManager, OgreObjectManager* objectManager, TransformSnapshotBuffer* snapshots = 0, AnimationPool* animationPool = 0) {
         mSceneManager = sceneManager;
         mResourceManager = resourceManager;
         mObjectManager = objectManager;
+        mSnapshots = snapshots;
+        mAnimationPool = animationPool;
       }
       /**
        * Set render component position
@@ -183,7 +189,7 @@ namespace Gsage {
       /**
        * Sets animation state
        * @param name Animation name
-       * @returns true if state was found
+       * @returns true if state was found, always true if render system runs in the dedicated thread
        */
       bool setAnimationState(const std::string& name);
       /**
@@ -195,7 +201,7 @@ namespace Gsage {
        * @param offset Animation start offset
        * @param reset Starts animation immediately
        *
-       * @returns true if animation group exists
+       * @returns true if animation group exists, always true if render system runs in the dedicated thread
        */
       bool playAnimation(const std::string& name, int times = -1, double speed = 1, double offset = 0, bool reset = false);
       /**
@@ -226,6 +232,9 @@ namespace Gsage {
        *    }
        *
        * \endverbatim
+       *
+       * If the component has "prefab" defined, children are compiled once for all entities using the same prefab
+       * and the node tree is reused after the entity is removed.
        */
       void setRootNode(const DataProxy& value);
 
@@ -266,6 +275,22 @@ namespace Gsage {
        * Get resources
        */
       const DataProxy& getResources() const;
+
+      /**
+       * Get union of query flags of all movable objects in the node tree
+       */
+      unsigned int getQueryFlags();
+
+      /**
+       * Show or hide the node tree
+       * @param visible visibility
+       */
+      void setVisible(bool visible);
+
+      /**
+       * Check if the node tree is visible
+       */
+      bool isVisible() const;
     private:
       friend class OgreRenderSystem;
       bool mAddedToScene;
@@ -273,10 +298,17 @@ namespace Gsage {
       AnimationScheduler mAnimationScheduler;
       SceneNodeWrapper* mRootNode;
 
+      unsigned int mQueryFlags;
+      bool mQueryFlagsDirty;
+      bool mVisible;
+
+      std::string mPrefab;
       DataProxy mResources;
       Ogre::SceneManager* mSceneManager;
       ResourceManager* mResourceManager;
       OgreObjectManager* mObjectManager;
+      TransformSnapshotBuffer* mSnapshots;
+      AnimationPool* mAnimationPool;
   };
 }
 
@@ -150,6 +150,14 @@ namespace Gsage {
          */
         bool read(const DataProxy& dict);
 
+        /**
+         * Lua tables are read by the same overridden logic
+         */
+        bool read(const sol::table& props)
+        {
+          return read(DataProxy::create(props));
+        }
+
         /**
          * Set common up vector of the billboard
          * @param vector Vector3
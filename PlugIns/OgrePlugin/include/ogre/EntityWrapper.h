@@ -149,6 +149,11 @@ namespace Gsage {
       }
 #endif
     private:
+      /**
+       * Add entity to static batch if it has explicit static query and is not animated
+       */
+      void updateBatching();
+
       OgreV1::SkeletonAnimationBlendMode mAnimBlendMode;
 
       std::string mMeshName;
@@ -61,6 +61,12 @@ namespace Gsage {
         }
       }
 
+      void setOwnerId(const std::string& ownerId)
+      {
+        OgreObject::setOwnerId(ownerId);
+        defineUserBindings();
+      }
+
       void defineUserBindings()
       {
         if(mObject) {
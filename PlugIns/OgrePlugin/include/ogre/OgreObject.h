@@ -30,6 +30,8 @@ THE SOFTWARE.
 #include "OgreConverters.h"
 #include "Serializable.h"
 
+#include <atomic>
+
 namespace Ogre
 {
   class SceneNode;
@@ -97,6 +99,17 @@ namespace Gsage {
        */
       const std::string& getObjectId() const;
 
+      /**
+       * Get id of entity that owns the object
+       */
+      const std::string& getOwnerId() const;
+
+      /**
+       * Change owner of the object. Used when the object is reused for another entity
+       * @param ownerId Id of the new owner entity
+       */
+      virtual void setOwnerId(const std::string& ownerId);
+
       /**
        * Attach object to the parent node
        * @param object Object to attach
@@ -109,6 +122,17 @@ namespace Gsage {
        */
       virtual bool attach(Ogre::MovableObject* object, const DataProxy& params);
 
+      /**
+       * Mark the object tree changed: objects were attached, destroyed or changed query flags.
+       * The flag is stored in the root object of the tree
+       */
+      void setTreeDirty();
+
+      /**
+       * Check if the tree was changed since the last call and reset the flag
+       */
+      bool resetTreeDirty();
+
       /**
        * Generate unique name for the object.
        */
@@ -135,6 +159,8 @@ namespace Gsage {
 
       OgreObject* mParentObject;
       DataProxy mAttachParams;
+
+      std::atomic<bool> mTreeDirty;
   };
 }
 #endif
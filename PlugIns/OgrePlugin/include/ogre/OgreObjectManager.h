@@ -28,6 +28,7 @@ THE SOFTWARE.
 #define _OgreObjectManager_H_
 
 #include <map>
+#include <mutex>
 
 #include "Definitions.h"
 #include "GsageDefinitions.h"
@@ -46,6 +47,8 @@ namespace Ogre
 namespace Gsage {
   class OgreRenderSystem;
   class OgreObject;
+  class SceneNodeWrapper;
+  class Prefab;
 
   /**
    * Event related to factory lifecycle
@@ -132,6 +135,58 @@ namespace Gsage {
        */
       void destroy(OgreObject* object);
 
+      /**
+       * Create node tree from the prefab. Prefab is compiled from the dict children on the first spawn,
+       * next spawns with the same prefab name ignore the children definitions.
+       *
+       * @param prefab Prefab name
+       * @param dict Root node values
+       * @param owner Owner entity of the created objects
+       * @param sceneManager Ogre::SceneManager to create objects in
+       * @returns root node or 0 if failed
+       */
+      SceneNodeWrapper* spawn(const std::string& prefab, const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager);
+
+      /**
+       * Return node tree to the prefab pool
+       * @param root Root node, created by spawn
+       * @returns false if the node was not created from the prefab
+       */
+      bool despawn(SceneNodeWrapper* root);
+
+      /**
+       * Destroy all pooled prefab instances
+       */
+      void clearPrefabs();
+
+      /**
+       * Destroy pooled prefab instances despawned by the entity.
+       * Ogre 1.x objects can't be renamed, so they should be released before the entity
+       * with the same id creates another node tree. Does nothing on Ogre 2.x
+       *
+       * @param owner Owner entity id
+       * @param except Prefab, which instances are kept
+       */
+      void releasePooled(const std::string& owner, Prefab* except = 0);
+
+      /**
+       * Set max count of despawned instances to keep for each prefab
+       * @param size Pool size, 0 disables reuse
+       */
+      inline void setPrefabPoolSize(size_t size) { mPrefabPoolSize = size; }
+
+      /**
+       * Get prefab by name
+       * @param name Prefab name
+       * @returns 0 if the prefab was not compiled yet
+       */
+      Prefab* getPrefab(const std::string& name);
+
+      /**
+       * Prefab instance is being created, objects should not create children from the definitions
+       */
+      inline bool isSpawning() const { return mSpawning; }
+
       /**
        * Register new element type, so factory will be able to create it
        * @param type String type representation
@@ -163,6 +218,7 @@ namespace Gsage {
         if(mObjects.count(type) == 0)
           return false; // no such type registered
 
+        clearPrefabs();
         fireEvent(OgreObjectManagerEvent(OgreObjectManagerEvent::FACTORY_UNREGISTERED, type));
         delete mObjects[type];
         mObjects.erase(type);
@@ -230,6 +286,15 @@ namespace Gsage {
 
       OgreRenderSystem* mRenderSystem;
 
+      typedef std::map<std::string, Prefab*> Prefabs;
+      Prefabs mPrefabs;
+
+      // root node -> prefab it was spawned from
+      std::map<SceneNodeWrapper*, Prefab*> mSpawned;
+      std::mutex mPrefabsMutex;
+      size_t mPrefabPoolSize;
+      bool mSpawning;
+
   };
 }
 #endif
@@ -50,6 +50,14 @@ namespace Gsage {
        */
       bool read(const DataProxy& dict);
 
+      /**
+       * Lua tables are read by the same overridden logic
+       */
+      bool read(const sol::table& props)
+      {
+        return read(DataProxy::create(props));
+      }
+
       /**
        * Set particle system template. Note that it requires particle system recreation
        * @param templateName Template name
@@ -0,0 +1,146 @@
+#ifndef _Prefab_H_
+#define _Prefab_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "DataProxy.h"
+
+namespace Ogre
+{
+  class SceneManager;
+}
+
+namespace Gsage {
+  class OgreObject;
+  class OgreObjectManager;
+  class SceneNodeWrapper;
+
+  /**
+   * Node tree of the render component, compiled into the flat list of object creation instructions.
+   *
+   * Children definitions are walked only once, so spawning an instance does not traverse nested dicts
+   * and does not diff the children collections. Despawned instances are detached from the scene
+   * and kept in the pool, the next spawn reuses them instead of creating Ogre objects again.
+   */
+  class Prefab
+  {
+    public:
+      /**
+       * @param objectManager OgreObjectManager to create objects with
+       * @param name Prefab name
+       * @param children Root node children definitions
+       */
+      Prefab(OgreObjectManager* objectManager, const std::string& name, const DataProxy& children);
+      virtual ~Prefab();
+
+      /**
+       * Create root node and replay all instructions, or reuse pooled instance
+       * @param dict Root node values, children definitions are ignored
+       * @param owner Owner entity id
+       * @param sceneManager Ogre::SceneManager to create objects in
+       * @returns root node or 0 if failed
+       */
+      SceneNodeWrapper* spawn(const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager);
+
+      /**
+       * Return instance to the pool, the instance is destroyed if the pool is full
+       * @param root Root node of the instance
+       * @param poolSize Max count of pooled instances
+       * @returns false if the instance does not belong to the prefab
+       */
+      bool despawn(SceneNodeWrapper* root, size_t poolSize);
+
+      /**
+       * Destroy all pooled instances
+       */
+      void clear();
+
+      /**
+       * Destroy pooled instances, which were despawned by the entity
+       * @param owner Owner entity id
+       * @returns count of destroyed instances
+       */
+      size_t release(const std::string& owner);
+
+      /**
+       * Get prefab name
+       */
+      inline const std::string& getName() const { return mName; }
+
+      /**
+       * Get count of compiled instructions
+       */
+      inline size_t getInstructionCount() const { return mInstructions.size(); }
+
+      /**
+       * Get count of pooled instances
+       */
+      size_t getPooledCount();
+    private:
+      struct Instruction {
+        // index of the parent node instruction, -1 is the root node
+        int parent;
+        std::string type;
+        DataProxy props;
+        bool named;
+      };
+
+      struct Instance {
+        SceneNodeWrapper* root;
+        // objects created for each instruction, 0 if creation failed
+        std::vector<OgreObject*> objects;
+      };
+
+      void compile(const DataProxy& children, int parent);
+
+      void destroy(Instance& instance);
+
+      bool acquire(const std::string& owner, Instance& instance);
+
+      void create(Instance& instance, const std::string& owner, Ogre::SceneManager* sceneManager);
+
+      void reuse(Instance& instance, const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager);
+
+      typedef std::vector<Instruction> Instructions;
+      Instructions mInstructions;
+
+      typedef std::map<SceneNodeWrapper*, Instance> Instances;
+      Instances mInstances;
+
+      std::vector<Instance> mPool;
+      std::mutex mMutex;
+
+      OgreObjectManager* mObjectManager;
+      std::string mName;
+  };
+}
+
+#endif
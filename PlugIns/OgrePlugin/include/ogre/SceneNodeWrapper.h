@@ -172,6 +172,20 @@ namespace Gsage {
        */
       OgreObject* getChild(const std::string& type, const std::string& name, bool traverse = false);
 
+      /**
+       * Register child, that was created outside of the children definitions
+       * @param type Type of the child
+       * @param name Child object id
+       * @param object Child object
+       */
+      void addChild(const std::string& type, const std::string& name, OgreObject* object);
+
+      /**
+       * Generate unique id for the child, which has no name defined
+       * @param type Type of the child
+       */
+      static std::string generateChildId(const std::string& type);
+
       /**
        * Get child of specific type
        * @param type Type of the child
@@ -238,6 +252,11 @@ namespace Gsage {
        */
       bool onFactoryUnregister(EventDispatcher* sender, const Event& event);
 
+      /**
+       * Rebuild static batches of the objects attached to this node or to its descendants
+       */
+      void notifyMoved();
+
       std::string mId;
 
       Ogre::Vector3 mOrientationVector;
@@ -90,6 +90,11 @@ namespace Gsage {
        */
       const std::string& getDatablock() const;
     private:
+      /**
+       * Add item to static batch if it has explicit static query and is not animated
+       */
+      void updateBatching();
+
       std::string mMeshName;
       std::string mDatablock;
       std::string mQueryString;
@@ -49,6 +49,10 @@ THE SOFTWARE.
 #include "ThreadSafeQueue.h"
 #include "ObjectMutation.h"
 #include "ManualTextureManager.h"
+#include "TransformSnapshot.h"
+#include "AnimationPool.h"
+#include "SpatialIndex.h"
+#include "StaticBatcher.h"
 
 #include "Definitions.h"
 #if OGRE_VERSION >= 0x020100
@@ -78,6 +82,7 @@ namespace Gsage
   class Engine;
   class EngineEvent;
   class MaterialLoader;
+  class MeshCollisionCache;
   class OgreInteractionManager;
   class WindowEventListener;
 
@@ -154,6 +159,11 @@ namespace Gsage
        */
       virtual bool removeComponent(OgreRenderComponent* component);
 
+      /**
+       * Remove all render components
+       */
+      virtual void unloadComponents();
+
       /**
        * Reconfigure render system
        *
@@ -283,9 +293,11 @@ namespace Gsage
       OgreEntities getEntities(const unsigned int& query = 0xFF);
 
       /**
-       * Get objects in radius
+       * Get objects in radius, entities are matched by the root node position using engine spatial index
        * @param position Point to search around
        * @param distance Radius of the sphere query
+       * @param flags Query flags
+       * @param id Only get entity with this id
        * @returns list of entities
        */
       Entities getObjectsInRadius(const Ogre::Vector3& center, float distance, const unsigned int flags = 0xFF, const std::string& id = "");
@@ -396,6 +408,16 @@ namespace Gsage
        * Gets object manager
        */
       inline OgreObjectManager* getObjectManager() { return &mObjectManager; }
+
+      /**
+       * Get static entities batcher
+       */
+      inline StaticBatcher* getStaticBatcher() { return &mStaticBatcher; }
+
+      /**
+       * Get time, spent on the last scene graph update, in seconds
+       */
+      inline double getSceneGraphUpdateTime() const { return mSceneGraphUpdateTime; }
     protected:
       /**
        * Handle window resizing
@@ -404,6 +426,45 @@ namespace Gsage
        */
       bool handleWindowResized(EventDispatcher* sender, const Event& event);
 
+      /**
+       * Publish transforms written during the last frame, when the system runs in the dedicated thread
+       * @param sender Engine
+       * @param event EngineEvent
+       */
+      bool handleEngineUpdate(EventDispatcher* sender, const Event& event);
+
+      /**
+       * Refresh positions of all components in the engine spatial index
+       */
+      void updateSpatialIndex();
+
+      /**
+       * Destroy component node tree and remove it from the storage
+       *
+       * @param component OgreRenderComponent to destroy
+       */
+      void destroyComponent(OgreRenderComponent* component);
+
+      /**
+       * Destroy component node tree and unload resources, the component itself is kept in the storage
+       *
+       * @param component OgreRenderComponent to release
+       */
+      void releaseComponent(OgreRenderComponent* component);
+
+      /**
+       * Check if component animations should not be applied to Ogre this frame
+       *
+       * @param component OgreRenderComponent to check
+       * @returns true if the component is outside of the camera frustum or further than animation LOD distance
+       */
+      bool isAnimationCulled(OgreRenderComponent* component);
+
+      /**
+       * Pass camera position and frustum to the engine update LOD
+       */
+      void updateViewer();
+
       bool installPlugin(const std::string& name);
 
       GeomPtr getGeometry(OgreEntities entities);
@@ -425,6 +486,7 @@ namespace Gsage
 
       ResourceManager* mResourceManager;
       MaterialLoader* mMaterialLoader;
+      MeshCollisionCache* mMeshCollisionCache;
 
       typedef std::queue<DataProxy> ComponentLoadQueue;
       ComponentLoadQueue mLoadQueue;
@@ -450,6 +512,19 @@ namespace Gsage
 #endif
       ThreadSafeQueue<ObjectMutation> mMutationQueue;
 
+      TransformSnapshotBuffer mSnapshots;
+      // frame time the dedicated thread is paced to
+      double mTargetFrameTime;
+
+      AnimationPool mAnimationPool;
+      float mAnimationLodDistance;
+      float mAnimationCullRadius;
+
+      SpatialIndex::Planes mViewerPlanes;
+
+      StaticBatcher mStaticBatcher;
+      double mSceneGraphUpdateTime;
+
       ManualTextureManager mManualTextureManager;
   };
 }
@@ -0,0 +1,229 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "AnimationPool.h"
+
+#include <OgreAnimationState.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace Gsage {
+
+  // spawning threads is not worth it for smaller counts
+  static const size_t PARALLEL_ANIMATIONS_THRESHOLD = 1 << 12;
+
+  const AnimationPool::Handle AnimationPool::INVALID_HANDLE = (AnimationPool::Handle)-1;
+
+  static inline float wrapTime(float value, float length, bool loop)
+  {
+    if(loop) {
+      if(length <= 0) {
+        return 0;
+      }
+      value = std::fmod(value, length);
+      return value < 0 ? value + length : value;
+    }
+    return std::min(std::max(value, 0.0f), length);
+  }
+
+  AnimationPool::AnimationPool()
+  {
+  }
+
+  AnimationPool::~AnimationPool()
+  {
+  }
+
+  AnimationPool::Handle AnimationPool::create(OgreV1::AnimationState* state, float length)
+  {
+    Handle handle;
+    if(mFree.empty()) {
+      handle = mFlags.size();
+      mStates.push_back(0);
+      mTime.push_back(0);
+      mLength.push_back(0);
+      mSpeed.push_back(0);
+      mWeight.push_back(0);
+      mFadeRate.push_back(0);
+      mFlags.push_back(0);
+    } else {
+      handle = mFree.back();
+      mFree.pop_back();
+    }
+
+    mStates[handle] = state;
+    mTime[handle] = 0;
+    mLength[handle] = length;
+    mSpeed[handle] = 1;
+    mWeight[handle] = 0;
+    mFadeRate[handle] = DEFAULT_FADE_SPEED;
+    mFlags[handle] = Dirty;
+    return handle;
+  }
+
+  void AnimationPool::destroy(Handle handle)
+  {
+    if(handle >= mFlags.size()) {
+      return;
+    }
+
+    mStates[handle] = 0;
+    mFlags[handle] = 0;
+    mFree.push_back(handle);
+  }
+
+  void AnimationPool::setTime(Handle handle, float value)
+  {
+    mTime[handle] = wrapTime(value, mLength[handle], (mFlags[handle] & Loop) != 0);
+    mFlags[handle] |= Dirty;
+  }
+
+  void AnimationPool::setFlags(Handle handle, unsigned char flags, bool value)
+  {
+    if(value) {
+      mFlags[handle] |= flags;
+    } else {
+      mFlags[handle] &= ~flags;
+    }
+
+    if(flags & Loop) {
+      // Ogre rewraps time position only on the next time change
+      mTime[handle] = wrapTime(mTime[handle], mLength[handle], value);
+    }
+    mFlags[handle] |= Dirty;
+  }
+
+  void AnimationPool::fade(Handle handle, bool in, float rate)
+  {
+    unsigned char& flags = mFlags[handle];
+    flags &= ~(FadeIn | FadeOut);
+    flags |= (in ? FadeIn : FadeOut) | Dirty;
+    mFadeRate[handle] = rate;
+  }
+
+  void AnimationPool::update(float time, int threads)
+  {
+    size_t count = mFlags.size();
+    if(threads <= 0) {
+      threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    threads = (int)std::min((size_t)threads, std::max((size_t)1, count / PARALLEL_ANIMATIONS_THRESHOLD));
+    if(threads <= 1) {
+      advance(0, count, time);
+      return;
+    }
+
+    // each slot is independent, so ranges are split between threads as is
+    std::vector<std::thread> workers;
+    size_t perThread = (count + threads - 1) / threads;
+    for(size_t start = perThread; start < count; start += perThread) {
+      workers.emplace_back(&AnimationPool::advance, this, start, std::min(start + perThread, count), time);
+    }
+
+    advance(0, std::min(perThread, count), time);
+
+    for(auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  void AnimationPool::update(Handle handle, float time)
+  {
+    advance(handle, handle + 1, time);
+  }
+
+  void AnimationPool::advance(size_t start, size_t end, float time)
+  {
+    float* timePositions = mTime.data();
+    const float* lengths = mLength.data();
+    const float* speeds = mSpeed.data();
+    float* weights = mWeight.data();
+    float* fadeRates = mFadeRate.data();
+    unsigned char* flags = mFlags.data();
+
+    for(size_t i = start; i < end; ++i) {
+      unsigned char f = flags[i];
+      if((f & Enabled) == 0) {
+        continue;
+      }
+
+      bool loop = (f & Loop) != 0;
+      float length = lengths[i];
+      float speed = speeds[i];
+      float position = wrapTime(timePositions[i] + time * speed, length, loop);
+
+      // finite animations start fading out right before the end
+      if(!loop) {
+        float delta = length * 0.1f;
+        if((speed > 0 && position > length - delta) || (speed < 0 && position < delta)) {
+          f = (f & ~FadeIn) | FadeOut;
+          fadeRates[i] = DEFAULT_FADE_SPEED;
+        }
+      }
+
+      if(f & FadeIn) {
+        float weight = weights[i] + time * fadeRates[i];
+        weights[i] = std::min(std::max(weight, 0.0f), 1.0f);
+        if(weight >= 1) {
+          f &= ~FadeIn;
+        }
+      } else if(f & FadeOut) {
+        float weight = weights[i] - time * fadeRates[i];
+        weights[i] = std::min(std::max(weight, 0.0f), 1.0f);
+        if(weight <= 0) {
+          f &= ~(FadeOut | Enabled);
+          position = wrapTime(length, length, loop);
+        }
+      }
+
+      timePositions[i] = position;
+      flags[i] = f | Dirty;
+    }
+  }
+
+  void AnimationPool::apply()
+  {
+    for(size_t i = 0; i < mFlags.size(); ++i) {
+      unsigned char f = mFlags[i];
+      OgreV1::AnimationState* state = mStates[i];
+      if(!state || (f & Dirty) == 0 || (f & Culled) != 0) {
+        continue;
+      }
+
+      bool enabled = (f & Enabled) != 0;
+      // enabling the state relinks it in the parent set, so it is done only on change
+      if(state->getEnabled() != enabled) {
+        state->setEnabled(enabled);
+      }
+      state->setLoop((f & Loop) != 0);
+      state->setTimePosition(mTime[i]);
+      state->setWeight(mWeight[i]);
+      mFlags[i] = f & ~Dirty;
+    }
+  }
+}
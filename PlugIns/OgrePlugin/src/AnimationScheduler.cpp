@@ -40,10 +40,8 @@ namespace Gsage {
   // --------------------------------------------------------------------------------
 
   Animation::Animation()
-    : mAnimationState(0)
-    , mFadeIn(false)
-    , mFadeOut(false)
-    , mSpeed(1)
+    : mPool(0)
+    , mHandle(AnimationPool::INVALID_HANDLE)
   {
 
   }
@@ -53,149 +51,135 @@ namespace Gsage {
 
   }
 
-  void Animation::initialize(OgreV1::AnimationState* state)
+  void Animation::initialize(AnimationPool* pool, OgreV1::AnimationState* state)
   {
-    mAnimationState = state;
-    mAnimationState->setWeight(0);
+    mPool = pool;
+    mHandle = mPool->create(state, state->getLength());
   }
 
-  void Animation::update(double time)
+  void Animation::release()
   {
-    if(!isInitialized() || !mAnimationState->getEnabled())
+    if(!isInitialized())
       return;
 
-    float len = getLength();
-    mAnimationState->addTime(time * mSpeed);
+    mPool->destroy(mHandle);
+    mPool = 0;
+    mHandle = AnimationPool::INVALID_HANDLE;
+  }
 
-    // TODO: Add ability to customize fade out speed
-    if(!getLoop())
-    {
-      double delta = len * 0.1f;
-      if(mSpeed > 0 && getTimePosition() > (len - delta))
-        disable();
-      else if(mSpeed < 0 && getTimePosition() < delta)
-        disable();
-    }
+  void Animation::update(double time)
+  {
+    if(!isInitialized())
+      return;
 
-    if(mFadeIn)
-    {
-      float newWeight = mAnimationState->getWeight() + time * mFadeTime;
-      mAnimationState->setWeight(Ogre::Math::Clamp<float>(newWeight, 0, 1));
-      if(newWeight >= 1)
-        mFadeIn = false;
-    }
-    else if(mFadeOut)
-    {
-      float newWeight = mAnimationState->getWeight() - time * mFadeTime;
-      mAnimationState->setWeight(Ogre::Math::Clamp<float>(newWeight, 0, 1));
-      if(newWeight <= 0)
-      {
-        mFadeOut = false;
-        mAnimationState->setEnabled(false);
-        setTimePosition(getLength());
-      }
-    }
+    mPool->update(mHandle, time);
   }
 
   void Animation::enable(double time)
   {
-    mFadeIn = true;
-    mFadeOut = false;
-
-    mFadeTime = (float)time;
+    if(!isInitialized())
+      return;
 
+    mPool->fade(mHandle, true, time);
     setEnabled(true);
   }
 
   void Animation::disable(double time)
   {
-    mFadeIn = false;
-    mFadeOut = true;
+    if(!isInitialized())
+      return;
 
-    mFadeTime = (float)time;
+    mPool->fade(mHandle, false, time);
   }
 
   float Animation::getTimePosition()
   {
-    return mAnimationState->getTimePosition();
+    return mPool->getTime(mHandle);
   }
 
   void Animation::setTimePosition(double value)
   {
-    mAnimationState->setTimePosition(value);
+    mPool->setTime(mHandle, value);
   }
 
   float Animation::getLength()
   {
-    return mAnimationState->getLength();
+    return mPool->getLength(mHandle);
   }
 
   bool Animation::getEnabled()
   {
-    return isInitialized() && mAnimationState->getEnabled();
+    return isInitialized() && mPool->hasFlags(mHandle, AnimationPool::Enabled);
   }
 
   void Animation::setEnabled(bool value)
   {
     if(isInitialized())
     {
-      mAnimationState->setEnabled(value);
+      mPool->setFlags(mHandle, AnimationPool::Enabled, value);
     }
   }
 
   bool Animation::getLoop()
   {
-    return mAnimationState->getLoop();
+    return mPool->hasFlags(mHandle, AnimationPool::Loop);
   }
 
   void Animation::setLoop(bool value)
   {
-    mAnimationState->setLoop(value);
+    mPool->setFlags(mHandle, AnimationPool::Loop, value);
   }
 
   bool Animation::hasEnded()
   {
-    return mAnimationState->hasEnded();
-
+    return !getLoop() && getTimePosition() >= getLength();
   }
 
   double Animation::getSpeed()
   {
-    return mSpeed;
+    return isInitialized() ? mPool->getSpeed(mHandle) : 1;
   }
 
   void Animation::setSpeed(float value)
   {
-    mSpeed = value;
+    if(isInitialized())
+      mPool->setSpeed(mHandle, value);
   }
 
   bool Animation::isInitialized()
   {
-    return mAnimationState != 0;
+    return mPool != 0;
   }
 
   bool Animation::isEnding()
   {
-    return isInitialized() && !getLoop() && mFadeOut;
+    return isInitialized() && !getLoop() && isFadingOut();
   }
 
   bool Animation::isFadingOut()
   {
-    return mFadeOut;
+    return isInitialized() && mPool->hasFlags(mHandle, AnimationPool::FadeOut);
   }
 
   void Animation::rewind(double offset)
   {
-    setTimePosition(mSpeed > 0 ? offset : getLength() - offset);
+    setTimePosition(getSpeed() > 0 ? offset : getLength() - offset);
+  }
+
+  void Animation::setCulled(bool value)
+  {
+    if(isInitialized())
+      mPool->setFlags(mHandle, AnimationPool::Culled, value);
   }
 
   // --------------------------------------------------------------------------------
   // AnimationGroup
   // --------------------------------------------------------------------------------
 
-  AnimationGroup::AnimationGroup(OgreRenderComponent* c)
+  AnimationGroup::AnimationGroup(OgreRenderComponent* c, AnimationPool* pool)
     : mSpeed(1)
     , mRenderComponent(c)
+    , mPool(pool)
   {
 
   }
@@ -252,11 +236,19 @@ namespace Gsage {
       }
 
       LOG(TRACE) << "Adding animation " << fullId << " to group " << pair.first;
-      mAnimations[pair.first].initialize(e->getAnimationState(id[1]));
+      mAnimations[pair.first].initialize(mPool, e->getAnimationState(id[1]));
     }
     return true;
   }
 
+  void AnimationGroup::release()
+  {
+    for(auto& pair : mAnimations)
+    {
+      pair.second.release();
+    }
+  }
+
   double AnimationGroup::getSpeed()
   {
     return mSpeed;
@@ -335,6 +327,8 @@ namespace Gsage {
     , mDefaultAnimationSpeed(1)
     , mSceneManager(0)
     , mRenderComponent(0)
+    , mPool(0)
+    , mCulled(false)
   {
     BIND_PROPERTY("defaultState", &mDefaultAnimation);
     BIND_PROPERTY("defaultSpeed", &mDefaultAnimationSpeed);
@@ -351,10 +345,11 @@ namespace Gsage {
     mRenderComponent = c;
   }
 
-  bool AnimationScheduler::initialize(const DataProxy& dict, Ogre::SceneManager* sceneManager, OgreRenderComponent* c)
+  bool AnimationScheduler::initialize(const DataProxy& dict, Ogre::SceneManager* sceneManager, OgreRenderComponent* c, AnimationPool* pool)
   {
     mRenderComponent = c;
     mSceneManager = sceneManager;
+    mPool = pool;
     read(dict);
     playDefaultAnimation();
     return mInitialized = mAnimationGroups.size() > 0;
@@ -468,54 +463,92 @@ namespace Gsage {
 
   void AnimationScheduler::update(double time)
   {
-    for(auto& pair : mAnimationGroups)
+    for(auto& track : mTracks)
     {
-      for(auto& anim : pair.second.mAnimations)
-      {
+      Animation& anim = *track.animation;
+      AnimationQueue& queue = *track.queue;
+      bool queued = !queue.empty() && queue.front() == anim;
+      if(!anim.getEnabled() && !queued)
+        continue;
 
-        AnimationQueue& queue = mAnimationQueues[anim.first];
-        if(!anim.second.getEnabled() && !isQueued(anim.first, anim.second))
+      if(anim.isEnding() || anim.hasEnded())
+      {
+        if(!queued)
           continue;
 
-        anim.second.update(time);
-        if(anim.second.isEnding() || anim.second.hasEnded())
+        // ended limited animation, remove from queue
+        queue.pop();
+        if(!queue.empty())
+        {
+          queue.front().start();
+        }
+        else if(!mCurrentAnimation.empty())
         {
-          if(!isQueued(anim.first, anim.second))
-            continue;
-
-          // ended limited animation, remove from queue
-          queue.pop();
-          if(!queue.empty())
-          {
-            queue.front().start();
-          }
-          else if(!mCurrentAnimation.empty())
-          {
-            play(mCurrentAnimation);
-          }
+          play(mCurrentAnimation);
         }
       }
     }
   }
 
-  void AnimationScheduler::setStates(const DataProxy& dict)
+  void AnimationScheduler::setCulled(bool value)
   {
-    mAnimationStatesDict = dict;
+    if(mCulled == value)
+      return;
+
+    for(auto& track : mTracks)
+    {
+      track.animation->setCulled(value);
+    }
+    mCulled = value;
+  }
+
+  void AnimationScheduler::release()
+  {
+    for(auto& pair : mAnimationGroups)
+    {
+      pair.second.release();
+    }
+    mAnimationGroups.clear();
     mAnimations.clear();
     mAnimationQueues.clear();
+    mTracks.clear();
+  }
+
+  void AnimationScheduler::setStates(const DataProxy& dict)
+  {
+    release();
+    mAnimationStatesDict = dict;
+    if(!mPool)
+    {
+      LOG(ERROR) << "Failed to set animation states: animation pool is not defined";
+      return;
+    }
+
     // get all entities anim states
     for(auto& pair : dict)
     {
-      AnimationGroup group(mRenderComponent);
+      AnimationGroup group(mRenderComponent, mPool);
       if(!group.initialize(pair.second, mSceneManager))
       {
         LOG(ERROR) << "Failed to initialize animation group \"" << pair.first << "\", skipped";
+        group.release();
         continue;
       }
 
       mAnimationGroups[pair.first] = group;
       LOG(TRACE) << "Initialized animation group \"" << pair.first << "\"";
     }
+
+    // queues are created upfront, map nodes are stable, so pointers stay valid
+    for(auto& pair : mAnimationGroups)
+    {
+      for(auto& anim : pair.second.mAnimations)
+      {
+        Track track = {&anim.second, &mAnimationQueues[anim.first]};
+        mTracks.push_back(track);
+      }
+    }
+    mCulled = false;
   }
 
   const DataProxy& AnimationScheduler::getStates() const
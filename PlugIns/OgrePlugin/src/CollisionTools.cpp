@@ -27,6 +27,8 @@
 #include "CollisionTools.h"
 #include "Logger.h"
 #include "MeshTools.h"
+#include "MeshCollisionCache.h"
+#include <algorithm>
 
 namespace MOC {
 
@@ -46,6 +48,7 @@ namespace MOC {
     mTerrainInfo = terrainInfo;
 
     _heightAdjust = 0.0f;
+    mStaticBatcher = NULL;
   }
 #endif
 
@@ -64,6 +67,7 @@ namespace MOC {
     mTSMRaySceneQuery =  mSceneMgr->createRayQuery(Ogre::Ray());
 
     _heightAdjust = 0.0f;
+    mStaticBatcher = NULL;
   }
 
   CollisionTools::~CollisionTools()
@@ -232,12 +236,7 @@ namespace MOC {
 #if OGRE_VERSION < 0x020100
       mRaySceneQuery->setQueryTypeMask(Ogre::SceneManager::FX_TYPE_MASK | Ogre::SceneManager::ENTITY_TYPE_MASK);
 #endif
-      // execute the query, returns a vector of hits
-      if (mRaySceneQuery->execute().size() <= 0)
-      {
-        // raycast did not hit an objects bounding box
-        return (false);
-      }
+      mRaySceneQuery->execute();
     }
     else
     {
@@ -252,7 +251,36 @@ namespace MOC {
     // we need to test every triangle of every object.
     closest_distance = -1.0f;
     Ogre::Vector3 closest_result;
-    Ogre::RaySceneQueryResult &query_result = mRaySceneQuery->getLastResults();
+    Gsage::StaticBatcher::RayHits hits;
+    if (mStaticBatcher)
+      mStaticBatcher->queryRay(ray, queryMask, hits);
+
+    // scene query results are copied only to merge batched objects into them
+    Ogre::RaySceneQueryResult merged;
+    if (!hits.empty())
+    {
+      merged = mRaySceneQuery->getLastResults();
+      for (auto& hit : hits)
+      {
+        Ogre::RaySceneQueryResultEntry entry;
+        entry.distance = hit.first;
+        entry.movable = hit.second;
+#if OGRE_VERSION < 0x020100
+        entry.worldFragment = NULL;
+#endif
+        merged.push_back(entry);
+      }
+      std::sort(merged.begin(), merged.end());
+    }
+
+    Ogre::RaySceneQueryResult &query_result = hits.empty() ? mRaySceneQuery->getLastResults() : merged;
+
+    if (query_result.empty())
+    {
+      // raycast did not hit an objects bounding box
+      return (false);
+    }
+
     for (size_t qr_idx = 0; qr_idx < query_result.size(); qr_idx++)
     {
       // stop checking if we have found a raycast hit that is closer
@@ -275,11 +303,38 @@ namespace MOC {
         Ogre::MeshTools* mt = Ogre::MeshTools::getSingletonPtr();
         Ogre::MeshInformation info;
 
-        // closest object is an entity
-        if(mt->getMeshInformation(pentity, info,
-          pentity->getParentNode()->_getDerivedPosition(),
-          pentity->getParentNode()->_getDerivedOrientation(),
-          pentity->getParentNode()->_getDerivedScale())) {
+        Ogre::Matrix4 transform;
+        if (!getWorldTransform(pentity, transform))
+          continue;
+
+        Ogre::Vector3 position;
+        Ogre::Vector3 scale;
+        Ogre::Quaternion orientation;
+        transform.decomposition(position, scale, orientation);
+
+        Gsage::MeshCollisionCache* cache = Gsage::MeshCollisionCache::getSingletonPtr();
+        Gsage::TriangleBVHPtr bvh = cache ? cache->get(pentity) : nullptr;
+
+        if(bvh) {
+          // bring the ray to the mesh local space, direction is not normalized
+          // so the distance along it stays in world units
+          Ogre::Matrix4 inverse = transform.inverseAffine();
+          Ogre::Matrix3 linear;
+          transform.extract3x3Matrix(linear);
+
+          Ogre::Real distance;
+          if(bvh->intersect(
+                inverse.transformAffine(ray.getOrigin()),
+                inverse.transformDirectionAffine(ray.getDirection()),
+                distance,
+                // mirrored transform flips triangles winding
+                linear.Determinant() < 0 ? Gsage::TriangleBVH::CULL_FRONT : Gsage::TriangleBVH::CULL_BACK,
+                closest_distance >= 0.0f ? closest_distance : std::numeric_limits<Ogre::Real>::max()))
+          {
+            closest_distance = distance;
+            new_closest_found = true;
+          }
+        } else if(mt->getMeshInformation(pentity, info, position, orientation, scale)) {
 
           for (size_t i = 0; i < info.indexCount; i += 3)
           {
@@ -306,9 +361,7 @@ namespace MOC {
           Ogre::AxisAlignedBox aabb(box.getMinimum(), box.getMaximum());
 #else
           Ogre::AxisAlignedBox aabb = pentity->getBoundingBox();
-          Ogre::Node* node = pentity->getParentNode();
-          if(node)
-            aabb.transformAffine(node->_getFullTransform());
+          aabb.transformAffine(transform);
 #endif
           std::pair<bool, Ogre::Real> hit = ray.intersects(aabb);
           if (hit.first) {
@@ -346,6 +399,20 @@ namespace MOC {
     }
   }
 
+  size_t CollisionTools::raycast(const std::vector<Ogre::Ray> &rays, RaycastHits &results, const Ogre::uint32 queryMask)
+  {
+    size_t count = 0;
+    results.resize(rays.size());
+    for(size_t i = 0; i < rays.size(); ++i) {
+      RaycastHit& hit = results[i];
+      hit.hit = raycast(rays[i], hit.point, hit.target, hit.distance, queryMask);
+      if(hit.hit) {
+        count++;
+      }
+    }
+    return count;
+  }
+
   void CollisionTools::setHeightAdjust(const float heightadjust) {
     _heightAdjust = heightadjust;
   }
@@ -354,4 +421,18 @@ namespace MOC {
     return _heightAdjust;
   }
 
+  void CollisionTools::setStaticBatcher(Gsage::StaticBatcher* batcher) {
+    mStaticBatcher = batcher;
+  }
+
+  bool CollisionTools::getWorldTransform(Ogre::MovableObject* object, Ogre::Matrix4& dest) {
+    Ogre::Node* node = object->getParentNode();
+    if (node) {
+      dest = node->_getFullTransform();
+      return true;
+    }
+
+    return mStaticBatcher && mStaticBatcher->getTransform(object, dest);
+  }
+
 };
@@ -79,7 +79,7 @@ namespace Gsage {
 
       lua.new_usertype<OgreObject>("OgreObject",
           sol::base_classes, sol::bases<Reflection>(),
-          "props", sol::property(&SceneNodeWrapper::getProps, &SceneNodeWrapper::setProps),
+          "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
           "type", sol::property(&OgreObject::getType),
           "name", sol::property(&OgreObject::getObjectId)
       );
@@ -87,7 +87,7 @@ namespace Gsage {
       lua.new_usertype<SceneNodeWrapper>(
           "OgreSceneNode",
           sol::base_classes, sol::bases<OgreObject>(),
-          "props", sol::property(&SceneNodeWrapper::getProps, &SceneNodeWrapper::setProps),
+          "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
           "orientation", sol::property(&SceneNodeWrapper::setOrientation, &SceneNodeWrapper::getOrientation),
           "scale", sol::property(&SceneNodeWrapper::setScale, &SceneNodeWrapper::getScale),
           "position", sol::property(&SceneNodeWrapper::setPosition, &SceneNodeWrapper::getPosition),
@@ -178,6 +178,12 @@ namespace Gsage {
 
       // Systems
 
+      lua.new_usertype<StaticBatcher>("StaticBatcher",
+          "new", sol::no_constructor,
+          "batchCount", sol::property(&StaticBatcher::getBatchCount),
+          "batchedCount", sol::property(&StaticBatcher::getBatchedCount)
+      );
+
       lua.new_usertype<OgreRenderSystem>("OgreRenderSystem",
           sol::base_classes, sol::bases<EngineSystem, RenderSystem>(),
           "configure", &OgreRenderSystem::configure,
@@ -196,7 +202,9 @@ namespace Gsage {
           "createTexture", &OgreRenderSystem::createTexture,
           "getTexture", &OgreRenderSystem::getTexture,
           "deleteTexture", &OgreRenderSystem::deleteTexture,
-          "getRenderer", &OgreRenderSystem::getRenderSystem
+          "getRenderer", &OgreRenderSystem::getRenderSystem,
+          "staticBatcher", sol::property(&OgreRenderSystem::getStaticBatcher),
+          "sceneGraphUpdateTime", sol::property(&OgreRenderSystem::getSceneGraphUpdateTime)
       );
 
       lua["ogre"] = lua.create_table();
@@ -275,7 +283,7 @@ namespace Gsage {
 
       lua.new_usertype<OgreRenderComponent>("OgreRenderComponent",
           sol::base_classes, sol::bases<EventDispatcher, Reflection>(),
-          "props", sol::property(&OgreRenderComponent::getProps, &OgreRenderComponent::setProps),
+          "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
           "position", sol::property((void(OgreRenderComponent::*)(const Ogre::Vector3&))&OgreRenderComponent::setPosition, &OgreRenderComponent::getOgrePosition),
           "root", sol::property(&OgreRenderComponent::getRoot),
           "direction", sol::property(&OgreRenderComponent::getOgreDirection),
@@ -284,6 +292,7 @@ namespace Gsage {
             &OgreRenderComponent::getOgreOrientation
           ),
           "facingOrientation", sol::property(&OgreRenderComponent::getOgreFaceOrientation),
+          "visible", sol::property(&OgreRenderComponent::setVisible, &OgreRenderComponent::isVisible),
           "lookAt", sol::overload(
             (void(OgreRenderComponent::*)(const Ogre::Vector3&, const Geometry::RotationAxis, Geometry::TransformSpace))&OgreRenderComponent::lookAt,
             (void(OgreRenderComponent::*)(const Ogre::Vector3&))&OgreRenderComponent::lookAt
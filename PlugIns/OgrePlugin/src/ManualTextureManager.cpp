@@ -239,40 +239,26 @@ namespace Gsage {
 
   void OgreTexture::update(const void* buffer, size_t size, int width, int height, const Rect<int>& area)
   {
-    std::lock_guard<std::mutex> lock(mLock);
-    int pixelSize = size / (width * height);
-
-    if(mSize < size) {
-      allocateBuffer(size);
-    }
-
-    mBufferWidth = width;
-    mBufferHeight = height;
-    mSize = size;
-    mScalingPolicy->update(width, height);
-
-    size_t textureRowWidth = width * pixelSize;
-
-    size_t start = area.x * pixelSize + textureRowWidth * area.y;
-    size_t end = std::min(mSize, start + textureRowWidth * area.height);
-    size_t areaRowSize = area.width * pixelSize;
+    write(buffer, size, width, height, &area, 1);
+  }
 
-    char* src = (char*)buffer;
+  void OgreTexture::update(const void* buffer, size_t size, int width, int height, const std::vector<Rect<int>>& areas)
+  {
+    write(buffer, size, width, height, areas.data(), areas.size());
+  }
 
-    if (start == 0 && end == mSize) {
-      memcpy(mBuffer, src, mSize);
-    } else {
-      while (start < end) {
-        memcpy(&mBuffer[start], &src[start], areaRowSize);
-        start += textureRowWidth;
-      }
+  void OgreTexture::write(const void* buffer, size_t size, int width, int height, const Rect<int>* areas, size_t count)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mBufferWidth = width;
+      mBufferHeight = height;
+      mScalingPolicy->update(width, height);
     }
 
+    // staging buffer has its own lock, so the render thread can blit the previous image meanwhile
+    mStaging.write(buffer, size, width, height, areas, count);
     mDirty = true;
-    // no need to update dirty regions if the texture does not support partial write
-    if(mFlags & OgreTexture::BlitDirty) {
-      mDirtyRegions.push_back(area);
-    }
   }
 
   void OgreTexture::setSize(int width, int height)
@@ -298,31 +284,22 @@ namespace Gsage {
 
   bool OgreTexture::blitAll()
   {
-    if(mValid && mSize > 0) {
+    if(mValid && mStaging.getSize() > 0) {
       OgreV1::HardwarePixelBufferSharedPtr texBuf = mTexture->getBuffer();
-      texBuf->lock(OgreV1::HardwareBuffer::HBL_DISCARD);
+      const Ogre::PixelBox& pb = texBuf->lock(OgreV1::HardwareBuffer::HBL_DISCARD);
 
       size_t pixelSize = Ogre::PixelUtil::getNumElemBytes(mTexture->getFormat());
-      int textureRowWidth = mTexture->getWidth() * pixelSize;
-      size_t textureSize = textureRowWidth * mTexture->getHeight();
-      char* dest = static_cast<char*>(texBuf->getCurrentLock().data);
-      if(mSize != textureSize) {
-        int bufferRowWidth = mBufferWidth * pixelSize;
-
-        int bufferOffset = 0;
-        int destOffset = 0;
-        while(bufferOffset < mSize && destOffset < textureSize) {
-          memcpy(&dest[destOffset], &mBuffer[bufferOffset], bufferRowWidth);
-          destOffset += textureRowWidth;
-          bufferOffset += bufferRowWidth;
-        }
-      } else {
-        memcpy(dest, mBuffer, mSize);
-      }
+      size_t textureRowWidth = pb.rowPitch * pixelSize;
+      size_t bufferRowWidth = mStaging.getWidth() * mStaging.getPixelSize();
+      size_t rows = std::min((size_t)mTexture->getHeight(), (size_t)mStaging.getHeight());
 
-      texBuf->unlock();
-      mDirtyRegions.clear();
+      StagingBuffer::copyRows(
+        static_cast<char*>(pb.data), textureRowWidth,
+        mStaging.getData(), bufferRowWidth,
+        std::min((size_t)mTexture->getWidth() * pixelSize, bufferRowWidth), rows
+      );
 
+      texBuf->unlock();
       return true;
     }
 
@@ -331,35 +308,25 @@ namespace Gsage {
 
   bool OgreTexture::blitDirty()
   {
-
     size_t pixelSize = Ogre::PixelUtil::getNumElemBytes(mTexture->getFormat());
-    size_t textureSize = mTexture->getWidth() * mTexture->getHeight() * pixelSize;
+    bool fits = mTexture->getWidth() >= (Ogre::uint32)mStaging.getWidth() && mTexture->getHeight() >= (Ogre::uint32)mStaging.getHeight();
 
-    if(mValid && mSize > 0 && textureSize >= mSize) {
+    if(mValid && mStaging.getSize() > 0 && fits) {
       OgreV1::HardwarePixelBufferSharedPtr texBuf = mTexture->getBuffer();
+      size_t bufferRowWidth = mStaging.getWidth() * mStaging.getPixelSize();
 
-      while(mDirtyRegions.size() > 0) {
-        Rect<int> area = *(mDirtyRegions.end() - 1);
-
+      // regions are already merged by the staging buffer, so there are just a few locks per frame
+      for(auto& area : mStaging.getRegions()) {
         const Ogre::PixelBox& pb = texBuf->lock(Ogre::Image::Box(area.x, area.y, area.x + area.width, area.y + area.height), OgreV1::HardwareBuffer::HBL_DISCARD);
-        char* dest = static_cast<char*>(pb.data);
-        size_t textureRowWidth = mBufferWidth * pixelSize;
-
-        size_t start = area.x * pixelSize + textureRowWidth * area.y;
-        size_t end = start + textureRowWidth * area.height;
+        const char* src = mStaging.getData() + area.y * bufferRowWidth + area.x * mStaging.getPixelSize();
 
-        size_t imageStart = 0;
-        size_t rowSize = pb.rowPitch * pixelSize;
-
-        while (start < end) {
-          memcpy(&dest[imageStart], &mBuffer[start], rowSize);
-          start += textureRowWidth;
-          imageStart += rowSize;
-        }
+        StagingBuffer::copyRows(
+          static_cast<char*>(pb.data), pb.rowPitch * pixelSize,
+          src, bufferRowWidth,
+          area.width * mStaging.getPixelSize(), area.height
+        );
 
         texBuf->unlock();
-
-        mDirtyRegions.pop_back();
       }
 
       return true;
@@ -370,16 +337,23 @@ namespace Gsage {
 
   void OgreTexture::render()
   {
-    std::lock_guard<std::mutex> lock(mLock);
-    bool wasCreated = mScalingPolicy->render();
+    bool wasCreated;
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      wasCreated = mScalingPolicy->render();
+    }
 
     if(mTexture->getUsage() & Ogre::TU_RENDERTARGET) {
       mHasData = true;
     } else {
-      if(mFlags & OgreTexture::BlitDirty) {
-        mHasData = blitDirty();
-      } else {
-        mHasData = blitAll();
+      bool acquired = mStaging.acquire();
+      if(acquired || wasCreated || !mHasData) {
+        // new texture is empty, so the whole image is copied there
+        if((mFlags & OgreTexture::BlitDirty) && mHasData && !wasCreated) {
+          mHasData = blitDirty();
+        } else {
+          mHasData = blitAll();
+        }
       }
     }
 
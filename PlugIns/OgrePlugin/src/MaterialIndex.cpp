@@ -0,0 +1,272 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "MaterialIndex.h"
+#include "Filesystem.h"
+#include "DataProxy.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <unordered_set>
+
+// files per thread, smaller folders are scanned in the calling thread
+#define PARALLEL_SCAN_THRESHOLD 16
+
+namespace Gsage {
+
+  static bool readFile(const std::string& path, std::string& dest)
+  {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if(!stream.is_open()) {
+      return false;
+    }
+
+    stream.seekg(0, std::ios::end);
+    dest.resize((size_t)stream.tellg());
+    stream.seekg(0, std::ios::beg);
+    stream.read(&dest[0], dest.size());
+    return !stream.bad();
+  }
+
+  MaterialIndex::MaterialIndex(Filesystem* filesystem)
+    : mFilesystem(filesystem)
+  {
+  }
+
+  MaterialIndex::~MaterialIndex()
+  {
+  }
+
+  MaterialIndex::ScanStats MaterialIndex::scan(const std::string& folder)
+  {
+    ScanStats stats = {0, 0, 0, 0, 0};
+    std::vector<std::string> files;
+    scanFolder(folder, files, "material");
+
+    std::vector<ScanJob> jobs(files.size());
+    for(size_t i = 0; i < files.size(); ++i) {
+      jobs[i].path = files[i];
+      auto iter = mFiles.find(files[i]);
+      jobs[i].cached = iter == mFiles.end() ? nullptr : &iter->second;
+    }
+
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max((size_t)1, jobs.size() / PARALLEL_SCAN_THRESHOLD));
+    if(threads <= 1) {
+      scanFiles(jobs, 0, jobs.size());
+    } else {
+      // jobs are independent, results are merged into the index after all threads finish
+      std::vector<std::thread> workers;
+      size_t perThread = (jobs.size() + threads - 1) / threads;
+      for(size_t start = perThread; start < jobs.size(); start += perThread) {
+        workers.emplace_back(&MaterialIndex::scanFiles, this, std::ref(jobs), start, std::min(start + perThread, jobs.size()));
+      }
+
+      scanFiles(jobs, 0, std::min(perThread, jobs.size()));
+
+      for(auto& worker : workers) {
+        worker.join();
+      }
+    }
+
+    for(auto& job : jobs) {
+      if(job.state == ScanJob::Unchanged) {
+        stats.unchanged++;
+        continue;
+      }
+
+      if(job.state == ScanJob::Failed) {
+        LOG(ERROR) << "Failed to scan file " << job.path;
+        stats.failed++;
+        continue;
+      }
+
+      IndexEntry& entry = mFiles[job.path];
+      if(job.state == ScanJob::Parsed) {
+        unindex(job.path, entry.materials);
+        entry.materials.swap(job.materials);
+        entry.hash = job.hash;
+        stats.parsed++;
+      } else {
+        stats.touched++;
+      }
+      entry.modified = job.modified;
+      entry.folder = folder;
+
+      for(auto& material : entry.materials) {
+        LOG(TRACE) << "Detected material " << material;
+        mMaterials[material] = FileInfo{
+          job.path,
+          job.modified,
+          folder
+        };
+      }
+    }
+
+    // drop files which were removed from the folder
+    std::unordered_set<std::string> existing(files.begin(), files.end());
+    for(auto iter = mFiles.begin(); iter != mFiles.end();) {
+      if(iter->second.folder == folder && existing.count(iter->first) == 0) {
+        unindex(iter->first, iter->second.materials);
+        iter = mFiles.erase(iter);
+        stats.removed++;
+        continue;
+      }
+      ++iter;
+    }
+    return stats;
+  }
+
+  const MaterialIndex::FileInfo* MaterialIndex::find(const std::string& material) const
+  {
+    auto iter = mMaterials.find(material);
+    return iter == mMaterials.end() ? nullptr : &iter->second;
+  }
+
+  void MaterialIndex::scanFiles(std::vector<MaterialIndex::ScanJob>& jobs, size_t start, size_t end)
+  {
+    std::string content;
+    for(size_t i = start; i < end; ++i) {
+      ScanJob& job = jobs[i];
+      job.modified = mFilesystem->getLastModified(job.path);
+      if(job.cached && job.cached->modified == job.modified) {
+        job.state = ScanJob::Unchanged;
+        continue;
+      }
+
+      if(!readFile(job.path, content)) {
+        job.state = ScanJob::Failed;
+        continue;
+      }
+
+      job.hash = MaterialScanner::hash(content.data(), content.size());
+      // file was touched, but the contents are the same
+      if(job.cached && job.cached->hash == job.hash) {
+        job.state = ScanJob::Touched;
+        continue;
+      }
+
+      MaterialScanner::scan(content.data(), content.size(), job.materials);
+      job.state = ScanJob::Parsed;
+    }
+  }
+
+  void MaterialIndex::unindex(const std::string& file, const MaterialScanner::Names& materials)
+  {
+    for(auto& material : materials) {
+      auto iter = mMaterials.find(material);
+      // the same material can be redefined by another file
+      if(iter != mMaterials.end() && iter->second.path == file) {
+        mMaterials.erase(iter);
+      }
+    }
+  }
+
+  void MaterialIndex::scanFolder(const std::string& folder, std::vector<std::string>& files, const std::string extension)
+  {
+    std::vector<std::string> parts;
+    parts.push_back(folder);
+
+    for(auto& file : mFilesystem->ls(folder)) {
+      parts.push_back(file);
+      std::string fullPath = mFilesystem->join(parts);
+      parts.pop_back();
+
+      if(mFilesystem->isDirectory(fullPath)) {
+        scanFolder(fullPath, files, extension);
+        continue;
+      }
+
+      if(mFilesystem->extension(file) != extension) {
+        continue;
+      }
+
+      files.push_back(fullPath);
+    }
+  }
+
+  bool MaterialIndex::read(const std::string& path)
+  {
+    if(!mFilesystem->exists(path)) {
+      return false;
+    }
+
+    bool success = false;
+    DataProxy index;
+    std::tie(index, success) = Gsage::load(path, DataWrapper::JSON_OBJECT);
+    if(!success) {
+      return false;
+    }
+
+    for(auto& pair : index) {
+      IndexEntry& entry = mFiles[pair.first];
+      entry.modified = pair.second.get<signed long>("modified", 0);
+      // old index files have no hash, so such files are scanned again when changed
+      entry.hash = pair.second.get<unsigned int>("hash", 0);
+      entry.folder = pair.second.get("folder", "");
+
+      for(auto& mat : pair.second.get("materials", DataProxy())) {
+        std::string material = mat.second.as<std::string>();
+        entry.materials.push_back(material);
+        mMaterials[material] = FileInfo{
+          pair.first,
+          entry.modified,
+          entry.folder
+        };
+      }
+    }
+    return true;
+  }
+
+  bool MaterialIndex::write(const std::string& path) const
+  {
+    DataProxy index;
+    for(auto& pair : mFiles) {
+      DataProxy object;
+      DataProxy materials = object.getOrCreateChild("materials");
+      for(auto& material : pair.second.materials) {
+        materials.push(material);
+      }
+
+      object.put("materials", materials);
+      object.put("modified", pair.second.modified);
+      object.put("hash", pair.second.hash);
+      object.put("folder", pair.second.folder);
+
+      index.put(pair.first, object, false);
+    }
+
+    return dump(index, path, DataWrapper::JSON_OBJECT);
+  }
+
+  void MaterialIndex::clear()
+  {
+    mFiles.clear();
+    mMaterials.clear();
+  }
+}
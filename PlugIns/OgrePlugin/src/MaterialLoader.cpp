@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include "systems/OgreRenderSystem.h"
 #include "GsageFacade.h"
 #include "Filesystem.h"
+#include "FileLoader.h"
 #include "Engine.h"
 #include "EngineEvent.h"
 #include "ScopedLocale.h"
@@ -37,33 +38,64 @@ THE SOFTWARE.
 #include <OgreHlmsDatablock.h>
 #endif
 
-#include <iostream>
-#include <regex>
+#include <OgreScriptLexer.h>
+#include <OgreScriptParser.h>
 
 namespace Gsage {
 
+  /**
+   * Lexer and parser do not touch any OGRE managers, so it is safe to run them in any thread
+   */
+  static Ogre::ConcreteNodeListPtr parseFile(const std::string& path)
+  {
+    std::string content;
+    if(!FileLoader::getSingletonPtr()->load(path, content, std::ios::in | std::ios::binary)) {
+      LOG(ERROR) << "Failed to read material file " << path;
+      return Ogre::ConcreteNodeListPtr();
+    }
+
+    try {
+      Ogre::ScriptLexer lexer;
+      Ogre::ScriptParser parser;
+      return parser.parse(lexer.tokenize(content, path));
+    } catch(Ogre::Exception& e) {
+      LOG(ERROR) << "Failed to parse material file " << path << ": " << e.what();
+    }
+    return Ogre::ConcreteNodeListPtr();
+  }
+
   MaterialLoader::MaterialLoader(OgreRenderSystem* render, GsageFacade* facade)
     : mRender(render)
     , mFacade(facade)
+    , mIndex(facade->filesystem())
+    , mCompiler(new Ogre::ScriptCompiler())
+    , mPending(std::make_shared<PendingLoads>())
   {
+    mPending->loader = this;
     reloadIndex();
 
     EventSubscriber<MaterialLoader>::addEventListener(mFacade->getEngine(), EngineEvent::ENV_UPDATED, &MaterialLoader::onEnvUpdated);
   }
 
+  MaterialLoader::~MaterialLoader()
+  {
+    // tasks, which are still queued, skip compilation
+    std::lock_guard<std::mutex> lock(mPending->mutex);
+    mPending->loader = 0;
+  }
+
   bool MaterialLoader::load(const std::string& material, const std::string& group, bool background)
   {
-    if(!contains(mMaterialIndex, material)) {
+    const MaterialIndex::FileInfo* info = mIndex.find(material);
+    if(!info) {
       return false;
     }
 
-    FileInfo info = mMaterialIndex[material];
-
-    if(!mFacade->filesystem()->exists(info.path)) {
+    if(!mFacade->filesystem()->exists(info->path)) {
       return false;
     }
 
-    bool modified = mFacade->filesystem()->getLastModified(info.path) != info.modified;
+    bool modified = mFacade->filesystem()->getLastModified(info->path) != info->modified;
 
 #if OGRE_VERSION >= 0x020100
     Ogre::HlmsManager* hlmsManager = Ogre::Root::getSingleton().getHlmsManager();
@@ -86,142 +118,70 @@ namespace Gsage {
       datablock = NULL;
     }
 #endif
-    {
-      ScopedCLocale l(true);
-      std::ifstream ifs(info.path, std::ios::in);
-      Ogre::DataStreamPtr dataStream(new Ogre::FileStreamDataStream(info.path, &ifs, false));
-      Ogre::MaterialManager::getSingletonPtr()->parseScript(dataStream, group);
-      ifs.close();
+    if(!background) {
+      return compile(parseFile(info->path), group);
     }
-    return true;
-  }
 
-  void MaterialLoader::scan(const std::string& file)
-  {
-    Filesystem* fs = mFacade->filesystem();
-    std::string folder = file;
-    if(!fs->isDirectory(file)) {
-      folder = fs->directory(file);
-    }
-    LOG(INFO) << "Scanning folder " << folder;
-
-    std::vector<std::string> files;
-    scanFolder(folder, files, "material");
-
-    bool dirty = false;
-    for(auto& file : files) {
-      signed long modified = fs->getLastModified(file);
-      DataProxy cached;
-      mIndex.read(file, cached, false);
-      if(modified != cached.get<signed long>("modified", -1)) {
-        // scanning material file
-        std::string content;
-        if(!FileLoader::getSingletonPtr()->load(file, content)) {
-          LOG(ERROR) << "Failed to scan file " << file;
-          continue;
-        }
-        std::regex r(R"((material|hlms)\s+([\w\/\.]+)(\s+(unlit|pbs))?)", std::regex_constants::icase);
-        std::smatch sm;
-        while(std::regex_search(content, sm, r))
-        {
-          if(sm.size() < 2) {
-            continue;
-          }
-
-          std::string material = sm[2].str();
-          LOG(TRACE) << "Detected material " << material;
-          mMaterialIndex[material] = FileInfo{
-            file,
-            modified,
-            folder
-          };
-          dirty = true;
-          content = sm.suffix();
-        }
+    std::shared_ptr<PendingLoads> pending = mPending;
+    {
+      std::lock_guard<std::mutex> lock(pending->mutex);
+      if(pending->paths.count(info->path) > 0) {
+        return true;
       }
+      pending->paths.insert(info->path);
     }
-    if(dirty) {
-      writeIndexFile();
-    }
-  }
-
-  void MaterialLoader::scanFolder(const std::string& folder, std::vector<std::string>& files, const std::string extension)
-  {
-    Filesystem* fs = mFacade->filesystem();
-    std::vector<std::string> parts;
-    parts.push_back(folder);
 
-    for(auto& file : fs->ls(folder)) {
-      parts.push_back(file);
-      std::string fullPath = fs->join(parts);
-      parts.pop_back();
-
-      if(fs->isDirectory(fullPath)) {
-        scanFolder(fullPath, files, extension);
-        continue;
+    std::string path = info->path;
+    mRender->asyncTask([pending, path, group] () {
+      Ogre::ConcreteNodeListPtr nodes = parseFile(path);
+      std::lock_guard<std::mutex> lock(pending->mutex);
+      if(!pending->loader) {
+        return;
       }
 
-      if(fs->extension(file) != extension) {
-        continue;
-      }
+      // compiler creates resources, so it is run by the render system when the script is parsed
+      pending->loader->mRender->queueMutation([pending, path, group, nodes] () {
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        pending->paths.erase(path);
+        if(pending->loader) {
+          pending->loader->compile(nodes, group);
+        }
+      });
+    });
+    return true;
+  }
 
-      files.push_back(fullPath);
+  bool MaterialLoader::compile(const Ogre::ConcreteNodeListPtr& nodes, const std::string& group)
+  {
+    if(nodes.isNull()) {
+      return false;
     }
+
+    ScopedCLocale l(true);
+    mCompiler->setListener(Ogre::ScriptCompilerManager::getSingleton().getListener());
+    return mCompiler->compile(nodes, group);
   }
 
-  void MaterialLoader::readIndexFile()
+  void MaterialLoader::scan(const std::string& file)
   {
     Filesystem* fs = mFacade->filesystem();
-    std::vector<std::string> parts;
-    parts.push_back(mWorkdir);
-    parts.push_back(".materials.index");
-
-    std::string indexPath = fs->join(parts);
-    if(fs->exists(indexPath)) {
-      bool success = false;
-      std::tie(mIndex, success) = Gsage::load(indexPath, DataWrapper::JSON_OBJECT);
-      if(!success)
-        return;
+    std::string folder = file;
+    if(!fs->isDirectory(file)) {
+      folder = fs->directory(file);
+    }
+    LOG(INFO) << "Scanning folder " << folder;
 
-      for(auto& pair : mIndex) {
-        for(auto& mat : pair.second.get("materials", DataProxy())) {
-          mMaterialIndex[mat.second.as<std::string>()] = FileInfo{
-            pair.first,
-            pair.second.get<signed long>("modified", 0),
-            pair.second.get("folder", "")
-          };
-        }
-      }
+    if(mIndex.scan(folder).changed() && !mIndex.write(getIndexPath())) {
+      LOG(ERROR) << "Failed to write material index file " << getIndexPath();
     }
   }
 
-  void MaterialLoader::writeIndexFile()
+  std::string MaterialLoader::getIndexPath() const
   {
-    mIndex = DataProxy();
-    Filesystem* fs = mFacade->filesystem();
     std::vector<std::string> parts;
     parts.push_back(mWorkdir);
     parts.push_back(".materials.index");
-
-    std::string indexPath = fs->join(parts);
-
-    for(auto& pair : mMaterialIndex) {
-      DataProxy materials;
-      DataProxy object;
-      mIndex.read(pair.second.path, object, false);
-
-      materials = object.getOrCreateChild("materials");
-      materials.push(pair.first);
-      object.put("materials", materials);
-      object.put("modified", pair.second.modified);
-      object.put("folder", pair.second.folder);
-
-      mIndex.put(pair.second.path, object, false);
-    }
-
-    if(!dump(mIndex, indexPath, DataWrapper::JSON_OBJECT)) {
-      LOG(ERROR) << "Failed to write material index file " << indexPath;
-    }
+    return mFacade->filesystem()->join(parts);
   }
 
   bool MaterialLoader::onEnvUpdated(EventDispatcher* sender, const Event& event)
@@ -237,7 +197,7 @@ namespace Gsage {
   void MaterialLoader::reloadIndex()
   {
     mWorkdir = mFacade->getEngine()->env().get("workdir", "");
-    mMaterialIndex.clear();
-    readIndexFile();
+    mIndex.clear();
+    mIndex.read(getIndexPath());
   }
 }
@@ -0,0 +1,133 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "MaterialScanner.h"
+
+namespace Gsage {
+
+  static inline bool isSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+  }
+
+  static inline bool isDelimiter(char c)
+  {
+    return isSpace(c) || c == '{' || c == '}' || c == ':' || c == '"';
+  }
+
+  static bool equalsKeyword(const char* token, size_t length, const char* keyword)
+  {
+    size_t i = 0;
+    for(; i < length && keyword[i]; ++i) {
+      char c = token[i];
+      if(c >= 'A' && c <= 'Z') {
+        c += 'a' - 'A';
+      }
+
+      if(c != keyword[i]) {
+        return false;
+      }
+    }
+    return i == length && keyword[i] == 0;
+  }
+
+  void MaterialScanner::scan(const char* data, size_t size, MaterialScanner::Names& names)
+  {
+    size_t i = 0;
+    int depth = 0;
+    bool expectName = false;
+
+    while(i < size) {
+      char c = data[i];
+      if(isSpace(c) || c == ':') {
+        i++;
+        continue;
+      }
+
+      if(c == '/' && i + 1 < size && data[i + 1] == '/') {
+        while(i < size && data[i] != '\n') {
+          i++;
+        }
+        continue;
+      }
+
+      if(c == '/' && i + 1 < size && data[i + 1] == '*') {
+        i += 2;
+        while(i + 1 < size && !(data[i] == '*' && data[i + 1] == '/')) {
+          i++;
+        }
+        i += 2;
+        continue;
+      }
+
+      if(c == '{' || c == '}') {
+        depth += c == '{' ? 1 : -1;
+        if(depth < 0) {
+          depth = 0;
+        }
+        expectName = false;
+        i++;
+        continue;
+      }
+
+      const char* token;
+      size_t length = 0;
+      if(c == '"') {
+        token = &data[++i];
+        while(i < size && data[i] != '"') {
+          i++;
+          length++;
+        }
+        // closing quote
+        i++;
+      } else {
+        token = &data[i];
+        while(i < size && !isDelimiter(data[i])) {
+          i++;
+          length++;
+        }
+      }
+
+      if(expectName) {
+        names.emplace_back(token, length);
+        expectName = false;
+      } else {
+        // materials and datablocks can be defined on the top level only
+        expectName = depth == 0 && (equalsKeyword(token, length, "material") || equalsKeyword(token, length, "hlms"));
+      }
+    }
+  }
+
+  unsigned int MaterialScanner::hash(const char* data, size_t size)
+  {
+    unsigned int res = 2166136261u;
+    for(size_t i = 0; i < size; ++i) {
+      res ^= (unsigned char)data[i];
+      res *= 16777619u;
+    }
+    return res;
+  }
+}
@@ -0,0 +1,137 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "MeshCollisionCache.h"
+#include "Logger.h"
+
+#if OGRE_VERSION >= 0x020100
+#include <OgreMesh2.h>
+#include <OgreItem.h>
+#endif
+
+template<> Gsage::MeshCollisionCache* Ogre::Singleton<Gsage::MeshCollisionCache>::msSingleton = 0;
+
+namespace Gsage {
+
+  MeshCollisionCache* MeshCollisionCache::getSingletonPtr(void)
+  {
+    return msSingleton;
+  }
+
+  MeshCollisionCache& MeshCollisionCache::getSingleton(void)
+  {
+    assert(msSingleton); return (*msSingleton);
+  }
+
+  MeshCollisionCache::MeshCollisionCache()
+  {
+  }
+
+  MeshCollisionCache::~MeshCollisionCache()
+  {
+    clear();
+  }
+
+  TriangleBVHPtr MeshCollisionCache::get(Ogre::MovableObject* object)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry* entry = getEntry(object);
+    if(!entry) {
+      return nullptr;
+    }
+
+    if(!entry->bvh) {
+      const Ogre::MeshInformation& info = *entry->info;
+      entry->bvh = std::make_shared<TriangleBVH>();
+      entry->bvh->build(info.vertices, info.vertexCount, info.indices, info.indexCount);
+      LOG(TRACE) << "Built collision BVH: " << entry->bvh->getTriangleCount() << " triangles, " << entry->bvh->getNodeCount() << " nodes";
+    }
+    return entry->bvh;
+  }
+
+  MeshInformationPtr MeshCollisionCache::getMeshInformation(Ogre::MovableObject* object)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Entry* entry = getEntry(object);
+    return entry ? entry->info : nullptr;
+  }
+
+  MeshCollisionCache::Entry* MeshCollisionCache::getEntry(Ogre::MovableObject* object)
+  {
+    Ogre::Resource* mesh = nullptr;
+    if(object->getMovableType() == "Entity") {
+      mesh = static_cast<OgreV1::Entity*>(object)->getMesh().get();
+    }
+#if OGRE_VERSION >= 0x020100
+    else if(object->getMovableType() == "Item") {
+      mesh = static_cast<Ogre::Item*>(object)->getMesh().get();
+    }
+#endif
+
+    if(!mesh) {
+      return nullptr;
+    }
+
+    auto iter = mEntries.find(mesh);
+    if(iter != mEntries.end()) {
+      return &iter->second;
+    }
+
+    std::shared_ptr<Ogre::MeshInformation> info = std::make_shared<Ogre::MeshInformation>();
+    if(!Ogre::MeshTools::getSingletonPtr()->getMeshInformation(object, *info, Ogre::Matrix4::IDENTITY, Ogre::MeshInformation::All)) {
+      return nullptr;
+    }
+
+    LOG(TRACE) << "Cached mesh data for " << mesh->getName() << ": " << info->vertexCount << " vertices, " << info->indexCount << " indices";
+    // listeners are stored in a set, so adding it again after reload is fine
+    mesh->addListener(this);
+    Entry& entry = mEntries[mesh];
+    entry.info = info;
+    return &entry;
+  }
+
+  void MeshCollisionCache::clear()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto& pair : mEntries) {
+      pair.first->removeListener(this);
+    }
+    mEntries.clear();
+  }
+
+  size_t MeshCollisionCache::size() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+  }
+
+  void MeshCollisionCache::unloadingComplete(Ogre::Resource* resource)
+  {
+    // listener is not removed here, as ogre is iterating listeners at this point
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.erase(resource);
+  }
+}
@@ -30,11 +30,101 @@ THE SOFTWARE.
 #include <OgreSceneManager.h>
 #include <OgreSubMesh.h>
 #include "Logger.h"
-#include "MeshTools.h"
+#include "MeshCollisionCache.h"
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 namespace Gsage {
 
-  OgreGeom::OgreGeom(OgreGeom::OgreEntities src, Ogre::SceneNode* referenceNode)
+  // below that amount of vertices threads cost more than they save
+  static const size_t PARALLEL_VERTICES_THRESHOLD = 1 << 16;
+
+  /**
+   * Single mesh instance to write into geom buffers
+   */
+  struct GeomInstance
+  {
+    MeshInformationPtr info;
+    Ogre::Matrix4 transform;
+    size_t vertexOffset;
+    size_t indexOffset;
+  };
+
+  /**
+   * Transform instance local space data and write it into geom buffers.
+   * Matrix is unpacked into floats and loops have no branches, so they can be vectorized.
+   */
+  static void writeInstance(const GeomInstance& instance, float* verts, float* normals, int* tris)
+  {
+    const Ogre::MeshInformation& info = *instance.info;
+    const Ogre::Matrix4& m = instance.transform;
+
+    // normals are transformed by the inverse transpose, to stay orthogonal to non uniformly scaled surfaces
+    Ogre::Matrix3 linear;
+    Ogre::Matrix3 normalMatrix;
+    m.extract3x3Matrix(linear);
+    if(linear.Inverse(normalMatrix)) {
+      normalMatrix = normalMatrix.Transpose();
+    } else {
+      normalMatrix = linear;
+    }
+
+    const float p[12] = {
+      (float)m[0][0], (float)m[0][1], (float)m[0][2], (float)m[0][3],
+      (float)m[1][0], (float)m[1][1], (float)m[1][2], (float)m[1][3],
+      (float)m[2][0], (float)m[2][1], (float)m[2][2], (float)m[2][3]
+    };
+
+    const float n[9] = {
+      (float)normalMatrix[0][0], (float)normalMatrix[0][1], (float)normalMatrix[0][2],
+      (float)normalMatrix[1][0], (float)normalMatrix[1][1], (float)normalMatrix[1][2],
+      (float)normalMatrix[2][0], (float)normalMatrix[2][1], (float)normalMatrix[2][2]
+    };
+
+    float* dv = verts + instance.vertexOffset * 3;
+    for(size_t i = 0; i < info.vertexCount; ++i) {
+      const Ogre::Vector3& v = info.vertices[i];
+      dv[i * 3]     = p[0] * v.x + p[1] * v.y + p[2]  * v.z + p[3];
+      dv[i * 3 + 1] = p[4] * v.x + p[5] * v.y + p[6]  * v.z + p[7];
+      dv[i * 3 + 2] = p[8] * v.x + p[9] * v.y + p[10] * v.z + p[11];
+    }
+
+    if(info.normals) {
+      float* dn = normals + instance.vertexOffset * 3;
+      for(size_t i = 0; i < info.vertexCount; ++i) {
+        const Ogre::Vector3& v = info.normals[i];
+        float x = n[0] * v.x + n[1] * v.y + n[2] * v.z;
+        float y = n[3] * v.x + n[4] * v.y + n[5] * v.z;
+        float z = n[6] * v.x + n[7] * v.y + n[8] * v.z;
+        float length = std::sqrt(x * x + y * y + z * z);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        dn[i * 3]     = x * scale;
+        dn[i * 3 + 1] = y * scale;
+        dn[i * 3 + 2] = z * scale;
+      }
+    } else {
+      // output buffer is not zeroed, so meshes without normals must not leave garbage there
+      std::fill(normals + instance.vertexOffset * 3, normals + (instance.vertexOffset + info.vertexCount) * 3, 0.0f);
+    }
+
+    int* dt = tris + instance.indexOffset;
+    int offset = (int)instance.vertexOffset;
+    for(size_t i = 0; i < info.indexCount; ++i) {
+      dt[i] = (int)info.indices[i] + offset;
+    }
+  }
+
+  static void writeInstances(const std::vector<GeomInstance>& instances, size_t start, size_t end, float* verts, float* normals, int* tris)
+  {
+    for(size_t i = start; i < end; ++i) {
+      writeInstance(instances[i], verts, normals, tris);
+    }
+  }
+
+  OgreGeom::OgreGeom(OgreGeom::OgreEntities src, Ogre::SceneNode* referenceNode, int threads, StaticBatcher* batcher)
     : mSrcEntities(src)
   {
     if(mSrcEntities.size() == 0) {
@@ -44,67 +134,78 @@ namespace Gsage {
     // get data
     size_t vertexCount = 0;
     size_t indexCount = 0;
-    size_t indexOffset = 0;
-    size_t vertexOffset = 0;
 
-    Ogre::MeshInformation* meshData = new Ogre::MeshInformation[mSrcEntities.size()];
-    size_t meshCount = 0;
+    std::vector<GeomInstance> instances;
+    instances.reserve(mSrcEntities.size());
+
+    MeshCollisionCache* cache = MeshCollisionCache::getSingletonPtr();
     Ogre::MeshTools* meshTools = Ogre::MeshTools::getSingletonPtr();
+    Ogre::Matrix4 referenceTransform = referenceNode->_getFullTransform().inverse();
 
     for(auto entity : mSrcEntities) {
-      if (!entity->getParentSceneNode()) {
+      Ogre::Matrix4 transform;
+      if(entity->getParentSceneNode()) {
+        transform = entity->getParentSceneNode()->_getFullTransform();
+      } else if(!batcher || !batcher->getTransform(entity, transform)) {
         continue;
       }
 
-      Ogre::Matrix4 transform = referenceNode->_getFullTransform().inverse() * entity->getParentSceneNode()->_getFullTransform();
+      // mesh data is shared between all instances of the same mesh, only the transform is different
+      MeshInformationPtr info;
+      if(cache) {
+        info = cache->getMeshInformation(entity);
+      } else {
+        std::shared_ptr<Ogre::MeshInformation> extracted = std::make_shared<Ogre::MeshInformation>();
+        if(meshTools->getMeshInformation(entity, *extracted, Ogre::Matrix4::IDENTITY, Ogre::MeshInformation::All)) {
+          info = extracted;
+        }
+      }
 
-      Ogre::MeshInformation& info = meshData[meshCount];
-      if(!meshTools->getMeshInformation(
-        entity,
-        info,
-        transform,
-        Ogre::MeshInformation::All
-      )) {
+      if(!info) {
         LOG(WARNING) << "Found movable object of incorrect type " << entity->getMovableType() << " in raw geom source list, skipped";
         continue;
       }
 
-      vertexCount += info.vertexCount;
-      indexCount += info.indexCount;
-      meshCount++;
-    }
+      GeomInstance instance;
+      instance.info = info;
+      instance.transform = referenceTransform * transform;
+      instance.vertexOffset = vertexCount;
+      instance.indexOffset = indexCount;
+      instances.push_back(instance);
 
-    vertexCount *= 3;
+      vertexCount += info->vertexCount;
+      indexCount += info->indexCount;
+    }
 
-    verts = new float[vertexCount];
-    nverts = vertexCount;
-    tris = new int[indexCount];
+    nverts = vertexCount * 3;
+    verts = new float[nverts];
     ntris = indexCount;
-    normals = new float[vertexCount];
-    int offset = 0;
+    tris = new int[ntris];
+    normals = new float[nverts];
 
-    for(size_t i = 0; i < meshCount; ++i) {
-      Ogre::MeshInformation& info = meshData[i];
-      for(size_t j = 0; j < info.indexCount; ++j) {
-        tris[indexOffset++] = (int)info.indices[j] + offset;
-      }
-
-      for(size_t j = 0; j < info.vertexCount; ++j)
-      {
-        verts[vertexOffset] = info.vertices[j].x;
-        verts[vertexOffset+1] = info.vertices[j].y;
-        verts[vertexOffset+2] = info.vertices[j].z;
+    if(threads <= 0) {
+      threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
 
-        normals[vertexOffset] = info.normals[j].x;
-        normals[vertexOffset+1] = info.normals[j].y;
-        normals[vertexOffset+2] = info.normals[j].z;
-        vertexOffset += 3;
-      }
+    // instances write to separate ranges, so they can be split between threads as is
+    threads = (int)std::min((size_t)threads, std::max((size_t)1, vertexCount / PARALLEL_VERTICES_THRESHOLD));
+    threads = std::min(threads, (int)instances.size());
+    if(threads <= 1) {
+      writeInstances(instances, 0, instances.size(), verts, normals, tris);
+      return;
+    }
 
-      offset += info.vertexCount;
+    std::vector<std::thread> workers;
+    size_t perThread = (instances.size() + threads - 1) / threads;
+    for(size_t start = perThread; start < instances.size(); start += perThread) {
+      workers.emplace_back(writeInstances, std::cref(instances), start, std::min(start + perThread, instances.size()), verts, normals, tris);
     }
 
-    delete[] meshData;
+    writeInstances(instances, 0, std::min(perThread, instances.size()), verts, normals, tris);
+
+    for(auto& worker : workers) {
+      worker.join();
+    }
   }
 
   OgreGeom::~OgreGeom()
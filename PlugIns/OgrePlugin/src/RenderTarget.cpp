@@ -289,6 +289,10 @@ namespace Gsage {
     switchToDefaultCamera();
 
     mCollisionTools = std::make_shared<MOC::CollisionTools>(mSceneManager);
+    OgreRenderSystem* rs = mEngine->getSystem<OgreRenderSystem>();
+    if(rs) {
+      mCollisionTools->setStaticBatcher(rs->getStaticBatcher());
+    }
   }
 
   int RenderTarget::getWidth() const
@@ -0,0 +1,429 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "StaticBatcher.h"
+#include "ogre/EntityWrapper.h"
+#if OGRE_VERSION_MAJOR != 1
+#include "ogre/v2/ItemWrapper.h"
+#endif
+#include "Logger.h"
+
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreSubEntity.h>
+#include <algorithm>
+#include <sstream>
+
+namespace Gsage {
+
+  StaticBatcher::StaticBatcher()
+    : mSceneManager(0)
+    , mEnabled(true)
+    , mMinInstances(4)
+    , mRegionSize(100.0f)
+    , mCounter(0)
+  {
+  }
+
+  StaticBatcher::~StaticBatcher()
+  {
+  }
+
+  void StaticBatcher::initialize(Ogre::SceneManager* sceneManager)
+  {
+    mSceneManager = sceneManager;
+  }
+
+  void StaticBatcher::configure(const DataProxy& config)
+  {
+    bool enabled = config.get("enabled", true);
+    if(!enabled) {
+      clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEnabled = enabled;
+    mMinInstances = std::max(config.get("minInstances", 4), 1);
+    mRegionSize = config.get("regionSize", 100.0f);
+    for(auto& pair : mGroups) {
+      pair.second.dirty = true;
+    }
+  }
+
+  void StaticBatcher::add(EntityWrapper* entity)
+  {
+    OgreV1::Entity* object = entity->getEntity();
+    if(!object) {
+      return;
+    }
+
+    std::stringstream ss;
+    ss << entity->getMesh();
+    for(unsigned int i = 0; i < object->getNumSubEntities(); ++i) {
+      ss << ":" << object->getSubEntity(i)->getMaterialName();
+    }
+    add(object, ss.str());
+  }
+
+#if OGRE_VERSION_MAJOR != 1
+  void StaticBatcher::add(ItemWrapper* item)
+  {
+    Ogre::Item* object = item->getItem();
+    if(!object) {
+      return;
+    }
+
+    // Hlms instances items by mesh and datablock
+    add(object, "item:" + item->getMesh() + ":" + item->getDatablock());
+  }
+#endif
+
+  void StaticBatcher::add(Ogre::MovableObject* object, const std::string& key)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Ogre::SceneNode* node = object->getParentSceneNode();
+    auto iter = mEntries.find(object);
+    if(iter != mEntries.end()) {
+      // batched objects can be detached from their nodes
+      if(iter->second.key == key && (iter->second.node == node || (iter->second.batched && !node))) {
+        return;
+      }
+      unregister(object);
+    }
+
+    if(!mEnabled || !node) {
+      return;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.node = node;
+    entry.path.push_back(node);
+    for(const Ogre::Node* parent = node->getParent(); parent && parent->getParent(); parent = parent->getParent()) {
+      entry.path.push_back(parent);
+    }
+
+    for(const Ogre::Node* n : entry.path) {
+      mNodes[n].push_back(object);
+    }
+    mEntries[object] = entry;
+
+    Group& group = mGroups[key];
+    group.objects.push_back(object);
+    group.dirty = true;
+  }
+
+  void StaticBatcher::remove(Ogre::MovableObject* object)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    unregister(object);
+  }
+
+  void StaticBatcher::invalidate(const Ogre::Node* node, bool restore)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mNodes.find(node);
+    if(iter == mNodes.end()) {
+      return;
+    }
+
+    for(Ogre::MovableObject* object : iter->second) {
+      Entry& entry = mEntries[object];
+      Group& group = mGroups[entry.key];
+      group.dirty = true;
+      if(restore && entry.batched) {
+        // static geometry keeps rendering it until the next update
+        this->restore(object, entry);
+        group.batched.erase(std::remove(group.batched.begin(), group.batched.end(), object), group.batched.end());
+      }
+    }
+  }
+
+  void StaticBatcher::update()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto iter = mGroups.begin(); iter != mGroups.end();) {
+      Group& group = iter->second;
+      if(group.dirty) {
+        build(group);
+      }
+
+      if(group.objects.empty()) {
+        iter = mGroups.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  void StaticBatcher::clear()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto& pair : mGroups) {
+      release(pair.second);
+    }
+
+    mGroups.clear();
+    mEntries.clear();
+    mNodes.clear();
+  }
+
+  size_t StaticBatcher::getBatchCount()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t count = 0;
+    for(auto& pair : mGroups) {
+      if(!pair.second.batched.empty()) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  size_t StaticBatcher::getBatchedCount()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t count = 0;
+    for(auto& pair : mGroups) {
+      count += pair.second.batched.size();
+    }
+    return count;
+  }
+
+  bool StaticBatcher::isBatched(const Ogre::MovableObject* object)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(object);
+    return iter != mEntries.end() && iter->second.batched;
+  }
+
+  bool StaticBatcher::getTransform(const Ogre::MovableObject* object, Ogre::Matrix4& dest)
+  {
+#if OGRE_VERSION_MAJOR == 1
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mEntries.find(object);
+    if(iter == mEntries.end() || !iter->second.batched) {
+      return false;
+    }
+
+    dest = iter->second.transform;
+    return true;
+#else
+    // batched objects stay in the scene graph
+    return false;
+#endif
+  }
+
+  void StaticBatcher::queryRay(const Ogre::Ray& ray, Ogre::uint32 queryMask, RayHits& dest)
+  {
+#if OGRE_VERSION_MAJOR == 1
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto& pair : mGroups) {
+      for(Ogre::MovableObject* object : pair.second.batched) {
+        if((object->getQueryFlags() & queryMask) == 0) {
+          continue;
+        }
+
+        std::pair<bool, Ogre::Real> hit = ray.intersects(mEntries[object].bounds);
+        if(hit.first) {
+          dest.push_back(RayHit(hit.second, object));
+        }
+      }
+    }
+#endif
+  }
+
+  void StaticBatcher::unregister(Ogre::MovableObject* object)
+  {
+    auto iter = mEntries.find(object);
+    if(iter == mEntries.end()) {
+      return;
+    }
+
+    Entry& entry = iter->second;
+    if(entry.batched) {
+      // static geometry keeps rendering it until the next update
+      restore(object, entry);
+    }
+
+    Group& group = mGroups[entry.key];
+    group.objects.erase(std::remove(group.objects.begin(), group.objects.end(), object), group.objects.end());
+    group.batched.erase(std::remove(group.batched.begin(), group.batched.end(), object), group.batched.end());
+    group.dirty = true;
+
+    for(const Ogre::Node* n : entry.path) {
+      auto node = mNodes.find(n);
+      if(node == mNodes.end()) {
+        continue;
+      }
+
+      std::vector<Ogre::MovableObject*>& objects = node->second;
+      objects.erase(std::remove(objects.begin(), objects.end(), object), objects.end());
+      if(objects.empty()) {
+        mNodes.erase(node);
+      }
+    }
+
+    mEntries.erase(iter);
+  }
+
+  bool StaticBatcher::isInScene(Ogre::MovableObject* object) const
+  {
+    // entities of pooled prefab instances are attached to nodes, which are out of the scene
+    const Ogre::Node* node = object->getParentNode();
+    if(!node) {
+      return false;
+    }
+
+    while(node->getParent()) {
+      node = node->getParent();
+    }
+#if OGRE_VERSION_MAJOR == 1
+    return node == mSceneManager->getRootSceneNode();
+#else
+    return node == mSceneManager->getRootSceneNode(Ogre::SCENE_DYNAMIC) || node == mSceneManager->getRootSceneNode(Ogre::SCENE_STATIC);
+#endif
+  }
+
+  void StaticBatcher::build(Group& group)
+  {
+    group.dirty = false;
+#if OGRE_VERSION_MAJOR == 1
+    // static geometry is baked, so it is built from scratch
+    release(group);
+#endif
+    if(!mEnabled || !mSceneManager) {
+      release(group);
+      return;
+    }
+
+    std::vector<Ogre::MovableObject*> members;
+    for(Ogre::MovableObject* object : group.objects) {
+      Entry& entry = mEntries[object];
+      if(entry.batched) {
+        members.push_back(object);
+        continue;
+      }
+
+      if(!isInScene(object) || object->getParentSceneNode() != entry.node) {
+        continue;
+      }
+#if OGRE_VERSION_MAJOR != 1
+      // static node makes all its attachments and children static
+      if(entry.node->numAttachedObjects() != 1 || entry.node->numChildren() != 0) {
+        continue;
+      }
+#endif
+      members.push_back(object);
+    }
+
+    if(members.size() < mMinInstances) {
+      release(group);
+      return;
+    }
+
+#if OGRE_VERSION_MAJOR == 1
+    std::stringstream ss;
+    ss << "gsage.batch." << mCounter++;
+    OgreV1::StaticGeometry* geometry = mSceneManager->createStaticGeometry(ss.str());
+    geometry->setRegionDimensions(Ogre::Vector3(mRegionSize));
+
+    bool castShadows = false;
+    for(Ogre::MovableObject* object : members) {
+      Ogre::Node* node = object->getParentNode();
+      geometry->addEntity(static_cast<OgreV1::Entity*>(object), node->_getDerivedPosition(), node->_getDerivedOrientation(), node->_getDerivedScale());
+      castShadows = castShadows || object->getCastShadows();
+    }
+
+    geometry->setCastShadows(castShadows);
+    geometry->setRenderQueueGroup(members[0]->getRenderQueueGroup());
+    geometry->build();
+    group.geometry = geometry;
+    LOG(TRACE) << "Built static batch " << ss.str() << " of " << members.size() << " entities";
+#endif
+
+    for(Ogre::MovableObject* object : members) {
+      detach(object, mEntries[object]);
+    }
+    group.batched = members;
+  }
+
+  void StaticBatcher::release(Group& group)
+  {
+    for(Ogre::MovableObject* object : group.batched) {
+      restore(object, mEntries[object]);
+    }
+    group.batched.clear();
+
+    if(group.geometry) {
+      mSceneManager->destroyStaticGeometry(group.geometry);
+      group.geometry = 0;
+    }
+  }
+
+  void StaticBatcher::detach(Ogre::MovableObject* object, Entry& entry)
+  {
+#if OGRE_VERSION_MAJOR == 1
+    Ogre::SceneNode* node = entry.node;
+    entry.transform = node->_getFullTransform();
+    entry.bounds = object->getBoundingBox();
+    entry.bounds.transformAffine(entry.transform);
+
+    // the batch renders the object, so the node is not updated anymore, unless it has something else attached
+    node->detachObject(object);
+    if(node->numAttachedObjects() == 0 && node->numChildren() == 0 && node->getParent()) {
+      entry.parent = node->getParent();
+      entry.parent->removeChild(node);
+    }
+#else
+    if(!entry.batched) {
+      entry.node->setStatic(true);
+    }
+    // static nodes transforms are updated only when notified
+    mSceneManager->notifyStaticDirty(entry.node);
+#endif
+    entry.batched = true;
+  }
+
+  void StaticBatcher::restore(Ogre::MovableObject* object, Entry& entry)
+  {
+#if OGRE_VERSION_MAJOR == 1
+    if(entry.parent) {
+      if(!entry.node->getParent()) {
+        entry.parent->addChild(entry.node);
+      }
+      entry.parent = 0;
+    }
+
+    if(!object->getParentNode()) {
+      entry.node->attachObject(object);
+    }
+#else
+    entry.node->setStatic(false);
+#endif
+    entry.batched = false;
+  }
+}
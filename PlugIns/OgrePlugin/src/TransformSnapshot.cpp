@@ -0,0 +1,209 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "TransformSnapshot.h"
+#include "ogre/SceneNodeWrapper.h"
+
+#include <algorithm>
+
+namespace Gsage {
+
+  TransformSnapshot::TransformSnapshot()
+    : mFrame(0)
+  {
+  }
+
+  TransformSnapshot::~TransformSnapshot()
+  {
+  }
+
+  void TransformSnapshot::clear()
+  {
+    // vectors keep their capacity, so steady state frames do not allocate
+    mNodes.clear();
+    mFields.clear();
+    mPositions.clear();
+    mOrientations.clear();
+    mVisible.clear();
+    mCommands.clear();
+  }
+
+  void TransformSnapshot::add(SceneNodeWrapper* node, unsigned char fields, const Ogre::Vector3& position, const Ogre::Quaternion& orientation, bool visible)
+  {
+    mNodes.push_back(node);
+    mFields.push_back(fields);
+    mPositions.push_back(position);
+    mOrientations.push_back(orientation);
+    mVisible.push_back(visible ? 1 : 0);
+  }
+
+  void TransformSnapshot::addCommand(unsigned long frame, const Command& command)
+  {
+    mCommands.emplace_back(frame, command);
+  }
+
+  void TransformSnapshot::apply(unsigned long lastFrame)
+  {
+    for(size_t i = 0; i < mNodes.size(); ++i) {
+      SceneNodeWrapper* node = mNodes[i];
+      if(!node->hasNode()) {
+        continue;
+      }
+
+      unsigned char fields = mFields[i];
+      if(fields & Position) {
+        node->setPosition(mPositions[i]);
+      }
+
+      if(fields & Orientation) {
+        node->setOrientation(mOrientations[i]);
+      }
+
+      if(fields & Visibility) {
+        node->getNode()->setVisible(mVisible[i] != 0);
+      }
+    }
+
+    // commands can be carried by several snapshots, run each only once
+    for(auto& pair : mCommands) {
+      if(pair.first > lastFrame) {
+        pair.second();
+      }
+    }
+  }
+
+  TransformSnapshotBuffer::State::State()
+    : fields(0)
+    , position(Ogre::Vector3::ZERO)
+    , orientation(Ogre::Quaternion::IDENTITY)
+    , visible(true)
+    , owner(0)
+    , queryFlags(0)
+    , frame(0)
+  {
+  }
+
+  TransformSnapshotBuffer::TransformSnapshotBuffer()
+    : mFrame(1)
+    , mAppliedFrame(0)
+    , mConsumedFrame(0)
+  {
+  }
+
+  TransformSnapshotBuffer::~TransformSnapshotBuffer()
+  {
+  }
+
+  TransformSnapshotBuffer::State& TransformSnapshotBuffer::write(SceneNodeWrapper* node)
+  {
+    State& state = mPending[node];
+    state.frame = mFrame;
+    return state;
+  }
+
+  const TransformSnapshotBuffer::State* TransformSnapshotBuffer::read(SceneNodeWrapper* node) const
+  {
+    auto iter = mPending.find(node);
+    if(iter == mPending.end()) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+
+  void TransformSnapshotBuffer::queue(const TransformSnapshot::Command& command)
+  {
+    mCommands.emplace_back(mFrame, command);
+  }
+
+  void TransformSnapshotBuffer::remove(SceneNodeWrapper* node)
+  {
+    mPending.erase(node);
+  }
+
+  void TransformSnapshotBuffer::publish()
+  {
+    unsigned long consumed = mConsumedFrame.load(std::memory_order_acquire);
+
+    TransformSnapshot& snapshot = mBuffer.back();
+    snapshot.clear();
+    snapshot.setFrame(mFrame);
+
+    // the render thread may skip snapshots, so everything it has not applied yet is sent again
+    for(auto iter = mPending.begin(); iter != mPending.end();) {
+      const State& state = iter->second;
+      if(state.frame <= consumed) {
+        iter = mPending.erase(iter);
+        continue;
+      }
+
+      snapshot.add(iter->first, state.fields, state.position, state.orientation, state.visible);
+      ++iter;
+    }
+
+    mCommands.erase(
+      std::remove_if(mCommands.begin(), mCommands.end(), [consumed] (const Commands::value_type& pair) { return pair.first <= consumed; }),
+      mCommands.end()
+    );
+
+    for(auto& pair : mCommands) {
+      snapshot.addCommand(pair.first, pair.second);
+    }
+
+    mBuffer.publish();
+    mFrame++;
+  }
+
+  bool TransformSnapshotBuffer::apply()
+  {
+    if(!mBuffer.acquire()) {
+      return false;
+    }
+
+    TransformSnapshot& snapshot = mBuffer.front();
+    snapshot.apply(mAppliedFrame);
+    mAppliedFrame = snapshot.getFrame();
+    mConsumedFrame.store(mAppliedFrame, std::memory_order_release);
+    return true;
+  }
+
+  void TransformSnapshotBuffer::flush()
+  {
+    unsigned long consumed = mConsumedFrame.load(std::memory_order_acquire);
+    Commands commands;
+    commands.swap(mCommands);
+    for(auto& pair : commands) {
+      if(pair.first > consumed) {
+        pair.second();
+      }
+    }
+  }
+
+  void TransformSnapshotBuffer::reset()
+  {
+    mPending.clear();
+    mCommands.clear();
+  }
+}
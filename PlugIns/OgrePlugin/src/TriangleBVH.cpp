@@ -0,0 +1,254 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Gsage {
+
+  static const float EPSILON = 1e-7f;
+
+  static bool intersectBox(const float min[3], const float max[3], const float origin[3], const float inverse[3], float maxDistance, float& entry)
+  {
+    float tmin = 0.0f;
+    float tmax = maxDistance;
+    for(int axis = 0; axis < 3; ++axis) {
+      float t1 = (min[axis] - origin[axis]) * inverse[axis];
+      float t2 = (max[axis] - origin[axis]) * inverse[axis];
+      if(t1 > t2) {
+        std::swap(t1, t2);
+      }
+      tmin = std::max(tmin, t1);
+      tmax = std::min(tmax, t2);
+      if(tmin > tmax) {
+        return false;
+      }
+    }
+    entry = tmin;
+    return true;
+  }
+
+  TriangleBVH::TriangleBVH()
+    : mTriangleCount(0)
+  {
+  }
+
+  TriangleBVH::~TriangleBVH()
+  {
+  }
+
+  void TriangleBVH::build(const Ogre::Vector3* vertices, size_t vertexCount, const Ogre::uint32* indices, size_t indexCount)
+  {
+    mNodes.clear();
+    mPackets.clear();
+
+    Triangles triangles;
+    triangles.reserve(indexCount / 3);
+    for(size_t i = 0; i + 2 < indexCount; i += 3) {
+      if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+        continue;
+      }
+
+      Triangle t;
+      t.a = vertices[indices[i]];
+      t.b = vertices[indices[i + 1]];
+      t.c = vertices[indices[i + 2]];
+      t.centroid = (t.a + t.b + t.c) / 3.0f;
+      triangles.push_back(t);
+    }
+
+    mTriangleCount = triangles.size();
+    if(triangles.empty()) {
+      return;
+    }
+
+    mNodes.reserve(triangles.size() / PACKET_SIZE * 2 + 1);
+    mPackets.reserve(triangles.size() / PACKET_SIZE + 1);
+    buildNode(triangles, 0, triangles.size());
+  }
+
+  Ogre::uint32 TriangleBVH::buildNode(Triangles& triangles, size_t start, size_t end)
+  {
+    Ogre::uint32 index = (Ogre::uint32)mNodes.size();
+    mNodes.push_back(Node());
+
+    Ogre::Vector3 min(std::numeric_limits<Ogre::Real>::max());
+    Ogre::Vector3 max(-std::numeric_limits<Ogre::Real>::max());
+    Ogre::Vector3 centroidMin = min;
+    Ogre::Vector3 centroidMax = max;
+    for(size_t i = start; i < end; ++i) {
+      const Triangle& t = triangles[i];
+      min.makeFloor(t.a); min.makeFloor(t.b); min.makeFloor(t.c);
+      max.makeCeil(t.a); max.makeCeil(t.b); max.makeCeil(t.c);
+      centroidMin.makeFloor(t.centroid);
+      centroidMax.makeCeil(t.centroid);
+    }
+
+    for(int axis = 0; axis < 3; ++axis) {
+      mNodes[index].min[axis] = min[axis];
+      mNodes[index].max[axis] = max[axis];
+    }
+
+    size_t count = end - start;
+    if(count <= PACKET_SIZE) {
+      Packet packet;
+      // unused lanes have zero edges, so the determinant check always rejects them
+      std::memset(&packet, 0, sizeof(Packet));
+      for(size_t i = 0; i < count; ++i) {
+        const Triangle& t = triangles[start + i];
+        Ogre::Vector3 e1 = t.b - t.a;
+        Ogre::Vector3 e2 = t.c - t.a;
+        for(int axis = 0; axis < 3; ++axis) {
+          packet.v0[axis][i] = t.a[axis];
+          packet.e1[axis][i] = e1[axis];
+          packet.e2[axis][i] = e2[axis];
+        }
+      }
+
+      mNodes[index].offset = (Ogre::uint32)mPackets.size();
+      mNodes[index].count = 1;
+      mPackets.push_back(packet);
+      return index;
+    }
+
+    // median split along the longest axis of centroid bounds
+    Ogre::Vector3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if(extent.y > extent.x) {
+      axis = 1;
+    }
+    if(extent.z > extent[axis]) {
+      axis = 2;
+    }
+
+    size_t middle = start + count / 2;
+    std::nth_element(triangles.begin() + start, triangles.begin() + middle, triangles.begin() + end, [axis] (const Triangle& l, const Triangle& r) {
+      return l.centroid[axis] < r.centroid[axis];
+    });
+
+    buildNode(triangles, start, middle);
+    Ogre::uint32 right = buildNode(triangles, middle, end);
+    mNodes[index].offset = right;
+    mNodes[index].count = 0;
+    return index;
+  }
+
+  void TriangleBVH::testPacket(const Packet& p, const float o[3], const float d[3], CullMode cull, float& closest) const
+  {
+    float hits[PACKET_SIZE];
+    // Moller-Trumbore, lanes are independent
+    for(int i = 0; i < PACKET_SIZE; ++i) {
+      float px = d[1] * p.e2[2][i] - d[2] * p.e2[1][i];
+      float py = d[2] * p.e2[0][i] - d[0] * p.e2[2][i];
+      float pz = d[0] * p.e2[1][i] - d[1] * p.e2[0][i];
+      float det = p.e1[0][i] * px + p.e1[1][i] * py + p.e1[2][i] * pz;
+
+      bool valid = cull == CULL_BACK ? det > EPSILON : (cull == CULL_FRONT ? det < -EPSILON : std::fabs(det) > EPSILON);
+      float inv = valid ? 1.0f / det : 0.0f;
+
+      float tx = o[0] - p.v0[0][i];
+      float ty = o[1] - p.v0[1][i];
+      float tz = o[2] - p.v0[2][i];
+      float u = (tx * px + ty * py + tz * pz) * inv;
+
+      float qx = ty * p.e1[2][i] - tz * p.e1[1][i];
+      float qy = tz * p.e1[0][i] - tx * p.e1[2][i];
+      float qz = tx * p.e1[1][i] - ty * p.e1[0][i];
+      float v = (d[0] * qx + d[1] * qy + d[2] * qz) * inv;
+      float t = (p.e2[0][i] * qx + p.e2[1][i] * qy + p.e2[2][i] * qz) * inv;
+
+      valid = valid && u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f;
+      hits[i] = valid ? t : std::numeric_limits<float>::max();
+    }
+
+    for(int i = 0; i < PACKET_SIZE; ++i) {
+      closest = std::min(closest, hits[i]);
+    }
+  }
+
+  bool TriangleBVH::intersect(const Ogre::Vector3& origin, const Ogre::Vector3& direction, Ogre::Real& distance, CullMode cull, Ogre::Real maxDistance) const
+  {
+    if(mNodes.empty()) {
+      return false;
+    }
+
+    float o[3] = {(float)origin.x, (float)origin.y, (float)origin.z};
+    float d[3] = {(float)direction.x, (float)direction.y, (float)direction.z};
+    float inverse[3];
+    for(int axis = 0; axis < 3; ++axis) {
+      inverse[axis] = d[axis] != 0.0f ? 1.0f / d[axis] : std::numeric_limits<float>::max();
+    }
+
+    float closest = std::min((float)maxDistance, std::numeric_limits<float>::max());
+    bool found = false;
+
+    Ogre::uint32 stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+      const Node& node = mNodes[stack[--top]];
+      float entry;
+      if(!intersectBox(node.min, node.max, o, inverse, closest, entry)) {
+        continue;
+      }
+
+      if(node.count > 0) {
+        float before = closest;
+        for(Ogre::uint32 i = 0; i < node.count; ++i) {
+          testPacket(mPackets[node.offset + i], o, d, cull, closest);
+        }
+        found = found || closest < before;
+        continue;
+      }
+
+      // visit the nearest child first, so the further one is likely culled by distance
+      Ogre::uint32 left = (Ogre::uint32)(&node - &mNodes[0]) + 1;
+      Ogre::uint32 right = node.offset;
+      float leftEntry, rightEntry;
+      bool hitLeft = intersectBox(mNodes[left].min, mNodes[left].max, o, inverse, closest, leftEntry);
+      bool hitRight = intersectBox(mNodes[right].min, mNodes[right].max, o, inverse, closest, rightEntry);
+      if(hitLeft && hitRight) {
+        if(leftEntry < rightEntry) {
+          std::swap(left, right);
+        }
+        stack[top++] = left;
+        stack[top++] = right;
+      } else if(hitLeft) {
+        stack[top++] = left;
+      } else if(hitRight) {
+        stack[top++] = right;
+      }
+    }
+
+    if(found) {
+      distance = closest;
+    }
+    return found;
+  }
+}
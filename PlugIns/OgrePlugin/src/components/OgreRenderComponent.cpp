@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include "components/OgreRenderComponent.h"
 #include "ogre/SceneNodeWrapper.h"
 #include "ogre/OgreObjectManager.h"
+#include "TransformSnapshot.h"
 #include "ResourceManager.h"
 #include "Entity.h"
 
@@ -45,10 +46,17 @@ namespace Gsage {
   OgreRenderComponent::OgreRenderComponent() :
     mAddedToScene(false),
     mRootNode(0),
+    mQueryFlags(0),
+    mQueryFlagsDirty(true),
+    mVisible(true),
     mSceneManager(0),
     mResourceManager(0),
-    mObjectManager(0)
+    mObjectManager(0),
+    mSnapshots(0),
+    mAnimationPool(0)
   {
+    // prefab should be known before the root node is created
+    registerProperty("prefab", &mPrefab, Optional, 1);
     BIND_ACCESSOR_OPTIONAL("resources", &OgreRenderComponent::setResources, &OgreRenderComponent::getResources);
     BIND_ACCESSOR("root", &OgreRenderComponent::setRootNode, &OgreRenderComponent::getRootNode);
     BIND_ACCESSOR_OPTIONAL("animations", &OgreRenderComponent::setAnimations, &OgreRenderComponent::getAnimations);
@@ -60,22 +68,72 @@ namespace Gsage {
 
   void OgreRenderComponent::setPosition(const Ogre::Vector3& position)
   {
-    if(mRootNode) {
+    if(!mRootNode) {
+      return;
+    }
+
+    if(mSnapshots) {
+      TransformSnapshotBuffer::State& state = mSnapshots->write(mRootNode);
+      state.fields |= TransformSnapshot::Position;
+      state.position = position;
+      state.owner = getOwner();
+      state.queryFlags = getQueryFlags();
+    } else {
       mRootNode->setPosition(position);
-      fireEvent(Event(OgreRenderComponent::POSITION_CHANGE));
     }
+    fireEvent(Event(OgreRenderComponent::POSITION_CHANGE));
   }
 
   void OgreRenderComponent::setOrientation(const Ogre::Quaternion& orientation)
   {
-    if(mRootNode)
+    if(!mRootNode) {
+      return;
+    }
+
+    if(mSnapshots) {
+      TransformSnapshotBuffer::State& state = mSnapshots->write(mRootNode);
+      state.fields |= TransformSnapshot::Orientation;
+      state.orientation = orientation;
+    } else {
       mRootNode->setOrientation(orientation);
+    }
   }
 
   void OgreRenderComponent::rotate(const Ogre::Quaternion& rotation)
   {
-    if(mRootNode)
+    if(!mRootNode) {
+      return;
+    }
+
+    if(mSnapshots) {
+      // same as Ogre::Node::rotate in TS_LOCAL
+      Ogre::Quaternion q = rotation;
+      q.normalise();
+      setOrientation(getOgreOrientation() * q);
+    } else {
       mRootNode->rotate(rotation, Ogre::Node::TransformSpace::TS_LOCAL);
+    }
+  }
+
+  /**
+   * Same as Ogre::Node::lookAt for the node attached to the scene root, without fixed yaw axis
+   */
+  static Ogre::Quaternion lookAtOrientation(const Ogre::Quaternion& orientation, const Ogre::Vector3& origin, const Ogre::Vector3& target, const Ogre::Vector3& localDirection, Ogre::Node::TransformSpace transformSpace)
+  {
+    Ogre::Vector3 direction = transformSpace == Ogre::Node::TS_LOCAL ? orientation * target : target - origin;
+    if(direction == Ogre::Vector3::ZERO) {
+      return orientation;
+    }
+    direction.normalise();
+
+    Ogre::Vector3 current = orientation * localDirection;
+    Ogre::Quaternion rotation;
+    if((current + direction).squaredLength() < 0.00005f) {
+      rotation.FromAngleAxis(Ogre::Radian(Ogre::Math::PI), Ogre::Vector3::UNIT_Y);
+    } else {
+      rotation = current.getRotationTo(direction);
+    }
+    return rotation * orientation;
   }
 
   void OgreRenderComponent::lookAt(const Ogre::Vector3& position, const Geometry::RotationAxis rotationAxis, Geometry::TransformSpace transformSpace)
@@ -108,11 +166,25 @@ namespace Gsage {
         axis.z = 1;
         break;
       default:
-        mRootNode->lookAt(position, tSpace);
-        return;
+        break;
+    }
+
+    Ogre::Vector3 origin = mRootNode->getPositionWithoutOffset();
+    if(mSnapshots) {
+      // node may not have the latest position yet
+      origin += getOgrePosition() - mRootNode->getPosition();
+    }
+
+    Ogre::Vector3 target = position;
+    if(axis != Ogre::Vector3::ZERO) {
+      target = position * (Ogre::Vector3::UNIT_SCALE - axis) + (origin * axis);
     }
 
-    mRootNode->lookAt(position * (Ogre::Vector3::UNIT_SCALE - axis) + (mRootNode->getPositionWithoutOffset() * axis), tSpace);
+    if(mSnapshots) {
+      setOrientation(lookAtOrientation(getOgreOrientation(), origin, target, mRootNode->getOrientationVector(), tSpace));
+    } else {
+      mRootNode->lookAt(target, tSpace);
+    }
   }
 
   void OgreRenderComponent::lookAt(const Ogre::Vector3& position)
@@ -133,7 +205,7 @@ namespace Gsage {
       LOG(ERROR) << "Failed to set up animations: scene manager is not defined";
       return;
     }
-    mAnimationScheduler.initialize(value, mSceneManager, this);
+    mAnimationScheduler.initialize(value, mSceneManager, this, mAnimationPool);
   }
 
   DataProxy OgreRenderComponent::getRootNode()
@@ -147,13 +219,20 @@ namespace Gsage {
 
   void OgreRenderComponent::setRootNode(const DataProxy& value)
   {
+    mQueryFlagsDirty = true;
     if(!mRootNode) {
       if(!mSceneManager || !mObjectManager) {
         LOG(ERROR) << "Failed to set up node tree: scene manager or object manager is not set";
         return;
       }
       try {
-        mRootNode = mObjectManager->create<SceneNodeWrapper>(value, getOwner()->getId(), mSceneManager, mSceneManager->getRootSceneNode());
+        if(mPrefab.empty()) {
+          // pooled prefab instances of the previous entity with the same id would clash by names
+          mObjectManager->releasePooled(getOwner()->getId());
+          mRootNode = mObjectManager->create<SceneNodeWrapper>(value, getOwner()->getId(), mSceneManager, mSceneManager->getRootSceneNode());
+        } else {
+          mRootNode = mObjectManager->spawn(mPrefab, value, getOwner()->getId(), mSceneManager);
+        }
       } catch(const Ogre::Exception& e) {
         LOG(ERROR) << "Failed to create render component " << e.what();
       }
@@ -171,8 +250,62 @@ namespace Gsage {
     return mRootNode;
   }
 
+  static unsigned int collectQueryFlags(Ogre::SceneNode* node)
+  {
+    unsigned int flags = 0;
+    for(size_t i = 0; i < node->numAttachedObjects(); ++i) {
+      flags |= node->getAttachedObject(i)->getQueryFlags();
+    }
+
+    for(size_t i = 0; i < node->numChildren(); ++i) {
+      Ogre::SceneNode* child = dynamic_cast<Ogre::SceneNode*>(node->getChild(i));
+      if(child) {
+        flags |= collectQueryFlags(child);
+      }
+    }
+    return flags;
+  }
+
+  unsigned int OgreRenderComponent::getQueryFlags()
+  {
+    // children attached or removed after the tree was read mark the root node dirty
+    bool treeChanged = mRootNode && mRootNode->resetTreeDirty();
+    if((mQueryFlagsDirty || treeChanged) && mRootNode && mRootNode->hasNode()) {
+      mQueryFlags = collectQueryFlags(mRootNode->getNode());
+      mQueryFlagsDirty = false;
+    }
+    return mQueryFlags;
+  }
+
+  void OgreRenderComponent::setVisible(bool visible)
+  {
+    mVisible = visible;
+    if(!mRootNode || !mRootNode->hasNode()) {
+      return;
+    }
+
+    if(mSnapshots) {
+      TransformSnapshotBuffer::State& state = mSnapshots->write(mRootNode);
+      state.fields |= TransformSnapshot::Visibility;
+      state.visible = visible;
+    } else {
+      mRootNode->getNode()->setVisible(visible);
+    }
+  }
+
+  bool OgreRenderComponent::isVisible() const
+  {
+    return mVisible;
+  }
+
   const Ogre::Vector3 OgreRenderComponent::getOgrePosition()
   {
+    if(mSnapshots) {
+      const TransformSnapshotBuffer::State* state = mSnapshots->read(mRootNode);
+      if(state && (state->fields & TransformSnapshot::Position)) {
+        return state->position;
+      }
+    }
     return mRootNode->getPosition();
   }
 
@@ -183,6 +316,12 @@ namespace Gsage {
 
   const Ogre::Quaternion OgreRenderComponent::getOgreOrientation()
   {
+    if(mSnapshots) {
+      const TransformSnapshotBuffer::State* state = mSnapshots->read(mRootNode);
+      if(state && (state->fields & TransformSnapshot::Orientation)) {
+        return state->orientation;
+      }
+    }
     return mRootNode->getOrientation();
   }
 
@@ -198,21 +337,37 @@ namespace Gsage {
 
   bool OgreRenderComponent::adjustAnimationStateSpeed(const std::string& name, double speed)
   {
+    if(mSnapshots) {
+      mSnapshots->queue([this, name, speed] () { mAnimationScheduler.adjustSpeed(name, speed); });
+      return true;
+    }
     return mAnimationScheduler.adjustSpeed(name, speed);
   }
 
   bool OgreRenderComponent::setAnimationState(const std::string& name)
   {
+    if(mSnapshots) {
+      mSnapshots->queue([this, name] () { mAnimationScheduler.play(name); });
+      return true;
+    }
     return mAnimationScheduler.play(name);
   }
 
   bool OgreRenderComponent::playAnimation(const std::string& name, int times, double speed, double offset, bool reset)
   {
+    if(mSnapshots) {
+      mSnapshots->queue([this, name, times, speed, offset, reset] () { mAnimationScheduler.play(name, times, speed, offset, reset); });
+      return true;
+    }
     return mAnimationScheduler.play(name, times, speed, offset, reset);
   }
 
   void OgreRenderComponent::resetAnimationState()
   {
+    if(mSnapshots) {
+      mSnapshots->queue([this] () { mAnimationScheduler.resetState(); });
+      return;
+    }
     mAnimationScheduler.resetState();
   }
 
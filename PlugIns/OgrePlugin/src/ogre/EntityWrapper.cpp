@@ -29,6 +29,7 @@ THE SOFTWARE.
 #include "FileLoader.h"
 #include "systems/OgreRenderSystem.h"
 #include "MaterialLoader.h"
+#include "StaticBatcher.h"
 
 #include <OgreMeshManager.h>
 #include <OgreEntity.h>
@@ -60,6 +61,10 @@ namespace Gsage {
 
   EntityWrapper::~EntityWrapper()
   {
+    if(mObject) {
+      mObjectManager->getRenderSystem()->getStaticBatcher()->remove(mObject);
+    }
+
     for(auto entity : mAttachedEntities) {
       entity->destroy();
     }
@@ -79,6 +84,8 @@ namespace Gsage {
     if(mObject != 0)
     {
       mObject->setQueryFlags(mQuery);
+      setTreeDirty();
+      updateBatching();
     }
   }
 
@@ -104,6 +111,7 @@ namespace Gsage {
     }
 
     if(mObject) {
+      mObjectManager->getRenderSystem()->getStaticBatcher()->remove(mObject);
       for(auto entity : mAttachedEntities) {
         entity->destroy();
       }
@@ -122,7 +130,8 @@ namespace Gsage {
       OgreV1::SubMesh* sm = mesh->getSubMesh(i);
       if(sm->isMatInitialised()) {
         Ogre::String materialName = sm->getMaterialName();
-        if(!mObjectManager->getRenderSystem()->getMaterialLoader()->load(materialName, mesh->getGroup())) {
+        // entity is created right away, so the material should be ready by then
+        if(!mObjectManager->getRenderSystem()->getMaterialLoader()->load(materialName, mesh->getGroup(), false)) {
           LOG(ERROR) << "Failed to load material " << materialName;
         }
       }
@@ -135,6 +144,7 @@ namespace Gsage {
     if(skeleton != 0)
       skeleton->setBlendMode(mAnimBlendMode);
     attachObject(mObject);
+    updateBatching();
   }
 
   const std::string& EntityWrapper::getMesh() const
@@ -202,6 +212,7 @@ namespace Gsage {
     mClone->setRenderQueueGroup(renderQueue);
     mClone->setCastShadows(false);
     attachObject(mClone);
+    updateBatching();
   }
 
   void EntityWrapper::removeClone()
@@ -210,6 +221,7 @@ namespace Gsage {
       mClone->detachFromParent();
       mSceneManager->destroyEntity(mClone);
       mClone = 0;
+      updateBatching();
     }
   }
 
@@ -221,4 +233,16 @@ namespace Gsage {
     OgreObject* object = mObjectManager->create(movableObjectData, mOwnerId, mSceneManager, movableObjectData.get("type", ""), params, this);
     mAttachedEntities.push_back(object);
   }
+
+  void EntityWrapper::updateBatching()
+  {
+    StaticBatcher* batcher = mObjectManager->getRenderSystem()->getStaticBatcher();
+    // entities have static query by default, so only explicitly static ones are batched,
+    // clone is attached to the same node, so the entity is not batched while it is shown
+    if(mQueryString == "static" && !mObject->hasSkeleton() && mAttachedEntities.empty() && !mClone) {
+      batcher->add(this);
+    } else {
+      batcher->remove(mObject);
+    }
+  }
 }
@@ -40,6 +40,7 @@ namespace Gsage {
     , mObjectManager(0)
     , mSceneManager(0)
     , mParentObject(0)
+    , mTreeDirty(false)
   {
     // setting couple of these props priorities to maximum
     BIND_PROPERTY_WITH_PRIORITY("type", &mType, 10000);
@@ -116,6 +117,9 @@ namespace Gsage {
 
   void OgreObject::destroy()
   {
+    if(mParentObject) {
+      mParentObject->setTreeDirty();
+    }
     mObjectManager->destroy(this);
     mParentObject = 0;
     mParentNode = 0;
@@ -131,6 +135,16 @@ namespace Gsage {
     return mObjectId;
   }
 
+  const std::string& OgreObject::getOwnerId() const
+  {
+    return mOwnerId;
+  }
+
+  void OgreObject::setOwnerId(const std::string& ownerId)
+  {
+    mOwnerId = ownerId;
+  }
+
   void OgreObject::attachObject(Ogre::MovableObject* object)
   {
     if(object->getParentNode()) {
@@ -139,7 +153,23 @@ namespace Gsage {
 
     if(!mParentObject || !mParentObject->attach(object, mAttachParams)) {
       LOG(ERROR) << "Failed to attach movable object, no parent defined";
+      return;
     }
+    setTreeDirty();
+  }
+
+  void OgreObject::setTreeDirty()
+  {
+    OgreObject* root = this;
+    while(root->mParentObject) {
+      root = root->mParentObject;
+    }
+    root->mTreeDirty = true;
+  }
+
+  bool OgreObject::resetTreeDirty()
+  {
+    return mTreeDirty.exchange(false);
   }
 
   bool OgreObject::attach(Ogre::MovableObject* object, const DataProxy& params)
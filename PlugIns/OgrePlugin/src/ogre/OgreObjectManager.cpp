@@ -28,6 +28,8 @@ THE SOFTWARE.
 #include <OgreSceneManager.h>
 
 #include "ogre/OgreObject.h"
+#include "ogre/Prefab.h"
+#include "ogre/SceneNodeWrapper.h"
 #include "Logger.h"
 #include "OgreRenderSystem.h"
 
@@ -39,11 +41,16 @@ namespace Gsage {
 
   OgreObjectManager::OgreObjectManager(OgreRenderSystem* rs)
     : mRenderSystem(rs)
+    , mPrefabPoolSize(64)
+    , mSpawning(false)
   {
   }
 
   OgreObjectManager::~OgreObjectManager()
   {
+    for(auto& pair : mPrefabs) {
+      delete pair.second;
+    }
   }
 
   OgreObject* OgreObjectManager::create(const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager, const std::string& type, const DataProxy& attachParams, OgreObject* parent)
@@ -118,4 +125,80 @@ namespace Gsage {
     fireEvent(OgreObjectManagerEvent(OgreObjectManagerEvent::OBJECT_DESTROYED, object->getObjectId(), object));
     mObjects[type]->remove(object);
   }
+
+  SceneNodeWrapper* OgreObjectManager::spawn(const std::string& name, const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager)
+  {
+    Prefab* prefab;
+    {
+      std::lock_guard<std::mutex> lock(mPrefabsMutex);
+      if(mPrefabs.count(name) == 0) {
+        mPrefabs[name] = new Prefab(this, name, dict.get("children", DataProxy()));
+      }
+      prefab = mPrefabs[name];
+    }
+
+    // instance of the same prefab is reused, others would clash by names
+    releasePooled(owner, prefab);
+
+    SceneNodeWrapper* root;
+    mSpawning = true;
+    try {
+      root = prefab->spawn(dict, owner, sceneManager);
+    } catch(...) {
+      mSpawning = false;
+      throw;
+    }
+    mSpawning = false;
+
+    if(root) {
+      std::lock_guard<std::mutex> lock(mPrefabsMutex);
+      mSpawned[root] = prefab;
+    }
+    return root;
+  }
+
+  bool OgreObjectManager::despawn(SceneNodeWrapper* root)
+  {
+    Prefab* prefab;
+    {
+      std::lock_guard<std::mutex> lock(mPrefabsMutex);
+      auto iter = mSpawned.find(root);
+      if(iter == mSpawned.end()) {
+        return false;
+      }
+      prefab = iter->second;
+      mSpawned.erase(iter);
+    }
+
+    return prefab->despawn(root, mPrefabPoolSize);
+  }
+
+  void OgreObjectManager::clearPrefabs()
+  {
+    std::lock_guard<std::mutex> lock(mPrefabsMutex);
+    for(auto& pair : mPrefabs) {
+      pair.second->clear();
+    }
+  }
+
+  void OgreObjectManager::releasePooled(const std::string& owner, Prefab* except)
+  {
+#if OGRE_VERSION_MAJOR == 1
+    std::lock_guard<std::mutex> lock(mPrefabsMutex);
+    for(auto& pair : mPrefabs) {
+      if(pair.second != except) {
+        pair.second->release(owner);
+      }
+    }
+#endif
+  }
+
+  Prefab* OgreObjectManager::getPrefab(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(mPrefabsMutex);
+    if(mPrefabs.count(name) == 0) {
+      return 0;
+    }
+    return mPrefabs[name];
+  }
 }
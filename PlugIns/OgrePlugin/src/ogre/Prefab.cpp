@@ -0,0 +1,253 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "ogre/Prefab.h"
+#include "ogre/OgreObjectManager.h"
+#include "ogre/SceneNodeWrapper.h"
+#include "systems/OgreRenderSystem.h"
+#include "Logger.h"
+
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+
+namespace Gsage {
+
+  Prefab::Prefab(OgreObjectManager* objectManager, const std::string& name, const DataProxy& children)
+    : mObjectManager(objectManager)
+    , mName(name)
+  {
+    compile(children, -1);
+    LOG(INFO) << "Compiled prefab \"" << mName << "\": " << mInstructions.size() << " instructions";
+  }
+
+  Prefab::~Prefab()
+  {
+  }
+
+  SceneNodeWrapper* Prefab::spawn(const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager)
+  {
+    Instance instance;
+    if(acquire(owner, instance)) {
+      reuse(instance, dict, owner, sceneManager);
+    } else {
+      instance.root = mObjectManager->create<SceneNodeWrapper>(dict, owner, sceneManager, sceneManager->getRootSceneNode());
+      if(!instance.root) {
+        return 0;
+      }
+      create(instance, owner, sceneManager);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mInstances[instance.root] = instance;
+    return instance.root;
+  }
+
+  bool Prefab::despawn(SceneNodeWrapper* root, size_t poolSize)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      auto iter = mInstances.find(root);
+      if(iter == mInstances.end()) {
+        return false;
+      }
+
+      Instance instance = iter->second;
+      mInstances.erase(iter);
+      if(mPool.size() < poolSize && root->hasNode()) {
+        Ogre::SceneNode* node = root->getNode();
+        // batched objects are returned to their nodes before the tree is detached,
+        // they are dropped from static batches on rebuild
+        mObjectManager->getRenderSystem()->getStaticBatcher()->invalidate(node, true);
+        if(node->getParentSceneNode()) {
+          node->getParentSceneNode()->removeChild(node);
+        }
+        mPool.push_back(instance);
+        return true;
+      }
+    }
+
+    root->destroy();
+    return true;
+  }
+
+  void Prefab::clear()
+  {
+    std::vector<Instance> pool;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      pool.swap(mPool);
+    }
+
+    for(auto& instance : pool) {
+      destroy(instance);
+    }
+  }
+
+  size_t Prefab::release(const std::string& owner)
+  {
+    std::vector<Instance> released;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      for(auto iter = mPool.begin(); iter != mPool.end();) {
+        if(iter->root->getObjectId() == owner) {
+          released.push_back(*iter);
+          iter = mPool.erase(iter);
+          continue;
+        }
+        ++iter;
+      }
+    }
+
+    for(auto& instance : released) {
+      destroy(instance);
+    }
+    return released.size();
+  }
+
+  void Prefab::destroy(Instance& instance)
+  {
+    // node tree destruction expects the root node to be attached
+    Ogre::SceneNode* node = instance.root->getNode();
+    node->getCreator()->getRootSceneNode()->addChild(node);
+    instance.root->destroy();
+  }
+
+  size_t Prefab::getPooledCount()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPool.size();
+  }
+
+  void Prefab::compile(const DataProxy& children, int parent)
+  {
+    for(auto& pair : children)
+    {
+      std::string type = pair.second.get("type", "");
+      if(type == "")
+      {
+        LOG(ERROR) << "Prefab \"" << mName << "\" skipped malformed child definition: no type defined";
+        continue;
+      }
+
+      Instruction instruction;
+      instruction.parent = parent;
+      instruction.type = type;
+      instruction.named = pair.second.count("name") != 0;
+      instruction.props = pair.second;
+      if(pair.second.getWrappedType() == DataWrapper::JSON_OBJECT) {
+        // detach from the source document, lua tables are kept by reference, as they may hold userdata
+        instruction.props = DataProxy::create(DataWrapper::JSON_OBJECT);
+        pair.second.dump(instruction.props, DataProxy::ForceCopy);
+      }
+      mInstructions.push_back(instruction);
+
+      // nested children are placed right after the parent node
+      auto nested = pair.second.get<DataProxy>("children");
+      if(type == SceneNodeWrapper::TYPE && nested.second) {
+        compile(nested.first, mInstructions.size() - 1);
+      }
+    }
+  }
+
+  bool Prefab::acquire(const std::string& owner, Instance& instance)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto iter = mPool.rbegin(); iter != mPool.rend(); ++iter) {
+#if OGRE_VERSION_MAJOR == 1
+      // scene nodes and movable objects can't be renamed in Ogre 1.x,
+      // so the instance can only be reused by the same entity
+      if(iter->root->getObjectId() != owner) {
+        continue;
+      }
+#endif
+      instance = *iter;
+      mPool.erase(std::next(iter).base());
+      return true;
+    }
+    return false;
+  }
+
+  void Prefab::create(Instance& instance, const std::string& owner, Ogre::SceneManager* sceneManager)
+  {
+    instance.objects.resize(mInstructions.size(), 0);
+    for(size_t i = 0; i < mInstructions.size(); ++i) {
+      Instruction& instruction = mInstructions[i];
+      SceneNodeWrapper* parent = instruction.parent < 0 ? instance.root : static_cast<SceneNodeWrapper*>(instance.objects[instruction.parent]);
+      if(!parent) {
+        // parent creation failed
+        continue;
+      }
+
+      DataProxy params;
+      OgreObject* object;
+      if(instruction.named) {
+        object = mObjectManager->create(instruction.props, owner, sceneManager, instruction.type, params, parent);
+      } else {
+        // generated name is not written to the props, as they can reference the user's lua table.
+        // name has the highest priority, so reading it separately is the same as reading it with the props
+        DataProxy named = DataProxy::create(DataWrapper::JSON_OBJECT);
+        named.put("name", SceneNodeWrapper::generateChildId(instruction.type));
+        object = mObjectManager->create(named, owner, sceneManager, instruction.type, params, parent);
+        if(object) {
+          object->read(instruction.props);
+        }
+      }
+
+      if(!object) {
+        LOG(ERROR) << "Prefab \"" << mName << "\" failed to create child " << instruction.type;
+        continue;
+      }
+
+      parent->addChild(instruction.type, object->getObjectId(), object);
+      instance.objects[i] = object;
+    }
+  }
+
+  void Prefab::reuse(Instance& instance, const DataProxy& dict, const std::string& owner, Ogre::SceneManager* sceneManager)
+  {
+    Ogre::SceneNode* node = instance.root->getNode();
+    sceneManager->getRootSceneNode()->addChild(node);
+    node->setVisible(true);
+
+    instance.root->setOwnerId(owner);
+    if(dict.count("name") == 0) {
+      instance.root->createNode(owner);
+    }
+    instance.root->read(dict);
+
+    // reset the state that could be changed during the previous lifetime
+    for(size_t i = 0; i < mInstructions.size(); ++i) {
+      OgreObject* object = instance.objects[i];
+      if(!object) {
+        continue;
+      }
+
+      // unnamed objects keep the generated name, as there is no name in the props
+      object->setOwnerId(owner);
+      object->read(mInstructions[i].props);
+    }
+  }
+}
@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include "ogre/SceneNodeWrapper.h"
 #include "ogre/OgreObjectManager.h"
 #include "ogre/MovableObjectWrapper.h"
+#include "systems/OgreRenderSystem.h"
 #include <OgreRoot.h>
 #include "Logger.h"
 
@@ -130,6 +131,7 @@ namespace Gsage {
   {
     assert(mNode != 0);
     mNode->setPosition(position);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     // mark position property dirty
     markDirty(SceneNodeWrapper::Position);
@@ -155,6 +157,7 @@ namespace Gsage {
   void SceneNodeWrapper::setScale(const Ogre::Vector3& scale)
   {
     mNode->setScale(scale);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     // mark scale property dirty
     markDirty(SceneNodeWrapper::Scale);
@@ -176,6 +179,7 @@ namespace Gsage {
   void SceneNodeWrapper::setOrientation(const Ogre::Quaternion& orientation)
   {
     mNode->setOrientation(orientation);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     // mark orientation property dirty
     markDirty(SceneNodeWrapper::Orientation);
@@ -195,6 +199,11 @@ namespace Gsage {
 
   void SceneNodeWrapper::readChildren(const DataProxy& dict)
   {
+    // prefab instances get children from the compiled instructions
+    if(mObjectManager && mObjectManager->isSpawning()) {
+      return;
+    }
+
     std::map<std::pair<std::string, std::string>, bool> visited;
     for(auto& pair : dict)
     {
@@ -210,9 +219,7 @@ namespace Gsage {
       auto objectId = pair.second.get<std::string>("name");
       std::string id = objectId.first;
       if (!objectId.second) {
-        std::stringstream ss("");
-        ss << type << counter++;
-        id = ss.str();
+        id = generateChildId(type);
         pair.second.put("name", id);
       }
 
@@ -284,6 +291,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->rotate(rotation, ts);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -295,6 +303,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->rotate(axis, degree, ts);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -306,6 +315,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->lookAt(position, relativeTo, mOrientationVector);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -362,6 +372,18 @@ namespace Gsage {
     }
   }
 
+  void SceneNodeWrapper::addChild(const std::string& type, const std::string& name, OgreObject* object)
+  {
+    mChildren[type][name] = object;
+  }
+
+  std::string SceneNodeWrapper::generateChildId(const std::string& type)
+  {
+    std::stringstream ss("");
+    ss << type << counter++;
+    return ss.str();
+  }
+
   OgreObject* SceneNodeWrapper::getChild(const std::string& type, const std::string& name, bool traverse)
   {
     std::string key = name;
@@ -399,6 +421,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->pitch(angle, relativeTo);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -410,6 +433,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->yaw(angle, relativeTo);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -421,6 +445,7 @@ namespace Gsage {
     updateProperty(SceneNodeWrapper::Orientation);
 #endif
     mNode->roll(angle, relativeTo);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Orientation);
 #endif
@@ -433,11 +458,17 @@ namespace Gsage {
   void SceneNodeWrapper::translate(const Ogre::Vector3& d, Ogre::Node::TransformSpace relativeTo)
   {
     mNode->translate(d, relativeTo);
+    notifyMoved();
 #if OGRE_VERSION >= 0x020100
     markDirty(SceneNodeWrapper::Position);
 #endif
   }
 
+  void SceneNodeWrapper::notifyMoved()
+  {
+    mObjectManager->getRenderSystem()->getStaticBatcher()->invalidate(mNode);
+  }
+
   bool SceneNodeWrapper::onFactoryUnregister(EventDispatcher* sender, const Event& event)
   {
     const OgreObjectManagerEvent& e = static_cast<const OgreObjectManagerEvent&>(event);
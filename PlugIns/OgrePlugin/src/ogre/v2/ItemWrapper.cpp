@@ -34,6 +34,7 @@ THE SOFTWARE.
 #include <OgreMeshManager2.h>
 
 #include "ogre/v2/ItemWrapper.h"
+#include "systems/OgreRenderSystem.h"
 
 namespace Gsage {
   const std::string ItemWrapper::TYPE = "item";
@@ -48,15 +49,23 @@ namespace Gsage {
 
   ItemWrapper::~ItemWrapper()
   {
+    if(mObject) {
+      mObjectManager->getRenderSystem()->getStaticBatcher()->remove(mObject);
+    }
   }
 
   void ItemWrapper::setMesh(const std::string& model)
   {
+    if(mObject) {
+      mObjectManager->getRenderSystem()->getStaticBatcher()->remove(mObject);
+    }
+
     mMeshName = model;
     mObject = mSceneManager->createItem(model, Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME, Ogre::SCENE_DYNAMIC);
     mObject->setQueryFlags(mQuery | Ogre::SceneManager::QUERY_ENTITY_DEFAULT_MASK);
     defineUserBindings();
     attachObject(mObject);
+    updateBatching();
   }
 
   const std::string& ItemWrapper::getMesh() const
@@ -77,6 +86,8 @@ namespace Gsage {
     if(mObject != 0)
     {
       mObject->setQueryFlags(mQuery | Ogre::SceneManager::QUERY_ENTITY_DEFAULT_MASK);
+      setTreeDirty();
+      updateBatching();
     }
   }
 
@@ -90,6 +101,7 @@ namespace Gsage {
     mDatablock = name;
     if(mObject) {
       mObject->setDatablock(mDatablock);
+      updateBatching();
     }
   }
 
@@ -97,4 +109,15 @@ namespace Gsage {
   {
     return mDatablock;
   }
+
+  void ItemWrapper::updateBatching()
+  {
+    StaticBatcher* batcher = mObjectManager->getRenderSystem()->getStaticBatcher();
+    // items have static query by default, so only explicitly static ones are batched
+    if(mQueryString == "static" && !mObject->hasSkeleton()) {
+      batcher->add(this);
+    } else {
+      batcher->remove(mObject);
+    }
+  }
 }
@@ -46,6 +46,7 @@ THE SOFTWARE.
 
 #include "AnimationScheduler.h"
 #include "MaterialLoader.h"
+#include "MeshCollisionCache.h"
 
 #include "ComponentStorage.h"
 #include "Entity.h"
@@ -60,6 +61,8 @@ THE SOFTWARE.
 #include <OgreFontManager.h>
 #endif
 #include <OgreParticleSystemManager.h>
+#include <OgreCamera.h>
+#include <OgreSphere.h>
 #include "ogre/ManualMovableTextRenderer.h"
 #include "WindowEventListener.h"
 
@@ -145,6 +148,11 @@ namespace Gsage {
     , mManualTextureManager(this)
     , mLogManager(0)
     , mMaterialLoader(0)
+    , mMeshCollisionCache(0)
+    , mTargetFrameTime(1.0 / 60.0)
+    , mAnimationLodDistance(0)
+    , mAnimationCullRadius(1)
+    , mSceneGraphUpdateTime(0)
   {
     mSystemInfo.put("type", OgreRenderSystem::ID);
     mSystemInfo.put("version", OGRE_VERSION);
@@ -174,6 +182,8 @@ namespace Gsage {
     mMaterialLoader = new MaterialLoader(this, mFacade);
     // initialize resource manager
     mResourceManager = new ResourceManager(mFacade, mMaterialLoader);
+    // raycast triangle hierarchies, shared by all render targets
+    mMeshCollisionCache = new MeshCollisionCache();
 
     auto pair = settings.get<DataProxy>("plugins");
     if(pair.second) {
@@ -334,6 +344,7 @@ namespace Gsage {
 #endif
 
     mSceneManager->addRenderQueueListener(this);
+    mStaticBatcher.initialize(mSceneManager);
 
     mFontManager = new Ogre::FontManager();
     // initializing custom factory for floating text particles
@@ -423,7 +434,14 @@ namespace Gsage {
       window->show();
     }
 
-    return EngineSystem::initialize(settings);
+    mTargetFrameTime = settings.get("targetFrameTime", 1.0 / 60.0);
+    bool res = EngineSystem::initialize(settings);
+    if(dedicatedThread()) {
+      // simulation thread writes transforms to snapshots instead of touching scene nodes
+      mSnapshots.reset();
+      EventSubscriber<OgreRenderSystem>::addEventListener(mEngine, EngineEvent::UPDATE, &OgreRenderSystem::handleEngineUpdate, 0);
+    }
+    return res;
   }
 
   void OgreRenderSystem::shutdown()
@@ -435,6 +453,11 @@ namespace Gsage {
 
     EngineSystem::shutdown();
     mManualTextureManager.reset();
+    // queued destroy commands are not dropped, otherwise node trees of removed components leak
+    mSnapshots.flush();
+    mSnapshots.reset();
+    mObjectManager.clearPrefabs();
+    mStaticBatcher.clear();
 
     if(getRenderWindow() != 0 && mWindowEventListener != 0)
       mWindowEventListener->windowClosed(getRenderWindow());
@@ -458,6 +481,11 @@ namespace Gsage {
       mWindowEventListener = 0;
     }
 
+    if(mMeshCollisionCache != 0) {
+      delete mMeshCollisionCache;
+      mMeshCollisionCache = 0;
+    }
+
     if(mRoot) {
       mRoot->shutdown();
       delete mRoot;
@@ -489,25 +517,40 @@ namespace Gsage {
     if(!mSceneManager) {
       return false;
     }
-    c->prepare(mSceneManager, mResourceManager, &mObjectManager);
+    c->prepare(mSceneManager, mResourceManager, &mObjectManager, dedicatedThread() ? &mSnapshots : 0, &mAnimationPool);
     return true;
   }
 
   bool OgreRenderSystem::fillComponentData(OgreRenderComponent* c, const DataProxy& dict)
   {
     c->mAddedToScene = true;
+    // added right away, so spatial queries see the entity in the frame it was spawned
+    if(c->mRootNode && c->mRootNode->hasNode()) {
+      mEngine->getSpatialIndex().update(c->getOwner(), c->getPosition(), c->getQueryFlags());
+    }
     return true;
   }
 
   void OgreRenderSystem::update(const double& time)
   {
+    auto frameStart = std::chrono::steady_clock::now();
+    if(dedicatedThread()) {
+      mSnapshots.apply();
+    }
+
     for(int i = 0; i < mMutationQueue.size(); ++i) {
       ObjectMutation om;
       mMutationQueue.get(om);
       om.execute();
     }
 
+    updateViewer();
+
+    // all animations are advanced in one pass, components only switch finished ones
+    mAnimationPool.update(time);
     ComponentStorage<OgreRenderComponent>::update(time);
+    updateSpatialIndex();
+    mAnimationPool.apply();
     Ogre::WindowEventUtilities::messagePump();
 
     mEngine->fireEvent(RenderEvent(RenderEvent::UPDATE, this));
@@ -518,16 +561,23 @@ namespace Gsage {
       }
     }
 
+    mStaticBatcher.update();
+
     bool continueRendering = !getRenderWindow()->isClosed();
     if(continueRendering) {
+      auto updateStart = std::chrono::steady_clock::now();
 #if OGRE_VERSION >= 0x020100
       if(mRenderSystem->getFriendlyName() == "NULL_RS") {
         mSceneManager->updateSceneGraph();
+        mSceneGraphUpdateTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - updateStart).count();
         mSceneManager->clearFrameData();
       } else {
         continueRendering = mRoot->renderOneFrame();
       }
 #else
+      // nodes are updated before rendering, so the scene graph update can be measured separately
+      mSceneManager->getRootSceneNode()->_update(true, false);
+      mSceneGraphUpdateTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - updateStart).count();
       continueRendering = mRoot->renderOneFrame();
 #endif
     }
@@ -537,14 +587,37 @@ namespace Gsage {
     if(!continueRendering)
       mEngine->fireEvent(EngineEvent(EngineEvent::SHUTDOWN));
 
-    if(dedicatedThread()) {
-      std::this_thread::sleep_for(std::chrono::microseconds((long)(6000 - time)));
+    if(dedicatedThread() && mTargetFrameTime > 0) {
+      std::chrono::duration<double> targetFrameTime(mTargetFrameTime);
+      std::this_thread::sleep_until(frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(targetFrameTime));
     }
   }
 
   void OgreRenderSystem::updateComponent(OgreRenderComponent* component, Entity* entity, const double& time)
   {
-    component->mAnimationScheduler.update(time);
+    AnimationScheduler& scheduler = component->mAnimationScheduler;
+    if(scheduler.hasAnimations()) {
+      scheduler.setCulled(isAnimationCulled(component));
+      scheduler.update(time);
+    }
+  }
+
+  void OgreRenderSystem::updateSpatialIndex()
+  {
+    // in the dedicated thread mode it is done on snapshot publishing
+    if(dedicatedThread()) {
+      return;
+    }
+
+    // it is not a part of updateComponent, so entities skipped by the update LOD are reindexed too,
+    // otherwise their rates are calculated from stale positions.
+    // entity is moved between index cells only when it crosses the cell border
+    SpatialIndex& index = mEngine->getSpatialIndex();
+    for(auto component : mComponents.getElements()) {
+      if(component->mRootNode && component->mRootNode->hasNode()) {
+        index.update(component->getOwner(), component->getPosition(), component->getQueryFlags());
+      }
+    }
   }
 
   bool OgreRenderSystem::configure(const DataProxy& config)
@@ -555,6 +628,11 @@ namespace Gsage {
 
     EngineSystem::configure(config);
 
+    mAnimationLodDistance = config.get("animation.lodDistance", 0.0f);
+    mAnimationCullRadius = config.get("animation.cullRadius", 1.0f);
+    mObjectManager.setPrefabPoolSize(config.get("prefabs.poolSize", 64));
+    mStaticBatcher.configure(config.get("batching", DataProxy()));
+
     resources = mConfig.get<DataProxy>("resources");
     if(resources.second)
       mResourceManager->load(resources.first);
@@ -708,7 +786,7 @@ namespace Gsage {
       toProcess.push_back(e);
     }
 
-    return getGeometry(entities);
+    return getGeometry(toProcess);
   }
 
   GeomPtr OgreRenderSystem::getGeometry(OgreEntities entities) {
@@ -722,7 +800,7 @@ namespace Gsage {
       return nullptr;
     }
 
-    GeomPtr geom = GeomPtr(new OgreGeom(entities, root));
+    GeomPtr geom = GeomPtr(new OgreGeom(entities, root, 0, &mStaticBatcher));
     Ogre::Vector3 min(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
     Ogre::Vector3 max = -min;
 #if OGRE_VERSION_MAJOR == 1
@@ -735,7 +813,14 @@ namespace Gsage {
     // calculate bounds
     for(auto entity : entities) {
 #if OGRE_VERSION_MAJOR == 1
-      Ogre::Matrix4 transform = root->_getFullTransform().inverse() * entity->getParentSceneNode()->_getFullTransform();
+      Ogre::Matrix4 transform;
+      if(entity->getParentSceneNode()) {
+        transform = entity->getParentSceneNode()->_getFullTransform();
+      } else if(!mStaticBatcher.getTransform(entity, transform)) {
+        continue;
+      }
+
+      transform = root->_getFullTransform().inverse() * transform;
       Ogre::AxisAlignedBox bbox = entity->getBoundingBox();
       bbox.transform(transform);
       meshBoundingBox.merge(bbox);
@@ -801,16 +886,107 @@ namespace Gsage {
   bool OgreRenderSystem::removeComponent(OgreRenderComponent* component)
   {
     LOG(INFO) << "Remove component " << component->getOwner()->getId();
+    mEngine->getSpatialIndex().remove(component->getOwner());
+    if(dedicatedThread() && component->mAddedToScene) {
+      // node tree can still be referenced by published snapshots,
+      // so it is destroyed by the render thread after applying them
+      component->mAddedToScene = false;
+      if(component->mRootNode) {
+        mSnapshots.remove(component->mRootNode);
+      }
+      mSnapshots.queue([this, component] () {
+        releaseComponent(component);
+        if(mShutdown.load()) {
+          // commands are flushed on shutdown, when the simulation thread is not running
+          ComponentStorage<OgreRenderComponent>::removeComponent(component);
+          return;
+        }
+        // the storage belongs to the simulation thread, which keeps creating components in it
+        mEngine->executeInMainThread([this, component] () {
+          ComponentStorage<OgreRenderComponent>::removeComponent(component);
+        });
+      });
+      return true;
+    }
+
+    destroyComponent(component);
+    return true;
+  }
+
+  void OgreRenderSystem::destroyComponent(OgreRenderComponent* component)
+  {
+    releaseComponent(component);
+    ComponentStorage<OgreRenderComponent>::removeComponent(component);
+  }
+
+  void OgreRenderSystem::releaseComponent(OgreRenderComponent* component)
+  {
+    // animation states are owned by the entities, which are destroyed with the node tree
+    component->mAnimationScheduler.release();
     if(component->mRootNode)
     {
-      component->mRootNode->destroy();
+      // prefab instances are returned to the pool
+      if(!mObjectManager.despawn(component->mRootNode)) {
+        component->mRootNode->destroy();
+      }
       component->mRootNode = 0;
     }
     component->mAddedToScene = false;
 
     mResourceManager->unload(component->getResources());
-    ComponentStorage<OgreRenderComponent>::removeComponent(component);
-    return true;
+  }
+
+  void OgreRenderSystem::updateViewer()
+  {
+    UpdateLOD& lod = mEngine->getUpdateLOD();
+    Ogre::Camera* camera = mWindow ? mWindow->getCamera() : 0;
+    if(!camera || !lod.isEnabled()) {
+      return;
+    }
+
+    const Ogre::Plane* frustum = camera->getFrustumPlanes();
+    mViewerPlanes.clear();
+    for(int i = 0; i < 6; ++i) {
+      // infinite far plane does not cull anything
+      if(i == Ogre::FRUSTUM_PLANE_FAR && camera->getFarClipDistance() == 0) {
+        continue;
+      }
+
+      SpatialIndex::Plane plane = {OgreVector3ToGsageVector3(frustum[i].normal), frustum[i].d};
+      mViewerPlanes.push_back(plane);
+    }
+    lod.setViewer(OgreVector3ToGsageVector3(camera->getDerivedPosition()), mViewerPlanes);
+  }
+
+  bool OgreRenderSystem::isAnimationCulled(OgreRenderComponent* component)
+  {
+    Ogre::Camera* camera = mWindow ? mWindow->getCamera() : 0;
+    if(!camera || !component->mRootNode || !component->mRootNode->hasNode()) {
+      return false;
+    }
+
+    const Ogre::Vector3& position = component->mRootNode->getNode()->_getDerivedPosition();
+    if(mAnimationLodDistance > 0 && camera->getDerivedPosition().squaredDistance(position) > mAnimationLodDistance * mAnimationLodDistance) {
+      return true;
+    }
+
+    return !camera->isVisible(Ogre::Sphere(position, mAnimationCullRadius));
+  }
+
+  void OgreRenderSystem::unloadComponents()
+  {
+    if(!dedicatedThread()) {
+      ComponentStorage<OgreRenderComponent>::unloadComponents();
+      return;
+    }
+
+    // removal is deferred, components stay in the storage until the render thread destroys them
+    ObjectPool<OgreRenderComponent>::PointerVector elements = mComponents.getElements();
+    for(auto component : elements) {
+      if(component->mAddedToScene) {
+        removeComponent(component);
+      }
+    }
   }
 
   OgreRenderSystem::OgreEntities OgreRenderSystem::getEntities(const unsigned int& query)
@@ -855,33 +1031,19 @@ namespace Gsage {
 
   OgreRenderSystem::Entities OgreRenderSystem::getObjectsInRadius(const Ogre::Vector3& center, float distance, const unsigned int flags, const std::string& id)
   {
-    Ogre::Sphere sphere(center, distance);
-    Ogre::SphereSceneQuery* query = mSceneManager->createSphereQuery(sphere, flags);
-    Ogre::SceneQueryResultMovableList nodes;
-
-    nodes = query->execute().movables;
     Entities res;
-    if(nodes.empty())
+    mEngine->getSpatialIndex().queryRadius(OgreVector3ToGsageVector3(center), distance, res, flags);
+    if(id.empty()) {
       return res;
+    }
 
-    Ogre::Any entityId;
-    for(Ogre::MovableObject* element : nodes)
-    {
-      entityId = element->getUserObjectBindings().getUserAny("entity");
-      if(entityId.isEmpty())
-        continue;
-
-      if(!id.empty() && id != entityId.get<std::string>())
-        continue;
-
-      Entity* entity = mEngine->getEntity(entityId.get<std::string>());
-      if(!entity)
-        continue;
-
-      res.push_back(entity);
+    Entities filtered;
+    for(Entity* entity : res) {
+      if(entity->getId() == id) {
+        filtered.push_back(entity);
+      }
     }
-    mSceneManager->destroyQuery(query);
-    return res;
+    return filtered;
   }
 
   void OgreRenderSystem::setWidth(unsigned int width, const std::string& target)
@@ -1027,4 +1189,19 @@ namespace Gsage {
     mWindow->setDimensions(event.width, event.height);
     return true;
   }
+
+  bool OgreRenderSystem::handleEngineUpdate(EventDispatcher* sender, const Event& event)
+  {
+    // spatial index belongs to the simulation thread, so moved entities are reindexed here
+    SpatialIndex& index = mEngine->getSpatialIndex();
+    for(auto& pair : mSnapshots.getPending()) {
+      const TransformSnapshotBuffer::State& state = pair.second;
+      if(state.owner && state.frame == mSnapshots.getFrame() && (state.fields & TransformSnapshot::Position)) {
+        index.update(state.owner, OgreVector3ToGsageVector3(state.position), state.queryFlags);
+      }
+    }
+
+    mSnapshots.publish();
+    return true;
+  }
 }
@@ -19,6 +19,14 @@ namespace Gsage
        */
       bool read(const DataProxy& node);
 
+      /**
+       * Lua tables are read by the same overridden logic
+       */
+      bool read(const sol::table& props)
+      {
+        return read(DataProxy::create(props));
+      }
+
       /**
        * Create particle system using previosly set name
        * @param template Particle system template file
@@ -19,6 +19,8 @@
 #ifndef CHUNKYTRIMESH_H
 #define CHUNKYTRIMESH_H
 
+#include <vector>
+
 struct rcChunkyTriMeshNode
 {
 	float bmin[2];
@@ -27,13 +29,28 @@ struct rcChunkyTriMeshNode
 	int n;
 };
 
+/// Node of the 4-ary tree built on top of the binary chunk tree.
+/// Child bounds are stored as structure of arrays, so all children are tested at once.
+struct rcChunkyTriMeshWideNode
+{
+	float bminX[4];
+	float bminY[4];
+	float bmaxX[4];
+	float bmaxY[4];
+	/// Wide node index if >= 0, otherwise leaf chunk index in nodes array encoded as -(index + 1).
+	int child[4];
+	int nchildren;
+};
+
 struct rcChunkyTriMesh
 {
-	inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {};
-	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; }
+	inline rcChunkyTriMesh() : nodes(0), nnodes(0), wideNodes(0), nwideNodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {};
+	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] wideNodes; delete [] tris; }
 
 	rcChunkyTriMeshNode* nodes;
 	int nnodes;
+	rcChunkyTriMeshWideNode* wideNodes;
+	int nwideNodes;
 	int* tris;
 	int ntris;
 	int maxTrisPerChunk;
@@ -46,14 +63,25 @@ private:
 
 /// Creates partitioned triangle mesh (AABB tree),
 /// where each node contains at max trisPerChunk triangles.
+/// Subtrees of big meshes are split in parallel, when threads > 1.
 bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-						   int trisPerChunk, rcChunkyTriMesh* cm);
+						   int trisPerChunk, rcChunkyTriMesh* cm, int threads = 1);
 
 /// Returns the chunk indices which overlap the input rectable.
+/// At most maxIds indices are written.
 int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, float bmin[2], float bmax[2], int* ids, const int maxIds);
 
+/// Returns the chunk indices which overlap the input rectable.
+/// Output vector grows to fit all overlapping chunks.
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, const float bmin[2], const float bmax[2], std::vector<int>& ids);
+
 /// Returns the chunk indices which overlap the input segment.
+/// At most maxIds indices are written.
 int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm, float p[2], float q[2], int* ids, const int maxIds);
 
+/// Returns the chunk indices which overlap the input segment.
+/// Output vector grows to fit all overlapping chunks.
+int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm, const float p[2], const float q[2], std::vector<int>& ids);
+
 
 #endif // CHUNKYTRIMESH_H
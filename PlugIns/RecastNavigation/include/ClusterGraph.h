@@ -0,0 +1,304 @@
+#ifndef _ClusterGraph_H_
+#define _ClusterGraph_H_
+
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "DetourNavMesh.h"
+
+namespace Gsage {
+
+  /**
+   * Simple least recently used cache
+   */
+  template<typename K, typename V, typename H = std::hash<K>>
+  class LRUCache
+  {
+    public:
+      LRUCache(size_t capacity)
+        : mCapacity(capacity)
+      {
+      }
+
+      /**
+       * Get cached value and mark it as recently used
+       *
+       * @param key Key
+       *
+       * @return pointer to value, nullptr if not found
+       */
+      V* get(const K& key)
+      {
+        auto iter = mIndex.find(key);
+        if(iter == mIndex.end()) {
+          return nullptr;
+        }
+
+        mItems.splice(mItems.begin(), mItems, iter->second);
+        return &iter->second->second;
+      }
+
+      /**
+       * Put value to the cache, evicts least recently used value if cache is full
+       *
+       * @param key Key
+       * @param value Value
+       */
+      void put(const K& key, V value)
+      {
+        if(mCapacity == 0) {
+          return;
+        }
+
+        auto iter = mIndex.find(key);
+        if(iter != mIndex.end()) {
+          iter->second->second = std::move(value);
+          mItems.splice(mItems.begin(), mItems, iter->second);
+          return;
+        }
+
+        if(mItems.size() >= mCapacity) {
+          mIndex.erase(mItems.back().first);
+          mItems.pop_back();
+        }
+
+        mItems.emplace_front(key, std::move(value));
+        mIndex[key] = mItems.begin();
+      }
+
+      /**
+       * Remove all values
+       */
+      void clear()
+      {
+        mItems.clear();
+        mIndex.clear();
+      }
+
+      /**
+       * Remove all values matching the predicate
+       *
+       * @param pred Callable, that accepts key and value
+       *
+       * @return count of removed values
+       */
+      template<typename P>
+      size_t removeIf(P pred)
+      {
+        size_t count = 0;
+        for(auto iter = mItems.begin(); iter != mItems.end();) {
+          if(pred(iter->first, iter->second)) {
+            mIndex.erase(iter->first);
+            iter = mItems.erase(iter);
+            count++;
+            continue;
+          }
+          ++iter;
+        }
+        return count;
+      }
+
+      /**
+       * Set cache capacity
+       */
+      void setCapacity(size_t capacity)
+      {
+        mCapacity = capacity;
+        while(mItems.size() > mCapacity) {
+          mIndex.erase(mItems.back().first);
+          mItems.pop_back();
+        }
+      }
+
+      inline size_t size() const { return mItems.size(); }
+    private:
+      typedef std::list<std::pair<K, V>> Items;
+      Items mItems;
+      std::unordered_map<K, typename Items::iterator, H> mIndex;
+      size_t mCapacity;
+  };
+
+  /**
+   * Hash of the poly refs pair, poly refs can be 64 bit wide
+   */
+  struct PolyPairHash
+  {
+    size_t operator()(const std::pair<dtPolyRef, dtPolyRef>& value) const
+    {
+      size_t res = std::hash<dtPolyRef>()(value.first);
+      res ^= std::hash<dtPolyRef>()(value.second) + 0x9e3779b9 + (res << 6) + (res >> 2);
+      return res;
+    }
+  };
+
+  /**
+   * Abstract graph of navmesh tiles.
+   *
+   * Each navmesh tile (layer) is a cluster, clusters are connected if any poly
+   * of one tile has a link to a poly of another tile.
+   * Used to find coarse paths across the whole navmesh, which are then refined in sections.
+   * Graph is built once for the baked navmesh, tiles rebuilt by the tile cache
+   * update only their own clusters and the clusters of their neighbours.
+   */
+  class ClusterGraph
+  {
+    public:
+      /**
+       * Boundary poly of the source cluster, that is linked to the target cluster
+       */
+      struct Portal
+      {
+        dtPolyRef poly;
+        // poly center, used as a section waypoint
+        float pos[3];
+      };
+
+      struct Edge
+      {
+        int to;
+        float cost;
+        std::vector<Portal> portals;
+      };
+
+      struct Node
+      {
+        Node() : tileRef(0) {}
+
+        dtTileRef tileRef;
+        float center[3];
+        std::vector<Edge> edges;
+      };
+
+      typedef std::vector<int> Clusters;
+
+      ClusterGraph(size_t cacheSize = 256);
+      virtual ~ClusterGraph();
+
+      /**
+       * Build graph for the navmesh
+       *
+       * @param navMesh Nav mesh
+       * @param revision Nav mesh revision the graph is built for
+       */
+      void build(const dtNavMesh* navMesh, unsigned int revision);
+
+      /**
+       * Rebuild clusters of the tiles, which were changed since the last build or update,
+       * and the clusters linked to them. Cached paths through these clusters are dropped
+       *
+       * @param revision Nav mesh revision
+       * @param dirty Output list of rebuilt clusters
+       */
+      void update(unsigned int revision, std::vector<int>& dirty);
+
+      /**
+       * Get navmesh revision this graph was built for
+       */
+      inline unsigned int getRevision() const { return mRevision; }
+
+      /**
+       * Check if graph was built
+       */
+      inline bool isBuilt() const { return mNavMesh != nullptr; }
+
+      /**
+       * Get cluster id of the poly
+       *
+       * @param ref Poly ref
+       *
+       * @return cluster id, -1 if the ref is invalid
+       */
+      int getCluster(dtPolyRef ref) const;
+
+      /**
+       * Find path between clusters. Results are cached
+       *
+       * @param start Start cluster
+       * @param end End cluster
+       * @param path Output clusters list, including start and end
+       *
+       * @return false if end cluster is not reachable
+       */
+      bool findClusterPath(int start, int end, Clusters& path);
+
+      /**
+       * Get edge between two clusters
+       *
+       * @return nullptr if clusters are not connected
+       */
+      const Edge* getEdge(int from, int to) const;
+
+      /**
+       * Set path cache size
+       */
+      void setCacheSize(size_t size);
+
+      /**
+       * Get count of cached cluster paths
+       */
+      inline size_t getCachedPathsCount() const { return mPathCache.size(); }
+    private:
+      typedef unsigned long long CacheKey;
+
+      bool search(int start, int end, Clusters& path);
+
+      /**
+       * Reset node of the tile: tile ref and center
+       *
+       * @param index Tile index
+       */
+      void resetNode(int index);
+
+      /**
+       * Collect edges of the tile from the tile links
+       *
+       * @param index Tile index
+       *
+       * @return edges count
+       */
+      int buildEdges(int index);
+
+      const dtNavMesh* mNavMesh;
+      unsigned int mRevision;
+      std::vector<Node> mNodes;
+
+      // A* working buffers
+      std::vector<float> mCosts;
+      std::vector<int> mParents;
+      std::vector<unsigned int> mVisited;
+      unsigned int mSearchId;
+
+      LRUCache<CacheKey, Clusters> mPathCache;
+  };
+}
+
+#endif
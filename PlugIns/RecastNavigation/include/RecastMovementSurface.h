@@ -47,6 +47,8 @@ namespace Gsage {
       float getHeight(const Gsage::Vector3& position);
     private:
       TileCachePtr mTileCache;
+      // poly the agent was on during the previous query
+      dtPolyRef mLastPoly;
   };
 }
 
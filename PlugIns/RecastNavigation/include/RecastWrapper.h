@@ -47,12 +47,26 @@ namespace Gsage {
     virtual int doGetAccumulatedTime(const rcTimerLabel label) const;
   };
 
+  /**
+   * Compressed tile cache layer
+   */
+  struct TileCacheData
+  {
+    unsigned char* data;
+    int dataSize;
+  };
+
   /**
    * Used to build Recast meshes
    */
   class RecastWrapper
   {
     public:
+      /**
+       * Max heightfield layers per tile
+       */
+      static const int MAX_LAYERS = 32;
+
       RecastWrapper();
       virtual ~RecastWrapper();
 
@@ -73,7 +87,7 @@ namespace Gsage {
       class GeomWrapper
       {
         public:
-          GeomWrapper(GeomPtr geom, int trisPerChunk);
+          GeomWrapper(GeomPtr geom, int trisPerChunk, int threads = 1);
           virtual ~GeomWrapper();
           /**
            * Generate and cache chunky tri mesh
@@ -107,9 +121,51 @@ namespace Gsage {
           GeomPtr mGeom;
           rcChunkyTriMesh* mChunkyMesh;
           int mTrisPerChunk;
+          int mThreads;
+      };
+
+      /**
+       * Rasterization settings, read once per build so tiles can be rasterized concurrently
+       */
+      struct RasterizationConfig
+      {
+        rcConfig cfg;
+        bool filterLowHangingObstacles;
+        bool filterLedgeSpans;
+        bool filterWalkableLowHeightSpans;
       };
 
-      unsigned char* buildTileMesh(GeomWrapper& geom, DataProxy options, const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize);
+      /**
+       * Read rasterization settings from the build options
+       *
+       * @param options Build options
+       */
+      RasterizationConfig readRasterizationConfig(DataProxy options);
+
+      /**
+       * Rasterize tile geometry and split it into compressed heightfield layers.
+       * Thread safe as long as chunky mesh is already built
+       *
+       * @param geom Geometry to rasterize
+       * @param config Rasterization settings
+       * @param tx Tile x-location
+       * @param ty Tile y-location
+       * @param bmin Tile bounds min
+       * @param bmax Tile bounds max
+       * @param tiles Output layers, caller owns the data
+       * @param maxTiles Max count of layers to write
+       *
+       * @return count of built layers
+       */
+      int rasterizeTileLayers(GeomWrapper& geom, const RasterizationConfig& config, const int tx, const int ty, const float* bmin, const float* bmax, TileCacheData* tiles, const int maxTiles);
+
+      /**
+       * Limit tile size, so that the layer with borders fits tile cache layer header
+       *
+       * @param tileSize Requested tile size
+       * @param walkableRadius Walkable radius in cells
+       */
+      int clampTileSize(int tileSize, int walkableRadius);
   };
 }
 
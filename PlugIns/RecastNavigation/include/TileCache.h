@@ -29,20 +29,62 @@ THE SOFTWARE.
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "Recast.h"
 #include "DetourAlloc.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourStatus.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
 
 #include "Path.h"
+#include "ClusterGraph.h"
 
 #define MAX_PATHPOLY      256 // max number of polygons in a path
 #define MAX_PATHVERT      512 // most verts in a path
 
 namespace Gsage {
 
+  /**
+   * Navigation poly flags
+   */
+  enum NavigationPolyFlags
+  {
+    NAV_POLYFLAGS_WALK = 0x01,
+    NAV_POLYFLAGS_DISABLED = 0x10,
+    NAV_POLYFLAGS_ALL = 0xffff
+  };
+
+  /**
+   * Compresses tile cache layers using simple run length encoding.
+   *
+   * Heightfield layers consist of long runs of equal heights and areas,
+   * so RLE gives decent compression ratio without any additional dependencies.
+   */
+  class TileCacheCompressor : public dtTileCacheCompressor
+  {
+    public:
+      virtual ~TileCacheCompressor();
+
+      virtual int maxCompressedSize(const int bufferSize);
+
+      virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+          unsigned char* compressed, const int maxCompressedSize, int* compressedSize);
+
+      virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+          unsigned char* buffer, const int maxBufferSize, int* bufferSize);
+  };
+
+  /**
+   * Tile cache wraps dtTileCache and dtNavMesh.
+   *
+   * Each tile is stored as a set of compressed heightfield layers,
+   * so temporary obstacles can be added and removed at runtime:
+   * only the tiles touched by an obstacle are rebuilt from the layers.
+   */
   class TileCache
   {
     public:
@@ -53,21 +95,26 @@ namespace Gsage {
        * Init tile cache
        *
        * @param params Nav mesh parameters
+       * @param tcparams Tile cache parameters
        * @param config Additional parameters
        */
-      dtStatus init(const dtNavMeshParams* params, DataProxy config);
+      dtStatus init(const dtNavMeshParams* params, const dtTileCacheParams* tcparams, DataProxy config);
 
       /**
-       * Load tile cache data from file
+       * Load tile cache data from file.
+       * Tile cache should not be initialized before this call:
+       * navmesh and tile cache parameters are read from the file
        *
        * @param path Data path
+       * @param config Additional parameters, same as for init call
        *
        * @return true if succeed
        */
-      bool load(const std::string& path);
+      bool load(const std::string& path, DataProxy config = DataProxy());
 
       /**
-       * Dump tile cache data to file
+       * Dump tile cache data to file.
+       * Compressed layers are stored, so temporary obstacles still work after load
        *
        * @param path Data path
        *
@@ -75,6 +122,11 @@ namespace Gsage {
        */
       bool dump(const std::string& path);
 
+      /**
+       * Get count of compressed tile cache layers
+       */
+      int getTileLayerCount() const;
+
       /**
        * Gets the tile at the specified grid location.
        *  @param[in]	x		The tile's x-location. (x, y, layer)
@@ -113,6 +165,89 @@ namespace Gsage {
        */
       dtStatus removeTile(dtTileRef ref, unsigned char** data, int* dataSize);
 
+      /**
+       * Adds compressed heightfield layer to the tile cache.
+       * Tile cache owns the data after this call if it succeeds.
+       *
+       * @param data Layer data built by dtBuildTileCacheLayer
+       * @param dataSize Layer data size
+       *
+       * @return The status flags for the operation
+       */
+      dtStatus addTileLayer(unsigned char* data, int dataSize);
+
+      /**
+       * Builds navmesh tiles at the specified grid location from the compressed layers
+       *
+       * @param tx Tile x-location
+       * @param ty Tile y-location
+       *
+       * @return The status flags for the operation
+       */
+      dtStatus buildNavMeshTilesAt(int tx, int ty);
+
+      /**
+       * Add cylinder obstacle
+       *
+       * @param pos Obstacle bottom center
+       * @param radius Cylinder radius
+       * @param height Cylinder height
+       *
+       * @return obstacle reference, 0 if failed
+       */
+      dtObstacleRef addObstacle(const Gsage::Vector3& pos, float radius, float height);
+
+      /**
+       * Add axis aligned box obstacle
+       *
+       * @param bmin Box min corner
+       * @param bmax Box max corner
+       *
+       * @return obstacle reference, 0 if failed
+       */
+      dtObstacleRef addBoxObstacle(const Gsage::Vector3& bmin, const Gsage::Vector3& bmax);
+
+      /**
+       * Add oriented box obstacle
+       *
+       * @param center Box center
+       * @param halfExtents Box half extents
+       * @param yRadians Box rotation around Y axis
+       *
+       * @return obstacle reference, 0 if failed
+       */
+      dtObstacleRef addBoxObstacle(const Gsage::Vector3& center, const Gsage::Vector3& halfExtents, float yRadians);
+
+      /**
+       * Remove obstacle
+       *
+       * @param ref Obstacle reference
+       *
+       * @return true if removal was scheduled
+       */
+      bool removeObstacle(dtObstacleRef ref);
+
+      /**
+       * Get obstacle count
+       */
+      int getObstacleCount() const;
+
+      /**
+       * Rebuild tiles affected by obstacle changes
+       *
+       * @param dt Elapsed time
+       * @param budget Time budget in microseconds, tiles are rebuilt one by one until it's exhausted
+       *
+       * @return true if navmesh is up to date
+       */
+      bool update(float dt, double budget);
+
+      /**
+       * Build the cluster graph for the baked navmesh, or rebuild clusters of the tiles
+       * changed since the last call. Cached path sections, going through these tiles, are dropped
+       */
+      void updateClusterGraph();
+
       /**
        * Find path using tile cache
        *
@@ -122,13 +257,22 @@ namespace Gsage {
       Path3DPtr findPath(const Gsage::Vector3& start, const Gsage::Vector3& end);
 
       /**
-       * Find path using tile cache
+       * Find path using tile cache.
+       *
+       * Long paths are found using navmesh cluster graph:
+       * coarse path over the tiles is refined section by section,
+       * so path length is not limited by MAX_PATHPOLY
        *
        * @param start Start point
        * @param end End point
        */
       Path3DPtr findPath(const float* start, const float* end);
 
+      /**
+       * Get navmesh revision, it is incremented each time any navmesh tile is rebuilt
+       */
+      inline unsigned int getRevision() const { return mRevision; }
+
       /**
        * Find nearest point on navmesh
        *
@@ -146,6 +290,36 @@ namespace Gsage {
        */
       float getHeight(const Gsage::Vector3& pos);
 
+      /**
+       * Get poly height at point, reusing the poly found by the previous query
+       *
+       * @param pos Position
+       * @param hint Last known poly ref, it is updated with the poly found for this position. Can be null
+       *
+       * @return height, -1 if failed
+       */
+      float getHeight(const Gsage::Vector3& pos, dtPolyRef* hint);
+
+      /**
+       * Get poly height at point
+       *
+       * @param pos Position float[3]
+       * @param hint Last known poly ref, it is updated with the poly found for this position. Can be null
+       *
+       * @return height, -1 if failed
+       */
+      float getHeight(const float* pos, dtPolyRef* hint);
+
+      /**
+       * Get heights for a batch of points
+       *
+       * @param positions Positions array, 3 floats per position
+       * @param count Positions count
+       * @param heights Output heights array, -1 is written for failed points
+       * @param hints Per point poly hints array. Can be null
+       */
+      void getHeights(const float* positions, int count, float* heights, dtPolyRef* hints = nullptr);
+
       // utility methods
 
       /**
@@ -155,11 +329,110 @@ namespace Gsage {
        */
       std::vector<Gsage::Vector3> getPoints() const;
     private:
+      /**
+       * Height and poly, found at the grid cell centre
+       */
+      struct HeightSample
+      {
+        HeightSample(float h = 0, dtPolyRef p = 0) : height(h), poly(p) {}
+
+        float height;
+        dtPolyRef poly;
+      };
+
+      /**
+       * Lazily filled height samples of a single navmesh tile
+       */
+      struct HeightGrid
+      {
+        HeightGrid() : tileRef(0), width(0), height(0) {}
+
+        dtTileRef tileRef;
+        float bmin[3];
+        float bmax[3];
+        int width;
+        int height;
+        std::vector<HeightSample> samples;
+      };
+
+      dtObstacleRef checkObstacleStatus(dtStatus status, dtObstacleRef ref);
+
+      /**
+       * Get the cell sample from the height grid of the tile
+       *
+       * @param pos Position
+       * @param dest Height at the cell centre
+       * @param poly Poly at the cell centre, used as a seed for the exact height query
+       *
+       * @return false if the grid can't be used for this position
+       */
+      bool sampleHeightGrid(const float* pos, float& dest, dtPolyRef& poly);
+
+      /**
+       * Query nearest poly height, using tight extents first
+       */
+      bool queryHeight(const float* pos, const float* extents, dtPolyRef* poly, float& dest);
+
+      /**
+       * Find path between two polys and append straight path points to the vector
+       *
+       * @param allowPartial Accept path which does not reach the end poly
+       * @param clusters Output list of clusters the poly corridor goes through. Can be null
+       *
+       * @return false if failed
+       */
+      bool appendPathSection(dtPolyRef startRef, const float* start, dtPolyRef endRef, const float* end, Path3D::Vector& points, bool allowPartial, std::vector<int>* clusters = nullptr);
+
+      /**
+       * Append path section to the portal, using section cache
+       *
+       * @param cacheable Section starts from the portal, so it can be cached
+       *
+       * @return false if the portal can't be reached
+       */
+      bool appendCachedSection(dtPolyRef fromRef, const float* from, const ClusterGraph::Portal& portal, bool cacheable, Path3D::Vector& points);
+
+      /**
+       * Refine cluster path into the list of points
+       *
+       * @return false if any of the sections failed
+       */
+      bool refineClusterPath(const ClusterGraph::Clusters& clusters, dtPolyRef startRef, const float* start, dtPolyRef endRef, const float* end, Path3D::Vector& points);
+
       dtNavMesh* mNavMesh;
       dtNavMeshQuery* mNavQuery;
       dtQueryFilter* mFilter;
+      dtTileCache* mTileCache;
+      dtTileCacheAlloc* mAllocator;
+      TileCacheCompressor* mCompressor;
+      dtTileCacheMeshProcess* mMeshProcess;
       float mExtents[3];
+      float mHeightExtents[3];
       float* mNormals;
+
+      bool mHeightGridEnabled;
+      float mHeightGridCellSize;
+      std::unordered_map<long long, HeightGrid> mHeightGrids;
+
+      unsigned int mRevision;
+
+      bool mHierarchicalPathEnabled;
+      // count of clusters in each refined path section
+      int mSectionClusters;
+      ClusterGraph mClusterGraph;
+      typedef std::pair<dtPolyRef, dtPolyRef> SectionKey;
+
+      /**
+       * Refined path between two cluster portals
+       */
+      struct PathSection
+      {
+        Path3D::Vector points;
+        // clusters of the poly corridor
+        std::vector<int> clusters;
+      };
+
+      LRUCache<SectionKey, PathSection, PolyPairHash> mSectionCache;
   };
 
   typedef std::shared_ptr<TileCache> TileCachePtr;
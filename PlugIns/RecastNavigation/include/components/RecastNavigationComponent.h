@@ -75,6 +75,23 @@ namespace Gsage {
        * Reset target currently set target
        */
       void resetTarget();
+
+      /**
+       * Check if the entity should be added to the navmesh as a temporary obstacle
+       */
+      bool isObstacle() const;
+
+      /**
+       * Set obstacle settings
+       *
+       * @param value Obstacle settings: type (cylinder/box), radius, height, halfExtents, offset, rotation
+       */
+      void setObstacle(const DataProxy& value);
+
+      /**
+       * Get obstacle settings
+       */
+      const DataProxy& getObstacle() const;
     private:
       friend class RecastNavigationSystem;
 
@@ -86,6 +103,12 @@ namespace Gsage {
       bool mHasTarget;
 
       Gsage::Vector3 mTarget;
+
+      DataProxy mObstacle;
+      // dtObstacleRef of the obstacle added for this component
+      unsigned int mObstacleRef;
+      bool mObstacleDirty;
+      Gsage::Vector3 mObstaclePosition;
   };
 }
 
@@ -41,6 +41,7 @@ namespace Gsage
   class Entity;
   class Engine;
   class RecastNavigationComponent;
+  class RenderComponent;
   class SelectEvent;
 
   class RecastNavigationSystem : public ComponentStorage<RecastNavigationComponent>, public EventSubscriber<RecastNavigationSystem>
@@ -69,6 +70,20 @@ namespace Gsage
        * @param time elapsed time
        */
       void updateComponent(RecastNavigationComponent* component, Entity* entity, const double& time);
+
+      using ComponentStorage<RecastNavigationComponent>::removeComponent;
+
+      /**
+       * Removes component and the obstacle associated with it
+       * @param component Component pointer
+       */
+      bool removeComponent(RecastNavigationComponent* component);
+
+      /**
+       * Update components and rebuild tiles affected by the obstacles
+       * @param time Elapsed time
+       */
+      void update(const double& time);
       /**
        * Rebuilds navigation mesh
        * @param renderer Render system to get all entities from
@@ -76,6 +91,22 @@ namespace Gsage
        * @return true if succeed
        */
       bool rebuild(DataProxy options);
+      /**
+       * Save navigation mesh, so it can be loaded later using "cache" config setting
+       *
+       * @param path File path
+       *
+       * @return true if succeed
+       */
+      bool dump(const std::string& path);
+      /**
+       * Load navigation mesh saved by dump call
+       *
+       * @param path File path
+       *
+       * @return true if succeed
+       */
+      bool load(const std::string& path);
       /**
        * Configures recast movement system
        */
@@ -102,6 +133,16 @@ namespace Gsage
        */
       Path3DPtr findPath(const Gsage::Vector3& start, const Gsage::Vector3& end);
 
+      /**
+       * Get navmesh heights for a batch of points
+       *
+       * @param positions Points to sample
+       * @param heights Output heights, -1 is written for points outside of the navmesh
+       * @param useHints Reuse polys, found by the previous call, by the point index.
+       *        Hints are reset when the batch size changes
+       */
+      void getHeights(const std::vector<Gsage::Vector3>& positions, std::vector<float>& heights, bool useHints = true);
+
       /**
        * Get navigation mesh data, for visualization purposes
        *
@@ -109,11 +150,55 @@ namespace Gsage
        */
       std::vector<Gsage::Vector3> getNavMeshRawPoints() const;
 
+      /**
+       * @copydoc TileCache::addObstacle
+       */
+      unsigned int addObstacle(const Gsage::Vector3& pos, float radius, float height);
+
+      /**
+       * @copydoc TileCache::addBoxObstacle(const Gsage::Vector3&, const Gsage::Vector3&)
+       */
+      unsigned int addBoxObstacle(const Gsage::Vector3& bmin, const Gsage::Vector3& bmax);
+
+      /**
+       * @copydoc TileCache::addBoxObstacle(const Gsage::Vector3&, const Gsage::Vector3&, float)
+       */
+      unsigned int addBoxObstacle(const Gsage::Vector3& center, const Gsage::Vector3& halfExtents, float yRadians);
+
+      /**
+       * @copydoc TileCache::removeObstacle
+       */
+      bool removeObstacle(unsigned int ref);
+
+      /**
+       * Get count of obstacles currently added to the navmesh
+       */
+      int getObstacleCount() const;
+
     private:
+      /**
+       * Add, move or remove component obstacle
+       */
+      void updateObstacle(RecastNavigationComponent* component, RenderComponent* renderComponent);
+
+      /**
+       * Replace current tile cache
+       */
+      void setTileCache(TileCachePtr tileCache);
+
       RecastWrapper mRecast;
       TileCachePtr mTileCache;
+      // path of the loaded navmesh cache
+      std::string mCachePath;
 
       int mAgentCounter;
+
+      // max time to spend on tiles rebuild each frame, microseconds
+      double mTileCacheUpdateBudget;
+      // min distance the obstacle should move to get rebuilt
+      float mObstacleMoveThreshold;
+      // polys found by the last getHeights call
+      std::vector<dtPolyRef> mHeightHints;
   };
 }
 #endif
@@ -20,9 +20,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CHUNKY_TRI_MESH_SSE
+#include <xmmintrin.h>
+#endif
 
 #include "Logger.h"
 
+// subtrees smaller than that are not worth a separate thread
+static const int PARALLEL_SPLIT_THRESHOLD = 1 << 15;
+// wide tree depth is limited by the binary tree depth, which is log2 of the chunks count
+static const int MAX_STACK_SIZE = 256;
+
 struct BoundsItem
 {
   float bmin[2];
@@ -30,28 +42,6 @@ struct BoundsItem
   int i;
 };
 
-static int compareItemX(const void* va, const void* vb)
-{
-  const BoundsItem* a = (const BoundsItem*)va;
-  const BoundsItem* b = (const BoundsItem*)vb;
-  if (a->bmin[0] < b->bmin[0])
-    return -1;
-  if (a->bmin[0] > b->bmin[0])
-    return 1;
-  return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-  const BoundsItem* a = (const BoundsItem*)va;
-  const BoundsItem* b = (const BoundsItem*)vb;
-  if (a->bmin[1] < b->bmin[1])
-    return -1;
-  if (a->bmin[1] > b->bmin[1])
-    return 1;
-  return 0;
-}
-
 static void calcExtends(const BoundsItem* items, const int /*nitems*/,
     const int imin, const int imax,
     float* bmin, float* bmax)
@@ -78,32 +68,39 @@ inline int longestAxis(float x, float y)
   return y > x ? 1 : 0;
 }
 
+/// Count of nodes in the subtree built for inum items.
+/// Split is always done in the middle, so it does not depend on the items themselves
+static int countNodes(int inum, int trisPerChunk)
+{
+  if (inum <= trisPerChunk)
+    return 1;
+
+  const int half = inum / 2;
+  return 1 + countNodes(half, trisPerChunk) + countNodes(inum - half, trisPerChunk);
+}
+
+/// Builds subtree of items [imin, imax) at the nodes[curNode].
+/// Node and triangle offsets are known in advance, so subtrees can be built concurrently
 static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int trisPerChunk,
-    int& curNode, rcChunkyTriMeshNode* nodes, const int maxNodes,
-    int& curTri, int* outTris, const int* inTris)
+    int curNode, rcChunkyTriMeshNode* nodes, int* outTris, const int* inTris, int threads)
 {
   int inum = imax - imin;
-  int icur = curNode;
 
-  if (curNode > maxNodes)
-    return;
-
-  rcChunkyTriMeshNode& node = nodes[curNode++];
+  rcChunkyTriMeshNode& node = nodes[curNode];
 
   if (inum <= trisPerChunk)
   {
     // Leaf
     calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
 
-    // Copy triangles.
-    node.i = curTri;
+    // Copy triangles. Leaves are laid out in the items order
+    node.i = imin;
     node.n = inum;
 
     for (int i = imin; i < imax; ++i)
     {
       const int* src = &inTris[items[i].i*3];
-      int* dst = &outTris[curTri*3];
-      curTri++;
+      int* dst = &outTris[i*3];
       dst[0] = src[0];
       dst[1] = src[1];
       dst[2] = src[2];
@@ -117,36 +114,112 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
     int	axis = longestAxis(node.bmax[0] - node.bmin[0],
         node.bmax[1] - node.bmin[1]);
 
-    if (axis == 0)
+    int isplit = imin+inum/2;
+
+    // Only the median is needed, so partial sort is enough
+    std::nth_element(items + imin, items + isplit, items + imax,
+      [axis] (const BoundsItem& a, const BoundsItem& b) {
+        return a.bmin[axis] < b.bmin[axis];
+      }
+    );
+
+    int left = curNode + 1;
+    int right = left + countNodes(isplit - imin, trisPerChunk);
+
+    if (threads > 1 && inum > PARALLEL_SPLIT_THRESHOLD)
     {
-      // Sort along x-axis
-      qsort(items+imin, static_cast<size_t>(inum), sizeof(BoundsItem), compareItemX);
+      const int leftThreads = threads / 2;
+      std::thread worker(subdivide, items, nitems, imin, isplit, trisPerChunk, left, nodes, outTris, inTris, leftThreads);
+      subdivide(items, nitems, isplit, imax, trisPerChunk, right, nodes, outTris, inTris, threads - leftThreads);
+      worker.join();
     }
-    else if (axis == 1)
+    else
     {
-      // Sort along y-axis
-      qsort(items+imin, static_cast<size_t>(inum), sizeof(BoundsItem), compareItemY);
+      subdivide(items, nitems, imin, isplit, trisPerChunk, left, nodes, outTris, inTris, 1);
+      subdivide(items, nitems, isplit, imax, trisPerChunk, right, nodes, outTris, inTris, 1);
     }
 
-    int isplit = imin+inum/2;
+    // Negative index means escape.
+    node.i = -countNodes(inum, trisPerChunk);
+    node.n = inum;
+  }
+}
 
-    // Left
-    subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
-    // Right
-    subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+/// Size of the binary subtree starting at the node
+inline int subtreeSize(const rcChunkyTriMeshNode* nodes, int index)
+{
+  return nodes[index].i >= 0 ? 1 : -nodes[index].i;
+}
 
-    int iescape = curNode - icur;
-    // Negative index means escape.
-    node.i = -iescape;
+/// Collapses binary subtree into the 4-ary node, returns wide node index
+static int collapse(const rcChunkyTriMeshNode* nodes, int index, std::vector<rcChunkyTriMeshWideNode>& wideNodes)
+{
+  int children[4];
+  int nchildren = 0;
+  if (nodes[index].i >= 0)
+  {
+    children[nchildren++] = index;
+  }
+  else
+  {
+    children[nchildren++] = index + 1;
+    children[nchildren++] = index + 1 + subtreeSize(nodes, index + 1);
+  }
+
+  // Replace inner children by their children while there are free slots
+  for (int k = 0; k < nchildren && nchildren < 4;)
+  {
+    const int c = children[k];
+    if (nodes[c].i >= 0)
+    {
+      ++k;
+      continue;
+    }
+
+    for (int j = nchildren; j > k + 1; --j)
+      children[j] = children[j - 1];
+    children[k] = c + 1;
+    children[k + 1] = c + 1 + subtreeSize(nodes, c + 1);
+    nchildren++;
   }
+
+  const int res = (int)wideNodes.size();
+  wideNodes.push_back(rcChunkyTriMeshWideNode());
+
+  rcChunkyTriMeshWideNode node;
+  node.nchildren = nchildren;
+  for (int k = 0; k < 4; ++k)
+  {
+    if (k >= nchildren)
+    {
+      // empty slots never overlap anything
+      node.bminX[k] = node.bminY[k] = 1.0f;
+      node.bmaxX[k] = node.bmaxY[k] = -1.0f;
+      node.child[k] = 0;
+      continue;
+    }
+
+    const rcChunkyTriMeshNode& child = nodes[children[k]];
+    node.bminX[k] = child.bmin[0];
+    node.bminY[k] = child.bmin[1];
+    node.bmaxX[k] = child.bmax[0];
+    node.bmaxY[k] = child.bmax[1];
+    node.child[k] = child.i >= 0 ? -(children[k] + 1) : collapse(nodes, children[k], wideNodes);
+  }
+
+  wideNodes[res] = node;
+  return res;
 }
 
 bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-    int trisPerChunk, rcChunkyTriMesh* cm)
+    int trisPerChunk, rcChunkyTriMesh* cm, int threads)
 {
-  int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
+  if (trisPerChunk <= 0)
+    return false;
 
-  cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
+  int nnodes = ntris > 0 ? countNodes(ntris, trisPerChunk) : 0;
+
+  cm->nodes = new rcChunkyTriMeshNode[std::max(nnodes, 1)];
   if (!cm->nodes)
     return false;
 
@@ -180,13 +253,12 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
     }
   }
 
-  int curTri = 0;
-  int curNode = 0;
-  subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+  if (ntris > 0)
+    subdivide(items, ntris, 0, ntris, trisPerChunk, 0, cm->nodes, cm->tris, tris, std::max(threads, 1));
 
   delete [] items;
 
-  cm->nnodes = curNode;
+  cm->nnodes = nnodes;
 
   // Calc max tris per node.
   cm->maxTrisPerChunk = 0;
@@ -199,119 +271,229 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
       cm->maxTrisPerChunk = node.n;
   }
 
+  // Build wide tree used for queries
+  std::vector<rcChunkyTriMeshWideNode> wideNodes;
+  wideNodes.reserve(cm->nnodes / 2 + 1);
+  if (cm->nnodes > 0)
+    collapse(cm->nodes, 0, wideNodes);
+
+  cm->nwideNodes = (int)wideNodes.size();
+  cm->wideNodes = new rcChunkyTriMeshWideNode[std::max(cm->nwideNodes, 1)];
+  std::copy(wideNodes.begin(), wideNodes.end(), cm->wideNodes);
+
   return true;
 }
 
-
-inline bool checkOverlapRect(const float amin[2], const float amax[2],
-    const float bmin[2], const float bmax[2])
+/// Tests all children bounds against the rectangle, returns overlap bit mask
+inline int overlapRect(const rcChunkyTriMeshWideNode& node, const float bmin[2], const float bmax[2])
 {
-  bool overlap = true;
-  overlap = (amin[0] > bmax[0] || amax[0] < bmin[0]) ? false : overlap;
-  overlap = (amin[1] > bmax[1] || amax[1] < bmin[1]) ? false : overlap;
-  return overlap;
+#ifdef CHUNKY_TRI_MESH_SSE
+  __m128 overlap = _mm_and_ps(
+    _mm_and_ps(
+      _mm_cmple_ps(_mm_set1_ps(bmin[0]), _mm_loadu_ps(node.bmaxX)),
+      _mm_cmpge_ps(_mm_set1_ps(bmax[0]), _mm_loadu_ps(node.bminX))
+    ),
+    _mm_and_ps(
+      _mm_cmple_ps(_mm_set1_ps(bmin[1]), _mm_loadu_ps(node.bmaxY)),
+      _mm_cmpge_ps(_mm_set1_ps(bmax[1]), _mm_loadu_ps(node.bminY))
+    )
+  );
+  return _mm_movemask_ps(overlap);
+#else
+  int mask = 0;
+  for (int k = 0; k < 4; ++k)
+  {
+    const bool overlap = !(bmin[0] > node.bmaxX[k] || bmax[0] < node.bminX[k]) &&
+      !(bmin[1] > node.bmaxY[k] || bmax[1] < node.bminY[k]);
+    mask |= overlap ? (1 << k) : 0;
+  }
+  return mask;
+#endif
 }
 
-int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
-    float bmin[2], float bmax[2],
-    int* ids, const int maxIds)
+/// Precomputed segment data for the slab test
+struct Segment
 {
-  // Traverse tree
-  int i = 0;
-  int n = 0;
-  while (i < cm->nnodes)
+  Segment(const float p[2], const float q[2])
   {
-    const rcChunkyTriMeshNode* node = &cm->nodes[i];
-    const bool overlap = checkOverlapRect(bmin, bmax, node->bmin, node->bmax);
-    const bool isLeafNode = node->i >= 0;
-
-    if (isLeafNode && overlap)
+    static const float EPSILON = 1e-6f;
+    for (int i = 0; i < 2; ++i)
     {
-      if (n < maxIds)
-      {
-        ids[n] = i;
-        n++;
-      }
-    }
-
-    if (overlap || isLeafNode)
-      i++;
-    else
-    {
-      const int escapeIndex = -node->i;
-      i += escapeIndex;
+      origin[i] = p[i];
+      const float d = q[i] - p[i];
+      parallel[i] = fabsf(d) < EPSILON;
+      ood[i] = parallel[i] ? 0.0f : 1.0f / d;
     }
   }
 
-  return n;
-}
-
-
+  float origin[2];
+  float ood[2];
+  bool parallel[2];
+};
 
-static bool checkOverlapSegment(const float p[2], const float q[2],
-    const float bmin[2], const float bmax[2])
+/// Tests all children bounds against the segment, returns overlap bit mask
+inline int overlapSegment(const rcChunkyTriMeshWideNode& node, const Segment& s)
 {
-  static const float EPSILON = 1e-6f;
-
-  float tmin = 0;
-  float tmax = 1;
-  float d[2];
-  d[0] = q[0] - p[0];
-  d[1] = q[1] - p[1];
-
-  for (int i = 0; i < 2; i++)
+  const float* bmin[2] = {node.bminX, node.bminY};
+  const float* bmax[2] = {node.bmaxX, node.bmaxY};
+#ifdef CHUNKY_TRI_MESH_SSE
+  __m128 tmin = _mm_setzero_ps();
+  __m128 tmax = _mm_set1_ps(1.0f);
+  __m128 overlap = _mm_cmpeq_ps(tmin, tmin);
+  for (int i = 0; i < 2; ++i)
   {
-    if (fabsf(d[i]) < EPSILON)
+    const __m128 lo = _mm_loadu_ps(bmin[i]);
+    const __m128 hi = _mm_loadu_ps(bmax[i]);
+    const __m128 p = _mm_set1_ps(s.origin[i]);
+    if (s.parallel[i])
     {
       // Ray is parallel to slab. No hit if origin not within slab
-      if (p[i] < bmin[i] || p[i] > bmax[i])
-        return false;
+      overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmpge_ps(p, lo), _mm_cmple_ps(p, hi)));
     }
     else
     {
       // Compute intersection t value of ray with near and far plane of slab
-      float ood = 1.0f / d[i];
-      float t1 = (bmin[i] - p[i]) * ood;
-      float t2 = (bmax[i] - p[i]) * ood;
-      if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
-      if (t1 > tmin) tmin = t1;
-      if (t2 < tmax) tmax = t2;
-      if (tmin > tmax) return false;
+      const __m128 ood = _mm_set1_ps(s.ood[i]);
+      const __m128 t1 = _mm_mul_ps(_mm_sub_ps(lo, p), ood);
+      const __m128 t2 = _mm_mul_ps(_mm_sub_ps(hi, p), ood);
+      tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+      tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
     }
   }
-  return true;
+  overlap = _mm_and_ps(overlap, _mm_cmple_ps(tmin, tmax));
+  return _mm_movemask_ps(overlap);
+#else
+  int mask = 0;
+  for (int k = 0; k < 4; ++k)
+  {
+    float tmin = 0;
+    float tmax = 1;
+    bool overlap = true;
+    for (int i = 0; i < 2 && overlap; ++i)
+    {
+      if (s.parallel[i])
+      {
+        // Ray is parallel to slab. No hit if origin not within slab
+        overlap = s.origin[i] >= bmin[i][k] && s.origin[i] <= bmax[i][k];
+      }
+      else
+      {
+        // Compute intersection t value of ray with near and far plane of slab
+        float t1 = (bmin[i][k] - s.origin[i]) * s.ood[i];
+        float t2 = (bmax[i][k] - s.origin[i]) * s.ood[i];
+        if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+        overlap = tmin <= tmax;
+      }
+    }
+    mask |= overlap ? (1 << k) : 0;
+  }
+  return mask;
+#endif
 }
 
-int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm,
-    float p[2], float q[2],
-    int* ids, const int maxIds)
+/// Traverses the wide tree, leaf chunks are reported in the same order as the binary tree walk does
+template<typename Test, typename Output>
+static void traverse(const rcChunkyTriMesh* cm, Test test, Output output)
 {
-  // Traverse tree
-  int i = 0;
-  int n = 0;
-  while (i < cm->nnodes)
+  if (cm->nwideNodes == 0)
+    return;
+
+  int stack[MAX_STACK_SIZE];
+  int size = 0;
+  stack[size++] = 0;
+
+  while (size > 0)
   {
-    const rcChunkyTriMeshNode* node = &cm->nodes[i];
-    const bool overlap = checkOverlapSegment(p, q, node->bmin, node->bmax);
-    const bool isLeafNode = node->i >= 0;
+    const int c = stack[--size];
+    if (c < 0)
+    {
+      if (!output(-c - 1))
+        return;
+      continue;
+    }
 
-    if (isLeafNode && overlap)
+    const rcChunkyTriMeshWideNode& node = cm->wideNodes[c];
+    const int mask = test(node) & ((1 << node.nchildren) - 1);
+    // reversed, so that the first child is visited first
+    for (int k = node.nchildren - 1; k >= 0; --k)
     {
-      if (n < maxIds)
+      if ((mask & (1 << k)) == 0)
+        continue;
+
+      if (size == MAX_STACK_SIZE)
       {
-        ids[n] = i;
-        n++;
+        LOG(ERROR) << "Chunky tri mesh traversal stack overflow";
+        return;
       }
+      stack[size++] = node.child[k];
     }
+  }
+}
 
-    if (overlap || isLeafNode)
-      i++;
-    else
-    {
-      const int escapeIndex = -node->i;
-      i += escapeIndex;
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
+    float bmin[2], float bmax[2],
+    int* ids, const int maxIds)
+{
+  int n = 0;
+  traverse(cm,
+    [bmin, bmax] (const rcChunkyTriMeshWideNode& node) { return overlapRect(node, bmin, bmax); },
+    [ids, maxIds, &n] (int id) {
+      if (n >= maxIds)
+        return false;
+      ids[n++] = id;
+      return true;
     }
-  }
+  );
+  return n;
+}
 
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
+    const float bmin[2], const float bmax[2],
+    std::vector<int>& ids)
+{
+  ids.clear();
+  traverse(cm,
+    [bmin, bmax] (const rcChunkyTriMeshWideNode& node) { return overlapRect(node, bmin, bmax); },
+    [&ids] (int id) {
+      ids.push_back(id);
+      return true;
+    }
+  );
+  return (int)ids.size();
+}
+
+int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm,
+    float p[2], float q[2],
+    int* ids, const int maxIds)
+{
+  int n = 0;
+  Segment s(p, q);
+  traverse(cm,
+    [&s] (const rcChunkyTriMeshWideNode& node) { return overlapSegment(node, s); },
+    [ids, maxIds, &n] (int id) {
+      if (n >= maxIds)
+        return false;
+      ids[n++] = id;
+      return true;
+    }
+  );
   return n;
 }
+
+int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm,
+    const float p[2], const float q[2],
+    std::vector<int>& ids)
+{
+  ids.clear();
+  Segment s(p, q);
+  traverse(cm,
+    [&s] (const rcChunkyTriMeshWideNode& node) { return overlapSegment(node, s); },
+    [&ids] (int id) {
+      ids.push_back(id);
+      return true;
+    }
+  );
+  return (int)ids.size();
+}
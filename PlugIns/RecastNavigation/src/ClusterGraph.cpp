@@ -0,0 +1,315 @@
+/*
+-----------------------------------------------------------------------------
+This file is a part of Gsage engine
+
+Copyright (c) 2014-2018 Artem Chernyshev and contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "ClusterGraph.h"
+#include "DetourCommon.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <queue>
+
+namespace Gsage {
+
+  ClusterGraph::ClusterGraph(size_t cacheSize)
+    : mNavMesh(nullptr)
+    , mRevision(0)
+    , mSearchId(0)
+    , mPathCache(cacheSize)
+  {
+  }
+
+  ClusterGraph::~ClusterGraph()
+  {
+  }
+
+  void ClusterGraph::build(const dtNavMesh* navMesh, unsigned int revision)
+  {
+    mNavMesh = navMesh;
+    mRevision = revision;
+    mPathCache.clear();
+    mNodes.clear();
+    mNodes.resize(navMesh->getMaxTiles());
+
+    for(int i = 0; i < (int)mNodes.size(); ++i) {
+      resetNode(i);
+    }
+
+    int edgesCount = 0;
+    for(int i = 0; i < (int)mNodes.size(); ++i) {
+      edgesCount += buildEdges(i);
+    }
+
+    mCosts.assign(mNodes.size(), FLT_MAX);
+    mParents.assign(mNodes.size(), -1);
+    mVisited.assign(mNodes.size(), 0);
+    mSearchId = 0;
+
+    LOG(DEBUG) << "Built navmesh cluster graph: " << mNodes.size() << " clusters, " << edgesCount << " edges";
+  }
+
+  void ClusterGraph::update(unsigned int revision, std::vector<int>& dirty)
+  {
+    dirty.clear();
+    if(!mNavMesh) {
+      return;
+    }
+    mRevision = revision;
+
+    // rebuilt tile gets a new ref, removed tile has no header
+    std::vector<int> changed;
+    for(int i = 0; i < (int)mNodes.size(); ++i) {
+      const dtMeshTile* tile = mNavMesh->getTile(i);
+      dtTileRef tileRef = tile->header ? mNavMesh->getTileRef(tile) : 0;
+      if(tileRef != mNodes[i].tileRef) {
+        changed.push_back(i);
+      }
+    }
+
+    if(changed.empty()) {
+      return;
+    }
+
+    std::vector<bool> marked(mNodes.size(), false);
+    auto mark = [&] (int index) {
+      if(!marked[index]) {
+        marked[index] = true;
+        dirty.push_back(index);
+      }
+    };
+
+    // links are two way, so the neighbours are the clusters linked before and after the rebuild
+    for(int index : changed) {
+      mark(index);
+      for(auto& edge : mNodes[index].edges) {
+        mark(edge.to);
+      }
+      resetNode(index);
+    }
+
+    for(int index : changed) {
+      buildEdges(index);
+      for(auto& edge : mNodes[index].edges) {
+        mark(edge.to);
+      }
+    }
+
+    for(int index : dirty) {
+      if(std::find(changed.begin(), changed.end(), index) == changed.end()) {
+        buildEdges(index);
+      }
+    }
+
+    // paths through the rebuilt clusters may be blocked now,
+    // unreachable clusters may become reachable
+    size_t dropped = mPathCache.removeIf([&marked] (const CacheKey& key, const Clusters& path) {
+      if(path.empty()) {
+        return true;
+      }
+
+      for(int cluster : path) {
+        if(marked[cluster]) {
+          return true;
+        }
+      }
+      return false;
+    });
+
+    LOG(DEBUG) << "Updated navmesh cluster graph: " << changed.size() << " tiles changed, "
+      << dirty.size() << " clusters rebuilt, " << dropped << " cached paths dropped";
+  }
+
+  void ClusterGraph::resetNode(int index)
+  {
+    Node& node = mNodes[index];
+    node.edges.clear();
+    node.tileRef = 0;
+
+    const dtMeshTile* tile = mNavMesh->getTile(index);
+    if(!tile->header) {
+      return;
+    }
+
+    node.tileRef = mNavMesh->getTileRef(tile);
+    dtVlerp(node.center, tile->header->bmin, tile->header->bmax, 0.5f);
+  }
+
+  int ClusterGraph::buildEdges(int index)
+  {
+    Node& node = mNodes[index];
+    node.edges.clear();
+
+    const dtMeshTile* tile = mNavMesh->getTile(index);
+    if(!tile->header) {
+      return 0;
+    }
+
+    const dtPolyRef base = mNavMesh->getPolyRefBase(tile);
+    for(int ip = 0; ip < tile->header->polyCount; ++ip) {
+      const dtPoly* poly = &tile->polys[ip];
+      for(unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next) {
+        unsigned int salt, it, ipoly;
+        mNavMesh->decodePolyId(tile->links[k].ref, salt, it, ipoly);
+        if((int)it == index) {
+          continue;
+        }
+
+        Edge* edge = nullptr;
+        for(auto& e : node.edges) {
+          if(e.to == (int)it) {
+            edge = &e;
+            break;
+          }
+        }
+
+        if(!edge) {
+          node.edges.emplace_back();
+          edge = &node.edges.back();
+          edge->to = it;
+          edge->cost = dtVdist(node.center, mNodes[it].center);
+        }
+
+        // each border poly can have several links to the same tile
+        dtPolyRef ref = base | (dtPolyRef)ip;
+        if(!edge->portals.empty() && edge->portals.back().poly == ref) {
+          continue;
+        }
+
+        Portal portal;
+        portal.poly = ref;
+        dtVset(portal.pos, 0, 0, 0);
+        for(int v = 0; v < poly->vertCount; ++v) {
+          dtVadd(portal.pos, portal.pos, &tile->verts[poly->verts[v] * 3]);
+        }
+        dtVscale(portal.pos, portal.pos, 1.0f / poly->vertCount);
+        edge->portals.push_back(portal);
+      }
+    }
+
+    return (int)node.edges.size();
+  }
+
+  int ClusterGraph::getCluster(dtPolyRef ref) const
+  {
+    if(!mNavMesh || !mNavMesh->isValidPolyRef(ref)) {
+      return -1;
+    }
+
+    unsigned int salt, it, ip;
+    mNavMesh->decodePolyId(ref, salt, it, ip);
+    return (int)it;
+  }
+
+  bool ClusterGraph::findClusterPath(int start, int end, Clusters& path)
+  {
+    if(start < 0 || end < 0 || start >= (int)mNodes.size() || end >= (int)mNodes.size()) {
+      return false;
+    }
+
+    CacheKey key = ((CacheKey)start << 32) | (CacheKey)end;
+    Clusters* cached = mPathCache.get(key);
+    if(cached) {
+      path = *cached;
+      return !path.empty();
+    }
+
+    bool found = search(start, end, path);
+    // unreachable pairs are cached as well, empty path means no path
+    mPathCache.put(key, found ? path : Clusters());
+    return found;
+  }
+
+  const ClusterGraph::Edge* ClusterGraph::getEdge(int from, int to) const
+  {
+    if(from < 0 || from >= (int)mNodes.size()) {
+      return nullptr;
+    }
+
+    for(auto& edge : mNodes[from].edges) {
+      if(edge.to == to) {
+        return &edge;
+      }
+    }
+    return nullptr;
+  }
+
+  void ClusterGraph::setCacheSize(size_t size)
+  {
+    mPathCache.setCapacity(size);
+  }
+
+  bool ClusterGraph::search(int start, int end, Clusters& path)
+  {
+    path.clear();
+    if(start == end) {
+      path.push_back(start);
+      return true;
+    }
+
+    // visited marks are compared against search id, so buffers are not reset for each search
+    if(++mSearchId == 0) {
+      std::fill(mVisited.begin(), mVisited.end(), 0);
+      mSearchId = 1;
+    }
+
+    typedef std::pair<float, int> QueueItem;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+
+    const float* goal = mNodes[end].center;
+    mCosts[start] = 0.0f;
+    mParents[start] = -1;
+    mVisited[start] = mSearchId;
+    open.emplace(dtVdist(mNodes[start].center, goal), start);
+
+    while(!open.empty()) {
+      int current = open.top().second;
+      open.pop();
+
+      if(current == end) {
+        for(int n = end; n != -1; n = mParents[n]) {
+          path.push_back(n);
+        }
+        std::reverse(path.begin(), path.end());
+        return true;
+      }
+
+      for(auto& edge : mNodes[current].edges) {
+        float cost = mCosts[current] + edge.cost;
+        if(mVisited[edge.to] == mSearchId && cost >= mCosts[edge.to]) {
+          continue;
+        }
+
+        mVisited[edge.to] = mSearchId;
+        mCosts[edge.to] = cost;
+        mParents[edge.to] = current;
+        open.emplace(cost + dtVdist(mNodes[edge.to].center, goal), edge.to);
+      }
+    }
+
+    return false;
+  }
+}
@@ -30,6 +30,7 @@ namespace Gsage {
 
   RecastMovementSurface::RecastMovementSurface(TileCachePtr tileCache)
     : mTileCache(tileCache)
+    , mLastPoly(0)
   {
   }
 
@@ -39,7 +40,7 @@ namespace Gsage {
 
   float RecastMovementSurface::getHeight(const Gsage::Vector3& pos)
   {
-    return mTileCache->getHeight(pos);
+    return mTileCache->getHeight(pos, &mLastPoly);
   }
 
 }
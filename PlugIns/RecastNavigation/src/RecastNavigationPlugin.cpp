@@ -57,6 +57,8 @@ namespace Gsage {
           sol::base_classes, sol::bases<EngineSystem>(),
           "defaultOptions", sol::property(&RecastNavigationSystem::getDefaultOptions),
           "rebuildNavMesh", &RecastNavigationSystem::rebuild,
+          "dumpNavMesh", &RecastNavigationSystem::dump,
+          "loadNavMesh", &RecastNavigationSystem::load,
           "findNearestPointOnNavmesh", &RecastNavigationSystem::findNearestPointOnNavmesh,
           "findPath", [](RecastNavigationSystem* self, Gsage::Vector3 start, Gsage::Vector3 end, sol::this_state s) -> sol::object {
             auto path = self->findPath(start, end);
@@ -69,6 +71,29 @@ namespace Gsage {
             path->dump(t);
             return res;
           },
+          "addObstacle", &RecastNavigationSystem::addObstacle,
+          "addBoxObstacle", sol::overload(
+            (unsigned int(RecastNavigationSystem::*)(const Gsage::Vector3&, const Gsage::Vector3&))&RecastNavigationSystem::addBoxObstacle,
+            (unsigned int(RecastNavigationSystem::*)(const Gsage::Vector3&, const Gsage::Vector3&, float))&RecastNavigationSystem::addBoxObstacle
+          ),
+          "removeObstacle", &RecastNavigationSystem::removeObstacle,
+          "obstacleCount", sol::property(&RecastNavigationSystem::getObstacleCount),
+          "getHeights", [](RecastNavigationSystem* self, sol::table positions, sol::optional<bool> useHints, sol::this_state s){
+            sol::state_view lua(s);
+            std::vector<Gsage::Vector3> points;
+            points.reserve(positions.size());
+            for(size_t i = 1; i <= positions.size(); ++i) {
+              points.push_back(positions.get<Gsage::Vector3>(i));
+            }
+
+            std::vector<float> heights;
+            self->getHeights(points, heights, useHints.value_or(true));
+            sol::table t = lua.create_table(heights.size(), 0);
+            for(size_t i = 0; i < heights.size(); ++i) {
+              t[i + 1] = heights[i];
+            }
+            return t;
+          },
           "getNavMeshRawPoints", [](RecastNavigationSystem* self, sol::this_state s){
             sol::state_view lua(s);
             sol::table t = lua.create_table();
@@ -84,7 +109,8 @@ namespace Gsage {
 
       lua.new_usertype<RecastNavigationComponent>("RecastNavigationComponent",
           sol::base_classes, sol::bases<Reflection>(),
-          "props", sol::property(&RecastNavigationComponent::getProps, &RecastNavigationComponent::setProps),
+          "props", sol::property(&Reflection::getPropsTable, &Reflection::setPropsTable),
+          "obstacle", sol::property(&RecastNavigationComponent::getObstacle, &RecastNavigationComponent::setObstacle),
           "go", sol::overload(
             (void(RecastNavigationComponent::*)(const Gsage::Vector3&))&RecastNavigationComponent::setTarget,
             (void(RecastNavigationComponent::*)(float, float, float))&RecastNavigationComponent::setTarget
@@ -26,11 +26,53 @@ THE SOFTWARE.
 
 #include "RecastWrapper.h"
 #include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include "DetourNavMeshBuilder.h"
+#include "DetourCommon.h"
 
 namespace Gsage {
 
+  static const int EXPECTED_LAYERS_PER_TILE = 4;
+
+  /**
+   * Holds all intermediate data used for a tile rasterization and frees it on destruction
+   */
+  struct RasterizationContext
+  {
+    RasterizationContext()
+      : solid(0)
+      , triareas(0)
+      , lset(0)
+      , chf(0)
+      , ntiles(0)
+    {
+      memset(tiles, 0, sizeof(TileCacheData) * RecastWrapper::MAX_LAYERS);
+    }
+
+    ~RasterizationContext()
+    {
+      rcFreeHeightField(solid);
+      delete [] triareas;
+      rcFreeHeightfieldLayerSet(lset);
+      rcFreeCompactHeightfield(chf);
+      for (int i = 0; i < RecastWrapper::MAX_LAYERS; ++i)
+      {
+        dtFree(tiles[i].data);
+        tiles[i].data = 0;
+      }
+    }
+
+    rcHeightfield* solid;
+    unsigned char* triareas;
+    rcHeightfieldLayerSet* lset;
+    rcCompactHeightfield* chf;
+    TileCacheData tiles[RecastWrapper::MAX_LAYERS];
+    int ntiles;
+  };
+
   inline unsigned int nextPow2(unsigned int v)
   {
     v--;
@@ -93,6 +135,8 @@ namespace Gsage {
     return 0;
   }
 
+  const int RecastWrapper::MAX_LAYERS;
+
   RecastWrapper::RecastWrapper()
   {
   }
@@ -107,14 +151,28 @@ namespace Gsage {
     const float* bmax = geom->getMeshBoundsMax();
 
     int gw = 0, gh = 0;
-    float cellSize;
+    float cellSize, cellHeight;
+    float walkableHeight, walkableRadius, walkableClimb, maxSimplificationError;
     int tileSize, maxTiles, maxPolys;
 
-    tileSize = 300;
+    tileSize = 48;
     cellSize = 0.3;
+    cellHeight = 0.2;
+    walkableHeight = 2.0f;
+    walkableRadius = 3.0f;
+    walkableClimb = 2.0f;
+    maxSimplificationError = 1.3f;
 
     config.read("cellSize", cellSize);
+    config.read("cellHeight", cellHeight);
     config.read("tileSize", tileSize);
+    config.read("walkableHeight", walkableHeight);
+    config.read("walkableRadius", walkableRadius);
+    config.read("walkableClimb", walkableClimb);
+    config.read("maxSimplificationError", maxSimplificationError);
+
+    tileSize = clampTileSize(tileSize, (int)walkableRadius);
+    config.put("tileSize", tileSize);
 
     rcCalcGridSize(bmin, bmax, cellSize, &gw, &gh);
 
@@ -122,10 +180,11 @@ namespace Gsage {
     const int tw = (gw + ts-1) / ts;
     const int th = (gh + ts-1) / ts;
     const float tcs = tileSize * cellSize;
+    const int expectedLayersPerTile = config.get("tileCache.expectedLayersPerTile", EXPECTED_LAYERS_PER_TILE);
 
     // Max tiles and max polys affect how the tile IDs are caculated.
 		// There are 22 bits available for identifying a tile and a polygon.
-		int tileBits = rcMin((int)ilog2(nextPow2(tw * th)), 14);
+		int tileBits = rcMin((int)ilog2(nextPow2(tw * th * expectedLayersPerTile)), 14);
 		if (tileBits > 14) {
       tileBits = 14;
     }
@@ -133,66 +192,145 @@ namespace Gsage {
 		maxTiles = 1 << tileBits;
 		maxPolys = 1 << polyBits;
 
-    float lastBmin[3] = {0.0f};
-    float lastBmax[3] = {0.0f};
-
     int trisPerChunk = 256;
 
     config.read("trisPerChunk", trisPerChunk);
 
-    GeomWrapper geomWrapper(std::move(geom), trisPerChunk);
+    int threads = config.get("buildThreads", 0);
+    if(threads <= 0) {
+      threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    GeomWrapper geomWrapper(std::move(geom), trisPerChunk, threads);
+
+    // walkable parameters are defined in cells, tile cache expects world units
+    dtTileCacheParams tcparams;
+    memset(&tcparams, 0, sizeof(tcparams));
+    rcVcopy(tcparams.orig, bmin);
+    tcparams.cs = cellSize;
+    tcparams.ch = cellHeight;
+    tcparams.width = tileSize;
+    tcparams.height = tileSize;
+    tcparams.walkableHeight = walkableHeight * cellHeight;
+    tcparams.walkableRadius = walkableRadius * cellSize;
+    tcparams.walkableClimb = walkableClimb * cellHeight;
+    tcparams.maxSimplificationError = maxSimplificationError;
+    tcparams.maxTiles = tw * th * expectedLayersPerTile;
+    tcparams.maxObstacles = config.get("tileCache.maxObstacles", 128);
 
     TileCachePtr res = std::make_shared<TileCache>();
     dtNavMeshParams params;
     memset(&params, 0, sizeof(params));
+    rcVcopy(params.orig, bmin);
     params.tileWidth = tileSize * cellSize;
     params.tileHeight = tileSize * cellSize;
     params.maxTiles = maxTiles;
     params.maxPolys = maxPolys;
 
-    res->init(&params, config);
+    if(dtStatusFailed(res->init(&params, &tcparams, config))) {
+      LOG(ERROR) << "Failed to initialize tile cache";
+      return nullptr;
+    }
 
-    for (int y = 0; y < th; ++y)
-    {
-      for (int x = 0; x < tw; ++x)
-      {
-        lastBmin[0] = bmin[0] + x * tcs;
-        lastBmin[1] = bmin[1];
-        lastBmin[2] = bmin[2] + y * tcs;
+    LOG(INFO) << "Building navigation:";
+    LOG(INFO) << "\tTiles: " << tw << " x " << th << ", tile size " << tileSize;
+    LOG(INFO) << "\tConfig: " << dumps(config, DataWrapper::JSON_OBJECT);
+
+    if(!geomWrapper.getChunkyMesh()) {
+      LOG(ERROR) << "Failed to build chunky mesh";
+      return nullptr;
+    }
+
+    RasterizationConfig rasterizationConfig = readRasterizationConfig(config);
+
+    threads = std::min(threads, tw * th);
+    LOG(INFO) << "\tRasterization threads: " << threads;
 
-        lastBmax[0] = bmin[0] + (x + 1) * tcs;
-        lastBmax[1] = bmax[1];
-        lastBmax[2] = bmin[2] + (y + 1) * tcs;
+    // tiles are rasterized independently, layers are added to the tile cache
+    // in the same order afterwards so the result does not depend on the threads count
+    std::vector<std::vector<TileCacheData>> layers(tw * th);
+    std::atomic<int> nextTile(0);
 
-        int dataSize = 0;
-        unsigned char* data = buildTileMesh(geomWrapper, config, x, y, lastBmin, lastBmax, dataSize);
+    auto rasterize = [&] () {
+      TileCacheData tiles[MAX_LAYERS];
+      for(int index = nextTile++; index < tw * th; index = nextTile++) {
+        const int x = index % tw;
+        const int y = index / tw;
+
+        float tileBmin[3];
+        float tileBmax[3];
+        tileBmin[0] = bmin[0] + x * tcs;
+        tileBmin[1] = bmin[1];
+        tileBmin[2] = bmin[2] + y * tcs;
+
+        tileBmax[0] = bmin[0] + (x + 1) * tcs;
+        tileBmax[1] = bmax[1];
+        tileBmax[2] = bmin[2] + (y + 1) * tcs;
+
+        memset(tiles, 0, sizeof(tiles));
+        int ntiles = rasterizeTileLayers(geomWrapper, rasterizationConfig, x, y, tileBmin, tileBmax, tiles, MAX_LAYERS);
+        layers[index].assign(tiles, tiles + ntiles);
+      }
+    };
 
-        // Remove any previous data (navmesh owns and deletes the data).
-				res->removeTile(res->getTileRefAt(x, y, 0), 0, 0);
-        if (data == nullptr) {
+    std::vector<std::thread> workers;
+    for(int i = 1; i < threads; ++i) {
+      workers.push_back(std::thread(rasterize));
+    }
+    rasterize();
+    for(auto& worker : workers) {
+      worker.join();
+    }
+
+    size_t cacheLayerCount = 0;
+    size_t cacheCompressedSize = 0;
+
+    for(auto& tiles : layers)
+    {
+      for(auto& tile : tiles)
+      {
+        // Let the tile cache own the data.
+        dtStatus status = res->addTileLayer(tile.data, tile.dataSize);
+        if (dtStatusFailed(status)) {
+          dtFree(tile.data);
           continue;
         }
 
-				// Let the navmesh own the data.
-				dtStatus status = res->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
-				if (dtStatusFailed(status))
-					dtFree(data);
+        cacheLayerCount++;
+        cacheCompressedSize += tile.dataSize;
+      }
+    }
+
+    // Build initial meshes
+    for (int y = 0; y < th; ++y)
+    {
+      for (int x = 0; x < tw; ++x)
+      {
+        res->buildNavMeshTilesAt(x, y);
       }
     }
+    res->updateClusterGraph();
 
+    LOG(INFO) << "Tile cache layers: " << cacheLayerCount << ", compressed size: " << cacheCompressedSize / 1024.0f << "kB";
     return res;
   }
 
-  unsigned char* RecastWrapper::buildTileMesh(GeomWrapper& geom, DataProxy config, const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+  int RecastWrapper::clampTileSize(int tileSize, int walkableRadius)
   {
-    rcConfig cfg;
-    memset(&cfg, 0, sizeof(cfg));
-
-    rcContext* ctx = new RecastContext();
+    // tile cache layer header stores dimensions as unsigned char
+    const int maxTileSize = 255 - (walkableRadius + 3) * 2;
+    if(tileSize > maxTileSize) {
+      LOG(WARNING) << "Tile size " << tileSize << " is too big for tile cache layers, using " << maxTileSize;
+      return maxTileSize;
+    }
+    return tileSize;
+  }
 
-    //
-    // Step 1. Initialize build config.
-    //
+  RecastWrapper::RasterizationConfig RecastWrapper::readRasterizationConfig(DataProxy config)
+  {
+    RasterizationConfig res;
+    rcConfig& cfg = res.cfg;
+    memset(&cfg, 0, sizeof(cfg));
 
     config.read("cellSize", cfg.cs);
     config.read("cellHeight", cfg.ch);
@@ -209,6 +347,23 @@ namespace Gsage {
     config.read("detailSampleDist", cfg.detailSampleDist);
     config.read("detailSampleMaxError", cfg.detailSampleMaxError);
 
+    res.filterLowHangingObstacles = config.get("filterLowHangingObstacles", true);
+    res.filterLedgeSpans = config.get("filterLedgeSpans", true);
+    res.filterWalkableLowHeightSpans = config.get("filterWalkableLowHeightSpans", true);
+    return res;
+  }
+
+  int RecastWrapper::rasterizeTileLayers(GeomWrapper& geom, const RasterizationConfig& config, const int tx, const int ty, const float* bmin, const float* bmax, TileCacheData* tiles, const int maxTiles)
+  {
+    RecastContext ctx;
+    RasterizationContext rc;
+    TileCacheCompressor comp;
+
+    //
+    // Step 1. Initialize build config.
+    //
+
+    rcConfig cfg = config.cfg;
     cfg.borderSize = cfg.walkableRadius + 3;
 
     if(bmin != nullptr) {
@@ -234,7 +389,6 @@ namespace Gsage {
     float* verts;
     int* tris;
     size_t nverts, ntris;
-    int tileTriCount = 0;
 
     std::tie(verts, nverts) = geom.getVerts();
     std::tie(tris, ntris) = geom.getTris();
@@ -242,38 +396,35 @@ namespace Gsage {
     // Recast always multiplies current index by 3 so it should have ntris 3 times smaller
     ntris /= 3;
 
-    LOG(INFO) << "Building navigation:";
-    LOG(INFO) << "\tDimensions: " << cfg.width << " x " << cfg.height << " cells";
-    LOG(INFO) << "\tConfig: " << dumps(config, DataWrapper::JSON_OBJECT);
-    LOG(INFO) << "\tGeom: " << nverts/1000.0 << "K verts, " << ntris/1000.0 << "K tris";
-
-
     rcChunkyTriMesh* chunkyMesh = geom.getChunkyMesh();
+    if(!chunkyMesh) {
+      return 0;
+    }
 
     //
     // Step 2. Rasterize input polygon soup.
     //
 
-    rcHeightfield* solid = rcAllocHeightfield();
-    if(!solid) {
+    rc.solid = rcAllocHeightfield();
+    if(!rc.solid) {
       LOG(ERROR) << "Out of memory 'solid'";
-      return nullptr;
+      return 0;
     }
 
-    if (!rcCreateHeightfield(ctx, *solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+    if (!rcCreateHeightfield(&ctx, *rc.solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
     {
       LOG(ERROR) << "Could not create solid heightfield";
-      return nullptr;
+      return 0;
     }
 
     // Allocate array that can hold triangle flags.
     // If you have multiple meshes you need to process, allocate
     // and array which can hold the max number of triangles you need to process.
-    unsigned char* triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
-    if (!triareas)
+    rc.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+    if (!rc.triareas)
     {
       LOG(ERROR) << "Out of memory 'triareas'" << chunkyMesh->maxTrisPerChunk;
-      return nullptr;
+      return 0;
     }
 
     float tbmin[2], tbmax[2];
@@ -282,34 +433,28 @@ namespace Gsage {
     tbmax[0] = cfg.bmax[0];
     tbmax[1] = cfg.bmax[2];
 
-    int cid[512];// TODO: Make grow when returning too many items.
-    const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+    std::vector<int> cid;
+    const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid);
     if (!ncid)
       return 0;
 
-    tileTriCount = 0;
-
     for (int i = 0; i < ncid; ++i)
     {
       const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
       const int* ctris = &chunkyMesh->tris[node.i * 3];
       const size_t nctris = node.n;
 
-      tileTriCount += nctris;
+      memset(rc.triareas, 0, nctris*sizeof(unsigned char));
+      rcMarkWalkableTriangles(&ctx, cfg.walkableSlopeAngle,
+          verts, nverts, ctris, nctris, rc.triareas);
 
-      memset(triareas, 0, nctris*sizeof(unsigned char));
-      rcMarkWalkableTriangles(ctx, cfg.walkableSlopeAngle,
-          verts, nverts, ctris, nctris, triareas);
-
-      if (!rcRasterizeTriangles(ctx, verts, nverts, ctris, triareas, nctris, *solid, cfg.walkableClimb))
+      if (!rcRasterizeTriangles(&ctx, verts, nverts, ctris, rc.triareas, nctris, *rc.solid, cfg.walkableClimb))
       {
         LOG(ERROR) << "Failed to rasterize triangles";
-        return nullptr;
+        return 0;
       }
     }
 
-    delete [] triareas;
-
     //
     // Step 3. Filter walkables surfaces.
     //
@@ -317,40 +462,38 @@ namespace Gsage {
     // Once all geometry is rasterized, we do initial pass of filtering to
     // remove unwanted overhangs caused by the conservative rasterization
     // as well as filter spans where the character cannot possibly stand.
-    if (config.get("filterLowHangingObstacles", true))
-      rcFilterLowHangingWalkableObstacles(ctx, cfg.walkableClimb, *solid);
-    if (config.get("filterLedgeSpans", true))
-      rcFilterLedgeSpans(ctx, cfg.walkableHeight, cfg.walkableClimb, *solid);
-    if (config.get("filterWalkableLowHeightSpans", true))
-      rcFilterWalkableLowHeightSpans(ctx, cfg.walkableHeight, *solid);
+    if (config.filterLowHangingObstacles)
+      rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, *rc.solid);
+    if (config.filterLedgeSpans)
+      rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, *rc.solid);
+    if (config.filterWalkableLowHeightSpans)
+      rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, *rc.solid);
 
     //
-    // Step 4. Partition walkable surface to simple regions.
+    // Step 4. Build compact heightfield.
     //
 
     // Compact the heightfield so that it is faster to handle from now on.
     // This will result more cache coherent data as well as the neighbours
     // between walkable cells will be calculated.
-    rcCompactHeightfield* chf = rcAllocCompactHeightfield();
-    if (!chf)
+    rc.chf = rcAllocCompactHeightfield();
+    if (!rc.chf)
     {
       LOG(ERROR) << "Out of memory 'compact heightfield'";
-      return nullptr;
+      return 0;
     }
 
-    if (!rcBuildCompactHeightfield(ctx, cfg.walkableHeight, cfg.walkableClimb, *solid, *chf))
+    if (!rcBuildCompactHeightfield(&ctx, cfg.walkableHeight, cfg.walkableClimb, *rc.solid, *rc.chf))
     {
       LOG(ERROR) << "Could not build compact data";
-      return nullptr;
+      return 0;
     }
 
-    rcFreeHeightField(solid);
-
     // Erode the walkable area by agent radius.
-    if (!rcErodeWalkableArea(ctx, cfg.walkableRadius, *chf))
+    if (!rcErodeWalkableArea(&ctx, cfg.walkableRadius, *rc.chf))
     {
       LOG(ERROR) << "Could not erode walkable area";
-      return nullptr;
+      return 0;
     }
 
     // TODO:
@@ -359,150 +502,83 @@ namespace Gsage {
     //for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
     //  rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *m_chf);
 
-    // Prepare for region partitioning, by calculating distance field along the walkable surface.
-    if (!rcBuildDistanceField(ctx, *chf))
-    {
-      LOG(ERROR) << "Could not build distance field";
-      return nullptr;
-    }
-
-    // Partition the walkable surface into simple regions without holes.
-    if (!rcBuildRegions(ctx, *chf, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea))
-    {
-      LOG(ERROR) << "Could not build watershed regions";
-      return nullptr;
-    }
-
     //
-    // Step 5. Trace and simplify region contours.
+    // Step 5. Split the walkable surface into heightfield layers.
     //
 
-    // Create contours.
-    rcContourSet* cset = rcAllocContourSet();
-    if (!cset)
-    {
-      LOG(ERROR) << " Out of memory 'cset'";
-      return nullptr;
-    }
-
-    if (!rcBuildContours(ctx, *chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *cset))
+    // Regions, contours and polygons are built later by the tile cache,
+    // so obstacles can be stamped into the layers before that.
+    rc.lset = rcAllocHeightfieldLayerSet();
+    if (!rc.lset)
     {
-      LOG(ERROR) << "Could not create contours";
-      return nullptr;
+      LOG(ERROR) << "Out of memory 'lset'";
+      return 0;
     }
 
-    // Build polygon navmesh from the contours.
-    rcPolyMesh* pmesh = rcAllocPolyMesh();
-    if (!pmesh)
+    if (!rcBuildHeightfieldLayers(&ctx, *rc.chf, cfg.borderSize, cfg.walkableHeight, *rc.lset))
     {
-      LOG(ERROR) << "Out of memory 'pmesh'.";
-      return nullptr;
-    }
-    if (!rcBuildPolyMesh(ctx, *cset, cfg.maxVertsPerPoly, *pmesh))
-    {
-      LOG(ERROR) << "Could not triangulate contours.";
-      return nullptr;
+      LOG(ERROR) << "Could not build heighfield layers";
+      return 0;
     }
 
     //
-    // Step 6. Create detail mesh which allows to access approximate height on each polygon.
+    // Step 6. Compress layers.
     //
 
-    rcPolyMeshDetail* dmesh = rcAllocPolyMeshDetail();
-    if (!dmesh)
-    {
-      LOG(ERROR) << "Out of memory 'pmdtl'.";
-      return nullptr;
-    }
-
-    if (!rcBuildPolyMeshDetail(ctx, *pmesh, *chf, cfg.detailSampleDist, cfg.detailSampleMaxError, *dmesh))
-    {
-      LOG(ERROR) << "Could not build detail mesh.";
-      return nullptr;
-    }
-
-    rcFreeCompactHeightfield(chf);
-    chf = 0;
-    rcFreeContourSet(cset);
-    cset = 0;
-
-    unsigned char* navData = 0;
-    int navDataSize = 0;
-    float tileMemUsage = 0.0f;
-
-    if (cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON)
+    rc.ntiles = 0;
+    for (int i = 0; i < rcMin(rc.lset->nlayers, MAX_LAYERS); ++i)
     {
-      if (pmesh->nverts >= 0xffff)
-      {
-        // The vertex indices are ushorts, and cannot point to more than 0xffff vertices.
-        LOG(ERROR) << "Too many vertices per tile " << pmesh->nverts << " (max: " << 0xffff << ")";
-        return nullptr;
-      }
-
-      // Update poly flags from areas.
-      // TODO:
-      for (int i = 0; i < pmesh->npolys; ++i)
-      {
-        if (pmesh->areas[i] == RC_WALKABLE_AREA) {
-          pmesh->flags[i] = 1;
-        }
-
-      }
-
-      dtNavMeshCreateParams params;
-      memset(&params, 0, sizeof(params));
-      params.verts = pmesh->verts;
-      params.vertCount = pmesh->nverts;
-      params.polys = pmesh->polys;
-      params.polyAreas = pmesh->areas;
-      params.polyFlags = pmesh->flags;
-      params.polyCount = pmesh->npolys;
-      params.nvp = pmesh->nvp;
-      params.detailMeshes = dmesh->meshes;
-      params.detailVerts = dmesh->verts;
-      params.detailVertsCount = dmesh->nverts;
-      params.detailTris = dmesh->tris;
-      params.detailTriCount = dmesh->ntris;
-      /*
-      params.offMeshConVerts = geom->getOffMeshConnectionVerts();
-      params.offMeshConRad = geom->getOffMeshConnectionRads();
-      params.offMeshConDir = geom->getOffMeshConnectionDirs();
-      params.offMeshConAreas = m_geom->getOffMeshConnectionAreas();
-      params.offMeshConFlags = m_geom->getOffMeshConnectionFlags();
-      params.offMeshConUserID = m_geom->getOffMeshConnectionId();
-      params.offMeshConCount = m_geom->getOffMeshConnectionCount();
-      */
-      config.read("agentHeight", params.walkableHeight);
-      config.read("agentMaxClimb", params.walkableClimb);
-      params.tileX = tx;
-      params.tileY = ty;
-      params.tileLayer = 0;
-      rcVcopy(params.bmin, pmesh->bmin);
-      rcVcopy(params.bmax, pmesh->bmax);
-      params.cs = cfg.cs;
-      params.ch = cfg.ch;
-      params.buildBvTree = true;
-
-      if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+      TileCacheData* tile = &rc.tiles[rc.ntiles++];
+      const rcHeightfieldLayer* layer = &rc.lset->layers[i];
+
+      // Store header
+      dtTileCacheLayerHeader header;
+      header.magic = DT_TILECACHE_MAGIC;
+      header.version = DT_TILECACHE_VERSION;
+
+      // Tile layer location in the navmesh.
+      header.tx = tx;
+      header.ty = ty;
+      header.tlayer = i;
+      dtVcopy(header.bmin, layer->bmin);
+      dtVcopy(header.bmax, layer->bmax);
+
+      // Tile info.
+      header.width = (unsigned char)layer->width;
+      header.height = (unsigned char)layer->height;
+      header.minx = (unsigned char)layer->minx;
+      header.maxx = (unsigned char)layer->maxx;
+      header.miny = (unsigned char)layer->miny;
+      header.maxy = (unsigned char)layer->maxy;
+      header.hmin = (unsigned short)layer->hmin;
+      header.hmax = (unsigned short)layer->hmax;
+
+      dtStatus status = dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons,
+          &tile->data, &tile->dataSize);
+      if (dtStatusFailed(status))
       {
-        LOG(ERROR) << "Could not build Detour navmesh.";
-        return nullptr;
+        LOG(ERROR) << "Failed to compress tile cache layer";
+        return 0;
       }
     }
-    tileMemUsage = navDataSize/1024.0f;
-
-    LOG(INFO) << "Nav mesh mem usage: " << tileMemUsage;
 
-    dataSize = navDataSize;
+    // Transfer ownership of tile data from build context to the caller.
+    int n = 0;
+    for (int i = 0; i < rcMin(rc.ntiles, maxTiles); ++i)
+    {
+      tiles[n++] = rc.tiles[i];
+      rc.tiles[i].data = 0;
+      rc.tiles[i].dataSize = 0;
+    }
 
-    delete ctx;
-    return navData;
+    return n;
   }
 
-  RecastWrapper::GeomWrapper::GeomWrapper(GeomPtr geom, int trisPerChunk)
+  RecastWrapper::GeomWrapper::GeomWrapper(GeomPtr geom, int trisPerChunk, int threads)
     : mChunkyMesh(nullptr)
     , mGeom(std::move(geom))
     , mTrisPerChunk(trisPerChunk)
+    , mThreads(threads)
   {
   }
 
@@ -530,7 +606,7 @@ namespace Gsage {
       std::tie(verts, nverts) = mGeom->getVerts();
       std::tie(tris, ntris) = mGeom->getTris();
 
-      if (!rcCreateChunkyTriMesh(verts, tris, ntris / 3, mTrisPerChunk, mChunkyMesh))
+      if (!rcCreateChunkyTriMesh(verts, tris, ntris / 3, mTrisPerChunk, mChunkyMesh, mThreads))
       {
         LOG(ERROR) << "buildTiledNavigation: Failed to build chunky mesh.";
         mChunkyMesh = nullptr;
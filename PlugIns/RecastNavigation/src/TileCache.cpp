@@ -26,40 +26,303 @@ THE SOFTWARE.
 
 #include "TileCache.h"
 #include "Logger.h"
+#include "DetourCommon.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
 
 namespace Gsage {
 
+  static const int TILECACHESET_MAGIC = 'T'<<24 | 'S'<<16 | 'E'<<8 | 'T';
+  static const int TILECACHESET_VERSION = 1;
+
+  /**
+   * Persisted tile cache file header
+   */
+  struct TileCacheSetHeader
+  {
+    int magic;
+    int version;
+    int numTiles;
+    dtNavMeshParams meshParams;
+    dtTileCacheParams cacheParams;
+  };
+
+  /**
+   * Persisted compressed layer header, followed by the layer data
+   */
+  struct TileCacheTileHeader
+  {
+    dtCompressedTileRef tileRef;
+    int dataSize;
+  };
+
+  /**
+   * Linear allocator for tile cache layer processing.
+   * Falls back to dtAlloc when the preallocated buffer is exhausted.
+   */
+  class TileCacheAllocator : public dtTileCacheAlloc
+  {
+    public:
+      TileCacheAllocator(size_t capacity)
+        : mBuffer(nullptr)
+        , mCapacity(0)
+        , mTop(0)
+        , mHigh(0)
+      {
+        resize(capacity);
+      }
+
+      virtual ~TileCacheAllocator()
+      {
+        reset();
+        dtFree(mBuffer);
+      }
+
+      void resize(size_t capacity)
+      {
+        if(mBuffer) {
+          dtFree(mBuffer);
+        }
+        mBuffer = (unsigned char*)dtAlloc(capacity, DT_ALLOC_PERM);
+        mCapacity = capacity;
+      }
+
+      virtual void reset()
+      {
+        for(void* ptr : mOverflow) {
+          dtFree(ptr);
+        }
+        mOverflow.clear();
+
+        // grow the buffer, so the next build does not overflow
+        if(mHigh > mCapacity) {
+          resize(mHigh);
+        }
+        mHigh = 0;
+        mTop = 0;
+      }
+
+      virtual void* alloc(const size_t size)
+      {
+        if(!mBuffer) {
+          return nullptr;
+        }
+
+        // keep allocations aligned
+        size_t aligned = (size + 15) & ~((size_t)15);
+        mHigh = std::max(mHigh, mTop + aligned);
+        if(mTop + aligned > mCapacity) {
+          void* ptr = dtAlloc(size, DT_ALLOC_TEMP);
+          if(ptr) {
+            mOverflow.push_back(ptr);
+          }
+          return ptr;
+        }
+
+        unsigned char* mem = &mBuffer[mTop];
+        mTop += aligned;
+        return mem;
+      }
+
+      virtual void free(void* /*ptr*/)
+      {
+        // memory is released by reset call
+      }
+    private:
+      unsigned char* mBuffer;
+      size_t mCapacity;
+      size_t mTop;
+      size_t mHigh;
+      std::vector<void*> mOverflow;
+  };
+
+  /**
+   * Sets navigation poly flags for tiles rebuilt by the tile cache
+   */
+  class TileCacheMeshProcess : public dtTileCacheMeshProcess
+  {
+    public:
+      TileCacheMeshProcess(unsigned int* revision)
+        : mRevision(revision)
+      {
+      }
+
+      virtual ~TileCacheMeshProcess()
+      {
+      }
+
+      virtual void process(dtNavMeshCreateParams* params, unsigned char* polyAreas, unsigned short* polyFlags)
+      {
+        // called for each rebuilt tile
+        (*mRevision)++;
+        for(int i = 0; i < params->polyCount; ++i) {
+          if(polyAreas[i] == DT_TILECACHE_WALKABLE_AREA) {
+            polyAreas[i] = RC_WALKABLE_AREA;
+            polyFlags[i] = NAV_POLYFLAGS_WALK;
+          }
+        }
+      }
+    private:
+      unsigned int* mRevision;
+  };
+
+  TileCacheCompressor::~TileCacheCompressor()
+  {
+  }
+
+  int TileCacheCompressor::maxCompressedSize(const int bufferSize)
+  {
+    // each literal block of 128 bytes adds one control byte
+    return bufferSize + bufferSize / 128 + 2;
+  }
+
+  dtStatus TileCacheCompressor::compress(const unsigned char* buffer, const int bufferSize,
+      unsigned char* compressed, const int maxCompressedSize, int* compressedSize)
+  {
+    // PackBits like encoding:
+    // control byte 0..127 is followed by (n + 1) literal bytes
+    // control byte 129..255 is followed by one byte, that should be repeated (257 - n) times
+    int i = 0;
+    int out = 0;
+    while(i < bufferSize) {
+      int run = 1;
+      while(i + run < bufferSize && run < 128 && buffer[i + run] == buffer[i]) {
+        run++;
+      }
+
+      if(run >= 3) {
+        if(out + 2 > maxCompressedSize) {
+          return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+        }
+        compressed[out++] = (unsigned char)(257 - run);
+        compressed[out++] = buffer[i];
+        i += run;
+        continue;
+      }
+
+      int start = i;
+      int len = 0;
+      while(i < bufferSize && len < 128) {
+        if(i + 2 < bufferSize && buffer[i] == buffer[i + 1] && buffer[i] == buffer[i + 2]) {
+          break;
+        }
+        i++;
+        len++;
+      }
+
+      if(out + len + 1 > maxCompressedSize) {
+        return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+      }
+      compressed[out++] = (unsigned char)(len - 1);
+      memcpy(&compressed[out], &buffer[start], len);
+      out += len;
+    }
+
+    *compressedSize = out;
+    return DT_SUCCESS;
+  }
+
+  dtStatus TileCacheCompressor::decompress(const unsigned char* compressed, const int compressedSize,
+      unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+  {
+    int i = 0;
+    int out = 0;
+    while(i < compressedSize) {
+      unsigned char control = compressed[i++];
+      if(control < 128) {
+        int len = control + 1;
+        if(i + len > compressedSize || out + len > maxBufferSize) {
+          return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+        }
+        memcpy(&buffer[out], &compressed[i], len);
+        i += len;
+        out += len;
+      } else if(control > 128) {
+        int run = 257 - control;
+        if(i >= compressedSize || out + run > maxBufferSize) {
+          return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+        }
+        memset(&buffer[out], compressed[i++], run);
+        out += run;
+      }
+    }
+
+    *bufferSize = out;
+    return DT_SUCCESS;
+  }
+
   TileCache::TileCache()
     : mNavMesh(nullptr)
     , mNavQuery(nullptr)
     , mFilter(nullptr)
+    , mTileCache(nullptr)
+    , mAllocator(nullptr)
+    , mCompressor(nullptr)
+    , mMeshProcess(nullptr)
+    , mNormals(nullptr)
+    , mHeightGridEnabled(true)
+    , mHeightGridCellSize(0.0f)
+    , mRevision(0)
+    , mHierarchicalPathEnabled(true)
+    , mSectionClusters(4)
+    , mSectionCache(1024)
   {
   }
 
   TileCache::~TileCache()
   {
+    if(mTileCache != nullptr) {
+      dtFreeTileCache(mTileCache);
+    }
     if(mNavMesh != nullptr) {
       dtFreeNavMesh(mNavMesh);
     }
     if(mNavQuery != nullptr) {
       dtFreeNavMeshQuery(mNavQuery);
     }
+    delete mFilter;
+    delete mAllocator;
+    delete mCompressor;
+    delete mMeshProcess;
 	  mNavMesh = nullptr;
+    mTileCache = nullptr;
   }
 
-  dtStatus TileCache::init(const dtNavMeshParams* params, DataProxy config)
+  dtStatus TileCache::init(const dtNavMeshParams* params, const dtTileCacheParams* tcparams, DataProxy config)
   {
     if(mNavMesh != nullptr) {
       return DT_FAILURE;
     }
 
+    mAllocator = new TileCacheAllocator(config.get("tileCache.allocatorSize", 32000));
+    mCompressor = new TileCacheCompressor();
+    mMeshProcess = new TileCacheMeshProcess(&mRevision);
+
+    mTileCache = dtAllocTileCache();
+    if(!mTileCache) {
+      LOG(ERROR) << "Out of memory: mTileCache";
+      return DT_FAILURE;
+    }
+
+    dtStatus s = mTileCache->init(tcparams, mAllocator, mCompressor, mMeshProcess);
+    if(dtStatusFailed(s)) {
+      LOG(ERROR) << "Could not init tile cache";
+      return s;
+    }
+
     mNavMesh = dtAllocNavMesh();
     if(!mNavMesh) {
       LOG(ERROR) << "Out of memory: mNavMesh";
       return DT_FAILURE;
     }
 
-    dtStatus s = mNavMesh->init(params);
+    s = mNavMesh->init(params);
     if(dtStatusFailed(s)) {
       return s;
     }
@@ -70,7 +333,7 @@ namespace Gsage {
     }
 
     mFilter = new dtQueryFilter();
-    mFilter->setIncludeFlags(0xFFFF);    // Include all
+    mFilter->setIncludeFlags(NAV_POLYFLAGS_ALL ^ NAV_POLYFLAGS_DISABLED);
     mFilter->setExcludeFlags(0);         // Exclude none
     // Area flags for polys to consider in search, and their cost
     //
@@ -81,19 +344,157 @@ namespace Gsage {
     // Set default size of box around points to look for nav polygons
     mExtents[0] = 100.0f; mExtents[1] = 100.0f; mExtents[2] = 100.0f;
 
+    // Height queries are done for points which are already close to the navmesh surface,
+    // so a couple of cells around the point is enough
+    mHeightExtents[0] = tcparams->cs * 2;
+    mHeightExtents[1] = std::max(tcparams->walkableHeight, tcparams->ch * 2);
+    mHeightExtents[2] = tcparams->cs * 2;
+
+    mHierarchicalPathEnabled = config.get("hierarchicalPath.enabled", true);
+    mSectionClusters = std::max(1, config.get("hierarchicalPath.sectionTiles", 4));
+    mClusterGraph.setCacheSize(config.get("hierarchicalPath.pathCacheSize", 256));
+    mSectionCache.setCapacity(config.get("hierarchicalPath.sectionCacheSize", 1024));
+
+    mHeightGridEnabled = config.get("heightGrid.enabled", true);
+    mHeightGridCellSize = config.get("heightGrid.cellSize", tcparams->cs);
+    if(mHeightGridCellSize <= 0.0f) {
+      mHeightGridEnabled = false;
+    }
+
     return mNavQuery->init(mNavMesh, config.get("navMeshQuery.maxNodes", 2048));
   }
 
-  bool TileCache::load(const std::string& filepath)
+  bool TileCache::load(const std::string& filepath, DataProxy config)
   {
-    // TODO
-    return false;
+    if(mNavMesh != nullptr) {
+      LOG(ERROR) << "Failed to load tile cache " << filepath << ": tile cache is already initialized";
+      return false;
+    }
+
+    std::ifstream stream(filepath, std::ios::in | std::ios::binary);
+    if(!stream) {
+      LOG(ERROR) << "Failed to open tile cache file " << filepath;
+      return false;
+    }
+
+    TileCacheSetHeader header;
+    if(!stream.read((char*)&header, sizeof(header))) {
+      LOG(ERROR) << "Failed to read tile cache header " << filepath;
+      return false;
+    }
+
+    if(header.magic != TILECACHESET_MAGIC) {
+      LOG(ERROR) << "Failed to load tile cache " << filepath << ": unknown file format";
+      return false;
+    }
+
+    if(header.version != TILECACHESET_VERSION) {
+      LOG(ERROR) << "Failed to load tile cache " << filepath << ": unsupported version " << header.version;
+      return false;
+    }
+
+    if(dtStatusFailed(init(&header.meshParams, &header.cacheParams, config))) {
+      LOG(ERROR) << "Failed to initialize tile cache " << filepath;
+      return false;
+    }
+
+    std::vector<dtCompressedTileRef> refs;
+    refs.reserve(header.numTiles);
+    for(int i = 0; i < header.numTiles; ++i) {
+      TileCacheTileHeader tileHeader;
+      if(!stream.read((char*)&tileHeader, sizeof(tileHeader))) {
+        LOG(ERROR) << "Failed to load tile cache " << filepath << ": unexpected end of file";
+        return false;
+      }
+
+      if(!tileHeader.tileRef || tileHeader.dataSize <= 0) {
+        continue;
+      }
+
+      unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
+      if(!data) {
+        LOG(ERROR) << "Out of memory: tile cache layer";
+        return false;
+      }
+
+      if(!stream.read((char*)data, tileHeader.dataSize)) {
+        dtFree(data);
+        LOG(ERROR) << "Failed to load tile cache " << filepath << ": unexpected end of file";
+        return false;
+      }
+
+      dtCompressedTileRef ref = 0;
+      if(dtStatusFailed(mTileCache->addTile(data, tileHeader.dataSize, DT_COMPRESSEDTILE_FREE_DATA, &ref))) {
+        dtFree(data);
+        continue;
+      }
+      refs.push_back(ref);
+    }
+
+    for(auto ref : refs) {
+      mTileCache->buildNavMeshTile(ref, mNavMesh);
+    }
+    updateClusterGraph();
+
+    LOG(INFO) << "Loaded tile cache " << filepath << ", layers: " << refs.size();
+    return true;
   }
 
   bool TileCache::dump(const std::string& filepath)
   {
-    // TODO
-    return false;
+    if(mTileCache == nullptr || mNavMesh == nullptr) {
+      return false;
+    }
+
+    std::ofstream stream(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!stream) {
+      LOG(ERROR) << "Failed to open tile cache file for writing " << filepath;
+      return false;
+    }
+
+    TileCacheSetHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TILECACHESET_MAGIC;
+    header.version = TILECACHESET_VERSION;
+    header.numTiles = getTileLayerCount();
+    memcpy(&header.cacheParams, mTileCache->getParams(), sizeof(dtTileCacheParams));
+    memcpy(&header.meshParams, mNavMesh->getParams(), sizeof(dtNavMeshParams));
+    stream.write((const char*)&header, sizeof(header));
+
+    for(int i = 0; i < mTileCache->getTileCount(); ++i) {
+      const dtCompressedTile* tile = mTileCache->getTile(i);
+      if(!tile || !tile->header || !tile->dataSize) {
+        continue;
+      }
+
+      TileCacheTileHeader tileHeader;
+      tileHeader.tileRef = mTileCache->getTileRef(tile);
+      tileHeader.dataSize = tile->dataSize;
+      stream.write((const char*)&tileHeader, sizeof(tileHeader));
+      stream.write((const char*)tile->data, tile->dataSize);
+    }
+
+    if(!stream) {
+      LOG(ERROR) << "Failed to write tile cache " << filepath;
+      return false;
+    }
+    return true;
+  }
+
+  int TileCache::getTileLayerCount() const
+  {
+    if(mTileCache == nullptr) {
+      return 0;
+    }
+
+    int count = 0;
+    for(int i = 0; i < mTileCache->getTileCount(); ++i) {
+      const dtCompressedTile* tile = mTileCache->getTile(i);
+      if(tile && tile->header && tile->dataSize) {
+        count++;
+      }
+    }
+    return count;
   }
 
   void TileCache::merge(TileCache* tileCache)
@@ -128,6 +529,168 @@ namespace Gsage {
     return mNavMesh->removeTile(ref, data, dataSize);
   }
 
+  dtStatus TileCache::addTileLayer(unsigned char* data, int dataSize)
+  {
+    if(mTileCache == nullptr) {
+      return DT_FAILURE;
+    }
+
+    return mTileCache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
+  }
+
+  dtStatus TileCache::buildNavMeshTilesAt(int tx, int ty)
+  {
+    if(mTileCache == nullptr || mNavMesh == nullptr) {
+      return DT_FAILURE;
+    }
+
+    return mTileCache->buildNavMeshTilesAt(tx, ty, mNavMesh);
+  }
+
+  dtObstacleRef TileCache::checkObstacleStatus(dtStatus status, dtObstacleRef ref)
+  {
+    if(dtStatusFailed(status)) {
+      if(dtStatusDetail(status, DT_BUFFER_TOO_SMALL)) {
+        LOG(WARNING) << "Failed to add obstacle: too many pending obstacle requests";
+      } else if(dtStatusDetail(status, DT_OUT_OF_MEMORY)) {
+        LOG(WARNING) << "Failed to add obstacle: obstacles limit reached";
+      } else {
+        LOG(WARNING) << "Failed to add obstacle";
+      }
+      return 0;
+    }
+    return ref;
+  }
+
+  dtObstacleRef TileCache::addObstacle(const Gsage::Vector3& pos, float radius, float height)
+  {
+    if(mTileCache == nullptr) {
+      return 0;
+    }
+
+    float p[3] = {(float)pos.X, (float)pos.Y, (float)pos.Z};
+    dtObstacleRef ref = 0;
+    return checkObstacleStatus(mTileCache->addObstacle(p, radius, height, &ref), ref);
+  }
+
+  dtObstacleRef TileCache::addBoxObstacle(const Gsage::Vector3& bmin, const Gsage::Vector3& bmax)
+  {
+    if(mTileCache == nullptr) {
+      return 0;
+    }
+
+    float min[3] = {(float)bmin.X, (float)bmin.Y, (float)bmin.Z};
+    float max[3] = {(float)bmax.X, (float)bmax.Y, (float)bmax.Z};
+    dtObstacleRef ref = 0;
+    return checkObstacleStatus(mTileCache->addBoxObstacle(min, max, &ref), ref);
+  }
+
+  dtObstacleRef TileCache::addBoxObstacle(const Gsage::Vector3& center, const Gsage::Vector3& halfExtents, float yRadians)
+  {
+    if(mTileCache == nullptr) {
+      return 0;
+    }
+
+    float c[3] = {(float)center.X, (float)center.Y, (float)center.Z};
+    float e[3] = {(float)halfExtents.X, (float)halfExtents.Y, (float)halfExtents.Z};
+    dtObstacleRef ref = 0;
+    return checkObstacleStatus(mTileCache->addBoxObstacle(c, e, yRadians, &ref), ref);
+  }
+
+  bool TileCache::removeObstacle(dtObstacleRef ref)
+  {
+    if(mTileCache == nullptr || ref == 0) {
+      return false;
+    }
+
+    dtStatus status = mTileCache->removeObstacle(ref);
+    if(dtStatusFailed(status)) {
+      LOG(WARNING) << "Failed to remove obstacle " << ref;
+      return false;
+    }
+    return true;
+  }
+
+  int TileCache::getObstacleCount() const
+  {
+    if(mTileCache == nullptr) {
+      return 0;
+    }
+
+    int count = 0;
+    for(int i = 0; i < mTileCache->getObstacleCount(); ++i) {
+      const dtTileCacheObstacle* ob = mTileCache->getObstacle(i);
+      if(ob->state != DT_OBSTACLE_EMPTY) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  bool TileCache::update(float dt, double budget)
+  {
+    if(mTileCache == nullptr || mNavMesh == nullptr) {
+      return true;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool upToDate = false;
+    // each update call rebuilds at most one tile, so it's possible to
+    // spread obstacle changes across several frames
+    while(!upToDate) {
+      dtStatus status = mTileCache->update(dt, mNavMesh, &upToDate);
+      if(dtStatusFailed(status)) {
+        LOG(ERROR) << "Failed to update tile cache";
+        break;
+      }
+
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+      if(elapsed.count() >= budget) {
+        break;
+      }
+    }
+
+    updateClusterGraph();
+    return upToDate;
+  }
+
+  void TileCache::updateClusterGraph()
+  {
+    if(!mHierarchicalPathEnabled || mNavMesh == nullptr) {
+      return;
+    }
+
+    if(!mClusterGraph.isBuilt()) {
+      mClusterGraph.build(mNavMesh, mRevision);
+      mSectionCache.clear();
+      return;
+    }
+
+    if(mClusterGraph.getRevision() == mRevision) {
+      return;
+    }
+
+    std::vector<int> dirty;
+    mClusterGraph.update(mRevision, dirty);
+    if(dirty.empty()) {
+      return;
+    }
+
+    std::vector<bool> marked(mNavMesh->getMaxTiles(), false);
+    for(int cluster : dirty) {
+      marked[cluster] = true;
+    }
+
+    mSectionCache.removeIf([&marked] (const SectionKey& key, const PathSection& section) {
+      for(int cluster : section.clusters) {
+        if(cluster < 0 || marked[cluster]) {
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
   Path3DPtr TileCache::findPath(const Gsage::Vector3& start, const Gsage::Vector3& end)
   {
     float s[3] = {(float)start.X, (float)start.Y, (float)start.Z};
@@ -142,46 +705,152 @@ namespace Gsage {
     float startNearest[3];
     dtPolyRef endPoly;
     float endNearest[3];
-    dtPolyRef polyPath[MAX_PATHPOLY];
-    int nVertCount = 0;
-    float straightPath[MAX_PATHVERT * 3];
-    int nPathCount = 0;
 
     // find the start polygon
     status = mNavQuery->findNearestPoly(start, mExtents, mFilter, &startPoly, startNearest);
-    if(dtStatusFailed(status)) {
+    if(dtStatusFailed(status) || startPoly == 0) {
       return nullptr;
     }
 
     // find the end polygon
     status = mNavQuery->findNearestPoly(end, mExtents, mFilter, &endPoly, endNearest) ;
-    if(dtStatusFailed(status)) {
+    if(dtStatusFailed(status) || endPoly == 0) {
       return nullptr;
     }
 
-    status = mNavQuery->findPath(startPoly, endPoly, startNearest, endNearest, mFilter, polyPath, &nPathCount, MAX_PATHPOLY);
-    if(dtStatusFailed(status) || nPathCount == 0) {
+    Path3D::Vector points;
+    if(mHierarchicalPathEnabled) {
+      // graph is kept up to date by the bake and tile cache updates,
+      // this covers tiles built directly through buildNavMeshTilesAt
+      updateClusterGraph();
+
+      // when clusters are not connected, the direct search still returns
+      // the partial path to the poly nearest to the target
+      ClusterGraph::Clusters clusters;
+      bool connected = mClusterGraph.findClusterPath(mClusterGraph.getCluster(startPoly), mClusterGraph.getCluster(endPoly), clusters);
+      if(connected && (int)clusters.size() > mSectionClusters + 1) {
+        if(refineClusterPath(clusters, startPoly, startNearest, endPoly, endNearest, points)) {
+          return std::make_shared<Path3D>(points);
+        }
+
+        LOG(DEBUG) << "Failed to refine hierarchical path, falling back to the direct search";
+        points.clear();
+      }
+    }
+
+    if(!appendPathSection(startPoly, startNearest, endPoly, endNearest, points, true)) {
       return nullptr;
     }
 
-    status = mNavQuery->findStraightPath(startNearest, endNearest, polyPath, nPathCount, straightPath, NULL, NULL, &nVertCount, MAX_PATHVERT);
+    return std::make_shared<Path3D>(points);
+  }
+
+  bool TileCache::refineClusterPath(const ClusterGraph::Clusters& clusters, dtPolyRef startRef, const float* start, dtPolyRef endRef, const float* end, Path3D::Vector& points)
+  {
+    dtPolyRef fromRef = startRef;
+    float from[3];
+    dtVcopy(from, start);
+
+    size_t last = clusters.size() - 1;
+    std::vector<std::pair<float, size_t>> candidates;
+    for(size_t i = mSectionClusters; ; i += mSectionClusters) {
+      if(i >= last) {
+        return appendPathSection(fromRef, from, endRef, end, points, false);
+      }
+
+      const ClusterGraph::Edge* edge = mClusterGraph.getEdge(clusters[i], clusters[i + 1]);
+      if(!edge) {
+        return false;
+      }
+
+      // portals closer to the straight line to the destination are tried first,
+      // the next one is used if the section to the portal is blocked
+      candidates.clear();
+      for(size_t p = 0; p < edge->portals.size(); ++p) {
+        const float* pos = edge->portals[p].pos;
+        candidates.emplace_back(dtVdist(from, pos) + dtVdist(pos, end), p);
+      }
+      std::sort(candidates.begin(), candidates.end());
+
+      const ClusterGraph::Portal* portal = nullptr;
+      for(auto& candidate : candidates) {
+        if(appendCachedSection(fromRef, from, edge->portals[candidate.second], fromRef != startRef, points)) {
+          portal = &edge->portals[candidate.second];
+          break;
+        }
+      }
+
+      if(!portal) {
+        return false;
+      }
+
+      fromRef = portal->poly;
+      dtVcopy(from, portal->pos);
+    }
+  }
+
+  bool TileCache::appendCachedSection(dtPolyRef fromRef, const float* from, const ClusterGraph::Portal& portal, bool cacheable, Path3D::Vector& points)
+  {
+    // sections between two portals are the same for all agents going through them
+    SectionKey key(fromRef, portal.poly);
+    PathSection* cached = cacheable ? mSectionCache.get(key) : nullptr;
+    if(cached) {
+      points.insert(points.end(), cached->points.begin(), cached->points.end());
+      return true;
+    }
+
+    size_t offset = points.size();
+    PathSection section;
+    if(!appendPathSection(fromRef, from, portal.poly, portal.pos, points, false, cacheable ? &section.clusters : nullptr)) {
+      points.erase(points.begin() + offset, points.end());
+      return false;
+    }
+
+    if(cacheable) {
+      section.points.assign(points.begin() + offset, points.end());
+      mSectionCache.put(key, std::move(section));
+    }
+    return true;
+  }
+
+  bool TileCache::appendPathSection(dtPolyRef startRef, const float* start, dtPolyRef endRef, const float* end, Path3D::Vector& points, bool allowPartial, std::vector<int>* clusters)
+  {
+    dtPolyRef polyPath[MAX_PATHPOLY];
+    int nPathCount = 0;
+    float straightPath[MAX_PATHVERT * 3];
+    int nVertCount = 0;
+
+    dtStatus status = mNavQuery->findPath(startRef, endRef, start, end, mFilter, polyPath, &nPathCount, MAX_PATHPOLY);
+    if(dtStatusFailed(status) || nPathCount == 0) {
+      return false;
+    }
+
+    if(!allowPartial && dtStatusDetail(status, DT_PARTIAL_RESULT)) {
+      return false;
+    }
+
+    if(clusters) {
+      // section depends on all tiles of the poly corridor
+      for(int i = 0; i < nPathCount; ++i) {
+        int cluster = mClusterGraph.getCluster(polyPath[i]);
+        if(clusters->empty() || clusters->back() != cluster) {
+          clusters->push_back(cluster);
+        }
+      }
+    }
+
+    status = mNavQuery->findStraightPath(start, end, polyPath, nPathCount, straightPath, NULL, NULL, &nVertCount, MAX_PATHVERT);
     if(dtStatusFailed(status) || nVertCount == 0) {
-      return nullptr;
+      return false;
     }
 
-    dtPolyRef currentPoly = startPoly;
-    float* currentStart = startNearest;
-    Path3D::Vector points;
-    // At this point we have our path.  Copy it to the path store
+    // the first point is the start point, which is either
+    // the agent position or the end of the previous section
     for(int i = 1; i < nVertCount; i++) {
       int index = i * 3;
-      float point[3] = {straightPath[index], straightPath[index + 1], straightPath[index + 2]};
-
-      if(i > 0) {
-        points.emplace_back(point[0], point[1], point[2]);
-      }
+      points.emplace_back(straightPath[index], straightPath[index + 1], straightPath[index + 2]);
     }
-    return std::make_shared<Path3D>(points);
+    return true;
   }
 
   bool TileCache::findNearestPointOnNavmesh(const Gsage::Vector3& point, Gsage::Vector3& dest)
@@ -239,22 +908,133 @@ namespace Gsage {
 
   float TileCache::getHeight(const Gsage::Vector3& position)
   {
-    dtStatus status;
-    dtPolyRef poly;
-    float nearest[3] = {0.0f};
+    return getHeight(position, nullptr);
+  }
+
+  float TileCache::getHeight(const Gsage::Vector3& position, dtPolyRef* hint)
+  {
     float pos[3] = {(float)position.X, (float)position.Y, (float)position.Z};
+    return getHeight(pos, hint);
+  }
 
-    status = mNavQuery->findNearestPoly(pos, mExtents, mFilter, &poly, nearest);
-    float height = -1;
-    if(dtStatusFailed(status)) {
+  float TileCache::getHeight(const float* pos, dtPolyRef* hint)
+  {
+    if(mNavQuery == nullptr) {
       return -1;
     }
 
-    status = mNavQuery->getPolyHeight(poly, nearest, &height);
-    if(dtStatusFailed(status)) {
-      return -1;
+    float height = -1;
+    // agent usually stays on the same poly for several frames
+    if(hint != nullptr && *hint != 0 && mNavMesh->isValidPolyRef(*hint)) {
+      if(dtStatusSucceed(mNavQuery->getPolyHeight(*hint, pos, &height))) {
+        return height;
+      }
+    }
+
+    // grid cell keeps the poly found at its centre, which is used as a seed for the exact query:
+    // cell height itself is only correct at the cell centre, so it is the last resort
+    float gridHeight = -1;
+    dtPolyRef seed = 0;
+    bool sampled = mHeightGridEnabled && sampleHeightGrid(pos, gridHeight, seed);
+    if(sampled && seed != 0 && (hint == nullptr || seed != *hint) && dtStatusSucceed(mNavQuery->getPolyHeight(seed, pos, &height))) {
+      if(hint != nullptr) {
+        *hint = seed;
+      }
+      return height;
+    }
+
+    dtPolyRef poly = 0;
+    if(!queryHeight(pos, mHeightExtents, &poly, height) && !queryHeight(pos, mExtents, &poly, height)) {
+      return sampled ? gridHeight : -1;
+    }
+
+    if(hint != nullptr) {
+      *hint = poly;
     }
     return height;
   }
 
+  void TileCache::getHeights(const float* positions, int count, float* heights, dtPolyRef* hints)
+  {
+    for(int i = 0; i < count; ++i) {
+      heights[i] = getHeight(&positions[i * 3], hints ? &hints[i] : nullptr);
+    }
+  }
+
+  bool TileCache::queryHeight(const float* pos, const float* extents, dtPolyRef* poly, float& dest)
+  {
+    float nearest[3] = {0.0f};
+    dtStatus status = mNavQuery->findNearestPoly(pos, extents, mFilter, poly, nearest);
+    if(dtStatusFailed(status) || *poly == 0) {
+      return false;
+    }
+
+    status = mNavQuery->getPolyHeight(*poly, nearest, &dest);
+    return dtStatusSucceed(status);
+  }
+
+  bool TileCache::sampleHeightGrid(const float* pos, float& dest, dtPolyRef& poly)
+  {
+    static const float HEIGHT_UNKNOWN = FLT_MAX;
+    static const float HEIGHT_NONE = -FLT_MAX;
+
+    int tx, ty;
+    mNavMesh->calcTileLoc(pos, &tx, &ty);
+
+    // several layers can share the same tile location, 2D grid can't represent them
+    const dtMeshTile* tiles[2];
+    if(mNavMesh->getTilesAt(tx, ty, tiles, 2) != 1 || !tiles[0]->header) {
+      return false;
+    }
+
+    const dtMeshTile* tile = tiles[0];
+    dtTileRef tileRef = mNavMesh->getTileRef(tile);
+    HeightGrid& grid = mHeightGrids[((long long)tx << 32) | (unsigned int)ty];
+    // rebuilt tile gets a new ref, so the grid is reset lazily
+    if(grid.tileRef != tileRef) {
+      grid.tileRef = tileRef;
+      dtVcopy(grid.bmin, tile->header->bmin);
+      dtVcopy(grid.bmax, tile->header->bmax);
+      grid.width = std::max(1, (int)std::ceil((grid.bmax[0] - grid.bmin[0]) / mHeightGridCellSize));
+      grid.height = std::max(1, (int)std::ceil((grid.bmax[2] - grid.bmin[2]) / mHeightGridCellSize));
+      grid.samples.assign(grid.width * grid.height, HeightSample(HEIGHT_UNKNOWN, 0));
+    }
+
+    int x = (int)std::floor((pos[0] - grid.bmin[0]) / mHeightGridCellSize);
+    int z = (int)std::floor((pos[2] - grid.bmin[2]) / mHeightGridCellSize);
+    if(x < 0 || z < 0 || x >= grid.width || z >= grid.height) {
+      return false;
+    }
+
+    HeightSample& sample = grid.samples[z * grid.width + x];
+    if(sample.height == HEIGHT_UNKNOWN) {
+      float center[3] = {
+        grid.bmin[0] + (x + 0.5f) * mHeightGridCellSize,
+        (grid.bmin[1] + grid.bmax[1]) * 0.5f,
+        grid.bmin[2] + (z + 0.5f) * mHeightGridCellSize
+      };
+      float extents[3] = {
+        mHeightGridCellSize * 0.5f,
+        (grid.bmax[1] - grid.bmin[1]) * 0.5f + 1.0f,
+        mHeightGridCellSize * 0.5f
+      };
+
+      dtPolyRef ref = 0;
+      float height;
+      if(queryHeight(center, extents, &ref, height)) {
+        sample = HeightSample(height, ref);
+      } else {
+        sample = HeightSample(HEIGHT_NONE, 0);
+      }
+    }
+
+    if(sample.height == HEIGHT_NONE) {
+      return false;
+    }
+
+    dest = sample.height;
+    poly = sample.poly;
+    return true;
+  }
+
 }
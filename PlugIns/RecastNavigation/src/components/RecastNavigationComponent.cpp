@@ -34,9 +34,12 @@ namespace Gsage {
     mAgentId(0),
     mHasTarget(false),
     mAligned(false),
-    mAlign(true)
+    mAlign(true),
+    mObstacleRef(0),
+    mObstacleDirty(false)
   {
     BIND_PROPERTY_OPTIONAL("align", &mAlign);
+    BIND_ACCESSOR_OPTIONAL("obstacle", &RecastNavigationComponent::setObstacle, &RecastNavigationComponent::getObstacle);
   }
 
   RecastNavigationComponent::~RecastNavigationComponent()
@@ -69,4 +72,20 @@ namespace Gsage {
   {
     return mTarget;
   }
+
+  bool RecastNavigationComponent::isObstacle() const
+  {
+    return !mObstacle.empty();
+  }
+
+  void RecastNavigationComponent::setObstacle(const DataProxy& value)
+  {
+    mObstacle = value;
+    mObstacleDirty = true;
+  }
+
+  const DataProxy& RecastNavigationComponent::getObstacle() const
+  {
+    return mObstacle;
+  }
 }
@@ -35,6 +35,7 @@ THE SOFTWARE.
 #include "RecastMovementSurface.h"
 
 #include "EngineEvent.h"
+#include "FileLoader.h"
 
 namespace Gsage {
 
@@ -42,7 +43,9 @@ namespace Gsage {
 
   RecastNavigationSystem::RecastNavigationSystem() :
     mAgentCounter(0),
-    mTileCache(nullptr)
+    mTileCache(nullptr),
+    mTileCacheUpdateBudget(1000.0),
+    mObstacleMoveThreshold(0.1f)
   {
     mSystemInfo.put("type", RecastNavigationSystem::ID);
   }
@@ -61,18 +64,39 @@ namespace Gsage {
     }
 
     EngineSystem::initialize(settings);
+    configUpdated();
     return true;
   }
 
   void RecastNavigationSystem::configUpdated()
   {
-    if(mConfig.count("cache") != 0)
-      mTileCache->load(mConfig.get<std::string>("cache").first);
-    //else
-      //rebuild(DataProxy::create(DataWrapper::JSON_OBJECT));
+    auto cache = mConfig.get<std::string>("cache");
+    if(cache.second && cache.first != mCachePath) {
+      load(cache.first);
+    }
+
+    mConfig.read("tileCacheUpdateBudget", mTileCacheUpdateBudget);
+    mConfig.read("obstacleMoveThreshold", mObstacleMoveThreshold);
     return EngineSystem::configUpdated();
   }
 
+  void RecastNavigationSystem::update(const double& time)
+  {
+    ComponentStorage<RecastNavigationComponent>::update(time);
+    if(mTileCache) {
+      mTileCache->update(time, mTileCacheUpdateBudget);
+    }
+  }
+
+  bool RecastNavigationSystem::removeComponent(RecastNavigationComponent* component)
+  {
+    if(mTileCache && component->mObstacleRef != 0) {
+      mTileCache->removeObstacle(component->mObstacleRef);
+      component->mObstacleRef = 0;
+    }
+    return ComponentStorage<RecastNavigationComponent>::removeComponent(component);
+  }
+
   bool RecastNavigationSystem::fillComponentData(RecastNavigationComponent* c, const DataProxy& data)
   {
     c->mAgentId = mAgentCounter++;
@@ -85,9 +109,17 @@ namespace Gsage {
       return;
     }
 
-    MovementComponent* movementComponent = mEngine->getComponent<MovementComponent>(entity);
     RenderComponent* renderComponent = mEngine->getComponent<RenderComponent>(entity);
-    if(!movementComponent || !renderComponent) {
+    if(!renderComponent) {
+      return;
+    }
+
+    if(component->isObstacle() || component->mObstacleRef != 0) {
+      updateObstacle(component, renderComponent);
+    }
+
+    MovementComponent* movementComponent = mEngine->getComponent<MovementComponent>(entity);
+    if(!movementComponent) {
       return;
     }
 
@@ -112,6 +144,51 @@ namespace Gsage {
     }
   }
 
+  void RecastNavigationSystem::updateObstacle(RecastNavigationComponent* component, RenderComponent* renderComponent)
+  {
+    const Gsage::Vector3& position = renderComponent->getPosition();
+    if(component->mObstacleRef != 0) {
+      bool moved = Gsage::Vector3::Distance(position, component->mObstaclePosition) >= mObstacleMoveThreshold;
+      if(!moved && !component->mObstacleDirty) {
+        return;
+      }
+
+      mTileCache->removeObstacle(component->mObstacleRef);
+      component->mObstacleRef = 0;
+    }
+
+    component->mObstacleDirty = false;
+    if(!component->isObstacle()) {
+      return;
+    }
+
+    const DataProxy& settings = component->mObstacle;
+    Gsage::Vector3 center = position + settings.get("offset", Gsage::Vector3::Zero());
+    std::string type = settings.get("type", std::string("cylinder"));
+    dtObstacleRef ref = 0;
+    if(type == "box") {
+      ref = mTileCache->addBoxObstacle(
+        center,
+        settings.get("halfExtents", Gsage::Vector3::One()),
+        settings.get("rotation", 0.0f)
+      );
+    } else if(type == "cylinder") {
+      ref = mTileCache->addObstacle(
+        center,
+        settings.get("radius", 1.0f),
+        settings.get("height", 2.0f)
+      );
+    } else {
+      LOG(ERROR) << "Unsupported obstacle type " << type;
+      component->mObstacle = DataProxy();
+      return;
+    }
+
+    // failed refs will be retried next frame
+    component->mObstacleRef = ref;
+    component->mObstaclePosition = position;
+  }
+
   bool RecastNavigationSystem::rebuild(DataProxy options)
   {
     EngineSystem* es = mEngine->getSystem("render");
@@ -136,16 +213,58 @@ namespace Gsage {
     DataProxy config = merge(defOptions, options);
 
     TileCachePtr tileCache = mRecast.buildTileCache(std::move(geom), config);
+    if(!tileCache) {
+      LOG(ERROR) << "Failed to rebuild tile cache";
+      return false;
+    }
 
     if(options.get("merge", true) && mTileCache != nullptr) {
       mTileCache->merge(tileCache.get());
     } else {
-      mTileCache = tileCache;
+      mCachePath.clear();
+      setTileCache(tileCache);
+    }
+
+    return true;
+  }
+
+  bool RecastNavigationSystem::dump(const std::string& path)
+  {
+    if(!mTileCache) {
+      LOG(ERROR) << "Failed to dump navigation mesh: it was not built";
+      return false;
+    }
+
+    return mTileCache->dump(path);
+  }
+
+  bool RecastNavigationSystem::load(const std::string& path)
+  {
+    std::string fullPath = FileLoader::getSingletonPtr()->searchFile(path);
+    if(fullPath.empty()) {
+      LOG(ERROR) << "Failed to load navigation mesh " << path << ": file not found";
+      return false;
+    }
+
+    TileCachePtr tileCache = std::make_shared<TileCache>();
+    if(!tileCache->load(fullPath, merge(getDefaultOptions(), mConfig))) {
+      return false;
     }
 
+    mCachePath = path;
+    setTileCache(tileCache);
     return true;
   }
 
+  void RecastNavigationSystem::setTileCache(TileCachePtr tileCache)
+  {
+    mTileCache = tileCache;
+    // obstacles belong to the old tile cache, so they should be added again
+    for(auto component : mComponents.getElements()) {
+      component->mObstacleRef = 0;
+    }
+  }
+
   const DataProxy& RecastNavigationSystem::getDefaultOptions() const
   {
     static DataProxy options = loads(" \
@@ -166,10 +285,24 @@ namespace Gsage {
       \"filterLowHangingObstacles\": true,\
       \"filterLedgeSpans\": true,\
       \"filterWalkableLowHeightSpans\": true,\
-      \"tileSize\": 300,\
+      \"tileSize\": 48,\
+      \"buildThreads\": 0,\
       \"trisPerChunk\": 256,\
       \"navMeshQuery\": {\
         \"maxNodes\": 2048\
+      },\
+      \"tileCache\": {\
+        \"maxObstacles\": 128,\
+        \"expectedLayersPerTile\": 4\
+      },\
+      \"heightGrid\": {\
+        \"enabled\": true\
+      },\
+      \"hierarchicalPath\": {\
+        \"enabled\": true,\
+        \"sectionTiles\": 4,\
+        \"pathCacheSize\": 256,\
+        \"sectionCacheSize\": 1024\
       }\
     }", DataWrapper::JSON_OBJECT);
     return options;
@@ -194,6 +327,32 @@ namespace Gsage {
     return mTileCache->findPath(start, end);
   }
 
+  void RecastNavigationSystem::getHeights(const std::vector<Gsage::Vector3>& positions, std::vector<float>& heights, bool useHints)
+  {
+    heights.assign(positions.size(), -1.0f);
+    if(!mTileCache) {
+      return;
+    }
+
+    std::vector<float> points(positions.size() * 3);
+    for(size_t i = 0; i < positions.size(); ++i) {
+      points[i * 3] = positions[i].X;
+      points[i * 3 + 1] = positions[i].Y;
+      points[i * 3 + 2] = positions[i].Z;
+    }
+
+    if(!useHints) {
+      mTileCache->getHeights(points.data(), (int)positions.size(), heights.data());
+      return;
+    }
+
+    // batches usually come from the same agents each frame, stale refs are rejected by the tile cache
+    if(mHeightHints.size() != positions.size()) {
+      mHeightHints.assign(positions.size(), 0);
+    }
+    mTileCache->getHeights(points.data(), (int)positions.size(), heights.data(), mHeightHints.data());
+  }
+
   std::vector<Gsage::Vector3> RecastNavigationSystem::getNavMeshRawPoints() const {
     if(!mTileCache) {
       return std::vector<Gsage::Vector3>();
@@ -201,4 +360,49 @@ namespace Gsage {
 
     return mTileCache->getPoints();
   }
+
+  unsigned int RecastNavigationSystem::addObstacle(const Gsage::Vector3& pos, float radius, float height)
+  {
+    if(!mTileCache) {
+      return 0;
+    }
+
+    return mTileCache->addObstacle(pos, radius, height);
+  }
+
+  unsigned int RecastNavigationSystem::addBoxObstacle(const Gsage::Vector3& bmin, const Gsage::Vector3& bmax)
+  {
+    if(!mTileCache) {
+      return 0;
+    }
+
+    return mTileCache->addBoxObstacle(bmin, bmax);
+  }
+
+  unsigned int RecastNavigationSystem::addBoxObstacle(const Gsage::Vector3& center, const Gsage::Vector3& halfExtents, float yRadians)
+  {
+    if(!mTileCache) {
+      return 0;
+    }
+
+    return mTileCache->addBoxObstacle(center, halfExtents, yRadians);
+  }
+
+  bool RecastNavigationSystem::removeObstacle(unsigned int ref)
+  {
+    if(!mTileCache) {
+      return false;
+    }
+
+    return mTileCache->removeObstacle(ref);
+  }
+
+  int RecastNavigationSystem::getObstacleCount() const
+  {
+    if(!mTileCache) {
+      return 0;
+    }
+
+    return mTileCache->getObstacleCount();
+  }
 }
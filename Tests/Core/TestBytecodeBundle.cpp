@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+
+#include "lua/BytecodeBundle.h"
+#include "systems/LuaScriptSystem.h"
+#include "FileLoader.h"
+#include "Filesystem.h"
+
+#include "lua.hpp"
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Timestamp.h>
+
+using namespace Gsage;
+
+class TestBytecodeBundle : public ::testing::Test
+{
+  public:
+    void SetUp()
+    {
+      mFolder = mFilesystem.join({Poco::Path::temp(), "gsageBytecodeBundle"});
+      mFilesystem.rmdir(mFolder, true);
+      mFilesystem.mkdir(mFilesystem.join({mFolder, "scripts", "mod"}), true);
+      mRoot = mFilesystem.join({mFolder, "scripts"});
+
+      mState = luaL_newstate();
+      luaL_openlibs(mState);
+    }
+
+    void TearDown()
+    {
+      lua_close(mState);
+      mFilesystem.rmdir(mFolder, true);
+    }
+
+    std::string write(const std::string& path, const std::string& content, long time)
+    {
+      std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+      stream << content;
+      stream.close();
+      touch(path, time);
+      return path;
+    }
+
+    void touch(const std::string& path, long time)
+    {
+      // explicit times, so the test does not depend on the filesystem time resolution
+      Poco::File(path).setLastModified(Poco::Timestamp::fromEpochTime(1000000 + time));
+    }
+
+    std::string read(const std::string& path)
+    {
+      std::ifstream stream(path, std::ios::in | std::ios::binary);
+      std::stringstream buffer;
+      buffer << stream.rdbuf();
+      return buffer.str();
+    }
+
+    std::string script(const std::string& path)
+    {
+      return mFilesystem.join({mRoot, path});
+    }
+
+    /**
+     * Write two modules and dump them to the bundle file
+     */
+    std::string createBundle()
+    {
+      write(script("mod/init.lua"), "return {value = 'package'}", 1);
+      write(script("mod/a.lua"), "return {value = 'a'}", 1);
+
+      BytecodeBundle bundle;
+      EXPECT_EQ(bundle.addFolder(mState, mRoot), 2);
+      std::string path = mFilesystem.join({mFolder, "scripts.bundle"});
+      EXPECT_TRUE(bundle.dump(path));
+      return path;
+    }
+
+    /**
+     * Require module and get its value field
+     */
+    std::string require(const std::string& module)
+    {
+      lua_getglobal(mState, "require");
+      lua_pushstring(mState, module.c_str());
+      if(lua_pcall(mState, 1, 1, 0) != 0) {
+        std::string error = lua_tostring(mState, -1);
+        lua_pop(mState, 1);
+        return "error: " + error;
+      }
+
+      lua_getfield(mState, -1, "value");
+      std::string res = lua_isstring(mState, -1) ? lua_tostring(mState, -1) : "";
+      lua_pop(mState, 2);
+      return res;
+    }
+
+    Filesystem mFilesystem;
+    std::string mFolder;
+    std::string mRoot;
+    lua_State* mState;
+};
+
+TEST_F(TestBytecodeBundle, TestModuleName)
+{
+  ASSERT_EQ(BytecodeBundle::getModuleName("a.lua"), "a");
+  ASSERT_EQ(BytecodeBundle::getModuleName("mod/a.lua"), "mod.a");
+  ASSERT_EQ(BytecodeBundle::getModuleName("mod\\a.lua"), "mod.a");
+  ASSERT_EQ(BytecodeBundle::getModuleName("mod/init.lua"), "mod");
+}
+
+TEST_F(TestBytecodeBundle, TestDumpLoad)
+{
+  std::string path = createBundle();
+
+  BytecodeBundle bundle;
+  ASSERT_TRUE(bundle.load(path, mRoot));
+  ASSERT_EQ(bundle.size(), 2);
+
+  int top = lua_gettop(mState);
+  ASSERT_TRUE(bundle.loadModule(mState, "mod.a"));
+  ASSERT_EQ(lua_pcall(mState, 0, 1, 0), 0);
+  lua_getfield(mState, -1, "value");
+  ASSERT_STREQ(lua_tostring(mState, -1), "a");
+  lua_settop(mState, top);
+
+  ASSERT_FALSE(bundle.loadModule(mState, "mod.b"));
+  ASSERT_EQ(lua_gettop(mState), top);
+
+  // dumping the loaded bundle gives the same file
+  std::string copy = mFilesystem.join({mFolder, "copy.bundle"});
+  ASSERT_TRUE(bundle.dump(copy));
+  BytecodeBundle reloaded;
+  ASSERT_TRUE(reloaded.load(copy, mRoot));
+  ASSERT_EQ(reloaded.size(), 2);
+  ASSERT_TRUE(reloaded.loadModule(mState, "mod"));
+  lua_settop(mState, top);
+}
+
+TEST_F(TestBytecodeBundle, TestRejectBrokenFiles)
+{
+  std::string path = createBundle();
+  std::string data = read(path);
+  std::string broken = mFilesystem.join({mFolder, "broken.bundle"});
+
+  BytecodeBundle bundle;
+  ASSERT_TRUE(bundle.load(path, mRoot));
+  ASSERT_FALSE(bundle.load(mFilesystem.join({mFolder, "missing.bundle"}), mRoot));
+
+  // truncated in the file header, in the entry headers and in the bytecode
+  for(size_t size : {(size_t)0, (size_t)10, data.size() / 3, data.size() / 2, data.size() - 1}) {
+    write(broken, data.substr(0, size), 1);
+    ASSERT_FALSE(bundle.load(broken, mRoot)) << "truncated to " << size;
+    // failed load keeps the previous contents
+    ASSERT_EQ(bundle.size(), 2);
+  }
+
+  std::string corrupted = data;
+  corrupted[0] ^= 0xFF;
+  write(broken, corrupted, 1);
+  ASSERT_FALSE(bundle.load(broken, mRoot));
+
+  // huge entry size must not overflow the bounds check
+  corrupted = data;
+  std::string huge(sizeof(uint64_t), (char)0xFF);
+  corrupted.replace(corrupted.find("mod") - sizeof(uint64_t), sizeof(uint64_t), huge);
+  write(broken, corrupted, 1);
+  ASSERT_FALSE(bundle.load(broken, mRoot));
+
+  // compiled by the other lua version: header is 4 ints, followed by the version string
+  corrupted = data;
+  corrupted[4 * sizeof(int)] ^= 0xFF;
+  write(broken, corrupted, 1);
+  ASSERT_FALSE(bundle.load(broken, mRoot));
+  ASSERT_EQ(bundle.size(), 2);
+}
+
+TEST_F(TestBytecodeBundle, TestSearcher)
+{
+  std::string path = createBundle();
+
+  BytecodeBundle bundle;
+  ASSERT_TRUE(bundle.load(path, mRoot));
+  ASSERT_TRUE(bundle.install(mState));
+
+  // scripts can be shipped without sources
+  Poco::File(script("mod/a.lua")).remove();
+  ASSERT_EQ(require("mod.a"), "a");
+  ASSERT_EQ(require("mod"), "package");
+
+  std::string miss = require("mod.missing");
+  ASSERT_EQ(miss.find("error: "), 0);
+  ASSERT_NE(miss.find("no module 'mod.missing' in bytecode bundle"), std::string::npos);
+}
+
+TEST_F(TestBytecodeBundle, TestSourceChanged)
+{
+  std::string path = createBundle();
+
+  BytecodeBundle bundle;
+  ASSERT_TRUE(bundle.load(path, mRoot));
+  int top = lua_gettop(mState);
+
+  // touched, but the contents are the same
+  touch(script("mod/a.lua"), 2);
+  ASSERT_TRUE(bundle.loadModule(mState, "mod.a"));
+  lua_settop(mState, top);
+
+  // changed source is loaded from the disk
+  write(script("mod/a.lua"), "return {value = 'changed'}", 3);
+  ASSERT_FALSE(bundle.loadModule(mState, "mod.a"));
+  ASSERT_EQ(lua_gettop(mState), top);
+  ASSERT_TRUE(bundle.loadModule(mState, "mod"));
+  lua_settop(mState, top);
+}
+
+TEST_F(TestBytecodeBundle, TestScriptCache)
+{
+  DataProxy environment;
+  FileLoader::init(environment);
+
+  std::string file = write(script("counter.lua"), "counter = 1", 1);
+  {
+    LuaScriptSystem system;
+    ASSERT_TRUE(system.setLuaState(mState));
+    sol::state_view lua(mState);
+
+    ASSERT_TRUE(system.runScript("@File:" + file));
+    ASSERT_EQ(lua["counter"].get<int>(), 1);
+
+    // the same modification time: compiled chunk is reused
+    write(file, "counter = 2", 1);
+    ASSERT_TRUE(system.runScript("@File:" + file));
+    ASSERT_EQ(lua["counter"].get<int>(), 1);
+
+    // modification time changed: script is compiled again
+    touch(file, 2);
+    ASSERT_TRUE(system.runScript("@File:" + file));
+    ASSERT_EQ(lua["counter"].get<int>(), 2);
+
+    // inline scripts are cached by the source
+    ASSERT_TRUE(system.runScript("counter = counter + 1"));
+    ASSERT_TRUE(system.runScript("counter = counter + 1"));
+    ASSERT_EQ(lua["counter"].get<int>(), 4);
+  }
+}
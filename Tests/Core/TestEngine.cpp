@@ -189,6 +189,81 @@ TEST_F(TestEngine, TestEntityAddFailure)
   ASSERT_FALSE(mInstance->removeEntity("not_exists"));
 }
 
+TEST_F(TestEngine, TestQuery)
+{
+  TestSystem system;
+  mInstance->addSystem("speed", &system);
+  mInstance->addSystem("accelerator", new AccelerationSystem());
+  DataProxy config;
+  mInstance->initialize(config, config);
+
+  DataProxy speed;
+  speed.put("speed", 2.0);
+  DataProxy accelerator;
+  accelerator.put("acceleration", 1.5);
+
+  DataProxy entityData;
+  entityData.put("id", "both");
+  entityData.put("speed", speed);
+  entityData.put("accelerator", accelerator);
+  mInstance->createEntity(entityData);
+
+  EntityQuery* both = mInstance->query({"speed", "accelerator"});
+  EntityQuery* dynamic = mInstance->query({"speed"}, {"dynamic"});
+  ASSERT_EQ(both, mInstance->query({"accelerator", "speed"}));
+  ASSERT_EQ(1, both->size());
+  ASSERT_EQ(0, dynamic->size());
+
+  DataProxy entityData2;
+  entityData2.put("id", "speed");
+  entityData2.put("speed", speed);
+  Entity* e = mInstance->createEntity(entityData2);
+  ASSERT_EQ(1, both->size());
+  ASSERT_EQ(0, dynamic->size());
+
+  e->setFlag("dynamic");
+  ASSERT_EQ(1, dynamic->size());
+  ASSERT_EQ(e, dynamic->get(0));
+
+  DataProxy entityData3;
+  entityData3.put("id", "transient");
+  entityData3.put("speed", speed);
+  Entity* transient = mInstance->createEntity(entityData3);
+
+  EntityQuery* speedQuery = mInstance->query({"speed"});
+  ASSERT_EQ(3, speedQuery->size());
+  EntityQuery::Entities slots;
+  for(size_t i = 0; i < speedQuery->slots(); ++i) {
+    slots.push_back(speedQuery->at(i));
+  }
+
+  // slots are kept until compaction, so iteration does not skip entities
+  ASSERT_TRUE(mInstance->removeEntity(transient));
+  ASSERT_EQ(2, speedQuery->size());
+  ASSERT_EQ(3, speedQuery->slots());
+  for(size_t i = 0; i < slots.size(); ++i) {
+    if(slots[i] == transient) {
+      ASSERT_TRUE(speedQuery->at(i) == nullptr);
+    } else {
+      ASSERT_EQ(slots[i], speedQuery->at(i));
+    }
+  }
+  ASSERT_TRUE(speedQuery->get(1) != nullptr);
+  ASSERT_EQ(2, speedQuery->slots());
+
+  ASSERT_TRUE(mInstance->removeEntity("both"));
+  ASSERT_EQ(0, both->size());
+  ASSERT_TRUE(mInstance->removeEntity(e));
+  ASSERT_EQ(0, dynamic->size());
+
+  DataProxy emptyData;
+  emptyData.put("id", "empty");
+  Entity* empty = mInstance->createEntity(emptyData);
+  EntityQuery* all = mInstance->query({});
+  ASSERT_EQ(1, all->size());
+  ASSERT_EQ(empty, all->get(0));
+}
+
 TEST_F(TestEngine, TestThreadedSystemsStartStop)
 {
   TestThreadedSystem system;
@@ -211,3 +286,11 @@ TEST_F(TestEngine, TestThreadedSystemsStartStop)
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
   }
 }
+
+TEST_F(TestEngine, TestThreadedSystemRejectsUpdateLOD)
+{
+  TestThreadedSystem system;
+  std::string rawJson = "{\"dedicatedThread\": true, \"updateLOD\": true}";
+  DataProxy config = loads(rawJson, DataWrapper::JSON_OBJECT);
+  ASSERT_FALSE(system.initialize(config));
+}
@@ -0,0 +1,83 @@
+#include "lua/LuaAllocator.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace Gsage;
+
+TEST(TestLuaAllocator, TestReuseFreedBlocks)
+{
+  LuaAllocator allocator;
+  void* a = allocator.reallocate(0, 0, 40);
+  ASSERT_NE(a, nullptr);
+  ASSERT_EQ(allocator.getAllocated(), 40);
+  ASSERT_EQ(allocator.getReserved(), LuaAllocator::CHUNK_SIZE);
+
+  ASSERT_EQ(allocator.reallocate(a, 40, 0), nullptr);
+  ASSERT_EQ(allocator.getAllocated(), 0);
+  // same size class gets the same block back
+  ASSERT_EQ(allocator.reallocate(0, 0, 48), a);
+  ASSERT_EQ(allocator.getReserved(), LuaAllocator::CHUNK_SIZE);
+}
+
+TEST(TestLuaAllocator, TestReallocate)
+{
+  LuaAllocator allocator;
+  char* block = static_cast<char*>(allocator.reallocate(0, 0, 20));
+  std::memcpy(block, "0123456789012345678", 20);
+
+  // growing within the size class keeps the block
+  ASSERT_EQ(allocator.reallocate(block, 20, 30), block);
+
+  // moving to the bigger class and then to malloc keeps the contents
+  char* bigger = static_cast<char*>(allocator.reallocate(block, 30, 100));
+  ASSERT_STREQ(bigger, "0123456789012345678");
+  char* large = static_cast<char*>(allocator.reallocate(bigger, 100, 4096));
+  ASSERT_STREQ(large, "0123456789012345678");
+  ASSERT_EQ(allocator.getAllocated(), 4096);
+
+  char* small = static_cast<char*>(allocator.reallocate(large, 4096, 20));
+  ASSERT_STREQ(small, "0123456789012345678");
+  ASSERT_EQ(allocator.getAllocated(), 20);
+  allocator.reallocate(small, 20, 0);
+  ASSERT_EQ(allocator.getAllocated(), 0);
+}
+
+TEST(TestLuaAllocator, TestRandomChurn)
+{
+  LuaAllocator allocator;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> size(1, 1024);
+
+  std::vector<std::pair<unsigned char*, size_t>> blocks;
+  size_t total = 0;
+  for(int i = 0; i < 10000; ++i) {
+    if(!blocks.empty() && gen() % 3 == 0) {
+      size_t index = gen() % blocks.size();
+      auto block = blocks[index];
+      for(size_t j = 0; j < block.second; ++j) {
+        ASSERT_EQ(block.first[j], (unsigned char)(block.second & 0xFF));
+      }
+      allocator.reallocate(block.first, block.second, 0);
+      total -= block.second;
+      blocks[index] = blocks.back();
+      blocks.pop_back();
+      continue;
+    }
+
+    size_t s = size(gen);
+    unsigned char* block = static_cast<unsigned char*>(allocator.reallocate(0, 0, s));
+    ASSERT_NE(block, nullptr);
+    std::memset(block, (int)(s & 0xFF), s);
+    blocks.emplace_back(block, s);
+    total += s;
+    ASSERT_EQ(allocator.getAllocated(), total);
+  }
+
+  for(auto& block : blocks) {
+    allocator.reallocate(block.first, block.second, 0);
+  }
+  ASSERT_EQ(allocator.getAllocated(), 0);
+}
@@ -144,3 +144,45 @@ TEST_F(TestSerializable, TestReadErrors)
   ASSERT_TRUE(loads(node, s, DataWrapper::JSON_OBJECT));
   ASSERT_TRUE(mInstance->read(node));
 }
+
+TEST_F(TestSerializable, TestReadTable)
+{
+  sol::state lua;
+  sol::table t = lua.create_table();
+  t["boolValue"] = true;
+  // strings are converted by DataProxy casters
+  t["floatValue"] = "0.5";
+  t["intAccessor"] = 1000;
+  t["node"] = lua.create_table_with("test", 1);
+  t["forNested"] = 0;
+
+  ASSERT_FALSE(mInstance->read(t));
+  ASSERT_EQ(mInstance->boolValue, true);
+  ASSERT_FLOAT_EQ(mInstance->floatValue, 0.5);
+  ASSERT_EQ(mInstance->notFound, 100);
+  ASSERT_EQ(mInstance->intValue, 1000);
+  ASSERT_TRUE(mInstance->readByAccessor);
+  ASSERT_EQ(mInstance->node.get<int>("test", -1), 1);
+  ASSERT_EQ(mInstance->nested->value, 1);
+
+  t["notFound"] = 404;
+  ASSERT_TRUE(mInstance->setPropsTable(t));
+  ASSERT_EQ(mInstance->notFound, 404);
+}
+
+TEST_F(TestSerializable, TestDumpTable)
+{
+  sol::state lua;
+  mInstance->floatValue = 1.5;
+  mInstance->node.put("hello", std::string("world"));
+
+  sol::table t = mInstance->getPropsTable(sol::this_state{lua.lua_state()});
+  ASSERT_EQ(t.get<int>("notFound"), 100);
+  ASSERT_FLOAT_EQ(t.get<float>("floatValue"), 1.5);
+  ASSERT_EQ(t.get<int>("intAccessor"), 0);
+  ASSERT_EQ(t["node"]["hello"].get<std::string>(), "world");
+
+  ASSERT_TRUE(mInstance->setProp("notFound", sol::make_object(lua, 5)));
+  ASSERT_EQ(mInstance->notFound, 5);
+  ASSERT_EQ(mInstance->getProp(sol::this_state{lua.lua_state()}, "notFound").as<int>(), 5);
+}
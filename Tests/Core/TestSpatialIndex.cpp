@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+
+#include "SpatialIndex.h"
+#include "Entity.h"
+#include "Logger.h"
+
+using namespace Gsage;
+
+class TestSpatialIndex : public ::testing::Test
+{
+  public:
+    void generate(int count, float size)
+    {
+      mEntities.reset(new Entity[count]);
+      mPositions.clear();
+      mFlags.clear();
+      mCount = count;
+      for(int i = 0; i < count; ++i) {
+        // deterministic scatter
+        Vector3 position((i * 7919 % 10007) / 10007.0 * size, (i % 10), (i * 104729 % 10009) / 10009.0 * size);
+        mPositions.push_back(position);
+        mFlags.push_back(i % 2 == 0 ? 0x01 : 0x02);
+        mIndex.update(&mEntities[i], position, mFlags[i]);
+      }
+    }
+
+    std::set<Entity*> bruteForceRadius(const Vector3& center, float radius, unsigned int flags)
+    {
+      std::set<Entity*> res;
+      for(int i = 0; i < mCount; ++i) {
+        if(!mIndex.contains(&mEntities[i]) || (mFlags[i] & flags) == 0) {
+          continue;
+        }
+
+        if(Vector3::Distance(mPositions[i], center) <= radius) {
+          res.insert(&mEntities[i]);
+        }
+      }
+      return res;
+    }
+
+    SpatialIndex mIndex;
+    std::unique_ptr<Entity[]> mEntities;
+    std::vector<Vector3> mPositions;
+    std::vector<unsigned int> mFlags;
+    int mCount;
+};
+
+TEST_F(TestSpatialIndex, TestUpdateAndRemove)
+{
+  Entity a, b;
+  mIndex.update(&a, Vector3(0, 0, 0));
+  mIndex.update(&b, Vector3(100, 0, 0));
+  ASSERT_EQ(mIndex.size(), 2);
+
+  SpatialIndex::Entities res;
+  ASSERT_EQ(mIndex.queryRadius(Vector3(0, 0, 0), 10, res), 1);
+  ASSERT_EQ(res[0], &a);
+
+  // move to another cell
+  mIndex.update(&a, Vector3(95, 0, 0));
+  ASSERT_EQ(mIndex.queryRadius(Vector3(0, 0, 0), 10, res), 0);
+  ASSERT_EQ(mIndex.queryRadius(Vector3(100, 0, 0), 10, res), 2);
+
+  ASSERT_TRUE(mIndex.remove(&a));
+  ASSERT_FALSE(mIndex.remove(&a));
+  ASSERT_FALSE(mIndex.contains(&a));
+  ASSERT_EQ(mIndex.queryRadius(Vector3(100, 0, 0), 10, res), 1);
+  ASSERT_EQ(res[0], &b);
+
+  // flags filtering
+  mIndex.update(&b, Vector3(100, 0, 0), 0x02);
+  ASSERT_EQ(mIndex.queryRadius(Vector3(100, 0, 0), 10, res, 0x01), 0);
+  ASSERT_EQ(mIndex.queryRadius(Vector3(100, 0, 0), 10, res, 0x03), 1);
+
+  mIndex.clear();
+  ASSERT_EQ(mIndex.size(), 0);
+}
+
+TEST_F(TestSpatialIndex, TestQueries)
+{
+  generate(2000, 200);
+  // remove some entities, to make sure swap removal keeps the index consistent
+  for(int i = 0; i < 2000; i += 7) {
+    mIndex.remove(&mEntities[i]);
+  }
+  // move some
+  for(int i = 1; i < 2000; i += 5) {
+    mPositions[i].X += 33;
+    mFlags[i] = 0x02;
+    mIndex.update(&mEntities[i], mPositions[i], mFlags[i]);
+  }
+
+  SpatialIndex::Entities res;
+  for(int i = 0; i < 50; ++i) {
+    Vector3 center(i * 4, 5, 200 - i * 4);
+    float radius = 5 + i;
+    mIndex.queryRadius(center, radius, res, 0x02);
+    ASSERT_EQ(std::set<Entity*>(res.begin(), res.end()), bruteForceRadius(center, radius, 0x02));
+
+    // nearest entities are sorted by distance and match brute force distances
+    mIndex.queryNearest(center, 5, res, 0x03);
+    ASSERT_EQ(res.size(), 5);
+    std::vector<double> expected;
+    for(int j = 0; j < mCount; ++j) {
+      if(mIndex.contains(&mEntities[j])) {
+        expected.push_back(Vector3::Distance(mPositions[j], center));
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    for(size_t j = 0; j < res.size(); ++j) {
+      ASSERT_NEAR(Vector3::Distance(mPositions[res[j] - &mEntities[0]], center), expected[j], 1e-3);
+    }
+
+    // box and frustum covering the same volume
+    BoundingBox box(Vector3(center.X - radius, 0, center.Z - radius), Vector3(center.X + radius, 4, center.Z + radius));
+    size_t inBox = mIndex.queryBox(box, res, 0x03);
+    for(auto entity : res) {
+      ASSERT_TRUE(box.contains(mPositions[entity - &mEntities[0]].X, mPositions[entity - &mEntities[0]].Y, mPositions[entity - &mEntities[0]].Z));
+    }
+
+    SpatialIndex::Planes planes = {
+      {Vector3(1, 0, 0), -box.min.X},
+      {Vector3(-1, 0, 0), box.max.X},
+      {Vector3(0, 1, 0), -box.min.Y},
+      {Vector3(0, -1, 0), box.max.Y},
+      {Vector3(0, 0, 1), -box.min.Z},
+      {Vector3(0, 0, -1), box.max.Z}
+    };
+    ASSERT_EQ(mIndex.queryFrustum(planes, res, 0x03), inBox);
+  }
+
+  ASSERT_EQ(mIndex.queryBox(BoundingBox(BoundingBox::EXTENT_INFINITE), res, 0x03), mIndex.size());
+
+  // changing cell size keeps the results
+  mIndex.queryRadius(Vector3(100, 5, 100), 30, res);
+  size_t count = res.size();
+  mIndex.setCellSize(3.0f);
+  ASSERT_EQ(mIndex.queryRadius(Vector3(100, 5, 100), 30, res), count);
+}
+
+TEST_F(TestSpatialIndex, TestNearestSparse)
+{
+  // far entity is reached only by the full scan fallback
+  mIndex.setCellSize(16.0f);
+  Entity a, b;
+  mIndex.update(&a, Vector3(0, 0, 0));
+  mIndex.update(&b, Vector3(1000, 0, 0));
+
+  SpatialIndex::Entities res;
+  ASSERT_EQ(mIndex.queryNearest(Vector3(0, 0, 0), 2, res), 2);
+  ASSERT_EQ(res[0], &a);
+  ASSERT_EQ(res[1], &b);
+
+  // max distance is still respected
+  ASSERT_EQ(mIndex.queryNearest(Vector3(0, 0, 0), 2, res, 0xFF, 500.0f), 1);
+  ASSERT_EQ(res[0], &a);
+}
+
+TEST_F(TestSpatialIndex, TestBatchQuery)
+{
+  generate(1000, 100);
+  std::vector<Vector3> centers = {Vector3(10, 0, 10), Vector3(50, 5, 50), Vector3(-100, 0, -100)};
+  std::vector<SpatialIndex::Entities> res;
+  size_t total = mIndex.queryRadius(centers, 15, res);
+  ASSERT_EQ(res.size(), centers.size());
+
+  size_t expected = 0;
+  for(size_t i = 0; i < centers.size(); ++i) {
+    ASSERT_EQ(std::set<Entity*>(res[i].begin(), res[i].end()), bruteForceRadius(centers[i], 15, 0xFF));
+    expected += res[i].size();
+  }
+  ASSERT_EQ(total, expected);
+  ASSERT_EQ(res[2].size(), 0);
+}
+
+// benchmark, run with --gtest_also_run_disabled_tests
+TEST_F(TestSpatialIndex, DISABLED_BenchmarkProximityQueries)
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  generate(20000, 2000);
+
+  const int frames = 10;
+  const int queries = 5000;
+  std::vector<Vector3> centers(queries);
+  std::vector<SpatialIndex::Entities> res;
+  size_t found = 0;
+
+  auto start = Clock::now();
+  for(int frame = 0; frame < frames; ++frame) {
+    // every entity moves a bit each frame
+    for(int i = 0; i < mCount; ++i) {
+      mPositions[i].X += (i % 3 - 1) * 0.5;
+      mIndex.update(&mEntities[i], mPositions[i], i % 2 == 0 ? 0x01 : 0x02);
+    }
+
+    for(int i = 0; i < queries; ++i) {
+      centers[i] = mPositions[i * 4];
+    }
+    found += mIndex.queryRadius(centers, 20, res);
+  }
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  LOG(INFO) << "Spatial index, " << mCount << " entities: "
+    << frames << " frames of " << mCount << " updates and " << queries << " radius queries " << elapsed << "s, "
+    << found << " entities found";
+
+  ASSERT_GT(found, 0);
+}
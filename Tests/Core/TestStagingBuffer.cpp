@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "StagingBuffer.h"
+#include "Logger.h"
+
+using namespace Gsage;
+
+class TestStagingBuffer : public ::testing::Test
+{
+  public:
+    void SetUp()
+    {
+      resize(64, 32);
+    }
+
+    void resize(int width, int height)
+    {
+      mWidth = width;
+      mHeight = height;
+      mImage.assign(width * height * 4, 0);
+    }
+
+    // fills rect with the value in the source image and writes it into the staging buffer
+    void paint(const Rect<int>& area, char value)
+    {
+      std::vector<Rect<int>> areas = {area};
+      paint(areas, value);
+    }
+
+    void paint(const std::vector<Rect<int>>& areas, char value)
+    {
+      for(auto& area : areas) {
+        for(int y = area.y; y < area.y + area.height; ++y) {
+          memset(&mImage[(y * mWidth + area.x) * 4], value, area.width * 4);
+        }
+      }
+      mStaging.write(mImage.data(), mImage.size(), mWidth, mHeight, areas.data(), areas.size());
+    }
+
+    bool frontMatches()
+    {
+      return mStaging.getWidth() == mWidth && mStaging.getHeight() == mHeight &&
+        memcmp(mStaging.getData(), mImage.data(), mImage.size()) == 0;
+    }
+
+    static bool containsRect(const DirtyRegions::Rects& rects, const Rect<int>& area)
+    {
+      for(auto& rect : rects) {
+        if(area.x >= rect.x && area.y >= rect.y &&
+           area.x + area.width <= rect.x + rect.width && area.y + area.height <= rect.y + rect.height) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    StagingBuffer mStaging;
+    std::vector<char> mImage;
+    int mWidth;
+    int mHeight;
+};
+
+TEST_F(TestStagingBuffer, TestMergeRegions)
+{
+  DirtyRegions regions;
+  // overlapping
+  regions.add(Rect<int>(0, 0, 10, 10), 100, 100);
+  regions.add(Rect<int>(5, 0, 10, 10), 100, 100);
+  ASSERT_EQ(regions.get().size(), 1);
+  ASSERT_EQ(regions.get()[0].width, 15);
+  ASSERT_EQ(regions.get()[0].height, 10);
+
+  // adjacent
+  regions.add(Rect<int>(0, 10, 15, 5), 100, 100);
+  ASSERT_EQ(regions.get().size(), 1);
+  ASSERT_EQ(regions.getArea(), 15 * 15);
+
+  // contained
+  regions.add(Rect<int>(2, 2, 3, 3), 100, 100);
+  ASSERT_EQ(regions.get().size(), 1);
+
+  // distant
+  regions.add(Rect<int>(80, 80, 10, 10), 100, 100);
+  ASSERT_EQ(regions.get().size(), 2);
+
+  // clipped
+  regions.clear();
+  regions.add(Rect<int>(-5, -5, 10, 10), 100, 100);
+  regions.add(Rect<int>(200, 0, 10, 10), 100, 100);
+  ASSERT_EQ(regions.get().size(), 1);
+  ASSERT_EQ(regions.getArea(), 25);
+}
+
+TEST_F(TestStagingBuffer, TestRegionsLimit)
+{
+  DirtyRegions regions(4);
+  std::vector<Rect<int>> rects;
+  for(int i = 0; i < 20; ++i) {
+    rects.emplace_back((i * 37) % 90, (i * 53) % 90, 5, 5);
+    regions.add(rects.back(), 100, 100);
+    ASSERT_LE(regions.get().size(), 4);
+  }
+
+  for(auto& rect : rects) {
+    ASSERT_TRUE(containsRect(regions.get(), rect));
+  }
+}
+
+TEST_F(TestStagingBuffer, TestPartialUpdates)
+{
+  ASSERT_FALSE(mStaging.acquire());
+
+  paint(Rect<int>(0, 0, mWidth, mHeight), 1);
+  ASSERT_TRUE(mStaging.hasChanges());
+  ASSERT_TRUE(mStaging.acquire());
+  ASSERT_FALSE(mStaging.hasChanges());
+  ASSERT_TRUE(frontMatches());
+  ASSERT_FALSE(mStaging.acquire());
+
+  // back buffer should get the changes which were made to the other buffer
+  for(int i = 0; i < 50; ++i) {
+    std::vector<Rect<int>> areas = {
+      Rect<int>(i % 50, i % 20, 10, 10),
+      Rect<int>((i * 7) % 60, (i * 3) % 30, 3, 2)
+    };
+    paint(areas, (char)(i + 2));
+    if(i % 3 == 0) {
+      paint(Rect<int>((i * 11) % 40, 5, 20, 1), (char)(i + 100));
+    }
+
+    ASSERT_TRUE(mStaging.acquire());
+    ASSERT_TRUE(frontMatches()) << "frame " << i;
+    for(auto& area : areas) {
+      ASSERT_TRUE(containsRect(mStaging.getRegions(), area));
+    }
+  }
+}
+
+TEST_F(TestStagingBuffer, TestResize)
+{
+  paint(Rect<int>(0, 0, mWidth, mHeight), 1);
+  ASSERT_TRUE(mStaging.acquire());
+
+  resize(128, 16);
+  paint(Rect<int>(0, 0, 10, 10), 2);
+  ASSERT_TRUE(mStaging.acquire());
+  ASSERT_EQ(mStaging.getRegions().size(), 1);
+  ASSERT_EQ(mStaging.getRegions()[0].width, 128);
+  ASSERT_EQ(mStaging.getRegions()[0].height, 16);
+
+  paint(Rect<int>(0, 0, mWidth, mHeight), 3);
+  ASSERT_TRUE(mStaging.acquire());
+  ASSERT_TRUE(frontMatches());
+
+  paint(Rect<int>(5, 5, 10, 10), 4);
+  ASSERT_TRUE(mStaging.acquire());
+  ASSERT_TRUE(frontMatches());
+
+  mStaging.reset();
+  ASSERT_EQ(mStaging.getSize(), 0);
+  ASSERT_FALSE(mStaging.acquire());
+}
+
+TEST_F(TestStagingBuffer, TestCopyRows)
+{
+  // big enough to be split between threads
+  const size_t width = 2048 * 4;
+  const size_t height = 1024;
+  const size_t destPitch = width + 64;
+  std::vector<char> src(width * height);
+  std::vector<char> dest(destPitch * height, 0);
+  for(size_t i = 0; i < src.size(); ++i) {
+    src[i] = (char)(i * 31 % 251);
+  }
+
+  StagingBuffer::copyRows(dest.data(), destPitch, src.data(), width, width, height);
+  for(size_t row = 0; row < height; ++row) {
+    ASSERT_EQ(memcmp(&dest[row * destPitch], &src[row * width], width), 0);
+    ASSERT_EQ(dest[row * destPitch + width], 0);
+  }
+}
+
+// benchmark, run with --gtest_also_run_disabled_tests
+TEST_F(TestStagingBuffer, DISABLED_BenchmarkWebviewPaints)
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  // 2 seconds of 60 Hz paints of a full HD webview: a blinking cursor, a small
+  // animated widget and scattered text updates, full repaint every second
+  resize(1920, 1080);
+  const int frames = 120;
+  std::vector<char> texture(mImage.size(), 0);
+  std::atomic<bool> finished(false);
+  size_t blitted = 0;
+  size_t naive = 0;
+  std::atomic<int> acquired(0);
+
+  auto blit = [&] () {
+    if(!mStaging.acquire()) {
+      return false;
+    }
+    size_t pitch = mStaging.getWidth() * mStaging.getPixelSize();
+    for(auto& area : mStaging.getRegions()) {
+      size_t offset = area.y * pitch + area.x * mStaging.getPixelSize();
+      StagingBuffer::copyRows(&texture[offset], pitch, mStaging.getData() + offset, pitch, area.width * mStaging.getPixelSize(), area.height);
+      blitted += area.width * area.height;
+    }
+    acquired++;
+    return true;
+  };
+
+  auto start = Clock::now();
+  std::thread renderThread([&] () {
+    while(!finished.load()) {
+      if(!blit()) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  double writeTime = 0;
+  for(int frame = 0; frame < frames; ++frame) {
+    std::vector<Rect<int>> areas;
+    if(frame % 60 == 0) {
+      areas.emplace_back(0, 0, mWidth, mHeight);
+    } else {
+      areas.emplace_back(400, 300, 2, 20);
+      areas.emplace_back(1500 + frame % 20, 100, 200, 200);
+      for(int i = 0; i < 10; ++i) {
+        areas.emplace_back((frame * 97 + i * 173) % 1800, (frame * 31 + i * 101) % 1000, 120, 16);
+      }
+    }
+
+    for(auto& area : areas) {
+      naive += area.width * area.height;
+    }
+
+    auto writeStart = Clock::now();
+    paint(areas, (char)frame);
+    writeTime += std::chrono::duration<double>(Clock::now() - writeStart).count();
+
+    // the render thread picks up each paint, like it would do once per frame
+    while(acquired.load() <= frame) {
+      std::this_thread::yield();
+    }
+  }
+  finished.store(true);
+  renderThread.join();
+  while(blit()) {}
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  LOG(INFO) << "Staging buffer, " << frames << " webview paints: " << elapsed << "s total, "
+    << writeTime << "s in writes, " << acquired << " frames blitted, "
+    << blitted << " pixels blitted, " << naive << " pixels painted";
+
+  ASSERT_EQ(memcmp(texture.data(), mImage.data(), mImage.size()), 0);
+}
@@ -0,0 +1,126 @@
+#include "TimerWheel.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include "Logger.h"
+
+using namespace Gsage;
+
+TEST(TestTimerWheel, TestExpireInOrder)
+{
+  TimerWheel wheel;
+  TimerWheel::Payloads expired;
+
+  wheel.schedule(10, 1);
+  wheel.schedule(5, 2);
+  wheel.schedule(100, 3);
+  wheel.schedule(5000, 4);
+  ASSERT_EQ(wheel.size(), 4);
+
+  ASSERT_EQ(wheel.advance(4, expired), 0);
+  ASSERT_EQ(wheel.advance(5, expired), 1);
+  ASSERT_EQ(expired.back(), 2);
+  ASSERT_EQ(wheel.advance(99, expired), 1);
+  ASSERT_EQ(expired.back(), 1);
+  ASSERT_EQ(wheel.advance(100, expired), 1);
+  ASSERT_EQ(expired.back(), 3);
+  ASSERT_EQ(wheel.advance(4999, expired), 0);
+  ASSERT_EQ(wheel.advance(6000, expired), 1);
+  ASSERT_EQ(expired.back(), 4);
+  ASSERT_EQ(wheel.size(), 0);
+}
+
+TEST(TestTimerWheel, TestDueTimers)
+{
+  TimerWheel wheel;
+  TimerWheel::Payloads expired;
+  wheel.advance(64, expired);
+
+  // timers that are already due fire on the next advance, even if the tick does not change
+  wheel.schedule(64, 1);
+  wheel.schedule(10, 2);
+  ASSERT_EQ(wheel.advance(64, expired), 2);
+  ASSERT_EQ(wheel.size(), 0);
+}
+
+/**
+ * Compare wheel against the sorted map with random timers
+ */
+void compareWithReference(int maxDelay, int maxStep)
+{
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> delay(0, maxDelay);
+  std::uniform_int_distribution<int> step(1, maxStep);
+
+  TimerWheel wheel;
+  std::multimap<TimerWheel::Tick, TimerWheel::Payload> reference;
+  TimerWheel::Payloads expired;
+
+  TimerWheel::Payload id = 0;
+  TimerWheel::Tick now = 0;
+  for(int i = 0; i < 2000; ++i) {
+    for(int j = 0; j < 10; ++j) {
+      TimerWheel::Tick expire = now + delay(gen);
+      wheel.schedule(expire, id);
+      reference.emplace(expire, id++);
+    }
+
+    now += step(gen);
+    expired.clear();
+    wheel.advance(now, expired);
+
+    std::vector<TimerWheel::Payload> expected;
+    auto end = reference.upper_bound(now);
+    for(auto it = reference.begin(); it != end; ++it) {
+      expected.push_back(it->second);
+    }
+    reference.erase(reference.begin(), end);
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(expired.begin(), expired.end());
+    ASSERT_EQ(expected, expired) << "mismatch at tick " << now;
+    ASSERT_EQ(wheel.size(), reference.size());
+  }
+}
+
+TEST(TestTimerWheel, TestMatchesReference)
+{
+  compareWithReference(1 << 20, 5000);
+  // exercise upper levels and overflow list
+  compareWithReference(1 << 27, 1 << 18);
+}
+
+TEST(TestTimerWheel, TestOverflow)
+{
+  TimerWheel wheel;
+  TimerWheel::Payloads expired;
+
+  TimerWheel::Tick far = (TimerWheel::Tick(1) << 26) + 17;
+  wheel.schedule(far, 1);
+  ASSERT_EQ(wheel.advance(far - 1, expired), 0);
+  ASSERT_EQ(wheel.advance(far, expired), 1);
+}
+
+TEST(TestTimerWheel, TestAdvanceCost)
+{
+  TimerWheel wheel;
+  TimerWheel::Payloads expired;
+  int count = 1000000;
+  for(int i = 0; i < count; ++i) {
+    // all timers wake up far in the future
+    wheel.schedule(1000000 + i, i);
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  // simulate ~16ms frames at 1ms resolution
+  for(int frame = 1; frame < 10000; ++frame) {
+    wheel.advance(frame * 16, expired);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  LOG(INFO) << "10000 idle frames with " << count << " timers took " << elapsed.count() << "us";
+  ASSERT_EQ(expired.size(), 0);
+  ASSERT_EQ(wheel.size(), count);
+}
@@ -0,0 +1,88 @@
+#include "TripleBuffer.h"
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <atomic>
+
+using namespace Gsage;
+
+TEST(TestTripleBuffer, TestSequential)
+{
+  TripleBuffer<int> buffer;
+  ASSERT_FALSE(buffer.acquire());
+
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+
+  // reader gets only the latest published value
+  ASSERT_TRUE(buffer.acquire());
+  ASSERT_EQ(buffer.front(), 2);
+  ASSERT_FALSE(buffer.acquire());
+  ASSERT_EQ(buffer.front(), 2);
+
+  buffer.back() = 3;
+  buffer.publish();
+  ASSERT_TRUE(buffer.acquire());
+  ASSERT_EQ(buffer.front(), 3);
+}
+
+TEST(TestTripleBuffer, TestBuffersAreNotShared)
+{
+  TripleBuffer<int> buffer;
+  for(int i = 0; i < 10; ++i) {
+    buffer.back() = i;
+    buffer.publish();
+    ASSERT_TRUE(buffer.acquire());
+    ASSERT_NE(&buffer.front(), &buffer.back());
+    ASSERT_EQ(buffer.front(), i);
+  }
+}
+
+TEST(TestTripleBuffer, TestParallel)
+{
+  struct Frame {
+    int values[64];
+  };
+
+  TripleBuffer<Frame> buffer;
+  int frames = 100000;
+  std::atomic_bool done(false);
+
+  std::thread writer([&] () {
+    for(int i = 1; i <= frames; ++i) {
+      Frame& frame = buffer.back();
+      for(int j = 0; j < 64; ++j) {
+        frame.values[j] = i;
+      }
+      buffer.publish();
+    }
+    done.store(true);
+  });
+
+  int last = 0;
+  bool consistent = true;
+  while(true) {
+    bool finished = done.load();
+    if(!buffer.acquire()) {
+      if(finished) {
+        break;
+      }
+      continue;
+    }
+
+    Frame& frame = buffer.front();
+    int value = frame.values[0];
+    // frames must be complete and must go in order
+    consistent = consistent && value > last;
+    for(int j = 1; j < 64; ++j) {
+      consistent = consistent && frame.values[j] == value;
+    }
+    last = value;
+  }
+  writer.join();
+
+  ASSERT_TRUE(consistent);
+  ASSERT_EQ(last, frames);
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "UpdateLOD.h"
+#include "SpatialIndex.h"
+#include "Entity.h"
+
+using namespace Gsage;
+
+class TestUpdateLOD : public ::testing::Test
+{
+  public:
+    void SetUp()
+    {
+      mLOD.setEnabled(true);
+      mLOD.setDistances(10, 20, 40);
+      mLOD.setViewer(Vector3(0, 0, 0), SpatialIndex::Planes());
+
+      mIndex.update(&mEntities[0], Vector3(5, 0, 0));
+      mIndex.update(&mEntities[1], Vector3(15, 0, 0));
+      mIndex.update(&mEntities[2], Vector3(0, 0, 30));
+      mIndex.update(&mEntities[3], Vector3(50, 0, 0));
+    }
+
+    int countTicks(Entity* entity, int frames, double& total)
+    {
+      double accumulated = 0;
+      int ticks = 0;
+      total = 0;
+      for(int i = 0; i < frames; ++i) {
+        mLOD.update(mIndex);
+        double delta;
+        if(mLOD.tick(entity, 0.01, accumulated, delta)) {
+          ticks++;
+          total += delta;
+        }
+      }
+      return ticks;
+    }
+
+    UpdateLOD mLOD;
+    SpatialIndex mIndex;
+    // entity with no position stays at the full rate
+    Entity mEntities[5];
+};
+
+TEST_F(TestUpdateLOD, TestDistanceRates)
+{
+  mLOD.update(mIndex);
+  ASSERT_EQ(mLOD.getRate(&mEntities[0]), UpdateLOD::RATE_FULL);
+  ASSERT_EQ(mLOD.getRate(&mEntities[1]), UpdateLOD::RATE_HALF);
+  ASSERT_EQ(mLOD.getRate(&mEntities[2]), UpdateLOD::RATE_QUARTER);
+  ASSERT_EQ(mLOD.getRate(&mEntities[3]), UpdateLOD::RATE_OFF);
+  ASSERT_EQ(mLOD.getRate(&mEntities[4]), UpdateLOD::RATE_FULL);
+
+  mLOD.setEnabled(false);
+  ASSERT_EQ(mLOD.getRate(&mEntities[3]), UpdateLOD::RATE_FULL);
+}
+
+TEST_F(TestUpdateLOD, TestStaleRates)
+{
+  mLOD.update(mIndex);
+  ASSERT_EQ(mLOD.getRate(&mEntities[3]), UpdateLOD::RATE_OFF);
+
+  // removed entity is not rated anymore, so it falls back to the full rate
+  mIndex.remove(&mEntities[3]);
+  mLOD.update(mIndex);
+  ASSERT_EQ(mLOD.getRate(&mEntities[3]), UpdateLOD::RATE_FULL);
+
+  // moved entity gets the new rate on the next frame
+  mIndex.update(&mEntities[2], Vector3(0, 0, 1));
+  mLOD.update(mIndex);
+  ASSERT_EQ(mLOD.getRate(&mEntities[2]), UpdateLOD::RATE_FULL);
+}
+
+TEST_F(TestUpdateLOD, TestInvisibleRate)
+{
+  // looking along X axis, everything behind the viewer is not visible
+  SpatialIndex::Planes planes;
+  SpatialIndex::Plane plane = {Vector3(1, 0, 0), 0};
+  planes.push_back(plane);
+  mLOD.setViewer(Vector3(0, 0, 0), planes);
+  mIndex.update(&mEntities[0], Vector3(-5, 0, 0));
+
+  mLOD.update(mIndex);
+  ASSERT_EQ(mLOD.getRate(&mEntities[0]), UpdateLOD::RATE_QUARTER);
+  // further entities keep the lower rate
+  ASSERT_EQ(mLOD.getRate(&mEntities[3]), UpdateLOD::RATE_OFF);
+}
+
+TEST_F(TestUpdateLOD, TestTickAccumulatesTime)
+{
+  double total;
+  ASSERT_EQ(countTicks(&mEntities[0], 64, total), 64);
+  ASSERT_NEAR(total, 0.64, 1e-9);
+
+  ASSERT_EQ(countTicks(&mEntities[1], 64, total), 32);
+  ASSERT_NEAR(total, 0.64, 0.02);
+
+  ASSERT_EQ(countTicks(&mEntities[2], 64, total), 16);
+  ASSERT_NEAR(total, 0.64, 0.04);
+
+  ASSERT_EQ(countTicks(&mEntities[3], 64, total), 0);
+}
+
+TEST_F(TestUpdateLOD, TestTicksAreSpread)
+{
+  // entities with the same rate should not tick on the same frame
+  mIndex.update(&mEntities[0], Vector3(0, 0, 15));
+  mIndex.update(&mEntities[4], Vector3(0, 15, 0));
+  mLOD.update(mIndex);
+
+  int frames[3] = {0, 0, 0};
+  double accumulated[3] = {0, 0, 0};
+  Entity* entities[3] = {&mEntities[0], &mEntities[1], &mEntities[4]};
+  for(int frame = 0; frame < 2; ++frame) {
+    mLOD.update(mIndex);
+    for(int i = 0; i < 3; ++i) {
+      double delta;
+      if(mLOD.tick(entities[i], 0.01, accumulated[i], delta)) {
+        frames[i] = frame;
+      }
+    }
+  }
+
+  ASSERT_NE(frames[0], frames[1]);
+  ASSERT_NE(frames[1], frames[2]);
+}
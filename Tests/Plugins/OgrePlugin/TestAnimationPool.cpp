@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "AnimationPool.h"
+
+using namespace Gsage;
+
+TEST(TestAnimationPool, TestAllocation)
+{
+  AnimationPool pool;
+  AnimationPool::Handle a = pool.create(0, 1.0f);
+  AnimationPool::Handle b = pool.create(0, 2.0f);
+  ASSERT_EQ(pool.size(), 2);
+  ASSERT_NE(a, b);
+
+  pool.destroy(a);
+  ASSERT_EQ(pool.size(), 1);
+
+  // freed slot is reused and reset
+  AnimationPool::Handle c = pool.create(0, 3.0f);
+  ASSERT_EQ(c, a);
+  ASSERT_FLOAT_EQ(pool.getLength(c), 3.0f);
+  ASSERT_FALSE(pool.hasFlags(c, AnimationPool::Enabled));
+}
+
+TEST(TestAnimationPool, TestLoop)
+{
+  AnimationPool pool;
+  AnimationPool::Handle h = pool.create(0, 1.0f);
+  pool.setFlags(h, AnimationPool::Enabled | AnimationPool::Loop, true);
+  pool.fade(h, true, 2.0f);
+
+  pool.update(0.25f);
+  ASSERT_FLOAT_EQ(pool.getTime(h), 0.25f);
+  ASSERT_FLOAT_EQ(pool.getWeight(h), 0.5f);
+
+  pool.update(1.0f);
+  ASSERT_FLOAT_EQ(pool.getTime(h), 0.25f);
+  ASSERT_FLOAT_EQ(pool.getWeight(h), 1.0f);
+  ASSERT_FALSE(pool.hasFlags(h, AnimationPool::FadeIn));
+
+  // reversed playback wraps from the end
+  pool.setSpeed(h, -1.0f);
+  pool.update(0.5f);
+  ASSERT_FLOAT_EQ(pool.getTime(h), 0.75f);
+}
+
+TEST(TestAnimationPool, TestFiniteAnimationFadesOut)
+{
+  AnimationPool pool;
+  AnimationPool::Handle h = pool.create(0, 1.0f);
+  pool.setFlags(h, AnimationPool::Enabled, true);
+  pool.fade(h, true, 100.0f);
+  pool.update(0.1f);
+  ASSERT_FLOAT_EQ(pool.getWeight(h), 1.0f);
+
+  pool.update(0.75f);
+  ASSERT_FALSE(pool.hasFlags(h, AnimationPool::FadeOut));
+
+  // close to the end fade out starts
+  pool.update(0.06f);
+  ASSERT_TRUE(pool.hasFlags(h, AnimationPool::FadeOut));
+  ASSERT_TRUE(pool.hasFlags(h, AnimationPool::Enabled));
+
+  for(int i = 0; i < 10; ++i) {
+    pool.update(0.1f);
+  }
+
+  ASSERT_FALSE(pool.hasFlags(h, AnimationPool::Enabled));
+  ASSERT_FLOAT_EQ(pool.getWeight(h), 0.0f);
+  ASSERT_FLOAT_EQ(pool.getTime(h), 1.0f);
+}
+
+TEST(TestAnimationPool, TestDisabledAndCulled)
+{
+  AnimationPool pool;
+  AnimationPool::Handle disabled = pool.create(0, 1.0f);
+  AnimationPool::Handle culled = pool.create(0, 1.0f);
+  pool.setFlags(culled, AnimationPool::Enabled | AnimationPool::Loop | AnimationPool::Culled, true);
+
+  pool.update(0.5f);
+  ASSERT_FLOAT_EQ(pool.getTime(disabled), 0.0f);
+  // culled animations keep time in sync, only Ogre state is not updated
+  ASSERT_FLOAT_EQ(pool.getTime(culled), 0.5f);
+  pool.apply();
+}
+
+TEST(TestAnimationPool, TestParallelUpdate)
+{
+  AnimationPool serial;
+  AnimationPool parallel;
+  int count = 20000;
+  for(int i = 0; i < count; ++i) {
+    float length = 1.0f + (i % 7);
+    bool loop = i % 3 != 0;
+    AnimationPool* pools[] = {&serial, &parallel};
+    for(auto pool : pools) {
+      AnimationPool::Handle h = pool->create(0, length);
+      pool->setFlags(h, AnimationPool::Enabled, i % 5 != 0);
+      pool->setFlags(h, AnimationPool::Loop, loop);
+      pool->setSpeed(h, (i % 4) - 1.5f);
+      pool->fade(h, true, 1.0f + (i % 3));
+    }
+  }
+
+  for(int frame = 0; frame < 100; ++frame) {
+    serial.update(1.0f / 60.0f, 1);
+    parallel.update(1.0f / 60.0f, 4);
+  }
+
+  for(AnimationPool::Handle h = 0; h < count; ++h) {
+    ASSERT_EQ(serial.getTime(h), parallel.getTime(h));
+    ASSERT_EQ(serial.getWeight(h), parallel.getWeight(h));
+    ASSERT_EQ(serial.hasFlags(h, AnimationPool::Enabled), parallel.hasFlags(h, AnimationPool::Enabled));
+  }
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <fstream>
+
+#include "MaterialIndex.h"
+#include "Filesystem.h"
+
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/Timestamp.h>
+
+using namespace Gsage;
+
+class TestMaterialIndex : public ::testing::Test
+{
+  public:
+    void SetUp()
+    {
+      mFolder = mFilesystem.join({Poco::Path::temp(), "gsageMaterialIndex"});
+      mFilesystem.rmdir(mFolder, true);
+      mFilesystem.mkdir(mFilesystem.join({mFolder, "sub"}), true);
+    }
+
+    void TearDown()
+    {
+      mFilesystem.rmdir(mFolder, true);
+    }
+
+    std::string write(const std::string& name, const std::string& content, long time)
+    {
+      std::string path = mFilesystem.join({mFolder, name});
+      std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+      stream << content;
+      stream.close();
+      touch(path, time);
+      return path;
+    }
+
+    void touch(const std::string& path, long time)
+    {
+      // explicit times, so the test does not depend on the filesystem time resolution
+      Poco::File(path).setLastModified(Poco::Timestamp::fromEpochTime(1000000 + time));
+    }
+
+    Filesystem mFilesystem;
+    std::string mFolder;
+};
+
+TEST_F(TestMaterialIndex, TestIncrementalScan)
+{
+  std::string a = write("a.material", "material A {}", 1);
+  std::string b = write("b.material", "material B {}\nmaterial C {}", 1);
+  std::string d = write("sub/d.material", "hlms D unlit {}", 1);
+  write("ignored.txt", "material Ignored {}", 1);
+
+  MaterialIndex index(&mFilesystem);
+  MaterialIndex::ScanStats stats = index.scan(mFolder);
+  ASSERT_EQ(stats.parsed, 3);
+  ASSERT_TRUE(stats.changed());
+  ASSERT_EQ(index.size(), 4);
+  ASSERT_EQ(index.find("C")->path, b);
+  ASSERT_EQ(index.find("D")->path, d);
+  ASSERT_TRUE(index.find("Ignored") == nullptr);
+
+  // unchanged: nothing is read
+  stats = index.scan(mFolder);
+  ASSERT_EQ(stats.unchanged, 3);
+  ASSERT_FALSE(stats.changed());
+
+  // touched: the same contents, only modification time is updated
+  touch(a, 2);
+  stats = index.scan(mFolder);
+  ASSERT_EQ(stats.touched, 1);
+  ASSERT_EQ(stats.parsed, 0);
+  ASSERT_EQ(stats.unchanged, 2);
+  ASSERT_EQ(index.find("A")->modified, mFilesystem.getLastModified(a));
+
+  // changed: materials of the file are replaced
+  write("b.material", "material E {}", 3);
+  stats = index.scan(mFolder);
+  ASSERT_EQ(stats.parsed, 1);
+  ASSERT_TRUE(index.find("B") == nullptr);
+  ASSERT_TRUE(index.find("C") == nullptr);
+  ASSERT_EQ(index.find("E")->path, b);
+
+  // removed: materials are dropped
+  Poco::File(d).remove();
+  stats = index.scan(mFolder);
+  ASSERT_EQ(stats.removed, 1);
+  ASSERT_TRUE(index.find("D") == nullptr);
+  ASSERT_EQ(index.size(), 2);
+}
+
+TEST_F(TestMaterialIndex, TestReadWrite)
+{
+  write("a.material", "material A {}", 1);
+  MaterialIndex index(&mFilesystem);
+  index.scan(mFolder);
+
+  std::string path = mFilesystem.join({mFolder, ".materials.index"});
+  ASSERT_TRUE(index.write(path));
+
+  MaterialIndex restored(&mFilesystem);
+  ASSERT_TRUE(restored.read(path));
+  ASSERT_EQ(restored.find("A")->path, index.find("A")->path);
+  // files from the index file are not read again
+  ASSERT_EQ(restored.scan(mFolder).unchanged, 1);
+
+  restored.clear();
+  ASSERT_EQ(restored.size(), 0);
+  ASSERT_FALSE(restored.read(mFilesystem.join({mFolder, "missing.index"})));
+}
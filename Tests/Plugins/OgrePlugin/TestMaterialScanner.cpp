@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <sstream>
+
+#include "MaterialScanner.h"
+#include "Logger.h"
+
+using namespace Gsage;
+
+class TestMaterialScanner : public ::testing::Test
+{
+  public:
+    MaterialScanner::Names scan(const std::string& script)
+    {
+      MaterialScanner::Names names;
+      MaterialScanner::scan(script.data(), script.size(), names);
+      return names;
+    }
+};
+
+TEST_F(TestMaterialScanner, TestDefinitions)
+{
+  std::string script = R"(
+// material Commented
+material Base
+{
+  technique
+  {
+    shadow_caster_material Caster
+    pass
+    {
+      texture_unit { texture base.png }
+    }
+  }
+}
+
+/* material
+   AlsoCommented */
+material Derived/Name.01 : Base
+{
+}
+
+abstract material Abstract {}
+MATERIAL "Quoted name"{}
+hlms Block unlit
+{
+  diffuse 1 1 1
+}
+material Last)";
+
+  MaterialScanner::Names names = scan(script);
+  MaterialScanner::Names expected = {"Base", "Derived/Name.01", "Abstract", "Quoted name", "Block", "Last"};
+  ASSERT_EQ(names, expected);
+}
+
+TEST_F(TestMaterialScanner, TestMalformed)
+{
+  ASSERT_TRUE(scan("").empty());
+  ASSERT_TRUE(scan("material").empty());
+  ASSERT_TRUE(scan("}}} material { A }").empty());
+  ASSERT_TRUE(scan("/* material A").empty());
+
+  MaterialScanner::Names names = scan("}}} material A");
+  ASSERT_EQ(names.size(), 1);
+  ASSERT_EQ(names[0], "A");
+}
+
+TEST_F(TestMaterialScanner, TestHash)
+{
+  std::string a = "material A {}";
+  std::string b = "material B {}";
+  ASSERT_EQ(MaterialScanner::hash(a.data(), a.size()), MaterialScanner::hash(a.data(), a.size()));
+  ASSERT_NE(MaterialScanner::hash(a.data(), a.size()), MaterialScanner::hash(b.data(), b.size()));
+}
+
+// benchmark, run with --gtest_also_run_disabled_tests
+TEST_F(TestMaterialScanner, DISABLED_BenchmarkScan)
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  // 5000 materials, similar to a big project material folder
+  std::stringstream ss;
+  const int count = 5000;
+  for(int i = 0; i < count; ++i) {
+    ss << "material Project/Material" << i << "\n{\n  technique\n  {\n    pass\n    {\n"
+       << "      ambient 0.5 0.5 0.5\n      diffuse 1 1 1\n"
+       << "      texture_unit\n      {\n        texture material" << i << ".png\n      }\n"
+       << "    }\n  }\n}\n\n";
+  }
+  std::string script = ss.str();
+
+  auto start = Clock::now();
+  MaterialScanner::Names names;
+  MaterialScanner::scan(script.data(), script.size(), names);
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  LOG(INFO) << "Material scanner, " << script.size() << " bytes: " << elapsed << "s, " << names.size() << " materials found";
+  ASSERT_EQ(names.size(), count);
+  ASSERT_EQ(names.back(), "Project/Material4999");
+}
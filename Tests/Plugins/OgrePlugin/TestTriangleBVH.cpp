@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "TriangleBVH.h"
+
+using namespace Gsage;
+
+class TestTriangleBVH : public ::testing::Test
+{
+  public:
+    void SetUp()
+    {
+      // grid of quads in the XZ plane, facing up
+      const int size = 16;
+      for(int z = 0; z <= size; ++z) {
+        for(int x = 0; x <= size; ++x) {
+          mVertices.push_back(Ogre::Vector3(x, 0, z));
+        }
+      }
+
+      for(int z = 0; z < size; ++z) {
+        for(int x = 0; x < size; ++x) {
+          Ogre::uint32 i = z * (size + 1) + x;
+          Ogre::uint32 quad[6] = {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2};
+          mIndices.insert(mIndices.end(), quad, quad + 6);
+        }
+      }
+
+      mBVH.build(&mVertices[0], mVertices.size(), &mIndices[0], mIndices.size());
+    }
+
+    std::vector<Ogre::Vector3> mVertices;
+    std::vector<Ogre::uint32> mIndices;
+    TriangleBVH mBVH;
+};
+
+TEST_F(TestTriangleBVH, TestBuild)
+{
+  ASSERT_EQ(mBVH.getTriangleCount(), mIndices.size() / 3);
+  ASSERT_GT(mBVH.getNodeCount(), 1);
+
+  TriangleBVH empty;
+  Ogre::Real distance;
+  ASSERT_TRUE(empty.empty());
+  ASSERT_FALSE(empty.intersect(Ogre::Vector3(0, 10, 0), Ogre::Vector3::NEGATIVE_UNIT_Y, distance));
+}
+
+TEST_F(TestTriangleBVH, TestIntersect)
+{
+  Ogre::Real distance = 0;
+  ASSERT_TRUE(mBVH.intersect(Ogre::Vector3(3.3, 10, 7.7), Ogre::Vector3::NEGATIVE_UNIT_Y, distance));
+  ASSERT_FLOAT_EQ(distance, 10);
+
+  // distance is measured in direction length units
+  ASSERT_TRUE(mBVH.intersect(Ogre::Vector3(3.3, 10, 7.7), Ogre::Vector3(0, -2, 0), distance));
+  ASSERT_FLOAT_EQ(distance, 5);
+
+  // slanted ray
+  ASSERT_TRUE(mBVH.intersect(Ogre::Vector3(0.25, 4, 0.5), Ogre::Vector3(3, -4, 0).normalisedCopy(), distance));
+  ASSERT_FLOAT_EQ(distance, 5);
+
+  // outside of the grid
+  ASSERT_FALSE(mBVH.intersect(Ogre::Vector3(20, 10, 20), Ogre::Vector3::NEGATIVE_UNIT_Y, distance));
+  // pointing away
+  ASSERT_FALSE(mBVH.intersect(Ogre::Vector3(3, 10, 3), Ogre::Vector3::UNIT_Y, distance));
+  // too far
+  ASSERT_FALSE(mBVH.intersect(Ogre::Vector3(3, 10, 3), Ogre::Vector3::NEGATIVE_UNIT_Y, distance, TriangleBVH::CULL_BACK, 5));
+}
+
+TEST_F(TestTriangleBVH, TestCulling)
+{
+  Ogre::Real distance;
+  Ogre::Vector3 below(5.5, -1, 5.5);
+  ASSERT_FALSE(mBVH.intersect(below, Ogre::Vector3::UNIT_Y, distance, TriangleBVH::CULL_BACK));
+  ASSERT_TRUE(mBVH.intersect(below, Ogre::Vector3::UNIT_Y, distance, TriangleBVH::CULL_FRONT));
+  ASSERT_FLOAT_EQ(distance, 1);
+  ASSERT_TRUE(mBVH.intersect(below, Ogre::Vector3::UNIT_Y, distance, TriangleBVH::CULL_NONE));
+
+  Ogre::Vector3 above(5.5, 1, 5.5);
+  ASSERT_FALSE(mBVH.intersect(above, Ogre::Vector3::NEGATIVE_UNIT_Y, distance, TriangleBVH::CULL_FRONT));
+}
+
+TEST_F(TestTriangleBVH, TestMatchesBruteForce)
+{
+  // add a second layer to make rays pick the closest one
+  size_t offset = mVertices.size();
+  for(size_t i = 0; i < offset; ++i) {
+    mVertices.push_back(mVertices[i] + Ogre::Vector3(0.5, 2, 0.5));
+  }
+  size_t count = mIndices.size();
+  for(size_t i = 0; i < count; ++i) {
+    mIndices.push_back(mIndices[i] + offset);
+  }
+  mBVH.build(&mVertices[0], mVertices.size(), &mIndices[0], mIndices.size());
+
+  for(int i = 0; i < 200; ++i) {
+    Ogre::Ray ray(
+        Ogre::Vector3((i * 7) % 19 - 0.63, 5, (i * 13) % 19 - 0.71),
+        Ogre::Vector3(((i * 3) % 5 - 2) * 0.1, -1, ((i * 11) % 5 - 2) * 0.1).normalisedCopy()
+    );
+
+    Ogre::Real expected = -1;
+    for(size_t j = 0; j < mIndices.size(); j += 3) {
+      std::pair<bool, Ogre::Real> hit = Ogre::Math::intersects(ray, mVertices[mIndices[j]], mVertices[mIndices[j + 1]], mVertices[mIndices[j + 2]], true, false);
+      if(hit.first && (expected < 0 || hit.second < expected)) {
+        expected = hit.second;
+      }
+    }
+
+    Ogre::Real distance;
+    bool hit = mBVH.intersect(ray.getOrigin(), ray.getDirection(), distance);
+    ASSERT_EQ(hit, expected >= 0) << "ray " << i;
+    if(hit) {
+      ASSERT_NEAR(distance, expected, 1e-4) << "ray " << i;
+    }
+  }
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include "ChunkyTriMesh.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+class TestChunkyTriMesh : public ::testing::Test
+{
+  public:
+    /**
+     * Generate grid terrain with some height noise, two triangles per cell
+     */
+    void generateTerrain(int width, int height)
+    {
+      mWidth = width;
+      mHeight = height;
+      mVerts.clear();
+      mTris.clear();
+      for(int z = 0; z <= height; ++z) {
+        for(int x = 0; x <= width; ++x) {
+          mVerts.push_back((float)x);
+          mVerts.push_back((float)((x * 7 + z * 3) % 5));
+          mVerts.push_back((float)z);
+        }
+      }
+
+      for(int z = 0; z < height; ++z) {
+        for(int x = 0; x < width; ++x) {
+          int a = z * (width + 1) + x;
+          int b = a + 1;
+          int c = a + width + 1;
+          int d = c + 1;
+          mTris.insert(mTris.end(), {a, c, b, b, c, d});
+        }
+      }
+    }
+
+    int triCount() const
+    {
+      return (int)mTris.size() / 3;
+    }
+
+    /**
+     * Get overlapping leaves by checking each of them
+     */
+    std::vector<int> bruteForceRect(const rcChunkyTriMesh& cm, const float* bmin, const float* bmax)
+    {
+      std::vector<int> res;
+      for(int i = 0; i < cm.nnodes; ++i) {
+        const rcChunkyTriMeshNode& node = cm.nodes[i];
+        if(node.i < 0) {
+          continue;
+        }
+
+        if(bmin[0] > node.bmax[0] || bmax[0] < node.bmin[0] ||
+           bmin[1] > node.bmax[1] || bmax[1] < node.bmin[1]) {
+          continue;
+        }
+        res.push_back(i);
+      }
+      return res;
+    }
+
+    int mWidth;
+    int mHeight;
+    std::vector<float> mVerts;
+    std::vector<int> mTris;
+};
+
+TEST_F(TestChunkyTriMesh, TestDenseRectQuery)
+{
+  generateTerrain(64, 64);
+  rcChunkyTriMesh cm;
+  // small chunks make the whole terrain query return a lot of them
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 4, &cm));
+
+  float bmin[2] = {0.0f, 0.0f};
+  float bmax[2] = {64.0f, 64.0f};
+  std::vector<int> ids;
+  int n = rcGetChunksOverlappingRect(&cm, bmin, bmax, ids);
+  ASSERT_GT(n, 512);
+  ASSERT_EQ(ids, bruteForceRect(cm, bmin, bmax));
+
+  int tris = 0;
+  for(int id : ids) {
+    tris += cm.nodes[id].n;
+  }
+  ASSERT_EQ(tris, triCount());
+
+  // fixed size output is truncated
+  int fixed[512];
+  ASSERT_EQ(rcGetChunksOverlappingRect(&cm, bmin, bmax, fixed, 512), 512);
+  ASSERT_EQ(0, memcmp(fixed, ids.data(), sizeof(fixed)));
+}
+
+TEST_F(TestChunkyTriMesh, TestRectQueryMatchesBruteForce)
+{
+  generateTerrain(100, 80);
+  rcChunkyTriMesh cm;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 32, &cm));
+
+  std::vector<int> ids;
+  for(int i = 0; i < 200; ++i) {
+    float bmin[2] = {(float)(i * 13 % 100) - 5.0f, (float)(i * 7 % 80) - 5.0f};
+    float bmax[2] = {bmin[0] + (float)(i % 30), bmin[1] + (float)(i % 17)};
+    rcGetChunksOverlappingRect(&cm, bmin, bmax, ids);
+    ASSERT_EQ(ids, bruteForceRect(cm, bmin, bmax));
+  }
+
+  // outside of the mesh
+  float bmin[2] = {200.0f, 200.0f};
+  float bmax[2] = {300.0f, 300.0f};
+  ASSERT_EQ(0, rcGetChunksOverlappingRect(&cm, bmin, bmax, ids));
+}
+
+TEST_F(TestChunkyTriMesh, TestSegmentQuery)
+{
+  generateTerrain(100, 80);
+  rcChunkyTriMesh cm;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 32, &cm));
+
+  std::vector<int> ids;
+  int fixed[1024];
+
+  // diagonal, axis parallel and degenerate segments
+  float segments[][4] = {
+    {0.0f, 0.0f, 100.0f, 80.0f},
+    {10.5f, 0.0f, 10.5f, 80.0f},
+    {0.0f, 40.5f, 100.0f, 40.5f},
+    {50.5f, 50.5f, 50.5f, 50.5f}
+  };
+
+  for(auto& s : segments) {
+    float p[2] = {s[0], s[1]};
+    float q[2] = {s[2], s[3]};
+    int n = rcGetChunksOverlappingSegment(&cm, p, q, ids);
+    ASSERT_GT(n, 0);
+    ASSERT_EQ(n, rcGetChunksOverlappingSegment(&cm, p, q, fixed, 1024));
+    ASSERT_EQ(0, memcmp(fixed, ids.data(), sizeof(int) * n));
+
+    // all found chunks must overlap segment bounds
+    float bmin[2] = {std::min(p[0], q[0]), std::min(p[1], q[1])};
+    float bmax[2] = {std::max(p[0], q[0]), std::max(p[1], q[1])};
+    std::vector<int> candidates = bruteForceRect(cm, bmin, bmax);
+    for(int id : ids) {
+      ASSERT_NE(std::find(candidates.begin(), candidates.end(), id), candidates.end());
+    }
+  }
+}
+
+TEST_F(TestChunkyTriMesh, TestParallelBuild)
+{
+  // big enough to be split between threads
+  generateTerrain(400, 200);
+  rcChunkyTriMesh sequential;
+  rcChunkyTriMesh parallel;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 256, &sequential, 1));
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 256, &parallel, 4));
+
+  ASSERT_EQ(sequential.nnodes, parallel.nnodes);
+  ASSERT_EQ(sequential.nwideNodes, parallel.nwideNodes);
+  ASSERT_EQ(sequential.maxTrisPerChunk, parallel.maxTrisPerChunk);
+  ASSERT_EQ(0, memcmp(sequential.tris, parallel.tris, sizeof(int) * triCount() * 3));
+  ASSERT_EQ(0, memcmp(sequential.nodes, parallel.nodes, sizeof(rcChunkyTriMeshNode) * sequential.nnodes));
+}
+
+TEST_F(TestChunkyTriMesh, TestEmptyMesh)
+{
+  rcChunkyTriMesh cm;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(nullptr, nullptr, 0, 256, &cm));
+
+  float bmin[2] = {0.0f, 0.0f};
+  float bmax[2] = {1.0f, 1.0f};
+  std::vector<int> ids;
+  ASSERT_EQ(0, rcGetChunksOverlappingRect(&cm, bmin, bmax, ids));
+}
+
+// benchmark, run with --gtest_also_run_disabled_tests
+TEST_F(TestChunkyTriMesh, DISABLED_BenchmarkSyntheticTerrain)
+{
+  typedef std::chrono::high_resolution_clock Clock;
+  // 1M triangles
+  generateTerrain(1000, 500);
+
+  int threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+  auto start = Clock::now();
+  rcChunkyTriMesh sequential;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 256, &sequential, 1));
+  double sequentialBuild = std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  rcChunkyTriMesh parallel;
+  ASSERT_TRUE(rcCreateChunkyTriMesh(mVerts.data(), mTris.data(), triCount(), 256, &parallel, threads));
+  double parallelBuild = std::chrono::duration<double>(Clock::now() - start).count();
+
+  // tile sized rect queries all over the terrain
+  std::vector<int> ids;
+  size_t found = 0;
+  start = Clock::now();
+  for(int i = 0; i < 10000; ++i) {
+    float bmin[2] = {(float)(i * 37 % 1000), (float)(i * 91 % 500)};
+    float bmax[2] = {bmin[0] + 24.0f, bmin[1] + 24.0f};
+    found += rcGetChunksOverlappingRect(&parallel, bmin, bmax, ids);
+  }
+  double query = std::chrono::duration<double>(Clock::now() - start).count();
+
+  LOG(INFO) << "Chunky tri mesh, " << triCount() << " tris: "
+    << "build " << sequentialBuild << "s, "
+    << "parallel build (" << threads << " threads) " << parallelBuild << "s, "
+    << "10000 rect queries " << query << "s, " << found << " chunks found";
+
+  ASSERT_GT(found, 0);
+}
@@ -26,6 +26,7 @@ THE SOFTWARE.
 
 #define POCO_NO_UNWINDOWS
 #include "GsageFacade.h"
+#include "lua/LuaAllocator.h"
 
 #include <stdio.h>
 #include <thread>
@@ -113,7 +114,7 @@ extern "C" {
       {
         Gsage::GsageFacade facade;
         std::string coreConfig = "testConfig.json";
-        L = lua_open();
+        L = Gsage::LuaAllocator::newState();
         if(!L) {
           LOG(ERROR) << "Lua state is not initialized";
           return 1;
@@ -0,0 +1,22 @@
+-- job module used by workers spec, runs in the worker lua state
+
+return function(args)
+  if args.action == "sum" then
+    local sum = 0
+    for i = 1, args.count do
+      sum = sum + i
+    end
+    return {sum = sum}
+  elseif args.action == "echo" then
+    return args.value
+  elseif args.action == "sandbox" then
+    return {
+      io = io ~= nil,
+      execute = os.execute ~= nil,
+      clock = os.clock ~= nil,
+      engine = core ~= nil
+    }
+  end
+
+  error("unknown action " .. tostring(args.action))
+end
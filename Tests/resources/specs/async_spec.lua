@@ -0,0 +1,94 @@
+local async = require 'lib.async'
+
+describe("async #core", function()
+  local function sleeper(seconds, results, id)
+    local co = coroutine.create(function()
+      async.waitSeconds(seconds)
+      table.insert(results, id)
+    end)
+    coroutine.resume(co)
+    return co
+  end
+
+  it("resumes coroutines after timeout", function()
+    local results = {}
+    local co1 = sleeper(0.5, results, 1)
+    local co2 = sleeper(0.1, results, 2)
+    assert.truthy(async.isSuspended(co1))
+    assert.truthy(async.isSuspended(co2))
+
+    async.addTime(0.2)
+    assert.same({2}, results)
+    assert.falsy(async.isSuspended(co2))
+    assert.truthy(async.isSuspended(co1))
+
+    async.addTime(0.3)
+    assert.same({2, 1}, results)
+    assert.falsy(async.isSuspended(co1))
+    assert.equals("dead", coroutine.status(co1))
+  end)
+
+  it("waits sequentially in one coroutine", function()
+    local count = 0
+    local co = coroutine.create(function()
+      for i = 1, 3 do
+        async.waitSeconds(0.1)
+        count = count + 1
+      end
+    end)
+    coroutine.resume(co)
+
+    for i = 1, 3 do
+      async.addTime(0.1)
+      assert.equals(i, count)
+    end
+    assert.falsy(async.isSuspended(co))
+  end)
+
+  it("calls later with arguments", function()
+    local value
+    async.callLater(0.1, function(a, b)
+      value = a + b
+    end, 1, 2)
+    assert.is_nil(value)
+    async.addTime(0.1)
+    assert.equals(3, value)
+  end)
+
+  it("resumes on signal", function()
+    local results = {}
+    for i = 1, 3 do
+      local co = coroutine.create(function()
+        async.waitSignal("asyncSpec")
+        table.insert(results, i)
+      end)
+      coroutine.resume(co)
+      assert.truthy(async.isSuspended(co))
+    end
+
+    async.signal("unknownSignal")
+    assert.same({}, results)
+    async.signal("asyncSpec")
+    assert.same({1, 2, 3}, results)
+    -- signal list is consumed
+    async.signal("asyncSpec")
+    assert.same({1, 2, 3}, results)
+  end)
+
+  it("survives errors in resumed coroutines", function()
+    local done = false
+    local co1 = coroutine.create(function()
+      async.waitSeconds(0.1)
+      error("expected failure")
+    end)
+    local co2 = coroutine.create(function()
+      async.waitSeconds(0.1)
+      done = true
+    end)
+    coroutine.resume(co1)
+    coroutine.resume(co2)
+    async.addTime(0.1)
+    assert.equals("dead", coroutine.status(co1))
+    assert.truthy(done)
+  end)
+end)
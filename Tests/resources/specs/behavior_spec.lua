@@ -0,0 +1,157 @@
+require 'lib.behaviors'
+local async = require 'lib.async'
+
+describe("native behavior trees #core", function()
+  local calls = {}
+  local counters = {}
+
+  local function record(name)
+    return Leaf(function(self, context)
+      table.insert(calls, name)
+    end)
+  end
+
+  local function count(self, context)
+    counters[self.id] = (counters[self.id] or 0) + 1
+  end
+
+  btree.register("spec.composites", function()
+    return Repeat(
+      Sequence(
+        record("a"),
+        Leaf(function(self, context)
+          context.waitSeconds(0.05)
+          table.insert(calls, "b")
+        end),
+        Invertor(Leaf(function() return false end)),
+        Selector(
+          Leaf(function() return false end),
+          record("c")
+        ),
+        Parallel(
+          record("d"),
+          record("e")
+        )
+      )
+    )
+  end)
+
+  btree.register("spec.once", function()
+    return Sequence(Leaf(count))
+  end)
+
+  btree.register("spec.counter", function()
+    return Repeat(Leaf(count))
+  end)
+
+  local function createEntity(id, behavior)
+    return data:createEntity({
+      id = id,
+      script = {
+        behavior = behavior
+      }
+    })
+  end
+
+  before_each(function()
+    calls = {}
+    counters = {}
+  end)
+
+  after_each(function()
+    local behaviors = core:script().behaviors
+    behaviors.tickBudget = 0
+    behaviors.timeBudget = 0
+    game:reset()
+  end)
+
+  it("runs composite nodes", function()
+    assert.is_not.is_nil(createEntity("btreeComposites", "spec.composites"))
+    async.waitSeconds(0.3)
+
+    assert.truthy(#calls >= 5)
+    assert.same({"a", "b", "c", "d", "e"}, {calls[1], calls[2], calls[3], calls[4], calls[5]})
+  end)
+
+  it("stops finished trees", function()
+    createEntity("btreeOnce", "spec.once")
+    async.waitSeconds(0.2)
+    assert.equals(1, counters.btreeOnce)
+  end)
+
+  it("removes tree with the entity", function()
+    local behaviors = core:script().behaviors
+    local size = behaviors.size
+    createEntity("btreeRemoved", "spec.counter")
+    async.waitSeconds(0.1)
+    assert.equals(size + 1, behaviors.size)
+
+    core:removeEntity("btreeRemoved")
+    async.waitSeconds(0.1)
+    assert.equals(size, behaviors.size)
+  end)
+
+  it("respects tick budget", function()
+    local behaviors = core:script().behaviors
+    behaviors.tickBudget = 1
+    for i = 1, 4 do
+      createEntity("btreeBudget" .. i, "spec.counter")
+    end
+    async.waitSeconds(0.3)
+
+    assert.equals(1, behaviors.tickCount)
+    -- round robin: all trees should be ticked
+    for i = 1, 4 do
+      assert.truthy((counters["btreeBudget" .. i] or 0) > 0)
+    end
+  end)
+end)
+
+describe("behavior tree tick rate LOD #ogre", function()
+  local counters = {}
+
+  btree.register("spec.lod", function()
+    return Repeat(Leaf(function(self, context)
+      counters[self.id] = (counters[self.id] or 0) + 1
+    end))
+  end)
+
+  local function createEntity(id, position)
+    return data:createEntity({
+      id = id,
+      render = {
+        root = {
+          position = position
+        }
+      },
+      script = {
+        behavior = "spec.lod"
+      }
+    })
+  end
+
+  setup(function()
+    game:reset()
+    core:configureSystem("script", {behaviors = {lod = {{distance = 10, interval = 0}, {interval = 0.5}}}}, false)
+    core:script().behaviors:setFocus(Vector3.new(0, 0, 0))
+  end)
+
+  teardown(function()
+    -- single level without interval ticks all trees each frame
+    core:configureSystem("script", {behaviors = {lod = {{interval = 0}}}}, false)
+    game:reset()
+  end)
+
+  it("ticks distant trees less often", function()
+    assert.is_not.is_nil(createEntity("btreeNear", Vector3.new(1, 0, 0)))
+    assert.is_not.is_nil(createEntity("btreeFar", Vector3.new(50, 0, 0)))
+    async.waitSeconds(1)
+
+    local near = counters.btreeNear or 0
+    local far = counters.btreeFar or 0
+    assert.truthy(far > 0)
+    -- first tick, then at most one tick per interval
+    assert.truthy(far <= 3)
+    assert.truthy(near > far)
+  end)
+end)
@@ -0,0 +1,27 @@
+local async = require 'lib.async'
+
+describe("async scheduler #benchmark", function()
+  it("check 100000 sleeping coroutines", function()
+    local count = 0
+    for i = 1, 100000 do
+      local co = coroutine.create(function()
+        async.waitSeconds(100 + i * 0.001)
+        count = count + 1
+      end)
+      coroutine.resume(co)
+    end
+
+    -- idle frames should not depend on the count of sleeping coroutines
+    assert.timing(function()
+      for i = 1, 1000 do
+        async.addTime(0.016)
+      end
+    end, 0.01)
+    assert.equals(0, count)
+
+    assert.timing(function()
+      async.addTime(1000)
+    end, 0.5)
+    assert.equals(100000, count)
+  end)
+end)
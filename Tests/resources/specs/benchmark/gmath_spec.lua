@@ -0,0 +1,34 @@
+local gmath = require 'lib.gmath'
+
+describe("gmath value types #benchmark", function()
+  local count = 1000000
+
+  -- runs vector math and returns time and the garbage collection pause it causes
+  local function measure(create)
+    collectgarbage("collect")
+    local before = collectgarbage("count")
+    local started = os.clock()
+    local acc = create(0, 0, 0)
+    local step = create(0.5, 0.25, 0.125)
+    for i = 1, count do
+      acc = (acc + step) * 0.5
+    end
+    local elapsed = os.clock() - started
+    local garbage = collectgarbage("count") - before
+
+    started = os.clock()
+    collectgarbage("collect")
+    local pause = os.clock() - started
+    return elapsed, garbage, pause
+  end
+
+  it("check one million vector operations", function()
+    local nativeTime, nativeGarbage, nativePause = measure(geometry.Vector3.new)
+    local valueTime, valueGarbage, valuePause = measure(gmath.Vector3)
+
+    if gmath.ffi then
+      assert.is_true(valueTime < nativeTime)
+      assert.is_true(valueGarbage < nativeGarbage)
+    end
+  end)
+end)
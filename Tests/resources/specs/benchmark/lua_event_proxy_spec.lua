@@ -15,7 +15,7 @@ describe("lua event proxy #benchmark", function()
 
     assert.timing(function()
       game:reset()
-    end, 0.6)
+    end, 0.06)
     assert.equals(1000000, count)
   end)
 end)
@@ -0,0 +1,42 @@
+describe("raw geometry extraction #benchmark #ogre", function()
+  local instancesCount = 1000
+
+  setup(function()
+    game:reset()
+    for i = 1, instancesCount do
+      assert.truthy(data:createEntity({
+        id = "geomInstance" .. i,
+        render = {
+          root = {
+            position = Vector3.new(i % 32 * 3, 0, math.floor(i / 32) * 3),
+            children = {{
+              type = "model",
+              mesh = "Cube.mesh",
+              castShadows = true
+            }}
+          }
+        }
+      }))
+    end
+  end)
+
+  teardown(function()
+    game:reset()
+  end)
+
+  it("check 1000 instances", function()
+    local bounds = BoundingBox.new(BoundingBox.EXTENT_INFINITE)
+    local geom = core:render():getGeometry(bounds, 0xFF)
+    local verts = #geom:verts()
+    assert.truthy(verts > 0)
+    assert.equals(0, verts % instancesCount)
+
+    -- mesh data is cached after the first call, so only transforms are applied
+    assert.timing(function()
+      for i = 1, 10 do
+        geom = core:render():getGeometry(bounds, 0xFF)
+      end
+    end, 1)
+    assert.equals(verts, #geom:verts())
+  end)
+end)
@@ -0,0 +1,67 @@
+local async = require 'lib.async'
+
+describe("prefab spawning #benchmark #ogre", function()
+  -- matches default prefab pool size, so all instances are reused on respawn
+  local instancesCount = 64
+
+  local function spawn(prefix, prefab)
+    local started = os.clock()
+    for i = 1, instancesCount do
+      assert.truthy(data:createEntity({
+        id = prefix .. i,
+        render = {
+          prefab = prefab,
+          root = {
+            position = Vector3.new(i % 32 * 3, 0, math.floor(i / 32) * 3),
+            children = {{
+              type = "node",
+              name = "body",
+              children = {{
+                type = "model",
+                mesh = "Cube.mesh",
+                castShadows = true
+              }}
+            }, {
+              type = "model",
+              mesh = "Cube.mesh"
+            }}
+          }
+        }
+      }))
+    end
+    return (os.clock() - started) / instancesCount
+  end
+
+  local function despawn(prefix)
+    for i = 1, instancesCount do
+      assert.truthy(core:removeEntity(prefix .. i))
+    end
+    -- node trees can be destroyed by the render thread
+    async.waitSeconds(0.1)
+  end
+
+  setup(function()
+    game:reset()
+  end)
+
+  teardown(function()
+    game:reset()
+  end)
+
+  it("check " .. instancesCount .. " instances", function()
+    local plain = spawn("plain")
+    despawn("plain")
+    spawn("prefabA", "benchmarkCube")
+    despawn("prefabA")
+    local pooled = spawn("prefabB", "benchmarkCube")
+
+    -- reused node tree belongs to the new owner
+    async.waitSeconds(0.1)
+    local found = core:render():getObjectsInRadius(Vector3.new(3, 0, 0), 1, 0xFF, "prefabB1")
+    assert.equals(1, #found)
+    assert.equals("prefabB1", found[1].id)
+
+    -- pooled node trees skip scene node and item creation
+    assert.truthy(pooled < plain)
+  end)
+end)
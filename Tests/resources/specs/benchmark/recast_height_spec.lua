@@ -0,0 +1,78 @@
+local async = require 'lib.async'
+
+describe("recast height sampling #benchmark #recast #ogre", function()
+  local agentsCount = 10000
+  local framesCount = 60
+
+  local area = {
+    id = "heightArea",
+    render = {
+      root = {
+        scale = Vector3.new(20, 20, 20),
+        children = {{
+          type = "model",
+          mesh = "Cube.mesh",
+          castShadows = true
+        },}
+      }
+    }
+  }
+
+  setup(function()
+    game:reset()
+    assert.truthy(game:loadPlugin("RecastNavigationPlugin"))
+    assert.truthy(game:createSystem("recast"))
+    assert.truthy(data:createEntity(area))
+    assert.truthy(core:navigation():rebuildNavMesh({merge = false, walkableRadius = 0.6}))
+  end)
+
+  teardown(function()
+    game:reset()
+    core:removeSystem("navigation")
+    assert:truthy(game:unloadPlugin("RecastNavigationPlugin"))
+  end)
+
+  -- moves agents for framesCount frames and samples the heights each frame
+  local simulate = function(useHints)
+    math.randomseed(42)
+    local positions = {}
+    local velocities = {}
+    for i = 1, agentsCount do
+      positions[i] = geometry.Vector3.new(math.random(-15, 15), 20, math.random(-15, 15))
+      velocities[i] = geometry.Vector3.new(math.random() - 0.5, 0, math.random() - 0.5) * 0.1
+    end
+
+    local heights = nil
+    local start = os.clock()
+    for frame = 1, framesCount do
+      for i = 1, agentsCount do
+        local p = positions[i] + velocities[i]
+        if math.abs(p.x) > 15 or math.abs(p.z) > 15 then
+          velocities[i] = velocities[i] * -1
+          p = positions[i]
+        end
+        positions[i] = p
+      end
+      heights = core:navigation():getHeights(positions, useHints)
+    end
+    return heights, os.clock() - start
+  end
+
+  it("check 10k moving agents", function()
+    -- before: each point is resolved by the nearest poly query
+    assert.truthy(core:navigation():rebuildNavMesh({merge = false, walkableRadius = 0.6, heightGrid = {enabled = false}}))
+    local exact, before = simulate(false)
+
+    -- after: poly hints, seeded by the height grid
+    assert.truthy(core:navigation():rebuildNavMesh({merge = false, walkableRadius = 0.6}))
+    local heights, after = simulate(true)
+    assert.truthy(after < 2)
+
+    assert.equals(agentsCount, #heights)
+    for i = 1, agentsCount do
+      assert.close_enough(heights[i], 20, 2, 0.5)
+      -- hints and the grid must not change the result
+      assert.close_enough(heights[i], exact[i], 0.01, 0.001)
+    end
+  end)
+end)
@@ -0,0 +1,21 @@
+local async = require 'lib.async'
+
+describe("lua garbage collector #core", function()
+  local gc = game.gc
+
+  it("should report heap stats", function()
+    assert.is_true(gc.heapSize > 0)
+    assert.is_true(gc.budget > 0)
+  end)
+
+  it("should collect garbage in frames", function()
+    local cycles = gc.cycles
+    local maxPause = gc.maxPause
+    for i = 1, 100000 do
+      local garbage = {i}
+    end
+    async.waitSeconds(0.5)
+    assert.is_true(gc.cycles > cycles)
+    assert.is_true(gc.maxPause >= maxPause)
+  end)
+end)
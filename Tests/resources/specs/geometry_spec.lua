@@ -72,4 +72,63 @@ describe("validate primitive", function()
       end)
     end)
   end)
+
+  describe("gmath", function()
+    local gmath = require 'lib.gmath'
+
+    it("should match native Quaternion math", function()
+      local q1 = gmath.Quaternion(1, 4, 0, 1)
+      local q3 = gmath.Quaternion(1, 4, 4, 1)
+      local q = q1 * q3
+      assert.equals(q.w, -16)
+      assert.equals(q.x, 4)
+      assert.equals(q.y, 4)
+      assert.equals(q.z, 18)
+
+      local v = q1 * gmath.Vector3(1, 4, 4)
+      assert.equals(v.x, 40)
+      assert.equals(v.y, -94)
+      assert.equals(v.z, -16)
+
+      local native = geometry.Quaternion.new(0.5, 0.5, 0.5, 0.5)
+      local value = gmath.Quaternion(0.5, 0.5, 0.5, 0.5)
+      for _, f in ipairs({"getPitch", "getYaw", "getRoll"}) do
+        assert.is_true(math.abs(native[f](native, true).radians - value[f](value, true).radians) < 1e-9)
+        assert.is_true(math.abs(native[f](native, false).radians - value[f](value, false).radians) < 1e-9)
+      end
+    end)
+
+    it("should multiply quaternions with distinct components", function()
+      local a = gmath.Quaternion(0.7, 0.3, -1.2, 2.5)
+      local b = gmath.Quaternion(-0.6, -2, 0.4, 1.1)
+      local q = a * b
+      local native = geometry.Quaternion.new(0.7, 0.3, -1.2, 2.5) * geometry.Quaternion.new(-0.6, -2, 0.4, 1.1)
+      for _, c in ipairs({"w", "x", "y", "z"}) do
+        assert.is_true(math.abs(native[c] - q[c]) < 1e-9)
+      end
+    end)
+
+    it("should match native Vector3 math", function()
+      local v1 = gmath.Vector3(1, 4, 0)
+      local v3 = gmath.Vector3(1, 4, 4)
+      assert.truthy(v1 == gmath.Vector3(1, 4, 0))
+      assert.falsy(v1 == v3)
+      assert.truthy(v1 * v3 == gmath.Vector3(1, 16, 0))
+      assert.truthy(v1 * 2 == gmath.Vector3(2, 8, 0))
+      assert.truthy(v1 + v3 == gmath.Vector3(2, 8, 4))
+      assert.equals(16, v1:squaredDistance(v3))
+
+      local cross = v1:crossProduct(v3)
+      local nativeCross = geometry.Vector3.new(1, 4, 0):crossProduct(geometry.Vector3.new(1, 4, 4))
+      assert.equals(nativeCross.x, cross.x)
+      assert.equals(nativeCross.y, cross.y)
+      assert.equals(nativeCross.z, cross.z)
+    end)
+
+    it("should convert to native types", function()
+      local v = gmath.Vector3(1, 2, 3):native()
+      assert.equals(v, geometry.Vector3.new(1, 2, 3))
+      assert.truthy(gmath.Vector3():set(v) == gmath.Vector3(1, 2, 3))
+    end)
+  end)
 end)
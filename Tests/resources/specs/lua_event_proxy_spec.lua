@@ -70,16 +70,44 @@ describe("test event proxy #core", function()
       assert.falsy(gotEvent)
     end)
 
-    pending("unbind in handler", function()
+    it("unbind in handler", function()
+      local count = 0
+      local handlers = {}
       for i = 1, 10 do
         local handle
-        local id
         handle = function(e)
+          count = count + 1
           event:unbind(core, EntityEvent.CREATE, handle)
         end
-        id = event:onEntity(core, EntityEvent.CREATE, handle)
+        handlers[i] = handle
+        event:onEntity(core, EntityEvent.CREATE, handle)
       end
-      local entity = createTestEntity()
+      createTestEntity()
+      assert.equals(10, count)
+      createTestEntity()
+      assert.equals(10, count)
+    end)
+
+    it("should call the rest of handlers if one of them unbinds the next one", function()
+      local calls = {}
+      local first, second, third
+      first = function(e)
+        table.insert(calls, "first")
+        event:unbind(core, EntityEvent.CREATE, second)
+      end
+      second = function(e)
+        table.insert(calls, "second")
+      end
+      third = function(e)
+        table.insert(calls, "third")
+      end
+      event:onEntity(core, EntityEvent.CREATE, first)
+      event:onEntity(core, EntityEvent.CREATE, second)
+      event:onEntity(core, EntityEvent.CREATE, third)
+      createTestEntity()
+      assert.same({"first", "third"}, calls)
+      assert.truthy(event:unbind(core, EntityEvent.CREATE, first))
+      assert.truthy(event:unbind(core, EntityEvent.CREATE, third))
     end)
   end)
 end)
@@ -0,0 +1,52 @@
+local async = require 'lib.async'
+
+describe("#ogre prefabs", function()
+  local function definition(prefab)
+    return {
+      id = "prefabbed",
+      render = {
+        prefab = prefab,
+        root = {
+          children = {{
+            type = "model",
+            mesh = "Cube.mesh"
+          }}
+        }
+      }
+    }
+  end
+
+  setup(function()
+    game:reset()
+  end)
+
+  teardown(function()
+    game:reset()
+  end)
+
+  it("does not write generated names to the definition", function()
+    local def = definition("specCube")
+    assert.truthy(data:createEntity(def))
+    assert.is_nil(def.render.root.children[1].name)
+    assert.truthy(core:removeEntity("prefabbed"))
+    async.waitSeconds(0.1)
+  end)
+
+  it("releases pooled instance when the id is reused", function()
+    assert.truthy(data:createEntity(definition("specCube")))
+    assert.truthy(core:removeEntity("prefabbed"))
+    async.waitSeconds(0.1)
+
+    -- the same id without prefab and with another prefab
+    local plain = definition()
+    assert.truthy(data:createEntity(plain))
+    assert.truthy(core:getEntity("prefabbed").render)
+    assert.truthy(core:removeEntity("prefabbed"))
+    async.waitSeconds(0.1)
+
+    assert.truthy(data:createEntity(definition("specCubeOther")))
+    assert.truthy(core:getEntity("prefabbed").render)
+    assert.truthy(core:removeEntity("prefabbed"))
+    async.waitSeconds(0.1)
+  end)
+end)
@@ -0,0 +1,69 @@
+local async = require 'lib.async'
+
+describe("#ogre spatial index", function()
+  local function createModel(id, position, query)
+    return data:createEntity({
+      id = id,
+      render = {
+        root = {
+          position = position,
+          children = {{
+            type = "model",
+            mesh = "Cube.mesh",
+            query = query
+          }}
+        }
+      }
+    })
+  end
+
+  setup(function()
+    game:reset()
+    createModel("spatialA", Vector3.new(0, 0, 0), "static")
+    createModel("spatialB", Vector3.new(5, 0, 0), "dynamic")
+    createModel("spatialC", Vector3.new(100, 0, 0), "dynamic")
+    -- render system indexes positions on update
+    async.waitSeconds(0.1)
+  end)
+
+  teardown(function()
+    game:reset()
+  end)
+
+  local function ids(entities)
+    local res = {}
+    for i = 1, #entities do
+      res[#res + 1] = entities[i].id
+    end
+    table.sort(res)
+    return res
+  end
+
+  it("should find entities in radius", function()
+    assert.same({"spatialA", "spatialB"}, ids(core.spatial:inRadius(Vector3.new(0, 0, 0), 10)))
+    assert.same({"spatialB"}, ids(core.spatial:inRadius(Vector3.new(0, 0, 0), 10, RenderComponent.DYNAMIC)))
+    assert.same({"spatialB"}, ids(core:render():getObjectsInRadius(Vector3.new(0, 0, 0), 10, 0xFF, "spatialB")))
+  end)
+
+  it("should find nearest entities", function()
+    local nearest = core.spatial:nearest(Vector3.new(90, 0, 0), 2)
+    assert.equals(2, #nearest)
+    assert.equals("spatialC", nearest[1].id)
+    assert.equals("spatialB", nearest[2].id)
+  end)
+
+  it("should run batch queries", function()
+    local res = core.spatial:inRadiusBatch({Vector3.new(0, 0, 0), Vector3.new(100, 0, 0)}, 1)
+    assert.equals(2, #res)
+    assert.same({"spatialA"}, ids(res[1]))
+    assert.same({"spatialC"}, ids(res[2]))
+  end)
+
+  it("should follow entity movement and removal", function()
+    core:getEntity("spatialA").render:setPosition(200, 0, 0)
+    async.waitSeconds(0.1)
+    assert.same({"spatialA"}, ids(core.spatial:inRadius(Vector3.new(200, 0, 0), 1)))
+    core:removeEntity("spatialA")
+    assert.equals(0, #core.spatial:inRadius(Vector3.new(200, 0, 0), 1))
+  end)
+end)
@@ -0,0 +1,78 @@
+local async = require 'lib.async'
+
+describe("#ogre static batching", function()
+  local instancesCount = 32
+
+  setup(function()
+    game:reset()
+    for i = 1, instancesCount do
+      assert.truthy(data:createEntity({
+        id = "batched" .. i,
+        render = {
+          root = {
+            position = Vector3.new(i % 8 * 3, 0, math.floor(i / 8) * 3),
+            children = {{
+              type = "model",
+              mesh = "Cube.mesh",
+              query = "static"
+            }}
+          }
+        }
+      }))
+    end
+
+    assert.truthy(data:createEntity({
+      id = "notBatched",
+      render = {
+        root = {
+          position = Vector3.new(0, 0, 30),
+          children = {{
+            type = "model",
+            mesh = "Cube.mesh",
+            query = "dynamic"
+          }}
+        }
+      }
+    }))
+    -- batches are built on the render system update
+    async.waitSeconds(0.1)
+  end)
+
+  teardown(function()
+    game:reset()
+  end)
+
+  it("should batch static entities sharing mesh", function()
+    local batcher = core:render().staticBatcher
+    assert.equals(1, batcher.batchCount)
+    assert.equals(instancesCount, batcher.batchedCount)
+  end)
+
+  it("should extract geometry of batched entities", function()
+    local geom = core:render():getGeometry(BoundingBox.new(BoundingBox.EXTENT_INFINITE), 0xFF)
+    local verts = #geom:verts()
+    assert.truthy(verts > 0)
+    assert.equals(0, verts % (instancesCount + 1))
+
+    -- entity bindings are kept, so single entity can be found
+    assert.equals(verts / (instancesCount + 1), #core:render():getGeometry({"batched1"}):verts())
+  end)
+
+  it("should rebuild the batch when a member is moved", function()
+    local before = core:render():getGeometry({"batched2"}):bmin()
+    core:getEntity("batched2").render:setPosition(0, 10, 0)
+    async.waitSeconds(0.1)
+
+    assert.equals(instancesCount, core:render().staticBatcher.batchedCount)
+    -- batched entity geometry follows the node
+    local after = core:render():getGeometry({"batched2"}):bmin()
+    assert.close_enough(before.y + 10, after.y, 1, 0.01)
+  end)
+
+  it("should drop removed entities from the batch", function()
+    core:removeEntity("batched1")
+    async.waitSeconds(0.1)
+    assert.equals(instancesCount - 1, core:render().staticBatcher.batchedCount)
+    assert.equals(0, #core:render():getGeometry({"batched1"}):verts())
+  end)
+end)
@@ -0,0 +1,77 @@
+local eal = require 'lib.eal.manager'
+
+describe("entity query #core", function()
+  local function collect(spec)
+    local ids = {}
+    for _, entity in core:query(spec) do
+      ids[#ids + 1] = entity.id
+    end
+    table.sort(ids)
+    return ids
+  end
+
+  before_each(function()
+    data:createEntity({id = "queryStatic", test = {prop = "static"}})
+    data:createEntity({id = "queryDynamic", flags = {"dynamic"}, test = {prop = "dynamic"}})
+    data:createEntity({id = "queryEmpty", flags = {"dynamic"}})
+  end)
+
+  after_each(function()
+    core:removeEntity("queryStatic")
+    core:removeEntity("queryDynamic")
+    core:removeEntity("queryEmpty")
+  end)
+
+  it("filters entities by components and flags", function()
+    assert.same({"queryDynamic", "queryStatic"}, collect({"test"}))
+    assert.same({"queryDynamic"}, collect({"test", flags = {"dynamic"}}))
+    assert.same({}, collect({"test", "unknown"}))
+  end)
+
+  it("keeps matches up to date", function()
+    local query = core:getQuery({"test"})
+    assert.equals(2, query.size)
+    assert.equals(2, core:getQuery({"test", "test"}).size)
+
+    data:createEntity({id = "queryCreated", test = {prop = "created"}})
+    assert.equals(3, query.size)
+    assert.truthy(core:removeEntity("queryCreated"))
+    assert.truthy(core:removeEntity("queryStatic"))
+    assert.same({"queryDynamic"}, collect({"test"}))
+  end)
+
+  it("does not skip entities removed while iterating", function()
+    for i = 1, 5 do
+      data:createEntity({id = "queryRemoved" .. i, test = {prop = "removed"}})
+    end
+
+    local visited = {}
+    for _, entity in core:query({"test"}) do
+      visited[#visited + 1] = entity.id
+      if entity.id:find("queryRemoved") then
+        assert.truthy(core:removeEntity(entity.id))
+      end
+    end
+    table.sort(visited)
+    assert.same({"queryDynamic", "queryRemoved1", "queryRemoved2", "queryRemoved3", "queryRemoved4", "queryRemoved5", "queryStatic"}, visited)
+    assert.same({"queryDynamic", "queryStatic"}, collect({"test"}))
+  end)
+
+  it("matches entities without components", function()
+    data:createEntity({id = "queryBare"})
+    local found = false
+    for _, entity in core:query({}) do
+      found = found or entity.id == "queryBare"
+    end
+    assert.truthy(found)
+    core:removeEntity("queryBare")
+  end)
+
+  it("iterates eal wrappers", function()
+    local ids = {}
+    for wrapper in eal:query({"test", flags = {"dynamic"}}) do
+      ids[#ids + 1] = wrapper.id
+    end
+    assert.same({"queryDynamic"}, ids)
+  end)
+end)
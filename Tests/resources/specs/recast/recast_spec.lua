@@ -139,7 +139,7 @@ describe("#recast #ogre", function()
   local defaultRecastOptions = {
     walkableSlopeAngle = 45,
     merge = false,
-    tileSize = 300,
+    tileSize = 48,
     walkableRadius = 3,
     walkableClimb = 2,
   }
@@ -210,12 +210,169 @@ describe("#recast #ogre", function()
 
     describe("cache", function()
       it("reload works", function()
-        -- TODO
+        game:reset()
+        assert.truthy(data:createEntity(navmeshVerifyCases.entity))
+        assert.truthy(core:navigation():rebuildNavMesh(defaultRecastOptions))
+
+        local pos = geometry.Vector3.new(10, 30, 10)
+        local expected, found = core:navigation():findNearestPointOnNavmesh(pos)
+        assert.truthy(found)
+
+        local path = os.tmpname()
+        assert.truthy(core:navigation():dumpNavMesh(path))
+        game:reset()
+        assert.truthy(core:navigation():loadNavMesh(path))
+        os.remove(path)
+
+        local result, found = core:navigation():findNearestPointOnNavmesh(pos)
+        assert.truthy(found)
+        assert.close_enough(result.x, expected.x, 1, 0.01)
+        assert.close_enough(result.y, expected.y, 1, 0.01)
+        assert.close_enough(result.z, expected.z, 1, 0.01)
+
+        -- loaded tile cache keeps compressed layers, so obstacles still work
+        assert.is_not.equals(0, core:navigation():addObstacle(expected, 1, 2))
+      end)
+
+      it("fails to load missing file", function()
+        assert.falsy(core:navigation():loadNavMesh("missing.navmesh"))
       end)
     end)
   end)
 
 
+  describe("findPath", function()
+    local from = geometry.Vector3.new(-18, 20, -18)
+    local to = geometry.Vector3.new(18, 20, 18)
+
+    local rebuild = function(hierarchical)
+      game:reset()
+      assert.truthy(data:createEntity(navmeshVerifyCases.entity))
+      -- small tiles make the path cross a lot of clusters
+      assert.truthy(core:navigation():rebuildNavMesh({
+        merge = false,
+        tileSize = 16,
+        walkableRadius = 0.6,
+        hierarchicalPath = {enabled = hierarchical}
+      }))
+    end
+
+    for _, hierarchical in ipairs({true, false}) do
+      it("finds long path, hierarchical: " .. tostring(hierarchical), function()
+        rebuild(hierarchical)
+        local path = core:navigation():findPath(from, to)
+        assert.is_not.is_nil(path)
+        local last = path[#path]
+        assert.close_enough(last.x, to.x, 2, 0.5)
+        assert.close_enough(last.z, to.z, 2, 0.5)
+      end)
+    end
+
+    local assertSamePath = function(expected, actual)
+      assert.is_not.is_nil(actual)
+      assert.equals(#expected, #actual)
+      for i = 1, #expected do
+        assert.close_enough(actual[i].x, expected[i].x, 0, 0.001)
+        assert.close_enough(actual[i].y, expected[i].y, 0, 0.001)
+        assert.close_enough(actual[i].z, expected[i].z, 0, 0.001)
+      end
+    end
+
+    it("returns cached path for the same clusters", function()
+      rebuild(true)
+      local first = core:navigation():findPath(from, to)
+      assert.is_not.is_nil(first)
+      -- second path is assembled from the cached sections
+      assertSamePath(first, core:navigation():findPath(from, to))
+    end)
+
+    it("drops cached sections blocked by the obstacle", function()
+      rebuild(true)
+      local first = core:navigation():findPath(from, to)
+      assert.is_not.is_nil(first)
+
+      -- tiles under the obstacle are rebuilt on the system update, along with their clusters
+      local ref = core:navigation():addBoxObstacle(geometry.Vector3.new(-3, 18, -3), geometry.Vector3.new(3, 22, 3))
+      assert.is_not.equals(0, ref)
+      async.waitSeconds(0.1)
+
+      local blocked = core:navigation():findPath(from, to)
+      assert.is_not.is_nil(blocked)
+      for _, point in ipairs(blocked) do
+        assert.truthy(math.abs(point.x) > 2.5 or math.abs(point.z) > 2.5)
+      end
+      local last = blocked[#blocked]
+      assert.close_enough(last.x, to.x, 2, 0.5)
+      assert.close_enough(last.z, to.z, 2, 0.5)
+
+      -- the same corridor is restored when the obstacle is removed
+      assert.truthy(core:navigation():removeObstacle(ref))
+      async.waitSeconds(0.1)
+      assertSamePath(first, core:navigation():findPath(from, to))
+    end)
+  end)
+
+  describe("obstacles", function()
+    local center = geometry.Vector3.new(0, 20, 0)
+
+    local rebuild = function()
+      game:reset()
+      assert.truthy(data:createEntity(navmeshVerifyCases.entity))
+      assert.truthy(core:navigation():rebuildNavMesh(defaultRecastOptions))
+    end
+
+    it("cylinder obstacle can be added and removed", function()
+      rebuild()
+      local ref = core:navigation():addObstacle(center, 2, 4)
+      assert.is_not.equals(0, ref)
+      async.waitSeconds(0.1)
+      assert.equals(1, core:navigation().obstacleCount)
+
+      -- nearest point is pushed out of the obstacle
+      local result, found = core:navigation():findNearestPointOnNavmesh(center)
+      assert.truthy(found)
+      assert.truthy(math.sqrt(result.x * result.x + result.z * result.z) > 1)
+
+      assert.truthy(core:navigation():removeObstacle(ref))
+      async.waitSeconds(0.1)
+      assert.equals(0, core:navigation().obstacleCount)
+    end)
+
+    it("box obstacle can be added", function()
+      rebuild()
+      local ref = core:navigation():addBoxObstacle(geometry.Vector3.new(-2, 18, -2), geometry.Vector3.new(2, 22, 2))
+      assert.is_not.equals(0, ref)
+      async.waitSeconds(0.1)
+      assert.equals(1, core:navigation().obstacleCount)
+    end)
+
+    it("component obstacle follows entity lifecycle", function()
+      rebuild()
+      local door = data:createEntity({
+        id = "door",
+        render = {
+          root = {
+            position = Vector3.new(0, 20, 0)
+          }
+        },
+        navigation = {
+          align = false,
+          obstacle = {
+            type = "box",
+            halfExtents = Vector3.new(2, 2, 2)
+          }
+        }
+      })
+      assert.is_not.is_nil(door)
+      async.waitSeconds(0.1)
+      assert.equals(1, core:navigation().obstacleCount)
+
+      core:removeEntity("door")
+      async.waitSeconds(0.1)
+      assert.equals(0, core:navigation().obstacleCount)
+    end)
+  end)
+
   describe("movement", function()
     game:reset()
     cfg = core:render().config
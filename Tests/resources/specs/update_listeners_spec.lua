@@ -0,0 +1,77 @@
+local async = require 'lib.async'
+
+describe("script system update listeners #core", function()
+  local script = core:script()
+
+  local function waitFrames()
+    async.waitSeconds(0.05)
+  end
+
+  it("removes failed listener without breaking others", function()
+    local count = 0
+    local failing = function()
+      error("listener failure")
+    end
+    local counter = function()
+      count = count + 1
+    end
+
+    local before = script.updateListeners
+    script:addUpdateListener(failing)
+    script:addUpdateListener(counter)
+    waitFrames()
+
+    assert.equals(before + 1, script.updateListeners)
+    assert.truthy(count > 0)
+    assert.falsy(script:removeUpdateListener(failing))
+    assert.truthy(script:removeUpdateListener(counter))
+    assert.equals(before, script.updateListeners)
+  end)
+
+  it("allows listeners to unsubscribe during the update", function()
+    local calls = {}
+    local first, second
+    first = function()
+      calls[#calls + 1] = "first"
+      script:removeUpdateListener(first)
+      script:removeUpdateListener(second)
+    end
+    second = function()
+      calls[#calls + 1] = "second"
+    end
+
+    script:addUpdateListener(first)
+    script:addUpdateListener(second)
+    waitFrames()
+    assert.same({"first"}, calls)
+  end)
+
+  it("calls listeners added during the update from the next one", function()
+    local calls = 0
+    local added = function()
+      calls = calls + 1
+    end
+    local adder
+    adder = function()
+      script:addUpdateListener(added)
+      script:removeUpdateListener(adder)
+      assert.equals(0, calls)
+    end
+
+    script:addUpdateListener(adder)
+    waitFrames()
+    assert.truthy(calls > 0)
+    script:removeUpdateListener(added)
+  end)
+
+  it("measures listener time", function()
+    local listener = function() end
+    script.profileListeners = true
+    script:addUpdateListener(listener)
+    waitFrames()
+    local times = script:getListenerTimes()
+    assert.is_not_nil(times[listener])
+    script:removeUpdateListener(listener)
+    script.profileListeners = false
+  end)
+end)
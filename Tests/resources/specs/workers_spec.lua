@@ -0,0 +1,47 @@
+local async = require 'lib.async'
+
+describe("lua workers #core", function()
+  it("runs job in the worker state", function()
+    local value, err = async.runJob("jobs.test", {action = "sum", count = 100})
+    assert.is_nil(err)
+    assert.equals(5050, value.sum)
+  end)
+
+  it("returns scalar values", function()
+    assert.equals("hello", async.runJob("jobs.test", {action = "echo", value = "hello"}))
+    assert.equals(42, async.runJob("jobs.test", {action = "echo", value = 42}))
+  end)
+
+  it("reports job errors", function()
+    local value, err = async.runJob("jobs.test", {action = "none"})
+    assert.is_nil(value)
+    assert.truthy(string.find(err, "unknown action none", 1, true))
+
+    value, err = async.runJob("jobs.missing")
+    assert.is_nil(value)
+    assert.is_not_nil(err)
+  end)
+
+  it("restricts worker states", function()
+    local value = async.runJob("jobs.test", {action = "sandbox"})
+    assert.same({io = false, execute = false, clock = true, engine = false}, value)
+  end)
+
+  it("runs jobs in parallel", function()
+    local workers = core:script().workers
+    local ids = {}
+    for i = 1, 8 do
+      ids[i] = workers:submit("jobs.test", {action = "sum", count = i})
+    end
+
+    for i, id in ipairs(ids) do
+      if not workers:isDone(id) then
+        async.waitSignal("job:" .. id)
+      end
+      local done, value = workers:result(id)
+      assert.truthy(done)
+      assert.equals(i * (i + 1) / 2, value.sum)
+    end
+    assert.equals(0, workers.pending)
+  end)
+end)
@@ -1,25 +1,20 @@
 require 'coroutine'
-local time = require 'lib.time'
 
 local async = {}
 
 -- This file implements waitSeconds, waitSignal, signal, and their supporting stuff.
-
--- This table is indexed by coroutine and simply contains the time at which the coroutine
--- should be woken up.
-local WAITING_ON_TIME = {}
-
-local WAITING_ON_SIGNAL_ALL = {}
-
--- This table is indexed by signal and contains list of coroutines that are waiting
--- on a given signal
-local WAITING_ON_SIGNAL = {}
-
--- Keep track of how long the game has been running.
-local CURRENT_TIME = 0
+-- Suspended coroutines are kept by the native scheduler owned by the script system:
+-- timers live in the timer wheel, signal waits are indexed by the signal name,
+-- and the script system resumes all woken coroutines in one batch on each update.
+
+local function scheduler()
+  local script = core:script()
+  assert(script ~= nil, "Script system is not initialized")
+  return script.scheduler
+end
 
 function async.isSuspended(co)
-  return WAITING_ON_TIME[co] ~= nil or WAITING_ON_SIGNAL_ALL[co] ~= nil
+  return scheduler():isSuspended(co)
 end
 
 function async.waitSeconds(seconds)
@@ -28,10 +23,7 @@ function async.waitSeconds(seconds)
 
     -- If co is nil, that means we're on the main process, which isn't a coroutine and can't yield
     assert(co ~= nil, "The main thread cannot wait!")
-
-    -- Store the coroutine and its wakeup time in the WAITING_ON_TIME table
-    local wakeupTime = CURRENT_TIME + seconds
-    WAITING_ON_TIME[co] = wakeupTime
+    assert(scheduler():waitSeconds(seconds), "The main thread cannot wait!")
 
     -- And suspend the process
     return coroutine.yield(co)
@@ -47,56 +39,45 @@ function async.callLater(seconds, callback, ...)
   return co
 end
 
+-- Advance scheduler time manually
+-- Script system does it automatically on each update, so it is only useful in tests
 function async.addTime(deltaTime)
-    -- This function should be called once per game logic update with the amount of time
-    -- that has passed since it was last called
-    CURRENT_TIME = CURRENT_TIME + deltaTime
-
-    -- First, grab a list of the threads that need to be woken up. They'll need to be removed
-    -- from the WAITING_ON_TIME table which we don't want to try and do while we're iterating
-    -- through that table, hence the list.
-
-    local threadsToWake = {}
-    for co, wakeupTime in pairs(WAITING_ON_TIME) do
-        if wakeupTime < CURRENT_TIME then
-            table.insert(threadsToWake, co)
-        end
-    end
-
-    -- Now wake them all up.
-    for _, co in pairs(threadsToWake) do
-        WAITING_ON_TIME[co] = nil -- Setting a field to nil removes it from the table
-        coroutine.resume(co)
-    end
+  scheduler():update(deltaTime)
 end
 
 function async.waitSignal(signalName)
     -- Same check as in waitSeconds; the main thread cannot wait
     local co = coroutine.running()
     assert(co ~= nil, "The main thread cannot wait!")
+    assert(scheduler():waitSignal(signalName), "The main thread cannot wait!")
 
-    if WAITING_ON_SIGNAL[signalName] == nil then
-        -- If there wasn't already a list for this signal, start a new one.
-        WAITING_ON_SIGNAL[signalName] = { co }
-    else
-        table.insert(WAITING_ON_SIGNAL[signalName], co)
-    end
-
-    WAITING_ON_SIGNAL_ALL[co] = true
     return coroutine.yield()
 end
 
 function async.signal(signalName)
-    local threads = WAITING_ON_SIGNAL[signalName]
-    if threads == nil then return end
-
-    WAITING_ON_SIGNAL[signalName] = nil
-    for _, co in pairs(threads) do
-        WAITING_ON_SIGNAL_ALL[co] = nil
-        coroutine.resume(co)
-    end
+  scheduler():signal(signalName)
 end
 
-time.addHandler("async", async.addTime, true)
+-- Run the job on the worker thread and wait for the result.
+-- Job module should return a function, which gets the copy of args and returns a value.
+-- Worker states are isolated, so only plain data can be passed to the job and back.
+-- @param module job module name
+-- @param args job arguments table
+-- @returns job result and error message if the job failed
+function async.runJob(module, args)
+  local co = coroutine.running()
+  assert(co ~= nil, "The main thread cannot wait!")
+
+  local workers = core:script().workers
+  local id = workers:submit(module, args)
+  assert(id ~= 0, "Failed to submit job " .. module)
+
+  if not workers:isDone(id) then
+    async.waitSignal("job:" .. id)
+  end
+
+  local _, value, err = workers:result(id)
+  return value, err
+end
 
 return async
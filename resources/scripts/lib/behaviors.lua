@@ -6,32 +6,6 @@ btree = btree or {}
 
 btree.factories = {}
 
-function btree.initialize(id, behaviorId)
-  if btree[id] ~= nil then
-    return btree[id]
-  end
-
-  local tree = btree.getBehavior(behaviorId)
-  if tree == nil then
-    return nil
-  end
-
-  btree[id] = BehaviorTree(RunContext(id))
-  btree[id]:start(tree)
-  log.info("Started btree for object " .. id)
-  return btree[id]
-end
-
-function btree.deinitialize(id)
-  if btree[id] == nil then
-    log.warn("Tried to stop non-existing tree with id " .. id)
-    return
-  end
-  btree[id]:stop()
-  log.info("Stopped btree for object " .. id)
-  btree[id] = nil
-end
-
 function btree.getBehavior(behaviorId)
   if not btree.factories[behaviorId] then
     local succeed, err = pcall(function() require(behaviorId) end)
@@ -51,40 +25,41 @@ function btree.register(behaviorId, tree)
   btree.factories[behaviorId] = tree
 end
 
---------------------------------------------------------------------------------
--- BehaviorTree class
---------------------------------------------------------------------------------
-
-BehaviorTree = class(function(self, context)
-  self.currentBehavior = nil
-  self.context = context
-  self.context.delta = 0
-  self.mainCoroutine = nil
-  self.context.waitSeconds = function(time)
+-- create run context for the native behavior tree executor
+-- @param id entity id
+function btree.createContext(id)
+  local context = RunContext(id)
+  context.delta = 0
+  context.waitSeconds = function(time)
     async.waitSeconds(time)
   end
-end)
-
-function BehaviorTree:start(rootNode)
-  self.mainCoroutine = coroutine.create(
-    function()
-      rootNode:run(self.context)
-      self:stop()
-    end
-  )
+  return context
 end
 
-function BehaviorTree:update(time)
-  if async.isSuspended(self.mainCoroutine) then
-    return
+-- run leaf callback
+-- native executor calls it in a separate coroutine, so leaf can wait
+-- @param callback leaf function
+-- @param context run context
+function btree.runLeaf(callback, context)
+  if not context.valid then
+    return false
   end
 
-  self.context.delta = time
-  coroutine.resume(self.mainCoroutine)
-end
+  local entity = eal:getEntity(context.id)
+  if not entity then
+    return false
+  end
+
+  local succeed, res = pcall(function() return callback(entity, context) end)
+  if not succeed then
+    log.error("Failed to call leaf: " .. tostring(res))
+    return false
+  end
 
-function BehaviorTree:stop()
-  self.mainCoroutine = nil
+  if res == nil then
+    return true
+  end
+  return res
 end
 
 --------------------------------------------------------------------------------
@@ -170,6 +145,7 @@ Repeat = class(BaseBehavior, function(self, ...)
   BaseBehavior.init(self, ({...}))
   self.running = true
 end)
+Repeat.nodeType = "repeat"
 
 function Repeat:run(context)
   self.running = true
@@ -190,6 +166,7 @@ end
 RepeatUntil = class(BaseBehavior, function(self, ...)
   BaseBehavior.init(self, ({...}))
 end)
+RepeatUntil.nodeType = "repeatUntil"
 
 function RepeatUntil:run(context)
   self.running = true
@@ -214,6 +191,7 @@ end
 Sequence = class(BaseBehavior, function(self, ...)
   BaseBehavior.init(self, ({...}))
 end)
+Sequence.nodeType = "sequence"
 
 function Sequence:run(context)
   local success = true
@@ -233,6 +211,7 @@ end
 Selector = class(BaseBehavior, function(self, ...)
   BaseBehavior.init(self, ({...}))
 end)
+Selector.nodeType = "selector"
 
 function Selector:run(context)
   local success = false
@@ -245,6 +224,27 @@ function Selector:run(context)
   return success
 end
 
+--------------------------------------------------------------------------------
+-- Parallel behavior class
+--------------------------------------------------------------------------------
+
+Parallel = class(BaseBehavior, function(self, ...)
+  BaseBehavior.init(self, ({...}))
+end)
+Parallel.nodeType = "parallel"
+
+-- runs all children, succeeds when all children succeed
+-- coroutine based runner can't interleave children, so they run one after another
+function Parallel:run(context)
+  local success = true
+  for _, child in pairs(self.children) do
+    if not child:run(context) then
+      success = false
+    end
+  end
+  return success
+end
+
 --------------------------------------------------------------------------------
 -- Invertor behavior class
 --------------------------------------------------------------------------------
@@ -252,6 +252,7 @@ end
 Invertor = class(BaseBehavior, function(self, child)
   self.child = child
 end)
+Invertor.nodeType = "invertor"
 
 function Invertor:__init(child)
   self.child = child
@@ -268,6 +269,7 @@ end
 Successor = class(BaseBehavior, function(self, child)
   self.child = child
 end)
+Successor.nodeType = "successor"
 
 function Successor:run(context)
   if self.child then
@@ -283,27 +285,10 @@ end
 Leaf = class(BaseBehavior, function(self, callback)
   self.callback = callback
 end)
+Leaf.nodeType = "leaf"
 
 function Leaf:run(context)
-  if not context.valid then
-    return false
-  end
-
-  local entity = eal:getEntity(context.id)
-  if not entity then
-    return false
-  end
-
-  local succeed, res = pcall(function() return self.callback(entity, context) end)
-  if not succeed then
-    log.error("Failed to call leaf: " .. res)
-    return false
-  end
-
-  if res == nil then
-    return true
-  end
-  return res
+  return btree.runLeaf(self.callback, context)
 end
 
 --------------------------------------------------------------------------------
@@ -315,6 +300,7 @@ Delay = class(BaseBehavior, function(self, child, delayClosure)
   self.timer = Timer()
   self.delayClosure = delayClosure
 end)
+Delay.nodeType = "delay"
 
 function Delay:run(context)
   if not self.timer.running then
@@ -76,6 +76,20 @@ function EALManager:getEntity(name)
   return self.entities[name]
 end
 
+-- iterate eal wrappers of entities, which have all the components and flags
+-- matches are cached by the engine, so it is cheap to call it each frame
+-- @param spec query spec: {"component1", "component2", flags = {"flag1"}}
+function EALManager:query(spec)
+  local nextEntity, query, index = core:query(spec)
+  return function()
+    local entity
+    index, entity = nextEntity(query, index)
+    if index then
+      return self:getEntity(entity.id)
+    end
+  end
+end
+
 -- assemble entity wrapper
 function EALManager:assemble(name)
   local e = core:getEntity(name)
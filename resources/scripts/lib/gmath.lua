@@ -0,0 +1,292 @@
+-- value type geometry primitives
+--
+-- When running on LuaJIT, Vector3, Quaternion and Radian are FFI structs, which
+-- have the same memory layout as gmath types in C++. Math on them is compiled by
+-- the JIT and does not produce garbage, unlike native usertypes, which are heap
+-- allocated shared pointers.
+--
+-- Plain Lua falls back to the native usertypes, so the module API stays the same.
+
+local hasFFI, ffi = pcall(require, "ffi")
+
+local gmath = {
+  ffi = hasFFI
+}
+
+local sqrt = math.sqrt
+local atan2 = math.atan2
+local asin = math.asin
+local pi = math.pi
+
+if hasFFI then
+  -- keep in sync with Gsage::Vector3, Gsage::Quaternion and Gsage::Radian
+  ffi.cdef[[
+    typedef struct { double x, y, z; } GsageVector3;
+    typedef struct { double x, y, z, w; } GsageQuaternion;
+    typedef struct { double value; } GsageRadian;
+  ]]
+
+  local Vector3
+  local Quaternion
+  local Radian
+
+  local vector3 = {}
+  vector3.__index = vector3
+
+  function vector3.__add(a, b)
+    return Vector3(a.x + b.x, a.y + b.y, a.z + b.z)
+  end
+
+  function vector3.__sub(a, b)
+    return Vector3(a.x - b.x, a.y - b.y, a.z - b.z)
+  end
+
+  function vector3.__unm(a)
+    return Vector3(-a.x, -a.y, -a.z)
+  end
+
+  function vector3.__mul(a, b)
+    if type(a) == "number" then
+      return Vector3(b.x * a, b.y * a, b.z * a)
+    elseif type(b) == "number" then
+      return Vector3(a.x * b, a.y * b, a.z * b)
+    end
+    return Vector3(a.x * b.x, a.y * b.y, a.z * b.z)
+  end
+
+  function vector3.__div(a, b)
+    if type(b) == "number" then
+      return Vector3(a.x / b, a.y / b, a.z / b)
+    end
+    return Vector3(a.x / b.x, a.y / b.y, a.z / b.z)
+  end
+
+  function vector3.__eq(a, b)
+    return ffi.istype(Vector3, b) and a.x == b.x and a.y == b.y and a.z == b.z
+  end
+
+  function vector3.__tostring(a)
+    return "Vector3(" .. a.x .. ", " .. a.y .. ", " .. a.z .. ")"
+  end
+
+  function vector3:dot(other)
+    return self.x * other.x + self.y * other.y + self.z * other.z
+  end
+
+  function vector3:length()
+    return sqrt(self.x * self.x + self.y * self.y + self.z * self.z)
+  end
+
+  function vector3:squaredDistance(other)
+    local x, y, z = self.x - other.x, self.y - other.y, self.z - other.z
+    return x * x + y * y + z * z
+  end
+
+  function vector3:crossProduct(other)
+    return Vector3(
+      self.y * other.z - self.z * other.y,
+      self.z * other.x - self.x * other.z,
+      self.x * other.y - self.y * other.x
+    )
+  end
+
+  function vector3:clamp(maxLength)
+    local length = self:length()
+    if length > maxLength then
+      return self * (maxLength / length)
+    end
+    return Vector3(self.x, self.y, self.z)
+  end
+
+  -- copy values from any object, which has x, y, z fields
+  function vector3:set(other)
+    self.x, self.y, self.z = other.x, other.y, other.z
+    return self
+  end
+
+  -- convert to native usertype, to pass it to C++ functions that accept Vector3
+  function vector3:native()
+    return geometry.Vector3.new(self.x, self.y, self.z)
+  end
+
+  local quaternion = {}
+  quaternion.__index = quaternion
+
+  function quaternion.__mul(a, b)
+    if not ffi.istype(Quaternion, b) then
+      -- rotate vector
+      local ux, uy, uz, s = a.x, a.y, a.z, a.w
+      local du = (ux * b.x + uy * b.y + uz * b.z) * 2
+      local dd = s * s - (ux * ux + uy * uy + uz * uz)
+      local s2 = 2 * s
+      return Vector3(
+        ux * du + b.x * dd + (uy * b.z - uz * b.y) * s2,
+        uy * du + b.y * dd + (uz * b.x - ux * b.z) * s2,
+        uz * du + b.z * dd + (ux * b.y - uy * b.x) * s2
+      )
+    end
+
+    -- raw constructor takes the struct fields order
+    return Quaternion(
+      a.x * b.w + a.w * b.x + a.y * b.z - a.z * b.y,
+      a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+      a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+      a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+    )
+  end
+
+  function quaternion.__eq(a, b)
+    return ffi.istype(Quaternion, b) and a.x == b.x and a.y == b.y and a.z == b.z and a.w == b.w
+  end
+
+  function quaternion.__tostring(a)
+    return "Quaternion(" .. a.w .. ", " .. a.x .. ", " .. a.y .. ", " .. a.z .. ")"
+  end
+
+  function quaternion:getPitch(reprojectAxis)
+    local x, y, z, w = self.x, self.y, self.z, self.w
+    if reprojectAxis then
+      return Radian(atan2(2 * z * y + 2 * x * w, 1 - (2 * x * x + 2 * z * z)))
+    end
+    return Radian(atan2(2 * (y * z + w * x), w * w - x * x - y * y + z * z))
+  end
+
+  function quaternion:getYaw(reprojectAxis)
+    local x, y, z, w = self.x, self.y, self.z, self.w
+    if reprojectAxis then
+      return Radian(atan2(2 * z * x + 2 * y * w, 1 - (2 * x * x + 2 * y * y)))
+    end
+
+    local value = -2 * (x * z - w * y)
+    if value <= -1 then
+      return Radian(-pi / 2)
+    elseif value >= 1 then
+      return Radian(pi / 2)
+    end
+    return Radian(asin(value))
+  end
+
+  function quaternion:getRoll(reprojectAxis)
+    local x, y, z, w = self.x, self.y, self.z, self.w
+    if reprojectAxis then
+      return Radian(atan2(2 * y * x + 2 * z * w, 1 - (2 * y * y + 2 * z * z)))
+    end
+    return Radian(atan2(2 * (x * y + w * z), w * w + x * x - y * y - z * z))
+  end
+
+  function quaternion:set(other)
+    self.x, self.y, self.z, self.w = other.x, other.y, other.z, other.w
+    return self
+  end
+
+  function quaternion:native()
+    return geometry.Quaternion.new(self.w, self.x, self.y, self.z)
+  end
+
+  local radian = {}
+
+  function radian.__index(self, key)
+    if key == "degrees" then
+      return self.value * 180 / pi
+    elseif key == "radians" then
+      return self.value
+    end
+  end
+
+  Vector3 = ffi.metatype("GsageVector3", vector3)
+  Quaternion = ffi.metatype("GsageQuaternion", quaternion)
+  Radian = ffi.metatype("GsageRadian", radian)
+
+  -- create vector
+  function gmath.Vector3(x, y, z)
+    return Vector3(x or 0, y or 0, z or 0)
+  end
+
+  -- create quaternion, argument order is the same as in Quaternion.new
+  function gmath.Quaternion(w, x, y, z)
+    return Quaternion(x or 0, y or 0, z or 0, w or 1)
+  end
+
+  function gmath.Radian(value)
+    return Radian(value)
+  end
+
+  -- check if the object is gmath value type
+  function gmath.isVector3(value)
+    return ffi.istype(Vector3, value)
+  end
+
+  function gmath.isQuaternion(value)
+    return ffi.istype(Quaternion, value)
+  end
+else
+  function gmath.Vector3(x, y, z)
+    return geometry.Vector3.new(x or 0, y or 0, z or 0)
+  end
+
+  function gmath.Quaternion(w, x, y, z)
+    return geometry.Quaternion.new(w or 1, x or 0, y or 0, z or 0)
+  end
+
+  function gmath.Radian(value)
+    return Radian.new(value)
+  end
+
+  function gmath.isVector3(value)
+    return type(value) == "userdata" and value.crossProduct ~= nil
+  end
+
+  function gmath.isQuaternion(value)
+    return type(value) == "userdata" and value.getPitch ~= nil
+  end
+end
+
+-- read render component position into the vector, without intermediate boxing
+-- @param render RenderComponent
+-- @param out optional vector to write to
+function gmath.position(render, out)
+  out = out or gmath.Vector3()
+  out.x, out.y, out.z = render:getPosition()
+  return out
+end
+
+-- set render component position from any object, which has x, y, z fields
+-- @param render RenderComponent
+-- @param position position to set
+function gmath.setPosition(render, position)
+  render:setPosition(position.x, position.y, position.z)
+end
+
+-- read render component orientation into the quaternion
+-- @param render RenderComponent
+-- @param out optional quaternion to write to
+function gmath.orientation(render, out)
+  out = out or gmath.Quaternion()
+  out.w, out.x, out.y, out.z = render:getOrientation()
+  return out
+end
+
+-- set render component orientation from any object, which has w, x, y, z fields
+-- @param render RenderComponent
+-- @param orientation orientation to set
+function gmath.setOrientation(render, orientation)
+  render:setOrientation(orientation.w, orientation.x, orientation.y, orientation.z)
+end
+
+-- read render component direction into the vector
+-- @param render RenderComponent
+-- @param out optional vector to write to
+function gmath.direction(render, out)
+  out = out or gmath.Vector3()
+  out.x, out.y, out.z = render:getDirection()
+  return out
+end
+
+-- send movement component to the point
+-- @param movement MovementComponent
+-- @param target any object, which has x, y, z fields
+function gmath.go(movement, target)
+  movement:go(target.x, target.y, target.z)
+end
+
+return gmath
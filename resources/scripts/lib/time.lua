@@ -54,6 +54,10 @@ function time.removeHandler(id, handler)
     return false
   end
   time.handlers[id] = nil
+  local raw = time.rawHandlers[id]
+  if raw and core:script() then
+    core:script():removeUpdateListener(raw.handler)
+  end
   time.rawHandlers[id] = nil
 
   return true